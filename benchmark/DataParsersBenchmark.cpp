@@ -0,0 +1,95 @@
+/**
+ * Copyright 2023 Wolkabout Technology s.r.o.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "more_modbus/utilities/DataParsers.h"
+
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+using namespace wolkabout::more_modbus;
+
+namespace
+{
+// The number of floats a meter returns in a single group, and how many times the group is parsed.
+const std::size_t VALUE_COUNT = 60;
+const std::size_t ITERATIONS = 200000;
+
+// Runs the parsing the given number of times, and returns the average time it took to parse a single value.
+template <typename Parse> double measure(Parse parse)
+{
+    const auto start = std::chrono::steady_clock::now();
+    for (auto iteration = std::size_t{0}; iteration < ITERATIONS; ++iteration)
+        parse();
+    const auto duration = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start);
+    return duration.count() / static_cast<double>(ITERATIONS * VALUE_COUNT);
+}
+}    // namespace
+
+int main()
+{
+    auto registers = std::vector<uint16_t>{};
+    for (auto index = std::size_t{0}; index < VALUE_COUNT; ++index)
+    {
+        const auto pair = DataParsers::floatToRegisters(static_cast<float>(index) * 0.25f, DataParsers::Endian::BIG);
+        registers.insert(registers.end(), pair.cbegin(), pair.cend());
+    }
+    auto floats = std::vector<float>(VALUE_COUNT);
+    auto int32s = std::vector<int32_t>(VALUE_COUNT);
+    auto uint32s = std::vector<uint32_t>(VALUE_COUNT);
+    // Keeps the compiler from throwing the parsed values away.
+    auto checksum = 0.0;
+
+    const auto single = measure([&] {
+        auto pair = std::vector<uint16_t>(2);
+        for (auto index = std::size_t{0}; index < VALUE_COUNT; ++index)
+        {
+            pair.assign(registers.cbegin() + static_cast<std::ptrdiff_t>(index * 2),
+                        registers.cbegin() + static_cast<std::ptrdiff_t>(index * 2 + 2));
+            floats[index] = DataParsers::registersToFloat(pair, DataParsers::Endian::BIG);
+        }
+        checksum += floats.back();
+    });
+    std::cout << "registersToFloat, one value at a time: " << single << " ns per value" << std::endl;
+
+    const auto orders = {std::make_pair(DataParsers::WordOrder::ABCD, "ABCD"),
+                         std::make_pair(DataParsers::WordOrder::CDAB, "CDAB"),
+                         std::make_pair(DataParsers::WordOrder::BADC, "BADC"),
+                         std::make_pair(DataParsers::WordOrder::DCBA, "DCBA")};
+    for (const auto& order : orders)
+    {
+        const auto batchFloats = measure([&] {
+            DataParsers::registersToFloat(registers.data(), VALUE_COUNT, order.first, floats.data());
+            checksum += floats.back();
+        });
+        const auto batchInt32s = measure([&] {
+            DataParsers::registersToInt32(registers.data(), VALUE_COUNT, order.first, int32s.data());
+            checksum += int32s.back();
+        });
+        const auto batchUint32s = measure([&] {
+            DataParsers::registersToUint32(registers.data(), VALUE_COUNT, order.first, uint32s.data());
+            checksum += uint32s.back();
+        });
+        std::cout << order.second << " batches - float: " << batchFloats << " ns, int32: " << batchInt32s
+                  << " ns, uint32: " << batchUint32s << " ns per value" << std::endl;
+    }
+
+    std::cout << "Checksum: " << checksum << std::endl;
+    return 0;
+}
@@ -19,9 +19,12 @@
 #include "more_modbus/ModbusDevice.h"
 
 #include "core/utilities/Logger.h"
+#include "more_modbus/ModbusReader.h"
 
 #include <algorithm>
+#include <cmath>
 #include <set>
+#include <stdexcept>
 
 using namespace wolkabout::legacy;
 
@@ -30,14 +33,29 @@ namespace wolkabout
 namespace more_modbus
 {
 ModbusDevice::ModbusDevice(const std::string& name, int16_t slaveAddress)
-: m_name(name), m_status(false), m_slaveAddress(slaveAddress), m_groups()
+: m_name(name)
+, m_status(false)
+, m_slaveAddress(slaveAddress)
+, m_maskWriteSupport(MaskWriteSupport::UNKNOWN)
+, m_livenessRegisterType(RegisterType::HOLDING_REGISTER)
+, m_livenessRegisterAddress(-1)
+, m_phaseOffset(0)
+, m_groups()
+, m_bitImageSizes{0, 0}
+, m_rewriteGeneration(0)
 {
 }
 
 ModbusDevice::ModbusDevice(const ModbusDevice& device)
 : m_name(device.m_name)
 , m_status(device.m_status)
+, m_maskWriteSupport(device.m_maskWriteSupport.load())
+, m_livenessRegisterType(device.m_livenessRegisterType)
+, m_livenessRegisterAddress(device.m_livenessRegisterAddress)
+, m_phaseOffset(device.m_phaseOffset)
 , m_groups()
+, m_bitImageSizes{0, 0}
+, m_rewriteGeneration(0)
 , m_reader(device.m_reader)
 , m_onMappingValueChangeBool(device.m_onMappingValueChangeBool)
 , m_onMappingValueChangeBytes(device.m_onMappingValueChangeBytes)
@@ -47,6 +65,12 @@ ModbusDevice::ModbusDevice(const ModbusDevice& device)
     {
         m_groups.emplace_back(std::make_shared<RegisterGroup>(*group));
     }
+    buildImages();
+}
+
+ModbusDevice::~ModbusDevice()
+{
+    releaseImages();
 }
 
 void ModbusDevice::createGroups(const std::vector<std::shared_ptr<RegisterMapping>>& mappings)
@@ -54,12 +78,13 @@ void ModbusDevice::createGroups(const std::vector<std::shared_ptr<RegisterMappin
     std::map<RegisterType, std::shared_ptr<RegisterGroup>> readRestrictedGroups;
     std::set<std::shared_ptr<RegisterMapping>, CompareFunction> set(mappings.begin(), mappings.end());
 
-    std::shared_ptr<RegisterGroup> previousGroup = nullptr;
+    // The last group created for each read period, the mappings are visited sorted by type and address.
+    std::map<std::chrono::milliseconds, std::shared_ptr<RegisterGroup>> previousGroups;
     for (const auto& mapping : set)
     {
         // Add the mapping to rewrite vector if it needs to be rewritten
         if (mapping->getRepeatedWrite().count() > 0)
-            m_rewrite.emplace_back(mapping);
+            addRewritable(mapping);
 
         if (mapping->isReadRestricted())
         {
@@ -67,6 +92,7 @@ void ModbusDevice::createGroups(const std::vector<std::shared_ptr<RegisterMappin
             if (readRestrictedGroups[mapping->getRegisterType()] == nullptr)
             {
                 const auto newGroup = std::make_shared<RegisterGroup>(mapping, shared_from_this());
+                newGroup->setSlaveAddress(m_slaveAddress);
                 readRestrictedGroups[mapping->getRegisterType()] = newGroup;
                 m_groups.insert(m_groups.end(), newGroup);
                 mapping->setGroup(newGroup);
@@ -80,6 +106,7 @@ void ModbusDevice::createGroups(const std::vector<std::shared_ptr<RegisterMappin
         }
         else
         {
+            auto& previousGroup = previousGroups[mapping->getReadPeriod()];
             if (previousGroup == nullptr)
             {
                 previousGroup = std::make_shared<RegisterGroup>(mapping, shared_from_this());
@@ -105,6 +132,9 @@ void ModbusDevice::createGroups(const std::vector<std::shared_ptr<RegisterMappin
         }
     }
 
+    for (const auto& group : m_groups)
+        group->compileDecodePlan();
+    buildImages();
     LOG(DEBUG) << "ModbusDevice: Created " << m_groups.size() << " groups for device " << m_name << ".";
 }
 
@@ -123,11 +153,183 @@ int16_t ModbusDevice::getSlaveAddress() const
     return m_slaveAddress;
 }
 
+MaskWriteSupport ModbusDevice::getMaskWriteSupport() const
+{
+    return m_maskWriteSupport;
+}
+
+void ModbusDevice::setMaskWriteSupport(MaskWriteSupport maskWriteSupport)
+{
+    m_maskWriteSupport = maskWriteSupport;
+}
+
+void ModbusDevice::setLivenessRegister(RegisterType registerType, int32_t address)
+{
+    if (address < 0)
+        throw std::logic_error("ModbusDevice: The liveness register address can not be negative.");
+
+    m_livenessRegisterType = registerType;
+    m_livenessRegisterAddress = address;
+}
+
+bool ModbusDevice::hasLivenessRegister() const
+{
+    return m_livenessRegisterAddress >= 0;
+}
+
+RegisterType ModbusDevice::getLivenessRegisterType() const
+{
+    return m_livenessRegisterType;
+}
+
+int32_t ModbusDevice::getLivenessRegisterAddress() const
+{
+    return m_livenessRegisterAddress;
+}
+
+void ModbusDevice::setPhaseOffset(std::chrono::milliseconds phaseOffset)
+{
+    if (phaseOffset.count() < 0)
+        throw std::logic_error("ModbusDevice: The phase offset can not be negative.");
+
+    m_phaseOffset = phaseOffset;
+}
+
+std::chrono::milliseconds ModbusDevice::getPhaseOffset() const
+{
+    return m_phaseOffset;
+}
+
 const std::vector<std::shared_ptr<RegisterGroup>>& ModbusDevice::getGroups() const
 {
     return m_groups;
 }
 
+Span<const uint16_t> ModbusDevice::getRegisterImage(RegisterType registerType) const
+{
+    const auto index = registerImageIndex(registerType);
+    if (index < 0)
+        return {};
+    return {m_registerImages[index].data(), m_registerImages[index].size()};
+}
+
+BitSpan ModbusDevice::getBitImage(RegisterType registerType) const
+{
+    const auto index = bitImageIndex(registerType);
+    if (index < 0)
+        return {};
+    return {m_bitImages[index].data(), 0, m_bitImageSizes[index]};
+}
+
+void ModbusDevice::storeRead(const RegisterGroup& group, const uint16_t* values)
+{
+    const auto index = registerImageIndex(group.getRegisterType());
+    if (index < 0 || !group.hasImageOffset())
+        return;
+
+    auto& image = m_registerImages[index];
+    const auto offset = group.getImageOffset();
+    if (offset + group.getAddressCount() <= image.size())
+        std::copy(values, values + group.getAddressCount(), image.data() + offset);
+}
+
+void ModbusDevice::storeRead(const RegisterGroup& group, const uint8_t* values)
+{
+    const auto index = bitImageIndex(group.getRegisterType());
+    if (index < 0 || !group.hasImageOffset() ||
+        group.getImageOffset() + group.getAddressCount() > m_bitImageSizes[index])
+        return;
+
+    auto& image = m_bitImages[index];
+    for (auto i = std::size_t{0}; i < group.getAddressCount(); ++i)
+    {
+        const auto bit = group.getImageOffset() + i;
+        const auto mask = std::uint64_t{1} << (bit % 64);
+        if (values[i] != 0)
+            image[bit / 64] |= mask;
+        else
+            image[bit / 64] &= ~mask;
+    }
+}
+
+void ModbusDevice::buildImages()
+{
+    releaseImages();
+    std::size_t registerSizes[2] = {0, 0};
+    std::size_t bitSizes[2] = {0, 0};
+    for (const auto& group : m_groups)
+    {
+        // The images start out empty, so the next read of every group has to be stored.
+        group->forgetLastRead();
+        if (group->isReadRestricted())
+            continue;
+
+        const auto registerIndex = registerImageIndex(group->getRegisterType());
+        const auto bitIndex = bitImageIndex(group->getRegisterType());
+        auto& size = registerIndex >= 0 ? registerSizes[registerIndex] : bitSizes[bitIndex];
+        group->setImageOffset(size);
+        size += group->getAddressCount();
+    }
+
+    for (auto i = 0; i < 2; ++i)
+    {
+        m_registerImages[i].assign(registerSizes[i], 0);
+        m_bitImages[i].assign((bitSizes[i] + 63) / 64, 0);
+        m_bitImageSizes[i] = bitSizes[i];
+    }
+
+    // The values of the mappings are kept in the register images from now on.
+    for (const auto& group : m_groups)
+    {
+        const auto index = registerImageIndex(group->getRegisterType());
+        if (index < 0 || !group->hasImageOffset())
+            continue;
+
+        for (const auto& claim : group->getMappings())
+        {
+            const auto& mapping = claim.second;
+            const auto offset = group->getImageOffset() +
+                                static_cast<std::size_t>(mapping->getStartingAddress() - group->getStartingAddress());
+            mapping->setImageRegisters(m_registerImages[index].data() + offset);
+        }
+    }
+}
+
+void ModbusDevice::releaseImages()
+{
+    for (const auto& group : m_groups)
+    {
+        for (const auto& claim : group->getMappings())
+            claim.second->setImageRegisters(nullptr);
+    }
+}
+
+int ModbusDevice::registerImageIndex(RegisterType registerType)
+{
+    switch (registerType)
+    {
+    case RegisterType::HOLDING_REGISTER:
+        return 0;
+    case RegisterType::INPUT_REGISTER:
+        return 1;
+    default:
+        return -1;
+    }
+}
+
+int ModbusDevice::bitImageIndex(RegisterType registerType)
+{
+    switch (registerType)
+    {
+    case RegisterType::COIL:
+        return 0;
+    case RegisterType::INPUT_CONTACT:
+        return 1;
+    default:
+        return -1;
+    }
+}
+
 std::vector<std::shared_ptr<RegisterMapping>> ModbusDevice::getRewritable() const
 {
     std::lock_guard<std::mutex> lockGuard{m_rewriteMutex};
@@ -137,19 +339,120 @@ std::vector<std::shared_ptr<RegisterMapping>> ModbusDevice::getRewritable() cons
 
 void ModbusDevice::addRewritable(const std::shared_ptr<RegisterMapping>& mapping)
 {
-    std::lock_guard<std::mutex> lockGuard{m_rewriteMutex};
+    {
+        std::lock_guard<std::mutex> lockGuard{m_rewriteMutex};
 
-    if (std::find(m_rewrite.cbegin(), m_rewrite.cend(), mapping) == m_rewrite.cend())
+        if (std::find(m_rewrite.cbegin(), m_rewrite.cend(), mapping) != m_rewrite.cend())
+            return;
         m_rewrite.emplace_back(mapping);
+        const auto generation = m_rewriteGeneration++;
+        m_rewriteStates[mapping.get()] = RewriteState{generation, false};
+
+        auto deadline = std::chrono::steady_clock::now();
+        if (mapping->getLastUpdateTime() == std::chrono::high_resolution_clock::time_point{})
+        {
+            // Spread the mappings that were never written into over their period, by the fractions of the golden
+            // ratio, so each new one lands in the largest gap left by the previous ones.
+            const auto fraction = std::fmod(static_cast<double>(generation) * 0.6180339887, 1.0);
+            deadline += std::chrono::duration_cast<std::chrono::steady_clock::duration>(mapping->getRepeatedWrite() *
+                                                                                        fraction);
+        }
+        else
+        {
+            deadline += std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+              mapping->getLastUpdateTime() + mapping->getRepeatedWrite() - std::chrono::high_resolution_clock::now());
+        }
+        pushRewrite(mapping, deadline);
+    }
+    notifyRewritableChange();
 }
 
 void ModbusDevice::removeRewritable(const std::shared_ptr<RegisterMapping>& mapping)
 {
-    std::lock_guard<std::mutex> lockGuard{m_rewriteMutex};
+    {
+        std::lock_guard<std::mutex> lockGuard{m_rewriteMutex};
 
-    const auto it = std::find(m_rewrite.cbegin(), m_rewrite.cend(), mapping);
-    if (it != m_rewrite.cend())
+        const auto it = std::find(m_rewrite.cbegin(), m_rewrite.cend(), mapping);
+        if (it == m_rewrite.cend())
+            return;
         m_rewrite.erase(it);
+        m_rewriteStates.erase(mapping.get());
+    }
+    notifyRewritableChange();
+}
+
+std::vector<std::shared_ptr<RegisterMapping>> ModbusDevice::takeDueRewritable(
+  std::chrono::steady_clock::time_point now)
+{
+    std::lock_guard<std::mutex> lockGuard{m_rewriteMutex};
+
+    const auto later = [](const RewriteDeadline& left, const RewriteDeadline& right) {
+        return left.deadline > right.deadline;
+    };
+    auto due = std::vector<std::shared_ptr<RegisterMapping>>{};
+    while (!m_rewriteDeadlines.empty() && m_rewriteDeadlines.front().deadline <= now)
+    {
+        std::pop_heap(m_rewriteDeadlines.begin(), m_rewriteDeadlines.end(), later);
+        const auto entry = std::move(m_rewriteDeadlines.back());
+        m_rewriteDeadlines.pop_back();
+
+        const auto state = m_rewriteStates.find(entry.mapping.get());
+        if (state == m_rewriteStates.end() || state->second.generation != entry.generation)
+            continue;
+        state->second.scheduled = false;
+
+        // The mapping could have been written into or read since the deadline was set.
+        const auto lastUpdateTime = entry.mapping->getLastUpdateTime();
+        if (lastUpdateTime != std::chrono::high_resolution_clock::time_point{})
+        {
+            const auto remaining =
+              lastUpdateTime + entry.mapping->getRepeatedWrite() - std::chrono::high_resolution_clock::now();
+            if (remaining.count() > 0)
+            {
+                pushRewrite(entry.mapping,
+                            now + std::chrono::duration_cast<std::chrono::steady_clock::duration>(remaining));
+                continue;
+            }
+        }
+        due.emplace_back(entry.mapping);
+    }
+    return due;
+}
+
+void ModbusDevice::scheduleRewrite(const std::shared_ptr<RegisterMapping>& mapping,
+                                   std::chrono::steady_clock::time_point deadline)
+{
+    std::lock_guard<std::mutex> lockGuard{m_rewriteMutex};
+
+    const auto state = m_rewriteStates.find(mapping.get());
+    if (state != m_rewriteStates.end() && !state->second.scheduled)
+        pushRewrite(mapping, deadline);
+}
+
+std::chrono::steady_clock::time_point ModbusDevice::getNextRewrite() const
+{
+    std::lock_guard<std::mutex> lockGuard{m_rewriteMutex};
+
+    return m_rewriteDeadlines.empty() ? std::chrono::steady_clock::time_point::max() :
+                                        m_rewriteDeadlines.front().deadline;
+}
+
+void ModbusDevice::pushRewrite(const std::shared_ptr<RegisterMapping>& mapping,
+                               std::chrono::steady_clock::time_point deadline)
+{
+    auto& state = m_rewriteStates[mapping.get()];
+    state.scheduled = true;
+    m_rewriteDeadlines.emplace_back(RewriteDeadline{deadline, mapping, state.generation});
+    std::push_heap(m_rewriteDeadlines.begin(), m_rewriteDeadlines.end(),
+                   [](const RewriteDeadline& left, const RewriteDeadline& right) {
+                       return left.deadline > right.deadline;
+                   });
+}
+
+void ModbusDevice::notifyRewritableChange()
+{
+    if (const auto reader = m_reader.lock())
+        reader->rescheduleRewrite(*this);
 }
 
 void ModbusDevice::setOnMappingValueChange(
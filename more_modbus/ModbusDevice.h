@@ -21,8 +21,11 @@
 
 #include "more_modbus/RegisterGroup.h"
 
+#include <atomic>
+#include <chrono>
 #include <functional>
 #include <mutex>
+#include <unordered_map>
 
 namespace wolkabout
 {
@@ -58,6 +61,17 @@ struct CompareFunction
     }
 };
 
+/**
+ * @brief Whether a device accepts the Mask Write Register (function 22) requests.
+ * @details UNKNOWN devices are probed on the first bit write.
+ */
+enum class MaskWriteSupport
+{
+    UNKNOWN,
+    SUPPORTED,
+    UNSUPPORTED
+};
+
 /**
  * @brief Collection of ModbusGroups for a single Modbus server/slave.
  * @details The device contains the slaveAddress, and all the groups to be read for the slave address.
@@ -79,8 +93,15 @@ public:
      */
     ModbusDevice(const ModbusDevice& device);
 
+    /**
+     * @brief Destructor, the mappings take their values out of the register images, as they can outlive the device.
+     */
+    ~ModbusDevice();
+
     /**
      * @brief Create all the RegisterGroup that this device will have by providing all mappings.
+     * @details Mappings are grouped only with the mappings that have the same read period, so a group that is read
+     *         often doesn't carry the registers that are needed rarely.
      * @param mappings container of all mappings the user wishes this device has.
      */
     void createGroups(const std::vector<std::shared_ptr<RegisterMapping>>& mappings);
@@ -95,14 +116,106 @@ public:
 
     int16_t getSlaveAddress() const;
 
+    MaskWriteSupport getMaskWriteSupport() const;
+
+    /**
+     * @brief Sets whether the device accepts the Mask Write Register requests, used to write bits of holding registers.
+     *        Devices that don't will have their bits written with a read of the register, followed by a write.
+     * @param maskWriteSupport UNKNOWN to probe the device on the next bit write
+     */
+    void setMaskWriteSupport(MaskWriteSupport maskWriteSupport);
+
+    /**
+     * @brief Sets the register that is read to check whether the device is back online, after the reader stopped
+     *        reading all of its groups because of consecutive failures. By default, the first register of the first
+     *        group is used.
+     * @param registerType type of the register
+     * @param address address of the register
+     */
+    void setLivenessRegister(RegisterType registerType, int32_t address);
+
+    bool hasLivenessRegister() const;
+
+    RegisterType getLivenessRegisterType() const;
+
+    int32_t getLivenessRegisterAddress() const;
+
+    /**
+     * @brief Sets the time after the start of reading the device, its groups are first read at. Every next read of a
+     *        group is due a whole number of its read periods after that, so devices with different offsets keep out
+     *        of each other's way, instead of all being read at once.
+     * @param phaseOffset can not be negative, the default is zero
+     */
+    void setPhaseOffset(std::chrono::milliseconds phaseOffset);
+
+    std::chrono::milliseconds getPhaseOffset() const;
+
     const std::vector<std::shared_ptr<RegisterGroup>>& getGroups() const;
 
+    /**
+     * @brief The register image of the type, holding the registers of all the groups of the type that are read, each
+     *       group at its image offset, as they were last read.
+     * @details The image is rebuilt, and the views into it invalidated, when the groups are created.
+     * @param registerType HOLDING_REGISTER or INPUT_REGISTER
+     * @return view of the whole image, empty for the other types
+     */
+    Span<const uint16_t> getRegisterImage(RegisterType registerType) const;
+
+    /**
+     * @brief The bit image of the type, packed 64 bits to a word, laid out like the register images.
+     * @param registerType COIL or INPUT_CONTACT
+     * @return view of the whole image, empty for the other types
+     */
+    BitSpan getBitImage(RegisterType registerType) const;
+
+    /**
+     * @brief Copies the values of a read of the group into the register image.
+     * @param group
+     * @param values getAddressCount() registers
+     */
+    void storeRead(const RegisterGroup& group, const uint16_t* values);
+
+    /**
+     * @brief Packs the values of a read of the group into the bit image.
+     * @param group
+     * @param values getAddressCount() bytes, one per bit
+     */
+    void storeRead(const RegisterGroup& group, const uint8_t* values);
+
     std::vector<std::shared_ptr<RegisterMapping>> getRewritable() const;
 
+    /**
+     * @brief Adds a mapping that is rewritten when it is not written into for its repeated write period.
+     * @details Mappings that were never written into are first rewritten at a point spread over their period, so the
+     *         rewritable mappings don't all get written in a single burst once the reader starts. The reader of the
+     *         device is woken up to take the new mapping into account.
+     * @param mapping
+     */
     void addRewritable(const std::shared_ptr<RegisterMapping>& mapping);
 
     void removeRewritable(const std::shared_ptr<RegisterMapping>& mapping);
 
+    /**
+     * @brief Takes the rewritable mappings whose deadline passed, and that weren't written into in the meantime.
+     *       The taken mappings have to be given their next deadline with scheduleRewrite().
+     * @param now
+     * @return The mappings that have to be rewritten.
+     */
+    std::vector<std::shared_ptr<RegisterMapping>> takeDueRewritable(std::chrono::steady_clock::time_point now);
+
+    /**
+     * @brief Sets the next deadline of a mapping returned by takeDueRewritable().
+     * @param mapping
+     * @param deadline
+     */
+    void scheduleRewrite(const std::shared_ptr<RegisterMapping>& mapping,
+                         std::chrono::steady_clock::time_point deadline);
+
+    /**
+     * @return The earliest deadline of the rewritable mappings, or max() if there are none.
+     */
+    std::chrono::steady_clock::time_point getNextRewrite() const;
+
     void setOnMappingValueChange(
       const std::function<void(const std::shared_ptr<RegisterMapping>&, bool)>& onMappingValueChangeBool);
 
@@ -130,10 +243,51 @@ private:
     std::string m_name;
     bool m_status;
     int16_t m_slaveAddress;
+    std::atomic<MaskWriteSupport> m_maskWriteSupport;
+    RegisterType m_livenessRegisterType;
+    int32_t m_livenessRegisterAddress;
+    std::chrono::milliseconds m_phaseOffset;
     std::vector<std::shared_ptr<RegisterGroup>> m_groups;
 
+    // Gives each group that is read its offset, sizes the images for all of them, and moves the values of the mappings
+    // into the register images.
+    void buildImages();
+
+    // Moves the values of the mappings out of the register images, before the images are created again or destroyed.
+    void releaseImages();
+
+    // The index of the image of the register type, in the register or the bit images, or -1 if it has none there.
+    static int registerImageIndex(RegisterType registerType);
+    static int bitImageIndex(RegisterType registerType);
+
+    // Holding and input registers, coils and input contacts, with the number of bits in each bit image.
+    std::vector<uint16_t> m_registerImages[2];
+    std::vector<std::uint64_t> m_bitImages[2];
+    std::size_t m_bitImageSizes[2];
+
+    // Rewritable mappings, and a min-heap of their deadlines. The entries of the removed mappings are left in the
+    // heap, and skipped by their generation. All of it is guarded by the m_rewriteMutex.
+    struct RewriteDeadline
+    {
+        std::chrono::steady_clock::time_point deadline;
+        std::shared_ptr<RegisterMapping> mapping;
+        std::uint64_t generation;
+    };
+    struct RewriteState
+    {
+        std::uint64_t generation;
+        bool scheduled;
+    };
+    // Adds the deadline to the heap, with the m_rewriteMutex locked.
+    void pushRewrite(const std::shared_ptr<RegisterMapping>& mapping, std::chrono::steady_clock::time_point deadline);
+    // Asks the reader to check the deadlines of the device again, without the m_rewriteMutex locked.
+    void notifyRewritableChange();
+
     mutable std::mutex m_rewriteMutex;
     std::vector<std::shared_ptr<RegisterMapping>> m_rewrite;
+    std::vector<RewriteDeadline> m_rewriteDeadlines;
+    std::unordered_map<const RegisterMapping*, RewriteState> m_rewriteStates;
+    std::uint64_t m_rewriteGeneration;
 
     std::weak_ptr<ModbusReader> m_reader;
 
@@ -0,0 +1,295 @@
+/**
+ * Copyright 2023 Wolkabout Technology s.r.o.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "more_modbus/ModbusFleet.h"
+
+#include "core/utilities/Logger.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+using namespace wolkabout::legacy;
+
+namespace wolkabout::more_modbus
+{
+ModbusFleet::ModbusFleet(std::size_t workerCount) : m_workerCount(workerCount), m_running(false)
+{
+    if (m_workerCount == 0)
+        throw std::logic_error("ModbusFleet: The fleet needs at least one worker.");
+}
+
+ModbusFleet::~ModbusFleet()
+{
+    stop();
+}
+
+bool ModbusFleet::addBus(const std::string& name, const std::shared_ptr<ModbusClient>& client,
+                         std::chrono::milliseconds readPeriod)
+{
+    if (client == nullptr)
+    {
+        LOG(ERROR) << "ModbusFleet: Failed to add bus '" << name << "' - The client is null.";
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock{m_mutex};
+    if (m_running)
+    {
+        LOG(ERROR) << "ModbusFleet: Failed to add bus '" << name << "' - The fleet is running.";
+        return false;
+    }
+    if (m_buses.find(name) != m_buses.cend())
+    {
+        LOG(ERROR) << "ModbusFleet: Failed to add bus '" << name << "' - A bus with the name already exists.";
+        return false;
+    }
+
+    auto bus = std::unique_ptr<Bus>{new Bus{name, client, std::make_shared<ModbusReader>(*client, readPeriod), {},
+                                            false, false, Clock::time_point{}}};
+    m_buses.emplace(name, std::move(bus));
+    return true;
+}
+
+bool ModbusFleet::addDevice(const std::string& bus, const std::shared_ptr<ModbusDevice>& device)
+{
+    if (device == nullptr)
+        return false;
+
+    std::lock_guard<std::mutex> lock{m_mutex};
+    if (m_running)
+    {
+        LOG(ERROR) << "ModbusFleet: Failed to add device '" << device->getName() << "' - The fleet is running.";
+        return false;
+    }
+    const auto it = m_buses.find(bus);
+    if (it == m_buses.cend())
+    {
+        LOG(ERROR) << "ModbusFleet: Failed to add device '" << device->getName() << "' - Bus '" << bus
+                   << "' doesn't exist.";
+        return false;
+    }
+    if (m_devices.find(device->getName()) != m_devices.cend())
+    {
+        LOG(ERROR) << "ModbusFleet: Failed to add device '" << device->getName()
+                   << "' - A device with the name already exists.";
+        return false;
+    }
+    const auto& reader = it->second->reader;
+    if (reader->getDevices().find(device->getSlaveAddress()) != reader->getDevices().cend())
+    {
+        LOG(ERROR) << "ModbusFleet: Failed to add device '" << device->getName() << "' - Slave address "
+                   << device->getSlaveAddress() << " is already used on bus '" << bus << "'.";
+        return false;
+    }
+
+    reader->addDevice(device);
+    m_devices.emplace(device->getName(), std::make_pair(bus, device));
+    return true;
+}
+
+bool ModbusFleet::submit(const std::string& bus, std::function<void(ModbusClient&)> task)
+{
+    std::lock_guard<std::mutex> lock{m_mutex};
+    const auto it = m_buses.find(bus);
+    if (!m_running || it == m_buses.cend() || !task)
+        return false;
+
+    auto& lane = *it->second;
+    enqueue(lane, [&lane, task] { task(*lane.client); });
+    return true;
+}
+
+std::shared_ptr<ModbusDevice> ModbusFleet::getDevice(const std::string& name) const
+{
+    std::lock_guard<std::mutex> lock{m_mutex};
+    const auto it = m_devices.find(name);
+    return it != m_devices.cend() ? it->second.second : nullptr;
+}
+
+std::vector<std::shared_ptr<ModbusDevice>> ModbusFleet::getDevices() const
+{
+    std::lock_guard<std::mutex> lock{m_mutex};
+    auto devices = std::vector<std::shared_ptr<ModbusDevice>>{};
+    devices.reserve(m_devices.size());
+    for (const auto& device : m_devices)
+        devices.emplace_back(device.second.second);
+    return devices;
+}
+
+std::map<std::string, bool> ModbusFleet::getDeviceStatuses() const
+{
+    std::lock_guard<std::mutex> lock{m_mutex};
+    auto statuses = std::map<std::string, bool>{};
+    for (const auto& device : m_devices)
+        statuses.emplace(device.first, device.second.second->getStatus());
+    return statuses;
+}
+
+std::string ModbusFleet::getBusOfDevice(const std::string& name) const
+{
+    std::lock_guard<std::mutex> lock{m_mutex};
+    const auto it = m_devices.find(name);
+    return it != m_devices.cend() ? it->second.first : std::string{};
+}
+
+std::shared_ptr<ModbusReader> ModbusFleet::getReader(const std::string& bus) const
+{
+    std::lock_guard<std::mutex> lock{m_mutex};
+    const auto it = m_buses.find(bus);
+    return it != m_buses.cend() ? it->second->reader : nullptr;
+}
+
+bool ModbusFleet::start()
+{
+    std::lock_guard<std::mutex> lock{m_mutex};
+    if (m_running)
+        return true;
+
+    const auto now = Clock::now();
+    for (const auto& bus : m_buses)
+        bus.second->nextPoll = now;
+
+    m_running = true;
+    for (auto i = std::size_t{0}; i < m_workerCount; ++i)
+        m_workers.emplace_back(&ModbusFleet::work, this);
+    LOG(DEBUG) << "ModbusFleet: Started " << m_workerCount << " workers for " << m_buses.size() << " buses.";
+    return true;
+}
+
+void ModbusFleet::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        if (!m_running)
+            return;
+        m_running = false;
+    }
+    m_condition.notify_all();
+    for (auto& worker : m_workers)
+    {
+        if (worker.joinable())
+            worker.join();
+    }
+    m_workers.clear();
+
+    std::lock_guard<std::mutex> lock{m_mutex};
+    m_ready.clear();
+    for (const auto& bus : m_buses)
+    {
+        bus.second->tasks.clear();
+        bus.second->active = false;
+        bus.second->pollPending = false;
+        if (bus.second->client->isConnected())
+            bus.second->client->disconnect();
+    }
+}
+
+bool ModbusFleet::isRunning() const
+{
+    return m_running;
+}
+
+void ModbusFleet::work()
+{
+    std::unique_lock<std::mutex> lock{m_mutex};
+    while (m_running)
+    {
+        schedulePolls(Clock::now());
+        if (m_ready.empty())
+        {
+            const auto wakeUp = nextPoll();
+            if (wakeUp == Clock::time_point::max())
+                m_condition.wait(lock);
+            else
+                m_condition.wait_until(lock, wakeUp);
+            continue;
+        }
+
+        // The lane stays active while its task is executing, so no other worker can pick up the same bus.
+        auto& bus = *m_ready.front();
+        m_ready.pop_front();
+        auto task = std::move(bus.tasks.front());
+        bus.tasks.pop_front();
+
+        lock.unlock();
+        task();
+        lock.lock();
+
+        if (bus.tasks.empty())
+        {
+            bus.active = false;
+        }
+        else
+        {
+            // Back to the end of the queue, so a busy bus doesn't starve the others.
+            m_ready.push_back(&bus);
+            m_condition.notify_one();
+        }
+    }
+}
+
+void ModbusFleet::schedulePolls(Clock::time_point now)
+{
+    for (const auto& pair : m_buses)
+    {
+        auto& bus = *pair.second;
+        if (bus.pollPending || now < bus.nextPoll)
+            continue;
+
+        // Polls that were missed are skipped, instead of executed back to back.
+        // The reader only reads the groups that are due, so the bus is polled as often as its fastest group.
+        const auto readPeriod = bus.reader->getPollPeriod();
+        bus.nextPoll += readPeriod;
+        if (bus.nextPoll < now)
+            bus.nextPoll = now + readPeriod;
+
+        bus.pollPending = true;
+        enqueue(bus, [this, &bus] { pollBus(bus); });
+    }
+}
+
+void ModbusFleet::enqueue(Bus& bus, std::function<void()> task)
+{
+    bus.tasks.emplace_back(std::move(task));
+    if (!bus.active)
+    {
+        bus.active = true;
+        m_ready.push_back(&bus);
+        m_condition.notify_one();
+    }
+}
+
+ModbusFleet::Clock::time_point ModbusFleet::nextPoll() const
+{
+    auto wakeUp = Clock::time_point::max();
+    for (const auto& bus : m_buses)
+    {
+        if (!bus.second->pollPending)
+            wakeUp = std::min(wakeUp, bus.second->nextPoll);
+    }
+    return wakeUp;
+}
+
+void ModbusFleet::pollBus(Bus& bus)
+{
+    bus.reader->poll();
+
+    std::lock_guard<std::mutex> lock{m_mutex};
+    bus.pollPending = false;
+}
+}    // namespace wolkabout::more_modbus
@@ -0,0 +1,157 @@
+/**
+ * Copyright 2023 Wolkabout Technology s.r.o.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef WOLKABOUT_MODBUS_MODBUSFLEET_H
+#define WOLKABOUT_MODBUS_MODBUSFLEET_H
+
+#include "more_modbus/ModbusDevice.h"
+#include "more_modbus/ModbusReader.h"
+#include "more_modbus/modbus/ModbusClient.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace wolkabout::more_modbus
+{
+/**
+ * @brief Reads devices on multiple buses (RTU ports, TCP connections) using a single, fixed size pool of threads.
+ * @details Every bus has its own client and ModbusReader, but instead of the reader's threads, the buses are polled
+ *         by the workers of the fleet. All the work for a bus is executed as a serialized lane - at most one task
+ *         of a bus is running at any time, in the order it was submitted - while different buses are worked on in
+ *         parallel, as many at once as there are workers. Writes through mappings keep working through the bus'
+ *         reader.
+ */
+class ModbusFleet
+{
+public:
+    /**
+     * @brief Constructor for the fleet.
+     * @param workerCount the number of threads shared by all the buses
+     */
+    explicit ModbusFleet(std::size_t workerCount = 2);
+
+    virtual ~ModbusFleet();
+
+    /**
+     * @brief Adds a bus to the fleet. Buses and devices can be added only while the fleet is not running.
+     * @param name unique name of the bus
+     * @param client the client used to access the devices on the bus
+     * @param readPeriod time period for cycling reads of the bus' devices
+     * @return Whether the bus has been added.
+     */
+    bool addBus(const std::string& name, const std::shared_ptr<ModbusClient>& client,
+                std::chrono::milliseconds readPeriod);
+
+    /**
+     * @brief Adds a device to one of the buses.
+     * @param bus name of the bus
+     * @param device the device, its name has to be unique in the fleet, and its slave address on the bus
+     * @return Whether the device has been added.
+     */
+    bool addDevice(const std::string& bus, const std::shared_ptr<ModbusDevice>& device);
+
+    /**
+     * @brief Queues a task in the lane of the bus, so it doesn't overlap with the polling of the bus.
+     * @param bus name of the bus
+     * @param task executed on one of the workers, with the client of the bus
+     * @return Whether the task has been queued, the fleet has to be running.
+     */
+    bool submit(const std::string& bus, std::function<void(ModbusClient&)> task);
+
+    /**
+     * @param name of the device
+     * @return The device with the name on any of the buses, or nullptr.
+     */
+    std::shared_ptr<ModbusDevice> getDevice(const std::string& name) const;
+
+    /**
+     * @return All the devices on all the buses.
+     */
+    std::vector<std::shared_ptr<ModbusDevice>> getDevices() const;
+
+    /**
+     * @return The statuses of all the devices on all the buses, by device name.
+     */
+    std::map<std::string, bool> getDeviceStatuses() const;
+
+    /**
+     * @param name of the device
+     * @return The name of the bus the device is on, or an empty string.
+     */
+    std::string getBusOfDevice(const std::string& name) const;
+
+    /**
+     * @param bus name of the bus
+     * @return The reader of the bus, or nullptr.
+     */
+    std::shared_ptr<ModbusReader> getReader(const std::string& bus) const;
+
+    bool start();
+
+    void stop();
+
+    bool isRunning() const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Bus
+    {
+        std::string name;
+        std::shared_ptr<ModbusClient> client;
+        std::shared_ptr<ModbusReader> reader;
+
+        // The lane, `active` is set while the lane is in the ready queue, or one of its tasks is executing.
+        std::deque<std::function<void()>> tasks;
+        bool active;
+
+        bool pollPending;
+        Clock::time_point nextPoll;
+    };
+
+    void work();
+
+    // Called with m_mutex locked.
+    void schedulePolls(Clock::time_point now);
+    void enqueue(Bus& bus, std::function<void()> task);
+    Clock::time_point nextPoll() const;
+
+    void pollBus(Bus& bus);
+
+    std::size_t m_workerCount;
+    std::atomic_bool m_running;
+    std::vector<std::thread> m_workers;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_condition;
+    std::map<std::string, std::unique_ptr<Bus>> m_buses;
+    std::map<std::string, std::pair<std::string, std::shared_ptr<ModbusDevice>>> m_devices;
+    std::deque<Bus*> m_ready;
+};
+}    // namespace wolkabout::more_modbus
+
+#endif    // WOLKABOUT_MODBUS_MODBUSFLEET_H
@@ -25,13 +25,30 @@
 
 #include <algorithm>
 #include <numeric>
+#include <random>
+#include <tuple>
 
 using namespace wolkabout::legacy;
 
 namespace wolkabout::more_modbus
 {
-ModbusReader::ModbusReader(ModbusClient& modbusClient, const std::chrono::milliseconds& readPeriod)
-: m_modbusClient(modbusClient), m_devices(), m_readerShouldRun(false), m_threads(), m_readPeriod(readPeriod)
+ModbusReader::ModbusReader(ModbusClient& modbusClient, const std::chrono::milliseconds& readPeriod,
+                           std::size_t workerCount)
+: m_modbusClient(modbusClient)
+, m_busScheduler(modbusClient)
+, m_devices()
+, m_failureThreshold(3)
+, m_initialBackoff(std::chrono::seconds(1))
+, m_maxBackoff(std::chrono::minutes(1))
+, m_minReconnectDelay(std::chrono::seconds(1))
+, m_maxReconnectDelay(std::chrono::hours(1))
+, m_random(std::random_device{}())
+, m_readerShouldRun(false)
+, m_workerCount(std::max(workerCount, std::size_t{1}))
+, m_readPeriod(readPeriod)
+, m_wheelChanged(false)
+, m_maxAdaptivePeriod(0)
+, m_adaptiveStretchFactor(2.0)
 {
 }
 
@@ -44,8 +61,8 @@ void ModbusReader::addDevice(const std::shared_ptr<ModbusDevice>& device)
 {
     m_devices.emplace(device->getSlaveAddress(), device);
     m_deviceActiveStatus.emplace(device->getSlaveAddress(), false);
-    m_threads.emplace(device->getSlaveAddress(), nullptr);
-    m_rewriteThreads.emplace(device->getSlaveAddress(), nullptr);
+    m_groupDeadlines.emplace(device->getSlaveAddress(), std::vector<std::chrono::steady_clock::time_point>{});
+    m_groupActivity.emplace(device->getSlaveAddress(), std::vector<GroupActivity>{});
     device->setReader(shared_from_this());
     LOG(INFO) << "ModbusReader: Successfully added new device " << device->getName();
 }
@@ -70,110 +87,215 @@ const std::map<int16_t, std::shared_ptr<ModbusDevice>>& ModbusReader::getDevices
     return m_devices;
 }
 
-const std::map<int16_t, bool>& ModbusReader::getDeviceStatuses() const
+void ModbusReader::setCircuitBreaker(std::uint32_t failureThreshold, std::chrono::milliseconds initialBackoff,
+                                     std::chrono::milliseconds maxBackoff)
 {
     std::lock_guard<std::mutex> lockGuard{m_deviceActiveMutex};
-    return m_deviceActiveStatus;
+    m_failureThreshold = failureThreshold;
+    m_initialBackoff = initialBackoff;
+    m_maxBackoff = std::max(initialBackoff, maxBackoff);
+    if (m_failureThreshold == 0)
+        m_circuitBreakers.clear();
 }
 
-bool ModbusReader::writeMapping(RegisterMapping& mapping, const std::vector<uint16_t>& values)
+bool ModbusReader::isCircuitOpen(int16_t slaveAddress) const
 {
-    if (mapping.getRegisterType() != RegisterType::HOLDING_REGISTER)
-        throw std::logic_error(
-          R"(ModbusReader: You can't write bytes to anything other than HOLDING_REGISTER mapping.)");
-    if (mapping.getRegisterCount() != static_cast<int16_t>(values.size()))
-        throw std::logic_error("ModbusReader: Received " + std::to_string(values.size()) + " values, but need " +
-                               std::to_string(mapping.getRegisterCount()) + ".");
-    if (m_devices.find(mapping.getSlaveAddress()) == m_devices.end())
-        throw std::logic_error(R"(ModbusReader: Mapping slave address isn't registered with the ModbusReader.)");
+    std::lock_guard<std::mutex> lockGuard{m_deviceActiveMutex};
+    const auto it = m_circuitBreakers.find(slaveAddress);
+    return it != m_circuitBreakers.cend() && it->second.open;
+}
 
-    if (!m_modbusClient.writeHoldingRegisters(mapping.getSlaveAddress(), mapping.getStartingAddress(),
-                                              const_cast<std::vector<uint16_t>&>(values)))
-    {
-        LOG(WARN) << "ModbusReader: Unable to write holding register values - Register address : "
-                  << mapping.getStartingAddress() << " Registers : " << values.size();
-        mapping.setValid(false);
-        return false;
-    }
-    LOG(TRACE) << "ModbusReader: Written values '"
-               << (std::accumulate(values.begin(), values.end(), std::string{},
-                                   [](auto s, auto v) { return s + " " + std::to_string(v); }))
-               << "' for mapping '" << mapping.getReference() << "'.";
-    if (mapping.isAutoUpdateEnabled())
-        mapping.update(values);
-    return true;
+void ModbusReader::setReconnectDelays(std::chrono::milliseconds minDelay, std::chrono::milliseconds maxDelay)
+{
+    if (minDelay.count() <= 0 || maxDelay < minDelay)
+        throw std::logic_error("ModbusReader: The reconnect delays have to be positive, and the minimum not above the "
+                               "maximum.");
+
+    m_minReconnectDelay = minDelay;
+    m_maxReconnectDelay = maxDelay;
 }
 
-bool ModbusReader::writeMapping(RegisterMapping& mapping, bool value)
+void ModbusReader::setAdaptivePolling(std::chrono::milliseconds maxPeriod, double stretchFactor)
 {
-    if (mapping.getRegisterType() != RegisterType::COIL)
-        throw std::logic_error(R"(ModbusReader: You can't write bool to anything other than COIL mapping.)");
-    if (m_devices.find(mapping.getSlaveAddress()) == m_devices.end())
-        throw std::logic_error(R"(ModbusReader: Mapping slave address isn't registered with the ModbusReader.)");
+    if (maxPeriod.count() < 0 || stretchFactor <= 1.0)
+        throw std::logic_error("ModbusReader: The adaptive polling needs a positive period, and a factor above 1.");
+
+    m_maxAdaptivePeriod = maxPeriod;
+    m_adaptiveStretchFactor = stretchFactor;
+}
 
-    if (!m_modbusClient.writeCoil(mapping.getSlaveAddress(), mapping.getStartingAddress(), value))
+std::chrono::milliseconds ModbusReader::getCurrentReadPeriod(int16_t slaveAddress, std::size_t groupIndex) const
+{
+    const auto device = m_devices.find(slaveAddress);
+    if (device == m_devices.cend() || groupIndex >= device->second->getGroups().size())
+        return std::chrono::milliseconds{0};
+
+    const auto activity = m_groupActivity.find(slaveAddress);
+    if (activity != m_groupActivity.cend() && groupIndex < activity->second.size() &&
+        activity->second[groupIndex].period.count() > 0)
+        return activity->second[groupIndex].period;
+    return readPeriodOf(*device->second->getGroups()[groupIndex]);
+}
+
+const std::chrono::milliseconds& ModbusReader::getReadPeriod() const
+{
+    return m_readPeriod;
+}
+
+std::chrono::milliseconds ModbusReader::getPollPeriod() const
+{
+    auto pollPeriod = m_readPeriod;
+    for (const auto& device : m_devices)
     {
-        LOG(WARN) << "ModbusReader: Unable to write coil value - Register address : " << mapping.getStartingAddress()
-                  << " Value : " << value;
-        mapping.setValid(false);
-        return false;
+        for (const auto& group : device.second->getGroups())
+            pollPeriod = std::min(pollPeriod, readPeriodOf(*group));
     }
+    return pollPeriod;
+}
 
-    LOG(TRACE) << "ModbusReader: Written value '" << value << "' for mapping '" << mapping.getReference() << "'.";
+const std::map<int16_t, bool>& ModbusReader::getDeviceStatuses() const
+{
+    std::lock_guard<std::mutex> lockGuard{m_deviceActiveMutex};
+    return m_deviceActiveStatus;
+}
 
-    if (mapping.isAutoUpdateEnabled())
-        mapping.update(value);
-    return true;
+PollTiming ModbusReader::getPollTiming(int16_t slaveAddress) const
+{
+    std::lock_guard<std::mutex> lockGuard{m_deviceActiveMutex};
+    const auto it = m_pollTimings.find(slaveAddress);
+    return it != m_pollTimings.cend() ? it->second : PollTiming{};
+}
+
+bool ModbusReader::writeMapping(RegisterMapping& mapping, const std::vector<uint16_t>& values)
+{
+    const auto written = executeOnBus(mapping.getSlaveAddress(), createWriteRequest(mapping, values),
+                                      ModbusBusScheduler::Priority::HIGH);
+    completeWrite(mapping, written, values);
+    return written;
+}
+
+bool ModbusReader::writeMapping(RegisterMapping& mapping, bool value)
+{
+    const auto written = executeOnBus(mapping.getSlaveAddress(), createWriteRequest(mapping, value),
+                                      ModbusBusScheduler::Priority::HIGH);
+    completeWrite(mapping, written, value);
+    return written;
 }
 
 bool ModbusReader::writeBitMapping(RegisterMapping& mapping, bool value)
 {
-    if (mapping.getRegisterType() != RegisterType::HOLDING_REGISTER)
-        throw std::logic_error(R"(ModbusReader: You can't write bit to anything other than HOLDING_REGISTER mapping.)");
-    if (mapping.getOperationType() != OperationType::TAKE_BIT)
-        throw std::logic_error(R"(ModbusReader: You can't write bit to mapping that isn't TAKE_BIT.)");
-    if (m_devices.find(mapping.getSlaveAddress()) == m_devices.end())
-        throw std::logic_error(R"(ModbusReader: Mapping slave address isn't registered with the ModbusReader.)");
+    const auto written = executeOnBus(mapping.getSlaveAddress(), createBitWriteRequest(mapping, value),
+                                      ModbusBusScheduler::Priority::HIGH);
+    completeWrite(mapping, written, value);
+    return written;
+}
+
+std::future<bool> ModbusReader::writeMappingAsync(RegisterMapping& mapping, const std::vector<uint16_t>& values)
+{
+    return toFuture([&](WriteCallback callback) { writeMappingAsync(mapping, values, std::move(callback)); });
+}
+
+void ModbusReader::writeMappingAsync(RegisterMapping& mapping, const std::vector<uint16_t>& values,
+                                     WriteCallback callback)
+{
+    auto request = createWriteRequest(mapping, values);
+    m_busScheduler.submit(
+      mapping.getSlaveAddress(), std::move(request),
+      [&mapping, values, callback](bool written) {
+          completeWrite(mapping, written, values);
+          if (callback)
+              callback(written);
+      },
+      ModbusBusScheduler::Priority::HIGH);
+}
 
-    // Read value
-    uint16_t registerValue;
-    if (!m_modbusClient.readHoldingRegister(mapping.getSlaveAddress(), mapping.getStartingAddress(), registerValue))
+std::future<bool> ModbusReader::writeMappingAsync(RegisterMapping& mapping, bool value)
+{
+    return toFuture([&](WriteCallback callback) { writeMappingAsync(mapping, value, std::move(callback)); });
+}
+
+void ModbusReader::writeMappingAsync(RegisterMapping& mapping, bool value, WriteCallback callback)
+{
+    auto request = createWriteRequest(mapping, value);
+    m_busScheduler.submit(
+      mapping.getSlaveAddress(), std::move(request),
+      [&mapping, value, callback](bool written) {
+          completeWrite(mapping, written, value);
+          if (callback)
+              callback(written);
+      },
+      ModbusBusScheduler::Priority::HIGH);
+}
+
+std::future<bool> ModbusReader::writeBitMappingAsync(RegisterMapping& mapping, bool value)
+{
+    return toFuture([&](WriteCallback callback) { writeBitMappingAsync(mapping, value, std::move(callback)); });
+}
+
+void ModbusReader::writeBitMappingAsync(RegisterMapping& mapping, bool value, WriteCallback callback)
+{
+    auto request = createBitWriteRequest(mapping, value);
+    m_busScheduler.submit(
+      mapping.getSlaveAddress(), std::move(request),
+      [&mapping, value, callback](bool written) {
+          completeWrite(mapping, written, value);
+          if (callback)
+              callback(written);
+      },
+      ModbusBusScheduler::Priority::HIGH);
+}
+
+std::vector<bool> ModbusReader::writeMappings(const std::vector<MappingWrite>& writes)
+{
+    for (const auto& write : writes)
     {
-        LOG(WARN) << "ModbusReader: Unable to read holding register value - Register address : "
-                  << mapping.getStartingAddress() << " for purpose of writing a bit into it.";
-        mapping.setValid(false);
-        return false;
+        if (write.mapping == nullptr)
+            throw std::logic_error(R"(ModbusReader: You can't write to a null mapping.)");
+        const auto& mapping = *write.mapping;
+        if (mapping.getRegisterType() == RegisterType::HOLDING_REGISTER)
+        {
+            if (mapping.getOperationType() == OperationType::TAKE_BIT)
+                throw std::logic_error(R"(ModbusReader: You can't batch write to mapping that is TAKE_BIT.)");
+            if (mapping.getRegisterCount() != static_cast<int16_t>(write.values.size()))
+                throw std::logic_error("ModbusReader: Received " + std::to_string(write.values.size()) +
+                                       " values, but need " + std::to_string(mapping.getRegisterCount()) + ".");
+        }
+        else if (mapping.getRegisterType() != RegisterType::COIL)
+        {
+            throw std::logic_error(
+              R"(ModbusReader: You can't batch write to anything other than COIL and HOLDING_REGISTER mappings.)");
+        }
+        if (m_devices.find(mapping.getSlaveAddress()) == m_devices.end())
+            throw std::logic_error(R"(ModbusReader: Mapping slave address isn't registered with the ModbusReader.)");
     }
-    uint16_t newValue = registerValue;
 
-    // Append bit
-    const auto index = static_cast<uint8_t>(mapping.getBitIndex());
-    const auto& bits = DataParsers::separateBits(registerValue);
-    if (bits[index] != value)
-        newValue += (1 << index) * (value ? 1 : -1);
-
-    // Write new value
-    if (registerValue != newValue)
+    const auto results = executeWrites(writes, ModbusBusScheduler::Priority::HIGH);
+    for (auto i = std::size_t{0}; i < writes.size(); ++i)
     {
-        if (!m_modbusClient.writeHoldingRegister(mapping.getSlaveAddress(), mapping.getStartingAddress(), newValue))
+        auto& mapping = *writes[i].mapping;
+        if (!results[i])
         {
-            LOG(WARN) << "ModbusReader: Unable to write holding register bit - Register address : "
-                      << mapping.getStartingAddress() << " Value : " << newValue;
             mapping.setValid(false);
-            return false;
+            continue;
         }
 
-        LOG(TRACE) << "ModbusReader: Written value '" << value << "' for mapping '" << mapping.getReference() << "'.";
-
+        LOG(TRACE) << "ModbusReader: Written value for mapping '" << mapping.getReference() << "'.";
         if (mapping.isAutoUpdateEnabled())
-            mapping.update(value);
+        {
+            if (mapping.getRegisterType() == RegisterType::COIL)
+                mapping.update(writes[i].value);
+            else
+                mapping.update(writes[i].values);
+        }
     }
-    return true;
+    return results;
 }
 
 bool ModbusReader::forceReadOfMapping(RegisterMapping& mapping)
 {
-    return ModbusMappingReader::readRegister(m_modbusClient, mapping);
+    return executeOnBus(mapping.getSlaveAddress(), [&](ModbusClient& client) {
+        return ModbusMappingReader::readRegister(client, mapping);
+    });
 }
 
 bool ModbusReader::start()
@@ -195,6 +317,7 @@ bool ModbusReader::start()
     }
     if (connected && m_mainReaderThread == nullptr)
     {
+        m_busScheduler.start();
         m_mainReaderThread = std::unique_ptr<std::thread>(new std::thread(&ModbusReader::run, this));
         LOG(DEBUG) << "ModbusReader: Started ModbusReader.";
     }
@@ -208,23 +331,27 @@ void ModbusReader::stop()
 
     LOG(DEBUG) << "ModbusReader: Stopping ModbusReader.";
     // Disconnect the modbus devices, and stop the main thread.
-    m_readerShouldRun = false;
+    {
+        std::scoped_lock lock{m_sleepMutex, m_taskMutex};
+        m_readerShouldRun = false;
+    }
+    m_sleepCondition.notify_all();
+    m_scheduleCondition.notify_all();
+    m_taskCondition.notify_all();
+    // Fails the queued requests, so the workers waiting on them can finish.
+    m_busScheduler.stop();
 
     if (m_modbusClient.isConnected())
     {
         m_modbusClient.disconnect();
     }
 
-    for (const auto& thread : m_threads)
+    for (auto& worker : m_workers)
     {
-        if (thread.second != nullptr && thread.second->joinable())
-            thread.second->join();
-    }
-    for (const auto& thread : m_rewriteThreads)
-    {
-        if (thread.second != nullptr && thread.second->joinable())
-            thread.second->join();
+        if (worker.joinable())
+            worker.join();
     }
+    m_workers.clear();
 
     if (m_mainReaderThread != nullptr && m_mainReaderThread->joinable())
     {
@@ -233,6 +360,67 @@ void ModbusReader::stop()
     LOG(DEBUG) << "ModbusReader: Stopped ModbusReader.";
 }
 
+bool ModbusReader::poll()
+{
+    if (!m_modbusClient.isConnected())
+    {
+        const auto now = std::chrono::steady_clock::now();
+        if (now < m_connectionState.nextAttempt)
+            return false;
+
+        if (!m_modbusClient.connect())
+        {
+            scheduleReconnect();
+
+            std::lock_guard<std::mutex> lockGuard{m_deviceActiveMutex};
+            for (const auto& device : m_devices)
+            {
+                if (m_deviceActiveStatus[device.first] || !m_deviceStatusReported[device.first])
+                    triggerDeviceStatusUpdate(device.second, false);
+            }
+            return false;
+        }
+        LOG(DEBUG) << "ModbusReader: Connected ModbusClient.";
+        m_connectionState = ConnectionState{};
+    }
+
+    // Read the devices that have groups due, the one with the earliest deadline first.
+    const auto now = std::chrono::steady_clock::now();
+    auto dueDevices = std::vector<std::tuple<std::chrono::steady_clock::time_point, std::shared_ptr<ModbusDevice>,
+                                             std::vector<std::shared_ptr<RegisterGroup>>>>{};
+    for (const auto& device : m_devices)
+    {
+        if (device.second->getGroups().empty())
+            continue;
+
+        const auto deadline = nextGroupRead(*device.second);
+        auto groups = takeDueGroups(*device.second, now);
+        if (!groups.empty())
+            dueDevices.emplace_back(deadline, device.second, std::move(groups));
+    }
+    std::stable_sort(dueDevices.begin(), dueDevices.end(),
+                     [](const auto& left, const auto& right) { return std::get<0>(left) < std::get<0>(right); });
+
+    auto deviceRead = false;
+    for (const auto& dueDevice : dueDevices)
+    {
+        deviceRead = readDeviceGroups(std::get<1>(dueDevice), std::get<2>(dueDevice)) || deviceRead;
+        adaptReadPeriods(*std::get<1>(dueDevice), std::get<2>(dueDevice));
+    }
+    for (const auto& device : m_devices)
+    {
+        if (device.second->getNextRewrite() <= now)
+            rewriteDeviceMappings(device.second);
+    }
+
+    if (!dueDevices.empty() && !deviceRead)
+    {
+        LOG(WARN) << "ModbusReader: No devices have been read successfully. Reconnecting...";
+        m_modbusClient.disconnect();
+    }
+    return dueDevices.empty() || deviceRead;
+}
+
 void ModbusReader::run()
 {
     auto threadsRunning = false;
@@ -260,14 +448,16 @@ void ModbusReader::run()
             while (!m_modbusClient.connect())
             {
                 // Timing logic, increase the time after which we attempt to reconnect.
-                std::this_thread::sleep_for(std::chrono::seconds(m_timeoutDurations[m_timeoutIterator]));
-                if ((uint32_t)m_timeoutIterator < m_timeoutDurations.size() - 1)
-                {
-                    m_timeoutIterator++;
-                }
+                scheduleReconnect();
+                if (!sleepFor(m_connectionState.nextAttempt - std::chrono::steady_clock::now()))
+                    break;
+            }
+            if (!m_readerShouldRun)
+            {
+                break;
             }
             m_shouldReconnect = false;
-            m_timeoutIterator = 0;
+            m_connectionState = ConnectionState{};
 
             // Report all devices as active.
             for (auto& device : m_deviceActiveStatus)
@@ -284,23 +474,19 @@ void ModbusReader::run()
             if (m_modbusClient.isConnected())
             {
                 LOG(TRACE) << "ModbusReader: Reading devices.";
-                // Start thread foreach device, wait the readPeriod for the threads to execute, and
-                // join them back in. Process if some of them reported errors, if all, go to reconnect,
+                // Start the workers, and hand them the reads and rewrites of the devices as they come due for the
+                // readPeriod. Process if some of the devices reported errors, if all, go to reconnect,
                 // if just some are, report them as non-active.
                 if (!threadsRunning)
                 {
                     for (const auto& device : m_devices)
-                    {
-                        m_threads[device.second->getSlaveAddress()] =
-                          std::unique_ptr<std::thread>(new std::thread(&ModbusReader::readDevice, this, device.second));
-                        m_rewriteThreads[device.second->getSlaveAddress()] = std::unique_ptr<std::thread>(
-                          new std::thread(&ModbusReader::rewriteDevice, this, device.second));
                         m_deviceActiveStatus[device.second->getSlaveAddress()] = true;
-                    }
+                    startWorkers();
                     threadsRunning = true;
                 }
 
-                std::this_thread::sleep_for(m_readPeriod);
+                if (!dispatchTasks(std::chrono::steady_clock::now() + m_readPeriod))
+                    break;
 
                 auto deviceRead = false;
                 {
@@ -329,170 +515,698 @@ void ModbusReader::run()
             else
             {
                 m_shouldReconnect = true;
+                sleepFor(std::chrono::milliseconds(100));
             }
+        }
+    }
+}
+
+TimerWheel::TimerId ModbusReader::toTimerId(int16_t slaveAddress, TaskType type)
+{
+    return (static_cast<TimerWheel::TimerId>(static_cast<uint16_t>(slaveAddress)) << 1) |
+           static_cast<TimerWheel::TimerId>(type);
+}
+
+void ModbusReader::startWorkers()
+{
+    {
+        std::lock_guard<std::mutex> lock{m_taskMutex};
+        const auto now = std::chrono::steady_clock::now();
+        for (const auto& device : m_devices)
+        {
+            if (device.second->getGroups().empty())
+                LOG(WARN) << "ModbusReader: Device " << device.second->getName() << " has no mappings.";
+            else
+                m_timerWheel.schedule(toTimerId(device.first, TaskType::READ), now);
 
-            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            // The rewrites are spread over time by the device, and the devices without any are woken up once they
+            // get some.
+            const auto nextRewrite = device.second->getNextRewrite();
+            if (nextRewrite != std::chrono::steady_clock::time_point::max())
+                m_timerWheel.schedule(toTimerId(device.first, TaskType::REWRITE), nextRewrite);
         }
     }
+
+    LOG(DEBUG) << "ModbusReader: Starting " << m_workerCount << " workers for " << m_devices.size() << " devices.";
+    for (auto i = std::size_t{0}; i < m_workerCount; ++i)
+        m_workers.emplace_back(&ModbusReader::work, this);
 }
 
-void ModbusReader::readDevice(const std::shared_ptr<ModbusDevice>& device)
+bool ModbusReader::dispatchTasks(std::chrono::steady_clock::time_point until)
 {
+    std::unique_lock<std::mutex> lock{m_taskMutex};
     while (m_readerShouldRun)
     {
-        auto start = std::chrono::high_resolution_clock::now();
-
-        if (device->getGroups().empty())
+        const auto now = std::chrono::steady_clock::now();
+        const auto due = m_timerWheel.advance(now);
+        if (!due.empty())
         {
-            LOG(WARN) << "ModbusReader: Device " << device->getName() << " has no mappings.";
-            return;
+            m_tasks.insert(m_tasks.end(), due.cbegin(), due.cend());
+            m_takenTasks.insert(due.cbegin(), due.cend());
+            m_taskCondition.notify_all();
         }
+        if (now >= until)
+            break;
 
-        LOG(TRACE) << "ModbusReader: Reading device : " << device->getName();
+        // Wake up for the next deadline, or when a worker puts a task back on the wheel.
+        m_wheelChanged = false;
+        m_scheduleCondition.wait_until(lock, std::min(m_timerWheel.nextWakeUp(), until),
+                                       [&] { return !m_readerShouldRun || m_wheelChanged; });
+    }
+    return m_readerShouldRun;
+}
 
-        // Work on this logic, read all groups and do it properly.
-        // Also, parse types and values as necessary.
-        uint16_t unreadGroups = 0;
+void ModbusReader::work()
+{
+    while (true)
+    {
+        auto task = TimerWheel::TimerId{0};
+        {
+            std::unique_lock<std::mutex> lock{m_taskMutex};
+            m_taskCondition.wait(lock, [&] { return !m_readerShouldRun || !m_tasks.empty(); });
+            if (!m_readerShouldRun)
+                return;
+            task = m_tasks.front();
+            m_tasks.pop_front();
+        }
 
-        // Read through all the groups.
-        for (const auto& group : device->getGroups())
+        auto next = executeTask(task);
         {
-            if (!ModbusGroupReader::readGroup(m_modbusClient, *group))
+            std::lock_guard<std::mutex> lock{m_taskMutex};
+            m_takenTasks.erase(task);
+            // The deadlines might have changed while the task was executed.
+            if (m_rescheduledTasks.erase(task) > 0)
             {
-                LOG(WARN) << "ModbusReader: Group starting at : " << group->getStartingAddress() << " on slave "
-                          << group->getSlaveAddress() << " had error while reading.";
-                unreadGroups++;
+                const auto device = m_devices.find(static_cast<int16_t>(static_cast<uint16_t>(task >> 1)));
+                if (device != m_devices.cend())
+                    next = std::min(next, device->second->getNextRewrite());
             }
+            if (next == std::chrono::steady_clock::time_point::max())
+                continue;
+
+            m_timerWheel.schedule(task, next);
+            m_wheelChanged = true;
         }
+        m_scheduleCondition.notify_one();
+    }
+}
 
-        // If all the groups had error while reading, report the device as having errors.
-        const auto status = unreadGroups != device->getGroups().size();
+std::chrono::steady_clock::time_point ModbusReader::executeTask(TimerWheel::TimerId task)
+{
+    const auto slaveAddress = static_cast<int16_t>(static_cast<uint16_t>(task >> 1));
+    const auto it = m_devices.find(slaveAddress);
+    if (it == m_devices.cend())
+        return std::chrono::steady_clock::time_point::max();
+
+    if (static_cast<TaskType>(task & 1) == TaskType::READ)
+        return readDevice(it->second);
+    return rewriteDevice(it->second);
+}
+
+std::chrono::steady_clock::time_point ModbusReader::readDevice(const std::shared_ptr<ModbusDevice>& device)
+{
+    if (device->getGroups().empty())
+    {
+        LOG(WARN) << "ModbusReader: Device " << device->getName() << " has no mappings.";
+        return std::chrono::steady_clock::time_point::max();
+    }
+
+    const auto groups = takeDueGroups(*device, std::chrono::steady_clock::now());
+    if (!groups.empty())
+    {
+        readDeviceGroups(device, groups);
+        adaptReadPeriods(*device, groups);
+    }
+
+    return nextGroupRead(*device);
+}
+
+bool ModbusReader::readDeviceGroups(const std::shared_ptr<ModbusDevice>& device)
+{
+    return readDeviceGroups(device, device->getGroups());
+}
+
+bool ModbusReader::readDeviceGroups(const std::shared_ptr<ModbusDevice>& device,
+                                    const std::vector<std::shared_ptr<RegisterGroup>>& groups)
+{
+    const auto slaveAddress = device->getSlaveAddress();
+    auto probe = false;
+    {
         std::lock_guard<std::mutex> lockGuard{m_deviceActiveMutex};
-        if (m_deviceActiveStatus[device->getSlaveAddress()] != status ||
-            !m_deviceStatusReported[device->getSlaveAddress()])
+        const auto& breaker = m_circuitBreakers[slaveAddress];
+        if (breaker.open)
         {
-            triggerDeviceStatusUpdate(device, status);
+            if (std::chrono::steady_clock::now() < breaker.nextProbe)
+                return false;
+            probe = true;
+        }
+    }
+
+    // Probe the device with a single read, and read all the groups only if it responded.
+    auto status = false;
+    if (!probe || probeDevice(*device))
+    {
+        if (probe)
+            LOG(INFO) << "ModbusReader: Device " << device->getName() << " responded to the probe, resuming reads.";
+        LOG(TRACE) << "ModbusReader: Reading device : " << device->getName();
+
+        // Clients that pipeline requests get all the groups at once, as a single turn on the bus. Other clients get
+        // a turn per group, so the writes of the users wait for at most one read. The values are parsed on this
+        // thread once the reads are done.
+        const auto unreadGroups = ModbusGroupReader::readGroups(
+          [&](std::vector<ModbusReadRequest>& requests) {
+              if (m_modbusClient.pipelinesRequests())
+              {
+                  executeOnBus(slaveAddress, [&](ModbusClient& client) { return client.readBatch(requests); });
+                  return;
+              }
+
+              for (auto& request : requests)
+              {
+                  request.success = false;
+                  executeOnBus(slaveAddress, [&](ModbusClient& client) { return client.read(request); });
+              }
+          },
+          groups);
+
+        // If all the groups had error while reading, report the device as having errors.
+        status = unreadGroups != groups.size();
+    }
+
+    std::lock_guard<std::mutex> lockGuard{m_deviceActiveMutex};
+    auto& breaker = m_circuitBreakers[slaveAddress];
+    if (status)
+    {
+        breaker = CircuitBreaker{};
+    }
+    else if (breaker.open)
+    {
+        breaker.backoff = std::min(breaker.backoff * 2, m_maxBackoff);
+        breaker.nextProbe = std::chrono::steady_clock::now() + breaker.backoff;
+    }
+    else if (m_failureThreshold > 0 && ++breaker.consecutiveFailures >= m_failureThreshold)
+    {
+        LOG(WARN) << "ModbusReader: Device " << device->getName() << " failed " << breaker.consecutiveFailures
+                  << " reads in a row, probing it until it responds.";
+        breaker.open = true;
+        breaker.backoff = m_initialBackoff;
+        breaker.nextProbe = std::chrono::steady_clock::now() + breaker.backoff;
+    }
+
+    if (m_deviceActiveStatus[slaveAddress] != status || !m_deviceStatusReported[slaveAddress])
+    {
+        triggerDeviceStatusUpdate(device, status);
+    }
+    return status;
+}
+
+std::vector<std::shared_ptr<RegisterGroup>> ModbusReader::takeDueGroups(const ModbusDevice& device,
+                                                                         std::chrono::steady_clock::time_point now)
+{
+    const auto& groups = device.getGroups();
+    auto& deadlines = m_groupDeadlines[device.getSlaveAddress()];
+    // New groups are first due at the phase offset of the device.
+    deadlines.resize(groups.size(), now + device.getPhaseOffset());
+
+    auto due = std::vector<std::size_t>{};
+    for (auto i = std::size_t{0}; i < groups.size(); ++i)
+    {
+        if (deadlines[i] <= now)
+            due.emplace_back(i);
+    }
+    std::stable_sort(due.begin(), due.end(),
+                     [&](std::size_t left, std::size_t right) { return deadlines[left] < deadlines[right]; });
+
+    auto dueGroups = std::vector<std::shared_ptr<RegisterGroup>>{};
+    dueGroups.reserve(due.size());
+    auto timing = PollTiming{};
+    for (const auto index : due)
+    {
+        dueGroups.emplace_back(groups[index]);
+        const auto jitter = std::chrono::duration_cast<std::chrono::microseconds>(now - deadlines[index]);
+        ++timing.reads;
+        timing.lastJitter = jitter;
+        timing.maxJitter = std::max(timing.maxJitter, jitter);
+        timing.totalJitter += jitter;
+
+        // The next deadline is a period after this one, not after now, so the reads don't drift. Reads that were
+        // missed are skipped, instead of executed back to back.
+        const auto period =
+          std::max(getCurrentReadPeriod(device.getSlaveAddress(), index), std::chrono::milliseconds{1});
+        deadlines[index] += period;
+        if (deadlines[index] <= now)
+        {
+            const auto missed = (now - deadlines[index]) / period + 1;
+            deadlines[index] += period * missed;
+            timing.overruns += static_cast<std::uint64_t>(missed);
         }
+    }
+
+    if (timing.overruns > 0)
+    {
+        LOG(WARN) << "ModbusReader: Skipped " << timing.overruns << " group read(s) of device " << device.getName()
+                  << ", as it was still being read. Consider increasing the read period.";
+    }
+    if (timing.reads > 0)
+    {
+        std::lock_guard<std::mutex> lockGuard{m_deviceActiveMutex};
+        auto& deviceTiming = m_pollTimings[device.getSlaveAddress()];
+        deviceTiming.reads += timing.reads;
+        deviceTiming.overruns += timing.overruns;
+        deviceTiming.lastJitter = timing.lastJitter;
+        deviceTiming.maxJitter = std::max(deviceTiming.maxJitter, timing.maxJitter);
+        deviceTiming.totalJitter += timing.totalJitter;
+    }
+    return dueGroups;
+}
 
-        auto duration =
-          std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - start);
+std::chrono::steady_clock::time_point ModbusReader::nextGroupRead(const ModbusDevice& device)
+{
+    const auto& deadlines = m_groupDeadlines[device.getSlaveAddress()];
+    // Groups that don't have a deadline yet have never been read.
+    if (deadlines.size() < device.getGroups().size())
+        return std::chrono::steady_clock::time_point{};
+    const auto earliest = std::min_element(deadlines.cbegin(), deadlines.cend());
+    return earliest != deadlines.cend() ? *earliest : std::chrono::steady_clock::time_point::max();
+}
+
+void ModbusReader::adaptReadPeriods(const ModbusDevice& device,
+                                    const std::vector<std::shared_ptr<RegisterGroup>>& readGroups)
+{
+    if (m_maxAdaptivePeriod.count() == 0)
+        return;
 
-        if (duration.count() >= m_readPeriod.count())
+    const auto& groups = device.getGroups();
+    auto& deadlines = m_groupDeadlines[device.getSlaveAddress()];
+    auto& activities = m_groupActivity[device.getSlaveAddress()];
+    activities.resize(groups.size(), GroupActivity{std::chrono::milliseconds{0}, 0, 0});
+    for (auto i = std::size_t{0}; i < groups.size() && i < deadlines.size(); ++i)
+    {
+        // Groups that weren't read, or failed to be read, keep their period.
+        const auto& group = groups[i];
+        auto& activity = activities[i];
+        if (group->getReadCount() == activity.readCount ||
+            std::find(readGroups.cbegin(), readGroups.cend(), group) == readGroups.cend())
+            continue;
+
+        const auto basePeriod = readPeriodOf(*group);
+        const auto currentPeriod = activity.period.count() > 0 ? activity.period : basePeriod;
+        auto nextPeriod = basePeriod;
+        if (group->getChangeCount() == activity.changeCount && m_maxAdaptivePeriod > basePeriod)
         {
-            LOG(WARN) << "ModbusReader: Thread read device " << device->getName()
-                      << " for more than read period."
-                         " Skipping sleep. Consider increasing the read period.";
+            const auto stretched = std::chrono::duration_cast<std::chrono::milliseconds>(
+              std::chrono::duration<double, std::milli>(currentPeriod) * m_adaptiveStretchFactor);
+            nextPeriod = std::min(std::max(stretched, currentPeriod + std::chrono::milliseconds{1}),
+                                  m_maxAdaptivePeriod);
         }
-        else
+        activity.readCount = group->getReadCount();
+        activity.changeCount = group->getChangeCount();
+
+        // The deadline was moved a current period on when the group was taken, it is moved by the new one instead.
+        if (nextPeriod != currentPeriod)
         {
-            std::this_thread::sleep_for(m_readPeriod - duration);
+            deadlines[i] += nextPeriod - currentPeriod;
+            activity.period = nextPeriod == basePeriod ? std::chrono::milliseconds{0} : nextPeriod;
         }
+    }
+}
 
-        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+std::chrono::milliseconds ModbusReader::readPeriodOf(const RegisterGroup& group) const
+{
+    return group.getReadPeriod().count() > 0 ? group.getReadPeriod() : m_readPeriod;
+}
+
+bool ModbusReader::probeDevice(const ModbusDevice& device)
+{
+    auto registerType = device.getLivenessRegisterType();
+    auto address = device.getLivenessRegisterAddress();
+    if (!device.hasLivenessRegister())
+    {
+        const auto& group = *device.getGroups().front();
+        registerType = group.getRegisterType();
+        address = group.getStartingAddress();
     }
+
+    return executeOnBus(device.getSlaveAddress(), [&](ModbusClient& client) {
+        auto bit = false;
+        auto bits = std::vector<bool>{};
+        auto value = uint16_t{0};
+        auto values = std::vector<uint16_t>{};
+        switch (registerType)
+        {
+        case RegisterType::COIL:
+            return client.readCoil(device.getSlaveAddress(), address, bit);
+        case RegisterType::INPUT_CONTACT:
+            return client.readInputContacts(device.getSlaveAddress(), address, 1, bits);
+        case RegisterType::HOLDING_REGISTER:
+            return client.readHoldingRegister(device.getSlaveAddress(), address, value);
+        case RegisterType::INPUT_REGISTER:
+            return client.readInputRegisters(device.getSlaveAddress(), address, 1, values);
+        }
+        return false;
+    });
 }
 
-void ModbusReader::rewriteDevice(const std::shared_ptr<ModbusDevice>& device)
+std::chrono::steady_clock::time_point ModbusReader::rewriteDevice(const std::shared_ptr<ModbusDevice>& device)
 {
-    bool connected = true;
+    rewriteDeviceMappings(device);
+    return device->getNextRewrite();
+}
 
-    while (m_readerShouldRun)
+ModbusBusScheduler& ModbusReader::getBusScheduler()
+{
+    return m_busScheduler;
+}
+
+void ModbusReader::rescheduleRewrite(const ModbusDevice& device)
+{
     {
-        if (device->getRewritable().empty())
+        std::lock_guard<std::mutex> lock{m_taskMutex};
+        if (!m_readerShouldRun || m_workers.empty())
+            return;
+
+        // A task that is taken off the wheel is put back by its worker, so it is never executed twice at once.
+        const auto task = toTimerId(device.getSlaveAddress(), TaskType::REWRITE);
+        if (m_takenTasks.count(task) > 0)
         {
-            LOG(WARN) << "ModbusReader: Device " << device->getName() << " has no rewritable mappings.";
+            m_rescheduledTasks.emplace(task);
             return;
         }
 
-        // Count the amount of mappings that needed to be rewritten, and the ones that succeeded
-        auto requiredMappings = std::uint64_t{0};
-        auto succeededMappings = std::uint64_t{0};
+        const auto nextRewrite = device.getNextRewrite();
+        if (nextRewrite == std::chrono::steady_clock::time_point::max())
+            m_timerWheel.cancel(task);
+        else
+            m_timerWheel.schedule(task, nextRewrite);
+        m_wheelChanged = true;
+    }
+    m_scheduleCondition.notify_one();
+}
+
+void ModbusReader::rewriteDeviceMappings(const std::shared_ptr<ModbusDevice>& device)
+{
+    // Collect the rewritable mappings that haven't been written into for a while.
+    const auto now = std::chrono::steady_clock::now();
+    auto writes = std::vector<MappingWrite>{};
+    for (const auto& rewritable : device->takeDueRewritable(now))
+        writes.emplace_back(MappingWrite{rewritable, rewritable->getBytesValues(), rewritable->getBoolValue()});
 
-        // Read through all the rewritable mappings.
-        for (const auto& rewritable : device->getRewritable())
+    // Write the current values in, the adjacent ones together.
+    const auto requiredMappings = writes.size();
+    auto succeededMappings = std::size_t{0};
+    // The rewrites are background work, so they wait for their turn like the reads.
+    const auto results = executeWrites(writes, ModbusBusScheduler::Priority::NORMAL);
+    for (auto i = std::size_t{0}; i < writes.size(); ++i)
+    {
+        const auto& rewritable = writes[i].mapping;
+        if (!results[i])
         {
-            // Check that the value is not
-            const auto repeatedWriteTime = rewritable->getRepeatedWrite();
-            if (repeatedWriteTime.count() == 0)
+            // Failed rewrites are retried in the next read period.
+            LOG(DEBUG) << "Failed to rewrite '" << rewritable->getReference() << "'.";
+            device->scheduleRewrite(rewritable, now + std::min(m_readPeriod, rewritable->getRepeatedWrite()));
+            continue;
+        }
+
+        LOG(TRACE) << "Successfully rewrote '" << rewritable->getReference() << "'.";
+        if (rewritable->getRegisterType() == RegisterType::COIL)
+            rewritable->update(writes[i].value);
+        else
+            rewritable->update(writes[i].values);
+        device->scheduleRewrite(rewritable, now + rewritable->getRepeatedWrite());
+        ++succeededMappings;
+    }
+
+    // If all the groups had error while reading, report the device as having errors.
+    if (requiredMappings > 0)
+    {
+        const auto status = succeededMappings > 0;
+        std::lock_guard<std::mutex> lockGuard{m_deviceActiveMutex};
+        if (m_deviceActiveStatus[device->getSlaveAddress()] != status ||
+            !m_deviceStatusReported[device->getSlaveAddress()])
+        {
+            triggerDeviceStatusUpdate(device, status);
+        }
+    }
+}
+
+ModbusBusScheduler::Request ModbusReader::createWriteRequest(const RegisterMapping& mapping,
+                                                             const std::vector<uint16_t>& values) const
+{
+    if (mapping.getRegisterType() != RegisterType::HOLDING_REGISTER)
+        throw std::logic_error(
+          R"(ModbusReader: You can't write bytes to anything other than HOLDING_REGISTER mapping.)");
+    if (mapping.getRegisterCount() != static_cast<int16_t>(values.size()))
+        throw std::logic_error("ModbusReader: Received " + std::to_string(values.size()) + " values, but need " +
+                               std::to_string(mapping.getRegisterCount()) + ".");
+    if (m_devices.find(mapping.getSlaveAddress()) == m_devices.end())
+        throw std::logic_error(R"(ModbusReader: Mapping slave address isn't registered with the ModbusReader.)");
+
+    const auto slaveAddress = mapping.getSlaveAddress();
+    const auto address = mapping.getStartingAddress();
+    return [slaveAddress, address, registers = values](ModbusClient& client) mutable {
+        if (client.writeHoldingRegisters(slaveAddress, address, registers))
+            return true;
+
+        LOG(WARN) << "ModbusReader: Unable to write holding register values - Register address : " << address
+                  << " Registers : " << registers.size();
+        return false;
+    };
+}
+
+ModbusBusScheduler::Request ModbusReader::createWriteRequest(const RegisterMapping& mapping, bool value) const
+{
+    if (mapping.getRegisterType() != RegisterType::COIL)
+        throw std::logic_error(R"(ModbusReader: You can't write bool to anything other than COIL mapping.)");
+    if (m_devices.find(mapping.getSlaveAddress()) == m_devices.end())
+        throw std::logic_error(R"(ModbusReader: Mapping slave address isn't registered with the ModbusReader.)");
+
+    const auto slaveAddress = mapping.getSlaveAddress();
+    const auto address = mapping.getStartingAddress();
+    return [slaveAddress, address, value](ModbusClient& client) {
+        if (client.writeCoil(slaveAddress, address, value))
+            return true;
+
+        LOG(WARN) << "ModbusReader: Unable to write coil value - Register address : " << address
+                  << " Value : " << value;
+        return false;
+    };
+}
+
+ModbusBusScheduler::Request ModbusReader::createBitWriteRequest(const RegisterMapping& mapping, bool value) const
+{
+    if (mapping.getRegisterType() != RegisterType::HOLDING_REGISTER)
+        throw std::logic_error(R"(ModbusReader: You can't write bit to anything other than HOLDING_REGISTER mapping.)");
+    if (mapping.getOperationType() != OperationType::TAKE_BIT)
+        throw std::logic_error(R"(ModbusReader: You can't write bit to mapping that isn't TAKE_BIT.)");
+    const auto it = m_devices.find(mapping.getSlaveAddress());
+    if (it == m_devices.end())
+        throw std::logic_error(R"(ModbusReader: Mapping slave address isn't registered with the ModbusReader.)");
+
+    // The read and the write are a single request, so nothing else is written into the register in between.
+    const auto device = it->second;
+    const auto slaveAddress = mapping.getSlaveAddress();
+    const auto address = mapping.getStartingAddress();
+    const auto index = static_cast<uint8_t>(mapping.getBitIndex());
+    return [device, slaveAddress, address, index, value](ModbusClient& client) {
+        // Write the bit with a single mask write if the device supports it, or it hasn't been probed yet.
+        const auto maskWriteSupport = device->getMaskWriteSupport();
+        if (maskWriteSupport != MaskWriteSupport::UNSUPPORTED)
+        {
+            const auto bit = static_cast<uint16_t>(1 << index);
+            if (client.maskWriteHoldingRegister(slaveAddress, address, static_cast<uint16_t>(~bit),
+                                                value ? bit : uint16_t{0}))
             {
-                continue;
+                if (maskWriteSupport == MaskWriteSupport::UNKNOWN)
+                    device->setMaskWriteSupport(MaskWriteSupport::SUPPORTED);
+                return true;
             }
 
-            const auto nextUpdateTime = rewritable->getLastUpdateTime() + repeatedWriteTime;
-            const auto diff = (std::chrono::duration_cast<std::chrono::milliseconds>(
-                                 std::chrono::high_resolution_clock::now() - nextUpdateTime))
-                                .count();
-            if (diff > 0)
+            if (maskWriteSupport == MaskWriteSupport::SUPPORTED)
             {
-                ++requiredMappings;
-
-                // Write the current value in
-                if (rewritable->getRegisterType() == RegisterType::COIL)
-                {
-                    if (m_modbusClient.writeCoil(rewritable->getSlaveAddress(), rewritable->getStartingAddress(),
-                                                 rewritable->getBoolValue()))
-                    {
-                        LOG(DEBUG) << "Successfully rewrote '" << rewritable->getReference() << "' - " << diff << "ms.";
-                        rewritable->update(rewritable->getBoolValue());
-                        ++succeededMappings;
-                    }
-                    else
-                    {
-                        LOG(DEBUG) << "Failed to rewrite '" << rewritable->getReference() << "'.";
-                    }
-                }
-                else
-                {
-                    if (rewritable->getRegisterCount() == 1)
-                    {
-                        if (m_modbusClient.writeHoldingRegister(rewritable->getSlaveAddress(),
-                                                                rewritable->getStartingAddress(),
-                                                                rewritable->getBytesValues().front()))
-                        {
-                            LOG(TRACE) << "Successfully rewrote '" << rewritable->getReference() << "' - " << diff
-                                       << "ms.";
-                            rewritable->update(rewritable->getBytesValues());
-                            ++succeededMappings;
-                        }
-                        else
-                        {
-                            LOG(WARN) << "Failed to rewrite '" << rewritable->getReference() << "'.";
-                        }
-                    }
-                    else
-                    {
-                        if (m_modbusClient.writeHoldingRegisters(
-                              rewritable->getSlaveAddress(), rewritable->getStartingAddress(),
-                              const_cast<std::vector<std::uint16_t>&>(rewritable->getBytesValues())))
-                        {
-                            LOG(DEBUG) << "Successfully rewrote '" << rewritable->getReference() << "' - " << diff
-                                       << "ms.";
-                            rewritable->update(rewritable->getBytesValues());
-                            ++succeededMappings;
-                        }
-                        else
-                        {
-                            LOG(DEBUG) << "Failed to rewrite '" << rewritable->getReference() << "'.";
-                        }
-                    }
-                }
+                LOG(WARN) << "ModbusReader: Unable to mask write holding register bit - Register address : "
+                          << address;
+                return false;
             }
         }
 
-        // If all the groups had error while reading, report the device as having errors.
-        if (requiredMappings > 0)
+        // Read value
+        uint16_t registerValue;
+        if (!client.readHoldingRegister(slaveAddress, address, registerValue))
         {
-            const auto status = succeededMappings > 0;
-            std::lock_guard<std::mutex> lockGuard{m_deviceActiveMutex};
-            if (m_deviceActiveStatus[device->getSlaveAddress()] != status ||
-                !m_deviceStatusReported[device->getSlaveAddress()])
+            LOG(WARN) << "ModbusReader: Unable to read holding register value - Register address : " << address
+                      << " for purpose of writing a bit into it.";
+            return false;
+        }
+        uint16_t newValue = registerValue;
+
+        // The device could be read, so the mask write must have failed because the device doesn't support it.
+        if (maskWriteSupport == MaskWriteSupport::UNKNOWN)
+        {
+            LOG(INFO) << "ModbusReader: Device '" << device->getName()
+                      << "' doesn't support mask writes, bits will be written with a read and a write.";
+            device->setMaskWriteSupport(MaskWriteSupport::UNSUPPORTED);
+        }
+
+        // Append bit
+        const auto& bits = DataParsers::separateBits(registerValue);
+        if (bits[index] != value)
+            newValue += (1 << index) * (value ? 1 : -1);
+        if (registerValue == newValue)
+            return true;
+
+        // Write new value
+        if (client.writeHoldingRegister(slaveAddress, address, newValue))
+            return true;
+
+        LOG(WARN) << "ModbusReader: Unable to write holding register bit - Register address : " << address
+                  << " Value : " << newValue;
+        return false;
+    };
+}
+
+void ModbusReader::completeWrite(RegisterMapping& mapping, bool written, const std::vector<uint16_t>& values)
+{
+    if (!written)
+    {
+        mapping.setValid(false);
+        return;
+    }
+
+    LOG(TRACE) << "ModbusReader: Written values '"
+               << (std::accumulate(values.begin(), values.end(), std::string{},
+                                   [](auto s, auto v) { return s + " " + std::to_string(v); }))
+               << "' for mapping '" << mapping.getReference() << "'.";
+    if (mapping.isAutoUpdateEnabled())
+        mapping.update(values);
+}
+
+void ModbusReader::completeWrite(RegisterMapping& mapping, bool written, bool value)
+{
+    if (!written)
+    {
+        mapping.setValid(false);
+        return;
+    }
+
+    LOG(TRACE) << "ModbusReader: Written value '" << value << "' for mapping '" << mapping.getReference() << "'.";
+    if (mapping.isAutoUpdateEnabled())
+        mapping.update(value);
+}
+
+std::future<bool> ModbusReader::toFuture(const std::function<void(WriteCallback)>& write)
+{
+    const auto promise = std::make_shared<std::promise<bool>>();
+    auto future = promise->get_future();
+    write([promise](bool written) { promise->set_value(written); });
+    return future;
+}
+
+std::vector<ModbusReader::WriteFrame> ModbusReader::planWrites(const std::vector<MappingWrite>& writes)
+{
+    // Sort the writes by slave, type and address, so the adjacent ones follow each other.
+    auto order = std::vector<std::size_t>(writes.size());
+    std::iota(order.begin(), order.end(), std::size_t{0});
+    std::stable_sort(order.begin(), order.end(), [&](std::size_t left, std::size_t right) {
+        const auto& leftMapping = *writes[left].mapping;
+        const auto& rightMapping = *writes[right].mapping;
+        return std::make_tuple(leftMapping.getSlaveAddress(), leftMapping.getRegisterType(),
+                               leftMapping.getStartingAddress()) <
+               std::make_tuple(rightMapping.getSlaveAddress(), rightMapping.getRegisterType(),
+                               rightMapping.getStartingAddress());
+    });
+
+    auto frames = std::vector<WriteFrame>{};
+    for (const auto index : order)
+    {
+        const auto& write = writes[index];
+        const auto& mapping = *write.mapping;
+        const auto isCoil = mapping.getRegisterType() == RegisterType::COIL;
+        const auto count = isCoil ? 1 : static_cast<int>(write.values.size());
+        const auto maxCount = isCoil ? ModbusClient::MAX_WRITE_COILS : ModbusClient::MAX_WRITE_REGISTERS;
+
+        if (frames.empty() || frames.back().slaveAddress != mapping.getSlaveAddress() ||
+            frames.back().registerType != mapping.getRegisterType() ||
+            frames.back().address + frames.back().count != mapping.getStartingAddress() ||
+            frames.back().count + count > maxCount)
+        {
+            frames.emplace_back(WriteFrame{mapping.getSlaveAddress(),
+                                           mapping.getRegisterType(),
+                                           mapping.getStartingAddress(),
+                                           0,
+                                           {},
+                                           {},
+                                           {}});
+        }
+
+        auto& frame = frames.back();
+        frame.count += count;
+        frame.writes.emplace_back(index);
+        if (isCoil)
+            frame.coils.emplace_back(write.value);
+        else
+            frame.registers.insert(frame.registers.end(), write.values.cbegin(), write.values.cend());
+    }
+    return frames;
+}
+
+std::vector<bool> ModbusReader::executeWrites(const std::vector<MappingWrite>& writes,
+                                              ModbusBusScheduler::Priority priority)
+{
+    auto results = std::vector<bool>(writes.size(), false);
+    for (auto& frame : planWrites(writes))
+    {
+        // Single values use the single write functions, as some devices don't support the multiple ones.
+        const auto success = executeOnBus(frame.slaveAddress, [&](ModbusClient& client) {
+            if (frame.registerType == RegisterType::COIL)
             {
-                triggerDeviceStatusUpdate(device, status);
+                return frame.coils.size() == 1 ?
+                         client.writeCoil(frame.slaveAddress, frame.address, frame.coils.front()) :
+                         client.writeCoils(frame.slaveAddress, frame.address, frame.coils);
             }
-        }
+            return frame.registers.size() == 1 ?
+                     client.writeHoldingRegister(frame.slaveAddress, frame.address, frame.registers.front()) :
+                     client.writeHoldingRegisters(frame.slaveAddress, frame.address, frame.registers);
+        }, priority);
 
-        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        if (!success)
+        {
+            LOG(WARN) << "ModbusReader: Unable to write " << frame.writes.size()
+                      << " mapping(s) - Slave address : " << frame.slaveAddress
+                      << " Register address : " << frame.address << " Count : " << frame.count;
+        }
+        for (const auto index : frame.writes)
+            results[index] = success;
     }
+    return results;
+}
+
+bool ModbusReader::sleepFor(std::chrono::steady_clock::duration duration)
+{
+    std::unique_lock<std::mutex> lock{m_sleepMutex};
+    return !m_sleepCondition.wait_for(lock, duration, [this] { return !m_readerShouldRun; });
+}
+
+void ModbusReader::scheduleReconnect()
+{
+    // Double the delay with each failed attempt, and take a random part of up to a half off.
+    const auto doublings = std::min(m_connectionState.failedAttempts, std::uint32_t{30});
+    const auto delay = std::min(m_minReconnectDelay * (std::int64_t{1} << doublings), m_maxReconnectDelay);
+    auto jitter = std::uniform_int_distribution<std::int64_t>{0, delay.count() / 2};
+
+    ++m_connectionState.failedAttempts;
+    m_connectionState.nextAttempt =
+      std::chrono::steady_clock::now() + delay - std::chrono::milliseconds(jitter(m_random));
+    LOG(DEBUG) << "ModbusReader: Next connection attempt in "
+               << std::chrono::duration_cast<std::chrono::milliseconds>(m_connectionState.nextAttempt -
+                                                                        std::chrono::steady_clock::now())
+                    .count()
+               << "ms.";
+}
+
+bool ModbusReader::executeOnBus(int16_t slaveAddress, const ModbusBusScheduler::Request& request,
+                                ModbusBusScheduler::Priority priority)
+{
+    return m_busScheduler.submit(slaveAddress, request, priority).get();
 }
 
 void ModbusReader::triggerDeviceStatusUpdate(const std::shared_ptr<ModbusDevice>& device, bool status)
@@ -21,20 +21,54 @@
 
 #include "core/utilities/Timer.h"
 #include "more_modbus/ModbusDevice.h"
+#include "more_modbus/modbus/ModbusBusScheduler.h"
 #include "more_modbus/modbus/ModbusClient.h"
+#include "more_modbus/utilities/TimerWheel.h"
 
 #include <atomic>
+#include <condition_variable>
+#include <deque>
 #include <functional>
+#include <future>
+#include <random>
+#include <set>
 #include <thread>
 
 namespace wolkabout::more_modbus
 {
+/**
+ * @brief A single value to be written into a mapping, as a part of a batch.
+ * @details COIL mappings take the `value`, HOLDING_REGISTER mappings take the `values`, one for each register.
+ */
+struct MappingWrite
+{
+    std::shared_ptr<RegisterMapping> mapping;
+    std::vector<uint16_t> values;
+    bool value;
+};
+
+/**
+ * @brief Timing of the group reads of a device, measured against their deadlines.
+ */
+struct PollTiming
+{
+    // Group reads that were started.
+    std::uint64_t reads = 0;
+    // Group reads that were skipped, because the device was still being read when they were due.
+    std::uint64_t overruns = 0;
+    // How late the group reads started after their deadlines.
+    std::chrono::microseconds lastJitter{0};
+    std::chrono::microseconds maxJitter{0};
+    std::chrono::microseconds totalJitter{0};
+};
+
 /**
  * @brief Main functional class, that accepts all devices and reads them periodically.
- * @details Function of the class is to periodically trigger the reading of all devices,
- *         of course, each and every on their separate threads. Where the connection
- *         gets split between them all, and data parsing for mappings is execute on their own
- *         thread. And also, the on value change for mappings event is invoked.
+ * @details Function of the class is to periodically trigger the reading of all devices. The next read and the next
+ *         rewrite of every device are kept on a timer wheel, and handed over to a fixed number of worker threads
+ *         once they are due, so the number of threads doesn't grow with the number of devices. The connection is
+ *         shared between the workers, and the data parsing for mappings is executed on them. And also, the on value
+ *         change for mappings event is invoked.
  */
 class ModbusReader : public std::enable_shared_from_this<ModbusReader>
 {
@@ -43,8 +77,10 @@ public:
      * @brief Main constructor for the reader, that prepares all the necessary data for reading.
      * @param modbusClient one of implementations of the abstract class
      * @param readPeriod time period for cycling reads
+     * @param workerCount number of threads reading and rewriting the devices
      */
-    ModbusReader(ModbusClient& modbusClient, const std::chrono::milliseconds& readPeriod);
+    ModbusReader(ModbusClient& modbusClient, const std::chrono::milliseconds& readPeriod,
+                 std::size_t workerCount = 2);
 
     /**
      * Default virtual destructor.
@@ -81,12 +117,76 @@ public:
 
     /**
      * @brief Force the reader to write to a mapping that interacts with a bit from an 16bit register
+     * @details Uses a single mask write (function 22) if the device supports it, otherwise reads the register, and
+     *         writes it back with the bit changed. Devices with unknown support are probed on their first bit write.
      * @param mapping reference to bit mapping from one of the device that the reader was passed in constructor
      * @param value single boolean
      * @return whether or not the operation was successful
      */
     virtual bool writeBitMapping(RegisterMapping& mapping, bool value);
 
+    using WriteCallback = std::function<void(bool)>;
+
+    /**
+     * @brief Queues the write of the values into the mapping, same as writeMapping(), without waiting for it.
+     * @details The mapping is checked right away, and the method throws the same as writeMapping(). The mapping has to
+     *         outlive the write, which is failed if the reader is stopped before it is sent.
+     * @param mapping reference to mapping from one of devices that the reader was passed in constructor
+     * @param values array of uint16_t's, needs to contain exact amount of values as the mapping has in register count.
+     * @return The future result of the write.
+     */
+    std::future<bool> writeMappingAsync(RegisterMapping& mapping, const std::vector<uint16_t>& values);
+
+    /**
+     * @brief Queues the write of the values into the mapping, same as above.
+     * @param mapping reference to mapping from one of devices that the reader was passed in constructor
+     * @param values array of uint16_t's, needs to contain exact amount of values as the mapping has in register count.
+     * @param callback invoked with the result of the write, once the mapping has been updated
+     */
+    void writeMappingAsync(RegisterMapping& mapping, const std::vector<uint16_t>& values, WriteCallback callback);
+
+    /**
+     * @brief Queues the write of the value into the COIL mapping, same as writeMapping(), without waiting for it.
+     * @param mapping reference to mapping from one of devices that the reader was passed in constructor
+     * @param value single boolean
+     * @return The future result of the write.
+     */
+    std::future<bool> writeMappingAsync(RegisterMapping& mapping, bool value);
+
+    /**
+     * @brief Queues the write of the value into the COIL mapping, same as above.
+     * @param mapping reference to mapping from one of devices that the reader was passed in constructor
+     * @param value single boolean
+     * @param callback invoked with the result of the write, once the mapping has been updated
+     */
+    void writeMappingAsync(RegisterMapping& mapping, bool value, WriteCallback callback);
+
+    /**
+     * @brief Queues the write of the bit, same as writeBitMapping(), without waiting for it.
+     * @param mapping reference to bit mapping from one of the device that the reader was passed in constructor
+     * @param value single boolean
+     * @return The future result of the write.
+     */
+    std::future<bool> writeBitMappingAsync(RegisterMapping& mapping, bool value);
+
+    /**
+     * @brief Queues the write of the bit, same as above.
+     * @param mapping reference to bit mapping from one of the device that the reader was passed in constructor
+     * @param value single boolean
+     * @param callback invoked with the result of the write, once the mapping has been updated
+     */
+    void writeBitMappingAsync(RegisterMapping& mapping, bool value, WriteCallback callback);
+
+    /**
+     * @brief Force the reader to write to many COIL and HOLDING_REGISTER mappings at once.
+     * @details Mappings of the same slave and type, that are adjacent to each other, are written with a single
+     *         request (function 15 for coils, function 16 for holding registers). Bit mappings have to be written
+     *         using writeBitMapping.
+     * @param writes the mappings and their values
+     * @return Whether each of the writes was successful, in the order of the writes.
+     */
+    virtual std::vector<bool> writeMappings(const std::vector<MappingWrite>& writes);
+
     /**
      * @brief Force the reader to read the mapping. The value of the mapping will be announced through the device.
      * @param mapping The mapping that should be read.
@@ -104,6 +204,15 @@ public:
 
     const std::map<int16_t, bool>& getDeviceStatuses() const;
 
+    /**
+     * @brief The groups are due at absolute deadlines, a whole number of their read periods after the first read, so
+     *        the reads don't drift. Reads that are missed because the previous ones took too long are skipped, and
+     *        counted as overruns.
+     * @param slaveAddress
+     * @return The timing of the group reads of the device.
+     */
+    PollTiming getPollTiming(int16_t slaveAddress) const;
+
     /**
      * @brief Initializes the modbus connection, will also reconnect if it isn't working,
      *         or it disconnected in the meanwhile. If the connection is up, it will read
@@ -116,46 +225,272 @@ public:
      */
     void stop();
 
+    /**
+     * @brief Executes a single cycle on the calling thread, instead of using the reader's own threads: connects if
+     *         necessary, reads the groups that are due, and rewrites the mappings that are due. Used by the
+     *         ModbusFleet, that runs many readers on a shared pool of threads. Must not be mixed with start().
+     * @details If connecting fails, the next attempt is made only after the reconnect delay passes, and the devices
+     *         are reported offline. The devices are read in the order of their earliest deadline. If no device can be
+     *         read, the client is disconnected.
+     * @return Whether at least one device has been read, or no groups were due.
+     */
+    bool poll();
+
+    const std::chrono::milliseconds& getReadPeriod() const;
+
+    /**
+     * @brief The period in which poll() has to be called for every group to be read in time.
+     * @return The shortest read period of all the groups, or the read period of the reader if it is shorter.
+     */
+    std::chrono::milliseconds getPollPeriod() const;
+
+    /**
+     * @brief Configures the circuit breaker of the devices.
+     * @details After a number of consecutive failed reads, the groups of the device are no longer read, and only its
+     *         liveness register is probed, so an offline device doesn't burn a timeout on the bus for every group.
+     *         The probes are sent with a backoff, that doubles with every failed probe. Once a probe succeeds, the
+     *         device is fully read again.
+     * @param failureThreshold consecutive failed reads that open the circuit, 0 disables the circuit breaker
+     * @param initialBackoff time until the first probe
+     * @param maxBackoff the longest time between two probes
+     */
+    void setCircuitBreaker(std::uint32_t failureThreshold, std::chrono::milliseconds initialBackoff,
+                           std::chrono::milliseconds maxBackoff);
+
+    /**
+     * @param slaveAddress
+     * @return Whether the device is only probed, instead of being fully read.
+     */
+    bool isCircuitOpen(int16_t slaveAddress) const;
+
+    /**
+     * @brief Configures the delays between the reconnect attempts.
+     * @details The delay doubles after every failed attempt, from the minimum up to the maximum, and a random part of
+     *         up to a half of it is taken off, so readers that lost the connection at the same time don't all retry at
+     *         once. Stopping the reader interrupts the wait.
+     * @param minDelay delay after the first failed attempt
+     * @param maxDelay the longest delay between two attempts
+     */
+    void setReconnectDelays(std::chrono::milliseconds minDelay, std::chrono::milliseconds maxDelay);
+
+    /**
+     * @brief Enables the adaptive polling of the groups.
+     * @details Every read of a group that doesn't change any of its mappings stretches the period of the group by the
+     *         factor, up to the maximum period. The first read that changes a mapping brings the group back to its
+     *         own read period. Has to be set before the reader is started.
+     * @param maxPeriod the longest period a group is stretched to, 0 disables the adaptive polling
+     * @param stretchFactor has to be greater than 1
+     */
+    void setAdaptivePolling(std::chrono::milliseconds maxPeriod, double stretchFactor = 2.0);
+
+    /**
+     * @param slaveAddress
+     * @param groupIndex index of the group in the groups of the device
+     * @return The period the group is currently read in.
+     */
+    std::chrono::milliseconds getCurrentReadPeriod(int16_t slaveAddress, std::size_t groupIndex) const;
+
+    /**
+     * @brief Makes the reader take the current rewrite deadlines of the device. Called by the device when its
+     *       rewritable mappings change, so a new mapping doesn't wait for the previously scheduled rewrite.
+     * @param device
+     */
+    void rescheduleRewrite(const ModbusDevice& device);
+
+    /**
+     * @brief The scheduler that executes all the requests of the reader on the client, while the reader is running.
+     *       Can be used to give slaves more requests in a row with setWeight(), and to see how long the writes waited
+     *       for the bus with getQueueWait().
+     * @return The scheduler.
+     */
+    ModbusBusScheduler& getBusScheduler();
+
 private:
+    // Writes of the same slave and type, at adjacent addresses, that are sent as a single request.
+    struct WriteFrame
+    {
+        int16_t slaveAddress;
+        RegisterType registerType;
+        int address;
+        int count;
+        std::vector<std::size_t> writes;
+        std::vector<uint16_t> registers;
+        std::vector<bool> coils;
+    };
+
+    // Check the mapping can be written, and create the request writing the value into it.
+    ModbusBusScheduler::Request createWriteRequest(const RegisterMapping& mapping,
+                                                   const std::vector<uint16_t>& values) const;
+    ModbusBusScheduler::Request createWriteRequest(const RegisterMapping& mapping, bool value) const;
+    ModbusBusScheduler::Request createBitWriteRequest(const RegisterMapping& mapping, bool value) const;
+
+    // Invalidates the mapping if the write failed, or updates it with the written value.
+    static void completeWrite(RegisterMapping& mapping, bool written, const std::vector<uint16_t>& values);
+    static void completeWrite(RegisterMapping& mapping, bool written, bool value);
+
+    // Invokes the write with a callback, and returns the future of the result the callback receives.
+    static std::future<bool> toFuture(const std::function<void(WriteCallback)>& write);
+
+    // Groups the writes into the least number of requests, writes of the same address are kept in their order.
+    static std::vector<WriteFrame> planWrites(const std::vector<MappingWrite>& writes);
+
+    // Sends the planned requests with the priority, and returns whether each of the writes was successful.
+    std::vector<bool> executeWrites(const std::vector<MappingWrite>& writes, ModbusBusScheduler::Priority priority);
+
     // Main thread, handles initializing reading of devices, their status, and the modbus connection.
     void run();
 
-    // Does the logic of reading all devices groups, and parsing data to
-    // each separate mapping as the mapping requires them.
-    void readDevice(const std::shared_ptr<ModbusDevice>& device);
+    // A read or a rewrite of a device, kept on the timer wheel under an id made of the slave address and the type.
+    enum class TaskType
+    {
+        READ = 0,
+        REWRITE = 1
+    };
+
+    static TimerWheel::TimerId toTimerId(int16_t slaveAddress, TaskType type);
+
+    // Starts the workers, and schedules the first read and rewrite of every device.
+    void startWorkers();
+
+    // Hands the tasks that are due over to the workers, until the time passes or the reader is stopped.
+    // Returns whether the reader is still running.
+    bool dispatchTasks(std::chrono::steady_clock::time_point until);
+
+    // Worker thread, executes the tasks and puts their next run back on the timer wheel.
+    void work();
+
+    // Executes the task, and returns the time it has to be executed next, or max() if it doesn't.
+    std::chrono::steady_clock::time_point executeTask(TimerWheel::TimerId task);
+
+    // Does the logic of reading the groups of the device that are due, and parsing data to
+    // each separate mapping as the mapping requires them. Returns the time the next group is due.
+    std::chrono::steady_clock::time_point readDevice(const std::shared_ptr<ModbusDevice>& device);
+
+    // Reads all the groups of the device once, and reports its status. Returns the status.
+    // While the circuit of the device is open, only probes the device when the backoff expires.
+    bool readDeviceGroups(const std::shared_ptr<ModbusDevice>& device);
+
+    // Reads the passed groups of the device, and reports its status, same as above.
+    bool readDeviceGroups(const std::shared_ptr<ModbusDevice>& device,
+                          const std::vector<std::shared_ptr<RegisterGroup>>& groups);
 
-    // Does the logic of writing the values into mappings if they happen to be not written into for a while
-    void rewriteDevice(const std::shared_ptr<ModbusDevice>& device);
+    // Returns the groups of the device that are due, earliest deadline first, and moves their deadlines a period on.
+    std::vector<std::shared_ptr<RegisterGroup>> takeDueGroups(const ModbusDevice& device,
+                                                              std::chrono::steady_clock::time_point now);
+
+    // The deadline of the group of the device that has to be read first.
+    std::chrono::steady_clock::time_point nextGroupRead(const ModbusDevice& device);
+
+    // The read period of the group, or the read period of the reader if the group doesn't have its own.
+    std::chrono::milliseconds readPeriodOf(const RegisterGroup& group) const;
+
+    // Stretches the periods of the read groups that haven't changed, and brings the changed ones back to their read
+    // period, moving their next deadlines along.
+    void adaptReadPeriods(const ModbusDevice& device, const std::vector<std::shared_ptr<RegisterGroup>>& readGroups);
+
+    // Reads a single value from the liveness register of the device.
+    bool probeDevice(const ModbusDevice& device);
+
+    // Does the logic of writing the values into mappings if they happen to be not written into for a while.
+    // Returns the deadline of the next rewrite, or max() if the device has no rewritable mappings.
+    std::chrono::steady_clock::time_point rewriteDevice(const std::shared_ptr<ModbusDevice>& device);
+
+    // Rewrites the mappings of the device that are due once, and schedules their next rewrite.
+    void rewriteDeviceMappings(const std::shared_ptr<ModbusDevice>& device);
 
     void triggerDeviceStatusUpdate(const std::shared_ptr<ModbusDevice>& device, bool status);
 
+    // Sleeps until the time passes, or the reader is stopped. Returns whether the reader is still running.
+    bool sleepFor(std::chrono::steady_clock::duration duration);
+
+    // Counts a failed connection attempt, and schedules the next one.
+    void scheduleReconnect();
+
+    // Executes the request through the bus scheduler, in the turn of the slave, and waits for its result.
+    // Writes asked for by the user are given the high priority, so they don't wait for the queued reads.
+    bool executeOnBus(int16_t slaveAddress, const ModbusBusScheduler::Request& request,
+                      ModbusBusScheduler::Priority priority = ModbusBusScheduler::Priority::NORMAL);
+
     std::function<void(std::map<int16_t, bool>)> m_onIterationStatuses;
 
     // Modbus client and device data
     ModbusClient& m_modbusClient;
+    // Orders the requests of all the devices on the client, so the slaves take turns on the bus.
+    ModbusBusScheduler m_busScheduler;
     std::map<int16_t, std::shared_ptr<ModbusDevice>> m_devices;
     mutable std::mutex m_deviceActiveMutex;
     std::map<int16_t, bool> m_deviceActiveStatus;
     std::map<int16_t, bool> m_deviceStatusReported;
 
+    // Circuit breakers of the devices, guarded by the m_deviceActiveMutex.
+    struct CircuitBreaker
+    {
+        std::uint32_t consecutiveFailures;
+        bool open;
+        std::chrono::milliseconds backoff;
+        std::chrono::steady_clock::time_point nextProbe;
+    };
+    std::map<int16_t, CircuitBreaker> m_circuitBreakers;
+    std::uint32_t m_failureThreshold;
+    std::chrono::milliseconds m_initialBackoff;
+    std::chrono::milliseconds m_maxBackoff;
+
     // Reconnect logic, modbusClient will after a failed read/connection,
     // try to reconnect in increasing periods of time.
-    unsigned long m_timeoutIterator{};
-    const std::vector<int> m_timeoutDurations = {1, 5, 10, 15, 30, 60, 300, 600, 1800, 3600};
+    struct ConnectionState
+    {
+        std::uint32_t failedAttempts;
+        std::chrono::steady_clock::time_point nextAttempt;
+    };
+    ConnectionState m_connectionState{};
+    std::chrono::milliseconds m_minReconnectDelay;
+    std::chrono::milliseconds m_maxReconnectDelay;
+    std::minstd_rand m_random;
     // All devices that experienced an error reading all the registers, will put their
     // slave address in this vector. And they can be reported offline.
     std::vector<int16_t> m_errorDevices;
     std::atomic_bool m_shouldReconnect{};
 
     // Threading and reader data
-    // Thread kill switch
+    // Thread kill switch, the condition wakes up the sleeping threads when the reader stops.
     std::atomic_bool m_readerShouldRun{};
-    // Main thread that handles connection and reconnection.
-    // Per-device threads, handles modbusClient call per group and parsing of data.
+    std::mutex m_sleepMutex;
+    std::condition_variable m_sleepCondition;
+    // Main thread that handles connection and reconnection, and hands the tasks that are due over to the workers.
+    // Worker threads, handle modbusClient call per group and parsing of data.
     std::unique_ptr<std::thread> m_mainReaderThread;
-    std::map<int16_t, std::unique_ptr<std::thread>> m_threads;
-    std::map<int16_t, std::unique_ptr<std::thread>> m_rewriteThreads;
+    std::size_t m_workerCount;
+    std::vector<std::thread> m_workers;
     std::chrono::milliseconds m_readPeriod;
+
+    // Scheduling data, guarded by the m_taskMutex. The main thread waits on the schedule condition for the next
+    // deadline, or for a worker to put a task back on the wheel, and the workers wait on the task condition.
+    std::mutex m_taskMutex;
+    std::condition_variable m_scheduleCondition;
+    std::condition_variable m_taskCondition;
+    TimerWheel m_timerWheel;
+    std::deque<TimerWheel::TimerId> m_tasks;
+    bool m_wheelChanged;
+    // Tasks taken off the wheel, and the ones among them whose deadline changed while they were taken.
+    std::set<TimerWheel::TimerId> m_takenTasks;
+    std::set<TimerWheel::TimerId> m_rescheduledTasks;
+
+    // The time each group has to be read at, in the order of the groups of the device. A task is never executed by
+    // two workers at the same time, so only a single worker touches the deadlines of a device.
+    std::map<int16_t, std::vector<std::chrono::steady_clock::time_point>> m_groupDeadlines;
+    // Adaptive polling, the current period of each group, 0 while it is read in its own read period, and the read
+    // and change counts of the group when its period was last adapted.
+    struct GroupActivity
+    {
+        std::chrono::milliseconds period;
+        std::uint64_t readCount;
+        std::uint64_t changeCount;
+    };
+    std::map<int16_t, std::vector<GroupActivity>> m_groupActivity;
+    std::chrono::milliseconds m_maxAdaptivePeriod;
+    double m_adaptiveStretchFactor;
+    // Timing of the group reads of each device, guarded by the m_deviceActiveMutex.
+    std::map<int16_t, PollTiming> m_pollTimings;
 };
 }    // namespace wolkabout::more_modbus
 
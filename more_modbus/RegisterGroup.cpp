@@ -19,8 +19,14 @@
 #include "more_modbus/RegisterGroup.h"
 
 #include "core/utilities/Logger.h"
+#include "more_modbus/ModbusDevice.h"
+#include "more_modbus/mappings/FloatMapping.h"
+#include "more_modbus/mappings/Int32Mapping.h"
+#include "more_modbus/mappings/UInt32Mapping.h"
+#include "more_modbus/utilities/WordDiff.h"
 
 #include <algorithm>
+#include <limits>
 
 using namespace wolkabout::legacy;
 
@@ -28,16 +34,27 @@ namespace wolkabout
 {
 namespace more_modbus
 {
+namespace
+{
+// The group whose read is being passed to its mappings on this thread. The changes the read makes to the mappings
+// don't make the group forget it.
+thread_local const RegisterGroup* passingGroup = nullptr;
+}    // namespace
+
 const char GroupUtility::SEPARATOR = '.';
 
-bool RegisterGroup::keyExistsInSet(const std::string& key)
+bool RegisterGroup::claimExists(Claim claim) const
 {
-    for (const auto& pair : m_mappings)
-    {
-        if (pair.first == key)
-            return true;
-    }
-    return false;
+    const auto pair = MappingsMap::value_type{claim, nullptr};
+    return std::binary_search(m_mappings.cbegin(), m_mappings.cend(), pair, GroupUtility{});
+}
+
+void RegisterGroup::insertClaim(Claim claim, const std::shared_ptr<RegisterMapping>& mapping)
+{
+    const auto pair = MappingsMap::value_type{claim, mapping};
+    const auto it = std::lower_bound(m_mappings.begin(), m_mappings.end(), pair, GroupUtility{});
+    if (it == m_mappings.end() || it->first != claim)
+        m_mappings.insert(it, pair);
 }
 
 RegisterGroup::RegisterGroup(const std::shared_ptr<RegisterMapping>& mapping,
@@ -45,8 +62,17 @@ RegisterGroup::RegisterGroup(const std::shared_ptr<RegisterMapping>& mapping,
 : m_registerType(mapping->getRegisterType())
 , m_slaveAddress(mapping->getSlaveAddress())
 , m_readRestricted(mapping->isReadRestricted())
+, m_readPeriod(mapping->getReadPeriod())
 , m_device(device)
 , m_mappings()
+, m_startingAddress(0)
+, m_addressCount(0)
+, m_readGeneration(1)
+, m_lastReadGeneration(0)
+, m_isDecodePlanCompiled(false)
+, m_imageOffset(std::numeric_limits<std::size_t>::max())
+, m_readCount(0)
+, m_changeCount(0)
 {
     addMapping(mapping);
 }
@@ -55,15 +81,33 @@ RegisterGroup::RegisterGroup(const RegisterGroup& instance)
 : m_registerType(instance.getRegisterType())
 , m_slaveAddress(-1)
 , m_readRestricted(instance.isReadRestricted())
+, m_readPeriod(instance.getReadPeriod())
 , m_mappings()
+, m_startingAddress(0)
+, m_addressCount(0)
+, m_readGeneration(1)
+, m_lastReadGeneration(0)
+, m_isDecodePlanCompiled(false)
+, m_imageOffset(std::numeric_limits<std::size_t>::max())
+, m_readCount(0)
+, m_changeCount(0)
 {
-    const auto mappingMap = instance.getMappingsMap();
-    for (const auto& mapping : mappingMap)
+    // The claims of a mapping are next to each other, so each mapping is copied once.
+    auto mapping = std::shared_ptr<RegisterMapping>{};
+    auto newMapping = std::shared_ptr<RegisterMapping>{};
+    for (const auto& pair : instance.getMappings())
     {
-        const auto newMapping = std::make_shared<RegisterMapping>(*(mapping.second));
-        m_mappings.emplace(std::string(mapping.first), newMapping);
-        newMapping->setSlaveAddress(-1);
+        if (pair.second != mapping)
+        {
+            mapping = pair.second;
+            newMapping = std::make_shared<RegisterMapping>(*mapping);
+            // The copy keeps its own value until the device it is copied into creates its images.
+            newMapping->setImageRegisters(nullptr);
+            newMapping->setSlaveAddress(-1);
+        }
+        m_mappings.emplace_back(pair.first, newMapping);
     }
+    updateAddressCount();
 }
 
 bool RegisterGroup::addMapping(const std::shared_ptr<RegisterMapping>& mapping)
@@ -85,6 +129,13 @@ bool RegisterGroup::addMapping(const std::shared_ptr<RegisterMapping>& mapping)
         return appendMapping(mapping);
     }
 
+    if (mapping->getReadPeriod() != m_readPeriod)
+    {
+        LOG(WARN) << "RegisterGroup: Mapping " << mapping->getReference()
+                  << " has a different read period than the group.";
+        return false;
+    }
+
     if (!m_mappings.empty())
     {
         const auto firstGroupAddress = getStartingAddress();
@@ -95,9 +146,7 @@ bool RegisterGroup::addMapping(const std::shared_ptr<RegisterMapping>& mapping)
         if (mapping->getOperationType() == OperationType::TAKE_BIT)
         {
             // If we're just adding bits, we don't need to apply same ruling.
-            const auto key = std::to_string(mapping->getStartingAddress()) + GroupUtility::SEPARATOR +
-                             std::to_string(mapping->getBitIndex());
-            if (keyExistsInSet(key))
+            if (claimExists(GroupUtility::makeClaim(mapping->getStartingAddress(), mapping->getBitIndex())))
             {
                 // The address we're targeting is already fully claimed.
                 LOG(WARN) << "RegisterGroup: Mapping " << mapping->getReference()
@@ -175,27 +224,52 @@ bool RegisterGroup::appendMapping(const std::shared_ptr<RegisterMapping>& mappin
 {
     if (mapping->getOperationType() == OperationType::TAKE_BIT)
     {
-        const auto key = std::to_string(mapping->getStartingAddress()) + GroupUtility::SEPARATOR +
-                         std::to_string(mapping->getBitIndex());
-        if (keyExistsInSet(std::to_string(mapping->getStartingAddress())))
+        if (claimExists(GroupUtility::makeClaim(mapping->getStartingAddress())))
         {
             LOG(WARN) << "RegisterGroup: Mapping " << mapping->getReference() << "(" << mapping->getStartingAddress()
                       << ") requests a bit that is already occupied.";
             return false;
         }
-        m_mappings.emplace(key, mapping);
+        insertClaim(GroupUtility::makeClaim(mapping->getStartingAddress(), mapping->getBitIndex()), mapping);
+        updateAddressCount();
         return true;
     }
     else
     {
         for (uint16_t i = 0; i < mapping->getRegisterCount(); i++)
         {
-            m_mappings.emplace(std::to_string(mapping->getStartingAddress() + i), mapping);
+            insertClaim(GroupUtility::makeClaim(mapping->getStartingAddress() + i), mapping);
         }
+        updateAddressCount();
         return true;
     }
 }
 
+void RegisterGroup::updateAddressCount()
+{
+    // The claims are sorted, so the claims of an address are next to each other.
+    m_startingAddress = m_mappings.empty() ? 0 : GroupUtility::getAddress(m_mappings.front().first);
+    m_addressCount = 0;
+    for (auto i = std::size_t{0}; i < m_mappings.size(); ++i)
+    {
+        const auto address = GroupUtility::getAddress(m_mappings[i].first);
+        if (i == 0 || address != GroupUtility::getAddress(m_mappings[i - 1].first))
+            ++m_addressCount;
+    }
+
+    // Only the buffer the group is read into is needed.
+    if (m_registerType == RegisterType::COIL || m_registerType == RegisterType::INPUT_CONTACT)
+    {
+        m_bitBuffer.resize(m_addressCount);
+    }
+    else
+    {
+        m_registerBuffer.resize(m_addressCount);
+    }
+    forgetLastRead();
+    m_isDecodePlanCompiled = false;
+}
+
 RegisterType RegisterGroup::getRegisterType() const
 {
     return m_registerType;
@@ -203,21 +277,12 @@ RegisterType RegisterGroup::getRegisterType() const
 
 int32_t RegisterGroup::getStartingAddress() const
 {
-    return GroupUtility::getAddressFromString(m_mappings.begin()->first);
+    return m_startingAddress;
 }
 
 uint16_t RegisterGroup::getAddressCount() const
 {
-    std::vector<int16_t> mappings;
-    for (const auto& pair : m_mappings)
-    {
-        const auto address = GroupUtility::getAddressFromString(pair.first);
-        if (std::find(mappings.begin(), mappings.end(), address) == mappings.end())
-        {
-            mappings.emplace_back(address);
-        }
-    }
-    return static_cast<uint16_t>(mappings.size());
+    return m_addressCount;
 }
 
 int16_t RegisterGroup::getSlaveAddress() const
@@ -239,12 +304,236 @@ bool RegisterGroup::isReadRestricted() const
     return m_readRestricted;
 }
 
+const std::chrono::milliseconds& RegisterGroup::getReadPeriod() const
+{
+    return m_readPeriod;
+}
+
+bool RegisterGroup::hasLastRead() const
+{
+    return hasImageOffset() && m_lastReadGeneration == m_readGeneration;
+}
+
+std::uint64_t RegisterGroup::beginPassingValues()
+{
+    passingGroup = this;
+    return m_readGeneration;
+}
+
+bool RegisterGroup::isSameAsLastRead(const uint8_t* values) const
+{
+    const auto device = m_device.lock();
+    if (device == nullptr || !hasLastRead())
+        return false;
+
+    const auto image = device->getBitImage(m_registerType).subspan(m_imageOffset, m_addressCount);
+    if (image.size() != m_addressCount)
+        return false;
+    for (auto i = std::size_t{0}; i < image.size(); ++i)
+    {
+        if (image[i] != (values[i] != 0))
+            return false;
+    }
+    return true;
+}
+
+std::size_t RegisterGroup::findChangedRegisters(const uint16_t* values, std::uint64_t* mask) const
+{
+    const auto device = m_device.lock();
+    const auto image = device != nullptr && hasImageOffset() ?
+                         device->getRegisterImage(m_registerType).subspan(m_imageOffset, m_addressCount) :
+                         Span<const uint16_t>{};
+    if (image.size() == m_addressCount)
+        return WordDiff::compare(values, image.data(), image.size(), mask);
+
+    // Without the image there is nothing to compare with, so all of the registers changed.
+    for (auto i = std::size_t{0}; i < m_addressCount; ++i)
+        mask[i / 64] |= std::uint64_t{1} << (i % 64);
+    return m_addressCount;
+}
+
+void RegisterGroup::rememberRead(std::uint64_t generation)
+{
+    passingGroup = nullptr;
+    // A mapping that changed while the values were passed might not hold the value of this read.
+    m_lastReadGeneration = generation;
+}
+
+void RegisterGroup::forgetLastRead()
+{
+    if (passingGroup != this)
+        ++m_readGeneration;
+}
+
+void RegisterGroup::compileDecodePlan()
+{
+    m_decodePlan.clear();
+    m_filteredDecodePlan.clear();
+    const auto isBitGroup = m_registerType == RegisterType::COIL || m_registerType == RegisterType::INPUT_CONTACT;
+    for (auto i = std::size_t{0}; i < m_mappings.size(); ++i)
+    {
+        // The claims of a mapping are next to each other, a mapping of many registers is decoded in a single step.
+        const auto& pair = m_mappings[i];
+        if (i > 0 && m_mappings[i - 1].second == pair.second)
+            continue;
+
+        auto step = DecodeStep{};
+        step.offset = static_cast<uint16_t>(GroupUtility::getAddress(pair.first) - m_startingAddress);
+        step.bitIndex = GroupUtility::getBit(pair.first);
+        step.wordCount = 1;
+        if (isBitGroup)
+        {
+            step.decoder = DecodeStep::Decoder::BIT;
+        }
+        else if (step.bitIndex >= 0)
+        {
+            step.decoder = DecodeStep::Decoder::REGISTER_BIT;
+        }
+        else
+        {
+            step.decoder = DecodeStep::Decoder::REGISTERS;
+            step.wordCount = static_cast<uint16_t>(pair.second->getRegisterCount());
+        }
+        step.mapping = pair.second;
+        step.filtered = step.mapping->getFrequencyFilter().count() > 0;
+        if (step.decoder == DecodeStep::Decoder::REGISTERS)
+            chooseRegistersDecoder(step);
+
+        if (step.filtered)
+            m_filteredDecodePlan.emplace_back(step);
+        m_decodePlan.emplace_back(std::move(step));
+    }
+    measureRuns(m_decodePlan);
+    measureRuns(m_filteredDecodePlan);
+
+    // The steps are sorted by their offsets, so the steps of each register stay sorted too.
+    auto stepCounts = std::vector<uint32_t>(m_addressCount + std::size_t{1}, 0);
+    for (const auto& step : m_decodePlan)
+    {
+        for (auto offset = step.offset; offset < step.offset + step.wordCount && offset < m_addressCount; ++offset)
+            ++stepCounts[offset + std::size_t{1}];
+    }
+    for (auto offset = std::size_t{0}; offset < m_addressCount; ++offset)
+        stepCounts[offset + 1] += stepCounts[offset];
+    m_registerSteps = stepCounts;
+    m_registerStepIndices.assign(stepCounts.back(), 0);
+    for (auto index = std::size_t{0}; index < m_decodePlan.size(); ++index)
+    {
+        const auto& step = m_decodePlan[index];
+        for (auto offset = step.offset; offset < step.offset + step.wordCount && offset < m_addressCount; ++offset)
+            m_registerStepIndices[stepCounts[offset]++] = static_cast<uint32_t>(index);
+    }
+    m_isDecodePlanCompiled = true;
+}
+
+const std::vector<DecodeStep>& RegisterGroup::getDecodePlan()
+{
+    if (!m_isDecodePlanCompiled)
+        compileDecodePlan();
+    return m_decodePlan;
+}
+
+const std::vector<DecodeStep>& RegisterGroup::getFilteredDecodePlan()
+{
+    if (!m_isDecodePlanCompiled)
+        compileDecodePlan();
+    return m_filteredDecodePlan;
+}
+
+Span<const uint32_t> RegisterGroup::getStepsOfRegister(std::size_t offset)
+{
+    if (!m_isDecodePlanCompiled)
+        compileDecodePlan();
+    if (offset >= m_addressCount)
+        return {};
+    const auto first = m_registerSteps[offset];
+    return {m_registerStepIndices.data() + first, m_registerSteps[offset + 1] - first};
+}
+
+void RegisterGroup::chooseRegistersDecoder(DecodeStep& step)
+{
+    if (step.wordCount != 2)
+        return;
+
+    // The 32-bit integers take the low register first as their big endian order, the floats the high one.
+    const auto operation = step.mapping->getOperationType();
+    if (dynamic_cast<FloatMapping*>(step.mapping.get()) != nullptr)
+    {
+        if (operation != OperationType::MERGE_FLOAT_BIG_ENDIAN && operation != OperationType::MERGE_FLOAT_LITTLE_ENDIAN)
+            return;
+        step.decoder = DecodeStep::Decoder::FLOAT;
+        step.wordOrder = operation == OperationType::MERGE_FLOAT_BIG_ENDIAN ? DataParsers::WordOrder::ABCD :
+                                                                              DataParsers::WordOrder::CDAB;
+        return;
+    }
+
+    if (operation != OperationType::MERGE_BIG_ENDIAN && operation != OperationType::MERGE_LITTLE_ENDIAN)
+        return;
+    if (dynamic_cast<Int32Mapping*>(step.mapping.get()) != nullptr)
+        step.decoder = DecodeStep::Decoder::INT32;
+    else if (dynamic_cast<UInt32Mapping*>(step.mapping.get()) != nullptr)
+        step.decoder = DecodeStep::Decoder::UINT32;
+    else
+        return;
+    step.wordOrder =
+      operation == OperationType::MERGE_BIG_ENDIAN ? DataParsers::WordOrder::CDAB : DataParsers::WordOrder::ABCD;
+}
+
+void RegisterGroup::measureRuns(std::vector<DecodeStep>& plan)
+{
+    for (auto index = plan.size(); index-- > 0;)
+    {
+        auto& step = plan[index];
+        step.runLength = 1;
+        if (index + 1 == plan.size() || step.decoder == DecodeStep::Decoder::BIT ||
+            step.decoder == DecodeStep::Decoder::REGISTER_BIT || step.decoder == DecodeStep::Decoder::REGISTERS)
+            continue;
+
+        const auto& next = plan[index + 1];
+        if (next.decoder == step.decoder && next.wordOrder == step.wordOrder && next.offset == step.offset + 2 &&
+            next.runLength < std::numeric_limits<uint16_t>::max())
+            step.runLength = static_cast<uint16_t>(next.runLength + 1);
+    }
+}
+
+bool RegisterGroup::hasImageOffset() const
+{
+    return m_imageOffset != std::numeric_limits<std::size_t>::max();
+}
+
+std::size_t RegisterGroup::getImageOffset() const
+{
+    return m_imageOffset;
+}
+
+void RegisterGroup::setImageOffset(std::size_t imageOffset)
+{
+    m_imageOffset = imageOffset;
+}
+
+void RegisterGroup::countRead(bool changed)
+{
+    ++m_readCount;
+    if (changed)
+        ++m_changeCount;
+}
+
+std::uint64_t RegisterGroup::getReadCount() const
+{
+    return m_readCount;
+}
+
+std::uint64_t RegisterGroup::getChangeCount() const
+{
+    return m_changeCount;
+}
+
 std::map<std::string, std::shared_ptr<RegisterMapping>> RegisterGroup::getMappingsMap() const
 {
     std::map<std::string, std::shared_ptr<RegisterMapping>> map;
     for (const auto& pair : m_mappings)
     {
-        map.emplace(pair.first, pair.second);
+        map.emplace(GroupUtility::toString(pair.first), pair.second);
     }
     return map;
 }
@@ -254,7 +543,7 @@ std::vector<std::string> RegisterGroup::getMappingsClaims() const
     std::vector<std::string> claims;
     for (const auto& mappingPair : m_mappings)
     {
-        claims.emplace_back(mappingPair.first);
+        claims.emplace_back(GroupUtility::toString(mappingPair.first));
     }
     return claims;
 }
@@ -264,6 +553,21 @@ const MappingsMap& RegisterGroup::getMappings() const
     return m_mappings;
 }
 
+uint16_t* RegisterGroup::getRegisterBuffer()
+{
+    return m_registerBuffer.data();
+}
+
+uint8_t* RegisterGroup::getBitBuffer()
+{
+    return m_bitBuffer.data();
+}
+
+std::vector<uint16_t>& RegisterGroup::getMappingValues()
+{
+    return m_mappingValues;
+}
+
 std::weak_ptr<ModbusDevice> RegisterGroup::getDevice() const
 {
     return m_device;
@@ -274,6 +578,14 @@ void RegisterGroup::setDevice(const std::shared_ptr<ModbusDevice>& device)
     m_device = device;
 }
 
+std::string GroupUtility::toString(Claim claim)
+{
+    const auto bitIndex = getBit(claim);
+    if (bitIndex < 0)
+        return std::to_string(getAddress(claim));
+    return std::to_string(getAddress(claim)) + SEPARATOR + std::to_string(bitIndex);
+}
+
 int32_t GroupUtility::getAddressFromString(const std::string& string)
 {
     auto firstAddressString = std::string(string);
@@ -20,10 +20,15 @@
 #define WOLKABOUT_MODBUS_REGISTERGROUP_H
 
 #include "more_modbus/RegisterMapping.h"
+#include "more_modbus/utilities/DataParsers.h"
 
+#include <atomic>
+#include <chrono>
+#include <cstdint>
 #include <map>
 #include <memory>
-#include <set>
+#include <string>
+#include <vector>
 
 namespace wolkabout
 {
@@ -31,16 +36,54 @@ namespace more_modbus
 {
 class ModbusDevice;
 
+/**
+ * @brief A claim of a group on an address, or on a single bit of it, packed into an integer.
+ * @details The address takes the upper bits, and the bit index, offset by one so a claim on the whole address is 0,
+ *         takes the lowest byte. Sorting the claims sorts them by address, and then by bit index.
+ */
+typedef std::uint64_t Claim;
+
 /**
  * @brief Structure containing various utility data/methods for RegisterGroup class.
- * @details Contains the helper methods for capturing address and bitIndex from the claims string.
- *         Also, the SEPARATOR being used for creating such strings, and the sort method as operator()
- *         used by the set for mappings.
+ * @details Contains the helper methods for packing and unpacking the claims, and for converting them from and to
+ *         the claim strings, like "40012.3", that the SEPARATOR is used for. Also, the sort method as operator()
+ *         used to keep the mappings of a group sorted.
  */
 struct GroupUtility
 {
     const static char SEPARATOR;
 
+    /**
+     * @brief Utility method to pack an address, and optionally a bit of it, into a claim.
+     * @param address
+     * @param bitIndex the bit in 0-15 range, or -1 to claim the whole address
+     * @return the claim
+     */
+    static Claim makeClaim(int32_t address, int16_t bitIndex = -1)
+    {
+        return (static_cast<Claim>(static_cast<uint32_t>(address)) << 8) | static_cast<Claim>(bitIndex + 1);
+    }
+
+    /**
+     * @param claim
+     * @return the address of the claim
+     */
+    static int32_t getAddress(Claim claim) { return static_cast<int32_t>(static_cast<uint32_t>(claim >> 8)); }
+
+    /**
+     * @param claim
+     * @return the bit index of the claim, or -1 if it claims the whole address
+     */
+    static int16_t getBit(Claim claim) { return static_cast<int16_t>(static_cast<int16_t>(claim & 0xFF) - 1); }
+
+    /**
+     * @brief Utility method to create the claim string of a claim.
+     * @details The address, followed by the separator and the bit index if the claim is on a single bit.
+     * @param claim
+     * @return the claim string
+     */
+    static std::string toString(Claim claim);
+
     /**
      * @brief Utility method to fetch the address from claim string
      * @details Address is found in the claim string before the separator
@@ -58,20 +101,52 @@ struct GroupUtility
     static int16_t getBitFromString(const std::string& string);
 
     /**
-     * @brief Main function that serves a purpose of sorting the elements in the set created by the group.
+     * @brief Main function that serves a purpose of sorting the mappings of the group by their claims.
      */
-    bool operator()(const std::pair<std::string, std::shared_ptr<RegisterMapping>>& left,
-                    const std::pair<std::string, std::shared_ptr<RegisterMapping>>& right) const
+    bool operator()(const std::pair<Claim, std::shared_ptr<RegisterMapping>>& left,
+                    const std::pair<Claim, std::shared_ptr<RegisterMapping>>& right) const
     {
-        const auto addressComp = getAddressFromString(right.first) - getAddressFromString(left.first);
-        if (addressComp != 0)
-            return addressComp > 0;
-
-        return getBitFromString(left.first) < getBitFromString(right.first);
+        return left.first < right.first;
     }
 };
 
-typedef std::set<std::pair<std::string, std::shared_ptr<RegisterMapping>>, GroupUtility> MappingsMap;
+/**
+ * @brief The claims of a group paired with the mappings that made them, kept sorted by the claims.
+ */
+typedef std::vector<std::pair<Claim, std::shared_ptr<RegisterMapping>>> MappingsMap;
+
+/**
+ * @brief A single step of decoding a read of a group, passing the values at an offset of the read to a mapping.
+ */
+struct DecodeStep
+{
+    enum class Decoder : std::uint8_t
+    {
+        // A single byte of the bit buffer.
+        BIT,
+        // A single bit of a register.
+        REGISTER_BIT,
+        // One or more whole registers.
+        REGISTERS,
+        // A pair of registers of a FloatMapping, Int32Mapping or UInt32Mapping, parsed by the group reader.
+        FLOAT,
+        INT32,
+        UINT32
+    };
+
+    uint16_t offset = 0;
+    uint16_t wordCount = 0;
+    int16_t bitIndex = -1;
+    Decoder decoder = Decoder::REGISTERS;
+    // Whether the mapping has a frequency filter, so its values are passed to it even when they didn't change.
+    bool filtered = false;
+    // The order of the bytes of the pair of registers of the FLOAT, INT32 and UINT32 decoders.
+    DataParsers::WordOrder wordOrder = DataParsers::WordOrder::ABCD;
+    // The number of steps from this one with the same decoder and word order, whose pairs of registers follow each
+    // other, so they can be parsed at once.
+    uint16_t runLength = 1;
+    std::shared_ptr<RegisterMapping> mapping;
+};
 
 /**
  * @brief Group serves to merge multiple mappings that can be read with a single Modbus command.
@@ -95,7 +170,7 @@ public:
     /**
      * @brief Add a mapping to the group.
      * @detail Add a mapping, see if it's address and register count can be added into the group
-     *        see if it can stay in continuity.
+     *        see if it can stay in continuity. Mappings read in a different period than the group can't be added.
      * @param mapping
      * @return whether or not the adding is successful
      */
@@ -122,7 +197,13 @@ public:
     bool isReadRestricted() const;
 
     /**
-     * @return all the claims strings and mappings in pairs, where the pairs
+     * @return the read period of the group, taken from its mappings. If it is 0, the group is read in the read
+     *        period of the reader.
+     */
+    const std::chrono::milliseconds& getReadPeriod() const;
+
+    /**
+     * @return all the claims and mappings in pairs, where the pairs
      *        are sorted by the comparer method (by address, and bit index)
      */
     const MappingsMap& getMappings() const;
@@ -138,19 +219,176 @@ public:
      */
     std::vector<std::string> getMappingsClaims() const;
 
+    /**
+     * @brief Buffer the group's registers are read into. It is sized to the address count of the group, so reading
+     *       the group doesn't have to allocate anything.
+     * @return pointer to getAddressCount() registers
+     */
+    uint16_t* getRegisterBuffer();
+
+    /**
+     * @brief Buffer the group's coils/contacts are read into, one byte per bit.
+     * @return pointer to getAddressCount() bytes
+     */
+    uint8_t* getBitBuffer();
+
+    /**
+     * @brief Scratch vector used to hand the values of a single mapping over to it. It is reused between reads,
+     *       so its capacity stays allocated.
+     * @return reference to the scratch vector
+     */
+    std::vector<uint16_t>& getMappingValues();
+
+    /**
+     * @return Whether the group has a read whose values were passed to all the mappings, to compare new reads with.
+     *         The last read is kept in the image of the device, so groups without a place in it have none.
+     */
+    bool hasLastRead() const;
+
+    /**
+     * @brief Marks the values of a read as being passed to the mappings on the calling thread, until rememberRead().
+     *       The changes the read makes to the mappings don't make the group forget the read, while the changes made
+     *       by other threads in the meantime do.
+     * @return The generation of the reads, which changes each time the last read is forgotten, for rememberRead().
+     */
+    std::uint64_t beginPassingValues();
+
+    /**
+     * @brief Marks the registers of a read that differ from the last read in the image of the device, whose values
+     *       were passed to all the mappings. It has to be checked that there is one with hasLastRead().
+     * @param values getAddressCount() registers
+     * @param mask (getAddressCount() + 63) / 64 cleared words, the bit of each register that differs is set
+     * @return The number of registers that differ.
+     */
+    std::size_t findChangedRegisters(const uint16_t* values, std::uint64_t* mask) const;
+
+    /**
+     * @brief Compares the values of a read with the last read in the image of the device, whose values were passed
+     *       to all the mappings.
+     * @param values getAddressCount() bytes, one per bit
+     * @return Whether the values are the same, so none of the mappings can change.
+     */
+    bool isSameAsLastRead(const uint8_t* values) const;
+
+    /**
+     * @brief Marks the read stored in the image of the device as passed to all the mappings, so the next reads are
+     *       compared with it. If the last read was forgotten while the values were passed, it isn't compared with.
+     * @param generation the generation returned by beginPassingValues() before the values were passed
+     */
+    void rememberRead(std::uint64_t generation);
+
+    /**
+     * @brief Forgets the last read, so the values of the next one are passed to all the mappings. Used when the value
+     *       of a mapping changes outside of a read of the group, so it can be called while the group is being read.
+     */
+    void forgetLastRead();
+
+    /**
+     * @brief Compiles the steps that pass the values of a read to the mappings, so reading the group doesn't have to
+     *       work out where the values of each mapping are. The device compiles them once its groups are created,
+     *       groups changed after that compile them again when they're next read.
+     */
+    void compileDecodePlan();
+
+    /**
+     * @return The steps that pass the values of a read to all the mappings, in the order of their offsets.
+     */
+    const std::vector<DecodeStep>& getDecodePlan();
+
+    /**
+     * @return The steps of the mappings with a frequency filter. Their values are passed to them even when the read is
+     *        the same as the last one, as the filter can hold back a change until its time passes.
+     */
+    const std::vector<DecodeStep>& getFilteredDecodePlan();
+
+    /**
+     * @param offset of a register in the group
+     * @return The indices of the steps in the decode plan whose values include the register, in ascending order.
+     */
+    Span<const uint32_t> getStepsOfRegister(std::size_t offset);
+
+    /**
+     * @return Whether the group has a place in the image of its device, which only the groups that are read have.
+     */
+    bool hasImageOffset() const;
+
+    /**
+     * @return The offset of the group in the image of its device, for the registers, or the bits, of its type.
+     */
+    std::size_t getImageOffset() const;
+
+    /**
+     * @brief Sets the offset of the group in the image of its device. Used by the device when it builds its images.
+     * @param imageOffset
+     */
+    void setImageOffset(std::size_t imageOffset);
+
+    /**
+     * @brief Counts a successful read of the group.
+     * @param changed whether the read changed the value of at least one of the mappings
+     */
+    void countRead(bool changed);
+
+    /**
+     * @return The number of successful reads of the group.
+     */
+    std::uint64_t getReadCount() const;
+
+    /**
+     * @return The number of reads of the group that changed the value of at least one of its mappings.
+     */
+    std::uint64_t getChangeCount() const;
+
 private:
     bool appendMapping(const std::shared_ptr<RegisterMapping>& mapping);
 
-    bool keyExistsInSet(const std::string& key);
+    void updateAddressCount();
+
+    bool claimExists(Claim claim) const;
+
+    // Inserts the claim of the mapping in its place, unless it is already claimed.
+    void insertClaim(Claim claim, const std::shared_ptr<RegisterMapping>& mapping);
+
+    // Picks the decoder of a whole register step, parsing the pairs of registers of the 32-bit mappings in the reader.
+    static void chooseRegistersDecoder(DecodeStep& step);
+
+    // Counts the run of each step of the plan, going backwards so each step continues the run of the next one.
+    static void measureRuns(std::vector<DecodeStep>& plan);
 
     RegisterType m_registerType;
     int16_t m_slaveAddress;
     bool m_readRestricted;
+    std::chrono::milliseconds m_readPeriod;
 
     std::weak_ptr<ModbusDevice> m_device;
 
     MappingsMap m_mappings;
 
+    // The extents of the group, updated whenever a mapping is added.
+    int32_t m_startingAddress;
+    uint16_t m_addressCount;
+    std::vector<uint16_t> m_registerBuffer;
+    std::vector<uint8_t> m_bitBuffer;
+    std::vector<uint16_t> m_mappingValues;
+
+    // The image of the device holds the last read passed to all the mappings. It is compared with while its generation
+    // is the current one, which forgetLastRead() changes from the threads writing the mappings.
+    std::atomic<std::uint64_t> m_readGeneration;
+    std::atomic<std::uint64_t> m_lastReadGeneration;
+
+    // The decode plan, compiled again once the mappings change.
+    std::vector<DecodeStep> m_decodePlan;
+    std::vector<DecodeStep> m_filteredDecodePlan;
+    // The steps of each register, the ones of the register at an offset start at m_registerSteps[offset].
+    std::vector<uint32_t> m_registerSteps;
+    std::vector<uint32_t> m_registerStepIndices;
+    bool m_isDecodePlanCompiled;
+
+    std::size_t m_imageOffset;
+
+    std::uint64_t m_readCount;
+    std::uint64_t m_changeCount;
+
     friend class RegisterMapping;
 };
 }    // namespace more_modbus
@@ -341,7 +341,8 @@ int8_t RegisterMapping::getBitIndex() const
 
 bool RegisterMapping::doesUpdate(const std::vector<uint16_t>& newValues) const
 {
-    if (newValues.size() != m_byteValues.size())
+    const auto values = getValues();
+    if (newValues.size() != values.size())
     {
         throw std::logic_error("RegisterMapping: The value array has to be the same size, it cannot change.");
     }
@@ -355,7 +356,7 @@ bool RegisterMapping::doesUpdate(const std::vector<uint16_t>& newValues) const
     uint32_t i = 0;
     while (i < newValues.size())
     {
-        if (m_byteValues[i] != newValues[i])
+        if (values[i] != newValues[i])
         {
             different = true;
             break;
@@ -395,7 +396,8 @@ bool RegisterMapping::doesUpdate(const std::vector<uint16_t>& newValues) const
 
 bool RegisterMapping::update(const std::vector<uint16_t>& newValues)
 {
-    if (newValues.size() != m_byteValues.size())
+    const auto values = getValues();
+    if (newValues.size() != values.size())
     {
         throw std::logic_error("RegisterMapping: The value array has to be the same size, it cannot change.");
     }
@@ -404,13 +406,17 @@ bool RegisterMapping::update(const std::vector<uint16_t>& newValues)
     uint32_t i = 0;
     while (!different && i < newValues.size())
     {
-        if (m_byteValues[i] != newValues[i])
+        if (values[i] != newValues[i])
         {
             different = true;
         }
         ++i;
     }
-    m_byteValues = newValues;
+    if (!m_imageRegisters.empty())
+        std::copy(newValues.cbegin(), newValues.cend(), m_imageRegisters.begin());
+    else
+        m_byteValues = newValues;
+    forgetGroupRead();
 
     bool isValueInitialized = m_isInitialized;
     m_isInitialized = true;
@@ -444,6 +450,7 @@ bool RegisterMapping::update(bool newRegisterValue)
 {
     bool different = m_boolValue != newRegisterValue;
     m_boolValue = newRegisterValue;
+    forgetGroupRead();
 
     bool isValueInitialized = m_isInitialized;
     m_isInitialized = true;
@@ -458,15 +465,7 @@ bool RegisterMapping::update(bool newRegisterValue)
 
 bool RegisterMapping::writeValue(const std::vector<std::uint16_t>& bytes)
 {
-    if (getGroup().expired())
-        return false;
-    const auto group = getGroup().lock();
-    if (group == nullptr || group->getDevice().expired())
-        return false;
-    const auto device = group->getDevice().lock();
-    if (device == nullptr || device->getReader().expired())
-        return false;
-    const auto reader = device->getReader().lock();
+    const auto reader = findReader();
     if (reader == nullptr)
         return false;
 
@@ -475,15 +474,7 @@ bool RegisterMapping::writeValue(const std::vector<std::uint16_t>& bytes)
 
 bool RegisterMapping::writeValue(bool value)
 {
-    if (getGroup().expired())
-        return false;
-    const auto group = getGroup().lock();
-    if (group == nullptr || group->getDevice().expired())
-        return false;
-    const auto device = group->getDevice().lock();
-    if (device == nullptr || device->getReader().expired())
-        return false;
-    const auto reader = device->getReader().lock();
+    const auto reader = findReader();
     if (reader == nullptr)
         return false;
 
@@ -496,9 +487,63 @@ bool RegisterMapping::writeValue(bool value)
     return success;
 }
 
-const std::vector<uint16_t>& RegisterMapping::getBytesValues() const
+void RegisterMapping::writeValueAsync(const std::vector<std::uint16_t>& bytes, std::function<void(bool)> callback)
+{
+    const auto reader = findReader();
+    if (reader == nullptr)
+    {
+        if (callback)
+            callback(false);
+        return;
+    }
+
+    // The mapping is kept alive until the write completes, if it is owned by a shared pointer.
+    reader->writeMappingAsync(*this, bytes, [self = weak_from_this().lock(), callback](bool success) {
+        if (callback)
+            callback(success);
+    });
+}
+
+std::future<bool> RegisterMapping::writeValueAsync(const std::vector<std::uint16_t>& bytes)
 {
-    return m_byteValues;
+    const auto promise = std::make_shared<std::promise<bool>>();
+    auto future = promise->get_future();
+    writeValueAsync(bytes, [promise](bool success) { promise->set_value(success); });
+    return future;
+}
+
+void RegisterMapping::writeValueAsync(bool value, std::function<void(bool)> callback)
+{
+    const auto reader = findReader();
+    if (reader == nullptr)
+    {
+        if (callback)
+            callback(false);
+        return;
+    }
+
+    auto completion = [self = weak_from_this().lock(), callback](bool success) {
+        if (callback)
+            callback(success);
+    };
+    if (m_operationType == OperationType::TAKE_BIT)
+        reader->writeBitMappingAsync(*this, value, std::move(completion));
+    else
+        reader->writeMappingAsync(*this, value, std::move(completion));
+}
+
+std::future<bool> RegisterMapping::writeValueAsync(bool value)
+{
+    const auto promise = std::make_shared<std::promise<bool>>();
+    auto future = promise->get_future();
+    writeValueAsync(value, [promise](bool success) { promise->set_value(success); });
+    return future;
+}
+
+std::vector<uint16_t> RegisterMapping::getBytesValues() const
+{
+    const auto values = getValues();
+    return {values.begin(), values.end()};
 }
 
 bool RegisterMapping::getBoolValue() const
@@ -519,6 +564,7 @@ bool RegisterMapping::isValid() const
 void RegisterMapping::setValid(bool valid)
 {
     m_isValid = valid;
+    forgetGroupRead();
 }
 
 std::weak_ptr<RegisterGroup> RegisterMapping::getGroup() const
@@ -557,6 +603,16 @@ void RegisterMapping::setRepeatedWrite(const std::chrono::milliseconds& repeated
     m_repeatedWrite = repeatedWrite;
 }
 
+const std::chrono::milliseconds& RegisterMapping::getReadPeriod() const
+{
+    return m_readPeriod;
+}
+
+void RegisterMapping::setReadPeriod(const std::chrono::milliseconds& readPeriod)
+{
+    m_readPeriod = readPeriod;
+}
+
 const std::string& RegisterMapping::getDefaultValue() const
 {
     return m_defaultValue;
@@ -567,6 +623,11 @@ const std::chrono::high_resolution_clock::time_point& RegisterMapping::getLastUp
     return m_lastUpdateTime;
 }
 
+const std::chrono::milliseconds& RegisterMapping::getFrequencyFilter() const
+{
+    return m_frequencyFilterValue;
+}
+
 bool RegisterMapping::isAutoUpdateEnabled() const
 {
     return m_autoLocalUpdate;
@@ -654,4 +715,79 @@ bool RegisterMapping::deadbandFilter(const std::vector<uint16_t>& newValues) con
 
     return significantChange;
 }
+
+std::shared_ptr<ModbusReader> RegisterMapping::findReader() const
+{
+    const auto group = getGroup().lock();
+    if (group == nullptr)
+        return nullptr;
+    const auto device = group->getDevice().lock();
+    if (device == nullptr)
+        return nullptr;
+    return device->getReader().lock();
+}
+
+Span<const uint16_t> RegisterMapping::getRegisterView() const
+{
+    const auto group = m_group.lock();
+    if (group == nullptr || !group->hasImageOffset())
+        return {};
+    const auto device = group->getDevice().lock();
+    if (device == nullptr)
+        return {};
+
+    const auto offset =
+      group->getImageOffset() + static_cast<std::size_t>(getStartingAddress() - group->getStartingAddress());
+    return device->getRegisterImage(m_registerType).subspan(offset, static_cast<std::size_t>(getRegisterCount()));
+}
+
+BitSpan RegisterMapping::getBitView() const
+{
+    const auto group = m_group.lock();
+    if (group == nullptr || !group->hasImageOffset())
+        return {};
+    const auto device = group->getDevice().lock();
+    if (device == nullptr)
+        return {};
+
+    const auto offset =
+      group->getImageOffset() + static_cast<std::size_t>(getStartingAddress() - group->getStartingAddress());
+    return device->getBitImage(m_registerType).subspan(offset, 1);
+}
+
+void RegisterMapping::setImageRegisters(uint16_t* registers)
+{
+    if (registers == m_imageRegisters.data())
+        return;
+
+    if (registers == nullptr)
+    {
+        m_byteValues.assign(m_imageRegisters.begin(), m_imageRegisters.end());
+        m_imageRegisters = {};
+        return;
+    }
+
+    // The filtered mappings hold back changes of the registers, so their value isn't the one in the image.
+    if (m_deadbandValue != 0.0 || m_frequencyFilterValue.count() > 0 || m_outputType == OutputType::BOOL)
+        return;
+
+    const auto values = getValues();
+    const auto count = static_cast<std::size_t>(getRegisterCount());
+    std::copy_n(values.begin(), std::min(values.size(), count), registers);
+    m_imageRegisters = {registers, count};
+    std::vector<uint16_t>{}.swap(m_byteValues);
+}
+
+Span<const uint16_t> RegisterMapping::getValues() const
+{
+    if (!m_imageRegisters.empty())
+        return {m_imageRegisters.data(), m_imageRegisters.size()};
+    return {m_byteValues.data(), m_byteValues.size()};
+}
+
+void RegisterMapping::forgetGroupRead() const
+{
+    if (const auto group = m_group.lock())
+        group->forgetLastRead();
+}
 }    // namespace wolkabout::more_modbus
@@ -19,14 +19,19 @@
 #ifndef WOLKABOUT_MODBUS_REGISTERMAPPING_H
 #define WOLKABOUT_MODBUS_REGISTERMAPPING_H
 
+#include "more_modbus/utilities/Span.h"
+
 #include <chrono>
 #include <cstdint>
+#include <functional>
+#include <future>
 #include <memory>
 #include <string>
 #include <vector>
 
 namespace wolkabout::more_modbus
 {
+class ModbusReader;
 class RegisterGroup;
 
 /**
@@ -266,17 +271,73 @@ public:
      */
     virtual bool writeValue(bool value);
 
+    /**
+     * @brief Register writing method, that queues the write without waiting for it.
+     * @param bytes The bytes that needs to be written into the register.
+     * @param callback Invoked with whether the bytes were successfully written, once the mapping has been updated.
+     *                 Invoked right away with false, if the mapping isn't a part of a device added to a reader.
+     */
+    void writeValueAsync(const std::vector<std::uint16_t>& bytes, std::function<void(bool)> callback);
+
+    /**
+     * @brief Register writing method, that queues the write without waiting for it.
+     * @param bytes The bytes that needs to be written into the register.
+     * @return The future of whether the bytes were successfully written.
+     */
+    std::future<bool> writeValueAsync(const std::vector<std::uint16_t>& bytes);
+
+    /**
+     * @brief Register writing method, that queues the write without waiting for it.
+     * @param value The bool value that needs to be written into the register.
+     * @param callback Invoked with whether the bool was successfully written, once the mapping has been updated.
+     *                 Invoked right away with false, if the mapping isn't a part of a device added to a reader.
+     */
+    void writeValueAsync(bool value, std::function<void(bool)> callback);
+
+    /**
+     * @brief Register writing method, that queues the write without waiting for it.
+     * @param value The bool value that needs to be written into the register.
+     * @return The future of whether the bool was successfully written.
+     */
+    std::future<bool> writeValueAsync(bool value);
+
     /**
      * @brief Return uint16_t values for mappings that use such values, otherwise return vector of length 0.
+     * @details The values of mappings without a filter are kept in the register image of their device, and are
+     *         copied out of it.
      * @return the uint16_t values received by the ModbusGroupReader, before parsing.
      */
-    const std::vector<uint16_t>& getBytesValues() const;
+    std::vector<uint16_t> getBytesValues() const;
 
     /**
      * @return the bool value received by the ModbusGroupReader.
      */
     bool getBoolValue() const;
 
+    /**
+     * @brief The registers of the mapping in the register image of its device, as they were last read. Unlike
+     *       getBytesValues(), the view isn't held back by the deadband or the frequency filter of the mapping.
+     * @details The view is valid until the groups of the device are created again. Reads update it on the reading
+     *         thread once their values are passed to the mappings, so it should be looked at from there. In the value
+     *         change callbacks, only the registers of the mappings without a filter are up to date.
+     * @return view of the registers, empty for coils, contacts, and mappings whose groups aren't read
+     */
+    Span<const uint16_t> getRegisterView() const;
+
+    /**
+     * @brief The bit of the mapping in the bit image of its device, as it was last read, like getRegisterView().
+     * @return view of the single bit, empty for registers, and mappings whose groups aren't read
+     */
+    BitSpan getBitView() const;
+
+    /**
+     * @brief Moves the value of the mapping into the register image of its device, so reads don't keep it twice.
+     *       Mappings with a deadband or a frequency filter, and the ones taking a bit, keep their own value, as it
+     *       differs from the registers that were read. Used by the device whenever it creates its images.
+     * @param registers getRegisterCount() registers of the image, or nullptr to move the value back into the mapping
+     */
+    void setImageRegisters(uint16_t* registers);
+
     bool isInitialized() const;
 
     bool isValid() const;
@@ -299,6 +360,23 @@ public:
      */
     void setRepeatedWrite(const std::chrono::milliseconds& repeatedWrite);
 
+    /**
+     * This is the default getter for the period in which the mapping should be read.
+     * If the value is 0, the mapping is read in the read period of the reader.
+     *
+     * @return The read period in milliseconds.
+     */
+    const std::chrono::milliseconds& getReadPeriod() const;
+
+    /**
+     * This is the default setter for the period in which the mapping should be read.
+     * Only mappings with the same read period are grouped together, so it has to be set before the groups of the
+     * device are created.
+     *
+     * @param readPeriod The new read period in milliseconds, 0 to use the read period of the reader.
+     */
+    void setReadPeriod(const std::chrono::milliseconds& readPeriod);
+
     /**
      * This is the default getter for the default value of this mapping.
      *
@@ -313,6 +391,13 @@ public:
      */
     const std::chrono::high_resolution_clock::time_point& getLastUpdateTime() const;
 
+    /**
+     * This is the default getter for the time in which changes of the value are ignored after an update.
+     *
+     * @return The frequency filter in milliseconds, 0 if the changes aren't filtered.
+     */
+    const std::chrono::milliseconds& getFrequencyFilter() const;
+
     /**
      * This is the default getter for whether the auto update is enabled or not.
      *
@@ -347,6 +432,9 @@ protected:
     std::chrono::milliseconds m_repeatedWrite;
     std::string m_defaultValue;
 
+    // Multi-rate reading logic
+    std::chrono::milliseconds m_readPeriod = std::chrono::milliseconds(0);
+
     // Frequency filter data
     double m_deadbandValue = 0.0;
     std::chrono::high_resolution_clock::time_point m_lastUpdateTime;
@@ -357,6 +445,18 @@ protected:
 
 private:
     bool deadbandFilter(const std::vector<uint16_t>& newValues) const;
+
+    // The value of the mapping, wherever it is kept.
+    Span<const uint16_t> getValues() const;
+
+    // The registers of the image the value is kept in, empty while it is kept in m_byteValues.
+    Span<uint16_t> m_imageRegisters;
+
+    // The reader of the device the mapping is a part of, or nullptr.
+    std::shared_ptr<ModbusReader> findReader() const;
+
+    // The value changed outside of a read of the group, so the group can't skip its next read as unchanged.
+    void forgetGroupRead() const;
 };
 }    // namespace wolkabout::more_modbus
 
@@ -82,17 +82,20 @@ bool FloatMapping::update(const std::vector<uint16_t>& newValues)
     {
     case OperationType::MERGE_FLOAT_BIG_ENDIAN:
     {
-        m_floatValue = DataParsers::registersToFloat(newValues, DataParsers::Endian::BIG);
-        break;
+        return updateDecoded(newValues, DataParsers::registersToFloat(newValues, DataParsers::Endian::BIG));
     }
     case OperationType::MERGE_FLOAT_LITTLE_ENDIAN:
     {
-        m_floatValue = DataParsers::registersToFloat(newValues, DataParsers::Endian::LITTLE);
-        break;
+        return updateDecoded(newValues, DataParsers::registersToFloat(newValues, DataParsers::Endian::LITTLE));
     }
     default:
         throw std::logic_error("FloatMapping: Illegal operation type set.");
     }
+}
+
+bool FloatMapping::updateDecoded(const std::vector<uint16_t>& newValues, float value)
+{
+    m_floatValue = value;
     return RegisterMapping::update(newValues);
 }
 
@@ -60,15 +60,17 @@ bool Int32Mapping::update(const std::vector<uint16_t>& newValues)
     switch (m_operationType)
     {
     case OperationType::MERGE_BIG_ENDIAN:
-        m_int32Value = DataParsers::registersToInt32(newValues, DataParsers::Endian::BIG);
-        break;
+        return updateDecoded(newValues, DataParsers::registersToInt32(newValues, DataParsers::Endian::BIG));
     case OperationType::MERGE_LITTLE_ENDIAN:
-        m_int32Value = DataParsers::registersToInt32(newValues, DataParsers::Endian::LITTLE);
-        break;
+        return updateDecoded(newValues, DataParsers::registersToInt32(newValues, DataParsers::Endian::LITTLE));
     default:
         throw std::logic_error("Int32Mapping: Illegal operation type set.");
     }
+}
 
+bool Int32Mapping::updateDecoded(const std::vector<uint16_t>& newValues, int32_t value)
+{
+    m_int32Value = value;
     return RegisterMapping::update(newValues);
 }
 
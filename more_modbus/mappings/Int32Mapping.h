@@ -57,6 +57,14 @@ public:
      */
     bool update(const std::vector<uint16_t>& newValues) override;
 
+    /**
+     * @brief Updates the mapping with the values, already parsed into the value by the group reader.
+     * @param newValues the registers of the mapping
+     * @param value the registers parsed with the operation type of the mapping
+     * @return Whether the value of the mapping changed.
+     */
+    bool updateDecoded(const std::vector<uint16_t>& newValues, int32_t value);
+
     /**
      * @brief Triggers the client to write the value for this register.
      * @param value INT32 value to be written
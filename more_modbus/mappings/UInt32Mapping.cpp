@@ -60,15 +60,17 @@ bool UInt32Mapping::update(const std::vector<uint16_t>& newValues)
     switch (m_operationType)
     {
     case OperationType::MERGE_BIG_ENDIAN:
-        m_uint32Value = DataParsers::registersToUint32(newValues, DataParsers::Endian::BIG);
-        break;
+        return updateDecoded(newValues, DataParsers::registersToUint32(newValues, DataParsers::Endian::BIG));
     case OperationType::MERGE_LITTLE_ENDIAN:
-        m_uint32Value = DataParsers::registersToUint32(newValues, DataParsers::Endian::LITTLE);
-        break;
+        return updateDecoded(newValues, DataParsers::registersToUint32(newValues, DataParsers::Endian::LITTLE));
     default:
         throw std::logic_error("UInt32Mapping: Illegal operation type set.");
     }
+}
 
+bool UInt32Mapping::updateDecoded(const std::vector<uint16_t>& newValues, uint32_t value)
+{
+    m_uint32Value = value;
     return RegisterMapping::update(newValues);
 }
 
@@ -34,6 +34,9 @@ namespace wolkabout
 {
 namespace more_modbus
 {
+const std::chrono::microseconds LibModbusSerialRtuClient::CALIBRATION_MAX_DELAY = std::chrono::milliseconds(10);
+const std::chrono::microseconds LibModbusSerialRtuClient::CALIBRATION_RESOLUTION = std::chrono::microseconds(100);
+
 LibModbusSerialRtuClient::LibModbusSerialRtuClient(std::string serialPort, int baudRate, char dataBits, char stopBits,
                                                    BitParity bitParity, std::chrono::milliseconds responseTimeout)
 : ModbusClient(std::move(responseTimeout))
@@ -41,6 +44,9 @@ LibModbusSerialRtuClient::LibModbusSerialRtuClient(std::string serialPort, int b
 , m_baudRate(baudRate)
 , m_dataBits(dataBits)
 , m_stopBits(stopBits)
+, m_silentInterval(calculateSilentInterval(baudRate, dataBits, stopBits, bitParity))
+, m_slaveAddress(-1)
+, m_lastSlaveAddress(-1)
 {
     switch (bitParity)
     {
@@ -63,6 +69,87 @@ LibModbusSerialRtuClient::~LibModbusSerialRtuClient()
     destroyContext();
 }
 
+std::chrono::microseconds LibModbusSerialRtuClient::calculateSilentInterval(int baudRate, char dataBits,
+                                                                           char stopBits, BitParity bitParity)
+{
+    if (baudRate <= 0)
+    {
+        return CALIBRATION_MAX_DELAY;
+    }
+
+    const auto characterBits = 1 + dataBits + (bitParity == BitParity::NONE ? 0 : 1) + stopBits;
+    // 3.5 characters in microseconds, as 7 half characters, rounded up.
+    const auto halfCharacters = static_cast<std::int64_t>(7) * characterBits * 1000000;
+    return std::chrono::microseconds((halfCharacters + 2 * baudRate - 1) / (2 * baudRate));
+}
+
+std::chrono::microseconds LibModbusSerialRtuClient::getSilentInterval() const
+{
+    return m_silentInterval;
+}
+
+void LibModbusSerialRtuClient::setTurnaroundDelay(int slaveAddress, std::chrono::microseconds delay)
+{
+    std::lock_guard<decltype(m_modbusMutex)> l{m_modbusMutex};
+    m_turnaroundDelays[slaveAddress] = delay;
+}
+
+void LibModbusSerialRtuClient::clearTurnaroundDelay(int slaveAddress)
+{
+    std::lock_guard<decltype(m_modbusMutex)> l{m_modbusMutex};
+    m_turnaroundDelays.erase(slaveAddress);
+}
+
+std::chrono::microseconds LibModbusSerialRtuClient::getTurnaroundDelay(int slaveAddress)
+{
+    std::lock_guard<decltype(m_modbusMutex)> l{m_modbusMutex};
+    const auto it = m_turnaroundDelays.find(slaveAddress);
+    return it != m_turnaroundDelays.cend() ? it->second : m_silentInterval;
+}
+
+bool LibModbusSerialRtuClient::calibrateTurnaroundDelay(int slaveAddress, int address, int attempts)
+{
+    std::lock_guard<decltype(m_modbusMutex)> l{m_modbusMutex};
+    const auto previous = m_turnaroundDelays.find(slaveAddress);
+    const auto hadDelay = previous != m_turnaroundDelays.cend();
+    const auto previousDelay = hadDelay ? previous->second : m_silentInterval;
+
+    auto tolerated = CALIBRATION_MAX_DELAY;
+    auto notTolerated = m_silentInterval;
+    if (!isDelayTolerated(slaveAddress, address, attempts, tolerated))
+    {
+        LOG(WARN) << "LibModbusClient: Unable to calibrate turnaround delay of slave " << slaveAddress
+                  << " - slave can not be read.";
+        if (hadDelay)
+            m_turnaroundDelays[slaveAddress] = previousDelay;
+        else
+            m_turnaroundDelays.erase(slaveAddress);
+        return false;
+    }
+
+    if (isDelayTolerated(slaveAddress, address, attempts, notTolerated))
+    {
+        tolerated = notTolerated;
+    }
+    else
+    {
+        // Look for the shortest tolerated delay in between.
+        while (tolerated - notTolerated > CALIBRATION_RESOLUTION)
+        {
+            const auto delay = notTolerated + (tolerated - notTolerated) / 2;
+            if (isDelayTolerated(slaveAddress, address, attempts, delay))
+                tolerated = delay;
+            else
+                notTolerated = delay;
+        }
+    }
+
+    m_turnaroundDelays[slaveAddress] = tolerated;
+    LOG(INFO) << "LibModbusClient: Calibrated turnaround delay of slave " << slaveAddress << " to "
+              << tolerated.count() << "us.";
+    return true;
+}
+
 bool LibModbusSerialRtuClient::createContext()
 {
     LOG(INFO) << "LibModbusClient: Opening serial port '" << m_serialPort << "'  Baud: " << m_baudRate;
@@ -96,7 +183,23 @@ bool LibModbusSerialRtuClient::writeHoldingRegister(int address, uint16_t value)
 {
     auto result = ModbusClient::writeHoldingRegister(address, value);
 
-    sleepBetweenModbusMessages();
+    markEndOfMessage();
+    return result;
+}
+
+bool LibModbusSerialRtuClient::writeHoldingRegisters(int address, std::vector<uint16_t>& values)
+{
+    auto result = ModbusClient::writeHoldingRegisters(address, values);
+
+    markEndOfMessage();
+    return result;
+}
+
+bool LibModbusSerialRtuClient::maskWriteHoldingRegister(int address, uint16_t andMask, uint16_t orMask)
+{
+    auto result = ModbusClient::maskWriteHoldingRegister(address, andMask, orMask);
+
+    markEndOfMessage();
     return result;
 }
 
@@ -104,23 +207,31 @@ bool LibModbusSerialRtuClient::writeCoil(int address, bool value)
 {
     auto result = ModbusClient::writeCoil(address, value);
 
-    sleepBetweenModbusMessages();
+    markEndOfMessage();
+    return result;
+}
+
+bool LibModbusSerialRtuClient::writeCoils(int address, std::vector<bool>& values)
+{
+    auto result = ModbusClient::writeCoils(address, values);
+
+    markEndOfMessage();
     return result;
 }
 
-bool LibModbusSerialRtuClient::readInputRegisters(int address, int number, std::vector<uint16_t>& values)
+bool LibModbusSerialRtuClient::readInputRegisters(int address, int number, uint16_t* values)
 {
     auto result = ModbusClient::readInputRegisters(address, number, values);
 
-    sleepBetweenModbusMessages();
+    markEndOfMessage();
     return result;
 }
 
-bool LibModbusSerialRtuClient::readInputContacts(int address, int number, std::vector<bool>& values)
+bool LibModbusSerialRtuClient::readInputContacts(int address, int number, uint8_t* values)
 {
     auto result = ModbusClient::readInputContacts(address, number, values);
 
-    sleepBetweenModbusMessages();
+    markEndOfMessage();
     return result;
 }
 
@@ -128,15 +239,15 @@ bool LibModbusSerialRtuClient::readHoldingRegister(int address, uint16_t& value)
 {
     auto result = ModbusClient::readHoldingRegister(address, value);
 
-    sleepBetweenModbusMessages();
+    markEndOfMessage();
     return result;
 }
 
-bool LibModbusSerialRtuClient::readHoldingRegisters(int address, int number, std::vector<uint16_t>& values)
+bool LibModbusSerialRtuClient::readHoldingRegisters(int address, int number, uint16_t* values)
 {
     auto result = ModbusClient::readHoldingRegisters(address, number, values);
 
-    sleepBetweenModbusMessages();
+    markEndOfMessage();
     return result;
 }
 
@@ -144,21 +255,56 @@ bool LibModbusSerialRtuClient::readCoil(int address, bool& value)
 {
     auto result = ModbusClient::readCoil(address, value);
 
-    sleepBetweenModbusMessages();
+    markEndOfMessage();
     return result;
 }
 
-bool LibModbusSerialRtuClient::readCoils(int address, int number, std::vector<bool>& values)
+bool LibModbusSerialRtuClient::readCoils(int address, int number, uint8_t* values)
 {
     auto result = ModbusClient::readCoils(address, number, values);
 
-    sleepBetweenModbusMessages();
+    markEndOfMessage();
     return result;
 }
 
-void LibModbusSerialRtuClient::sleepBetweenModbusMessages() const
+bool LibModbusSerialRtuClient::changeSlaveAddress(int address)
+{
+    if (!ModbusClient::changeSlaveAddress(address))
+    {
+        return false;
+    }
+
+    m_slaveAddress = address;
+    return true;
+}
+
+void LibModbusSerialRtuClient::waitBeforeRequest()
+{
+    const auto it = m_turnaroundDelays.find(m_lastSlaveAddress);
+    const auto delay = it != m_turnaroundDelays.cend() ? it->second : m_silentInterval;
+    // Sleeps only for what is left, the time spent since the last message already counts.
+    std::this_thread::sleep_until(m_lastMessageEnd + delay);
+}
+
+void LibModbusSerialRtuClient::markEndOfMessage()
+{
+    m_lastSlaveAddress = m_slaveAddress;
+    m_lastMessageEnd = std::chrono::steady_clock::now();
+}
+
+bool LibModbusSerialRtuClient::isDelayTolerated(int slaveAddress, int address, int attempts,
+                                                std::chrono::microseconds delay)
 {
-    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    m_turnaroundDelays[slaveAddress] = delay;
+    for (auto i = 0; i < attempts; ++i)
+    {
+        auto value = uint16_t{0};
+        if (!ModbusClient::readHoldingRegister(slaveAddress, address, value))
+        {
+            return false;
+        }
+    }
+    return true;
 }
 }    // namespace more_modbus
 }    // namespace wolkabout
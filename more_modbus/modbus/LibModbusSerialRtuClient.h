@@ -22,6 +22,7 @@
 #include "more_modbus/modbus/ModbusClient.h"
 
 #include <chrono>
+#include <map>
 #include <mutex>
 #include <string>
 
@@ -32,7 +33,9 @@ namespace more_modbus
 /**
  * @brief ModbusClient implementation for Modbus SERIAL/RTU connections.
  * @details Uses modbus_new_rtu method from libmodbus, and takes in a bunch of arguments.
- *         Overrides all the methods to add a timeout after messages.
+ *         Overrides all the methods to keep the bus silent between two messages. The silent interval is the
+ *         3.5 character time the protocol requires, calculated from the serial settings, unless a slave has its
+ *         own turnaround delay set, or calibrated using calibrateTurnaroundDelay().
  */
 class LibModbusSerialRtuClient : public ModbusClient
 {
@@ -61,31 +64,99 @@ public:
 
     ~LibModbusSerialRtuClient() override;
 
+    /**
+     * @brief Calculates the time of 3.5 characters, the silent interval that separates two frames.
+     * @details A character is made of the start bit, the data bits, the parity bit (if any) and the stop bits.
+     * @param baudRate
+     * @param dataBits
+     * @param stopBits
+     * @param bitParity
+     * @return The silent interval, rounded up to a whole microsecond.
+     */
+    static std::chrono::microseconds calculateSilentInterval(int baudRate, char dataBits, char stopBits,
+                                                             BitParity bitParity);
+
+    /**
+     * @return The silent interval kept between messages to slaves without their own turnaround delay.
+     */
+    std::chrono::microseconds getSilentInterval() const;
+
+    /**
+     * @brief Sets the time the bus is kept silent after a message to the slave, for slaves that need longer than
+     *       the silent interval to become ready for the next request.
+     * @param slaveAddress
+     * @param delay
+     */
+    void setTurnaroundDelay(int slaveAddress, std::chrono::microseconds delay);
+
+    /**
+     * @brief Removes the turnaround delay of the slave, so the silent interval is used for it again.
+     * @param slaveAddress
+     */
+    void clearTurnaroundDelay(int slaveAddress);
+
+    /**
+     * @param slaveAddress
+     * @return The time the bus is kept silent after a message to the slave.
+     */
+    std::chrono::microseconds getTurnaroundDelay(int slaveAddress);
+
+    /**
+     * @brief Measures the shortest turnaround delay the slave tolerates, and sets it as the slave's turnaround delay.
+     * @details Reads a single HOLDING_REGISTER back to back, looking for the shortest delay between the silent
+     *         interval and CALIBRATION_MAX_DELAY where all the reads succeed. Every failed read costs a response
+     *         timeout, so this is meant to be done once, during commissioning.
+     * @param slaveAddress
+     * @param address of a holding register the slave can read
+     * @param attempts the number of back to back reads that have to succeed for a delay to be tolerated
+     * @return Whether the slave could be read at all. If not, the turnaround delay is left as it was.
+     */
+    bool calibrateTurnaroundDelay(int slaveAddress, int address, int attempts = 3);
+
+    static const std::chrono::microseconds CALIBRATION_MAX_DELAY;
+    static const std::chrono::microseconds CALIBRATION_RESOLUTION;
+
 private:
     bool createContext() override;
     bool destroyContext() override;
 
     bool writeHoldingRegister(int address, uint16_t value) override;
+    bool writeHoldingRegisters(int address, std::vector<uint16_t>& values) override;
+    bool maskWriteHoldingRegister(int address, uint16_t andMask, uint16_t orMask) override;
 
     bool writeCoil(int address, bool value) override;
+    bool writeCoils(int address, std::vector<bool>& values) override;
 
-    bool readInputRegisters(int address, int number, std::vector<uint16_t>& values) override;
+    bool readInputRegisters(int address, int number, uint16_t* values) override;
 
-    bool readInputContacts(int address, int number, std::vector<bool>& values) override;
+    bool readInputContacts(int address, int number, uint8_t* values) override;
 
     bool readHoldingRegister(int address, uint16_t& value) override;
-    bool readHoldingRegisters(int address, int number, std::vector<uint16_t>& values) override;
+    bool readHoldingRegisters(int address, int number, uint16_t* values) override;
 
     bool readCoil(int address, bool& value) override;
-    bool readCoils(int address, int number, std::vector<bool>& values) override;
+    bool readCoils(int address, int number, uint8_t* values) override;
+
+    bool changeSlaveAddress(int address) override;
 
-    void sleepBetweenModbusMessages() const;
+    // Waits until the bus has been silent long enough after the last message.
+    void waitBeforeRequest() override;
+    void markEndOfMessage();
+
+    bool isDelayTolerated(int slaveAddress, int address, int attempts, std::chrono::microseconds delay);
 
     std::string m_serialPort;
     int m_baudRate;
     char m_dataBits;
     char m_stopBits;
     char m_bitParity;
+
+    std::chrono::microseconds m_silentInterval;
+    std::map<int, std::chrono::microseconds> m_turnaroundDelays;
+
+    int m_slaveAddress;
+    int m_lastSlaveAddress;
+    std::chrono::steady_clock::time_point m_lastMessageEnd;
 };
 }    // namespace more_modbus
 }    // namespace wolkabout
@@ -0,0 +1,268 @@
+/**
+ * Copyright 2023 Wolkabout Technology s.r.o.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "more_modbus/modbus/ModbusBusScheduler.h"
+
+#include "core/utilities/Logger.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+using namespace wolkabout::legacy;
+
+namespace wolkabout::more_modbus
+{
+ModbusBusScheduler::ModbusBusScheduler(ModbusClient& modbusClient, std::size_t laneCount)
+: m_modbusClient(modbusClient)
+, m_queuedRequests(0)
+, m_laneCount(laneCount != 0 ? laneCount : std::max<std::size_t>(modbusClient.getConnectionCount(), 1))
+, m_running(false)
+{
+}
+
+ModbusBusScheduler::~ModbusBusScheduler()
+{
+    stop();
+}
+
+void ModbusBusScheduler::setWeight(int16_t slaveAddress, std::uint32_t weight)
+{
+    if (weight == 0)
+        throw std::logic_error("ModbusBusScheduler: The weight of a slave has to be positive.");
+
+    std::lock_guard<std::mutex> lock{m_mutex};
+    m_queues[slaveAddress].weight = weight;
+}
+
+std::uint32_t ModbusBusScheduler::getWeight(int16_t slaveAddress) const
+{
+    std::lock_guard<std::mutex> lock{m_mutex};
+    const auto it = m_queues.find(slaveAddress);
+    return it != m_queues.cend() ? it->second.weight : 1;
+}
+
+std::future<bool> ModbusBusScheduler::submit(int16_t slaveAddress, Request request, Priority priority)
+{
+    const auto promise = std::make_shared<std::promise<bool>>();
+    auto future = promise->get_future();
+    submit(slaveAddress, std::move(request), [promise](bool result) { promise->set_value(result); }, priority);
+    return future;
+}
+
+void ModbusBusScheduler::submit(int16_t slaveAddress, Request request, Callback callback, Priority priority)
+{
+    {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        // The I/O threads can't wait for their own queue, so their requests are executed right away.
+        if (m_running && !isLaneThread())
+        {
+            auto job = Job{slaveAddress, std::move(request), std::move(callback), std::chrono::steady_clock::now()};
+            if (priority == Priority::HIGH)
+            {
+                m_priorityJobs.emplace_back(std::move(job));
+            }
+            else
+            {
+                auto& queue = m_queues[slaveAddress];
+                if (queue.jobs.empty())
+                    m_turns.emplace_back(slaveAddress);
+                queue.jobs.emplace_back(std::move(job));
+            }
+            ++m_queuedRequests;
+            m_condition.notify_one();
+            return;
+        }
+    }
+
+    const auto result = execute(request);
+    if (callback)
+        callback(result);
+}
+
+std::size_t ModbusBusScheduler::getQueuedRequests() const
+{
+    std::lock_guard<std::mutex> lock{m_mutex};
+    return m_queuedRequests;
+}
+
+ModbusBusScheduler::QueueWait ModbusBusScheduler::getQueueWait(Priority priority) const
+{
+    std::lock_guard<std::mutex> lock{m_mutex};
+    return m_queueWaits[static_cast<int>(priority)];
+}
+
+std::size_t ModbusBusScheduler::getLaneCount() const
+{
+    return m_laneCount;
+}
+
+void ModbusBusScheduler::start()
+{
+    std::lock_guard<std::mutex> lock{m_mutex};
+    if (m_running)
+        return;
+
+    m_running = true;
+    for (auto lane = std::size_t{0}; lane < m_laneCount; ++lane)
+    {
+        m_threads.emplace_back(&ModbusBusScheduler::run, this);
+        m_threadIds.emplace_back(m_threads.back().get_id());
+    }
+}
+
+void ModbusBusScheduler::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        if (!m_running)
+            return;
+        m_running = false;
+    }
+    m_condition.notify_all();
+
+    for (auto& thread : m_threads)
+    {
+        if (thread.joinable())
+            thread.join();
+    }
+    m_threads.clear();
+
+    std::lock_guard<std::mutex> lock{m_mutex};
+    m_threadIds.clear();
+}
+
+bool ModbusBusScheduler::isRunning() const
+{
+    return m_running;
+}
+
+void ModbusBusScheduler::run()
+{
+    std::unique_lock<std::mutex> lock{m_mutex};
+    while (m_running)
+    {
+        auto job = Job{};
+        auto priority = Priority::HIGH;
+        if (!takeJob(job, priority))
+        {
+            m_condition.wait(lock);
+            continue;
+        }
+        --m_queuedRequests;
+
+        const auto wait = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() -
+                                                                                job.queuedAt);
+        auto& queueWait = m_queueWaits[static_cast<int>(priority)];
+        ++queueWait.requests;
+        queueWait.total += wait;
+        queueWait.maximum = std::max(queueWait.maximum, wait);
+
+        lock.unlock();
+        const auto result = execute(job.request);
+        if (job.callback)
+            job.callback(result);
+        lock.lock();
+
+        // The next request of the slave can now go to any of the lanes.
+        m_queues[job.slaveAddress].executing = false;
+        m_condition.notify_all();
+    }
+
+    // Nobody is going to execute the requests that are left, so they are failed.
+    auto jobs = std::move(m_priorityJobs);
+    m_priorityJobs.clear();
+    for (auto& queue : m_queues)
+    {
+        for (auto& job : queue.second.jobs)
+            jobs.emplace_back(std::move(job));
+        queue.second.jobs.clear();
+        queue.second.served = 0;
+    }
+    m_turns.clear();
+    m_queuedRequests = 0;
+    lock.unlock();
+
+    if (!jobs.empty())
+        LOG(WARN) << "ModbusBusScheduler: Stopped with " << jobs.size() << " request(s) queued, failing them.";
+    for (const auto& job : jobs)
+    {
+        if (job.callback)
+            job.callback(false);
+    }
+}
+
+bool ModbusBusScheduler::takeJob(Job& job, Priority& priority)
+{
+    // The high priority requests don't take a turn of their slave.
+    for (auto it = m_priorityJobs.begin(); it != m_priorityJobs.end(); ++it)
+    {
+        auto& queue = m_queues[it->slaveAddress];
+        if (queue.executing)
+            continue;
+
+        queue.executing = true;
+        job = std::move(*it);
+        m_priorityJobs.erase(it);
+        priority = Priority::HIGH;
+        return true;
+    }
+
+    // A slave that is executing a request on another lane is skipped, without losing its turn.
+    for (auto it = m_turns.begin(); it != m_turns.end(); ++it)
+    {
+        const auto slaveAddress = *it;
+        auto& queue = m_queues[slaveAddress];
+        if (queue.executing)
+            continue;
+
+        queue.executing = true;
+        job = std::move(queue.jobs.front());
+        queue.jobs.pop_front();
+        priority = Priority::NORMAL;
+
+        // The turn passes to the next slave once this one has used up its weight, or has nothing left to execute.
+        if (++queue.served >= queue.weight || queue.jobs.empty())
+        {
+            queue.served = 0;
+            m_turns.erase(it);
+            if (!queue.jobs.empty())
+                m_turns.emplace_back(slaveAddress);
+        }
+        return true;
+    }
+    return false;
+}
+
+bool ModbusBusScheduler::isLaneThread() const
+{
+    return std::find(m_threadIds.cbegin(), m_threadIds.cend(), std::this_thread::get_id()) != m_threadIds.cend();
+}
+
+bool ModbusBusScheduler::execute(const Request& request)
+{
+    try
+    {
+        return request(m_modbusClient);
+    }
+    catch (const std::exception& exception)
+    {
+        LOG(ERROR) << "ModbusBusScheduler: Request failed with an exception - '" << exception.what() << "'.";
+        return false;
+    }
+}
+}    // namespace wolkabout::more_modbus
@@ -0,0 +1,196 @@
+/**
+ * Copyright 2023 Wolkabout Technology s.r.o.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef MOREMODBUS_MODBUSBUSSCHEDULER_H
+#define MOREMODBUS_MODBUSBUSSCHEDULER_H
+
+#include "more_modbus/modbus/ModbusClient.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace wolkabout::more_modbus
+{
+/**
+ * @brief Owns the order in which the requests are executed on a client.
+ * @details Requests are queued for each slave, and executed on dedicated I/O threads, one lane per connection of the
+ *         client, so a ModbusClientPool keeps all of its connections busy. Each lane executes a request at a time,
+ *         and a slave has at most one request executing. The slaves take turns, each executing up to its weight of
+ *         requests in a row, so a slave with a lot of queued requests doesn't hold up the others, and the wait of
+ *         every slave is bounded by the requests of the other slaves queued at the same time. High priority
+ *         requests, like the writes the user asked for, skip the turns and are executed as soon as a lane is free.
+ *         While the scheduler isn't running, the requests are executed on the thread that submits them, as are the
+ *         requests submitted from the I/O threads themselves.
+ */
+class ModbusBusScheduler
+{
+public:
+    using Request = std::function<bool(ModbusClient&)>;
+    using Callback = std::function<void(bool)>;
+
+    enum class Priority
+    {
+        NORMAL = 0,
+        HIGH = 1
+    };
+
+    /**
+     * @brief The time the executed requests of a priority spent in the queue.
+     */
+    struct QueueWait
+    {
+        std::uint64_t requests = 0;
+        std::chrono::microseconds total{0};
+        std::chrono::microseconds maximum{0};
+    };
+
+    /**
+     * @brief Default constructor.
+     * @param modbusClient the client the requests are executed on
+     * @param laneCount the number of requests executed at the same time, by default the connections of the client
+     */
+    explicit ModbusBusScheduler(ModbusClient& modbusClient, std::size_t laneCount = 0);
+
+    /**
+     * @brief Stops the I/O thread, failing the requests that are still queued.
+     */
+    virtual ~ModbusBusScheduler();
+
+    /**
+     * @brief Sets the number of requests the slave can execute in a row, before the next slave gets its turn.
+     * @param slaveAddress
+     * @param weight has to be positive, the default is 1
+     */
+    void setWeight(int16_t slaveAddress, std::uint32_t weight);
+
+    /**
+     * @param slaveAddress
+     * @return The number of requests the slave can execute in a row.
+     */
+    std::uint32_t getWeight(int16_t slaveAddress) const;
+
+    /**
+     * @brief Queues the request of the slave.
+     * @param slaveAddress
+     * @param request the function executing the request, returning whether it was successful
+     * @param priority high priority requests are executed before all the normal ones
+     * @return The future result of the request. Requests that throw, or are still queued when the scheduler is
+     *        stopped, result in false.
+     */
+    std::future<bool> submit(int16_t slaveAddress, Request request, Priority priority = Priority::NORMAL);
+
+    /**
+     * @brief Queues the request of the slave.
+     * @param slaveAddress
+     * @param request the function executing the request, returning whether it was successful
+     * @param callback invoked with the result of the request, on the I/O thread
+     * @param priority high priority requests are executed before all the normal ones
+     */
+    void submit(int16_t slaveAddress, Request request, Callback callback, Priority priority = Priority::NORMAL);
+
+    /**
+     * @return The number of requests waiting to be executed.
+     */
+    std::size_t getQueuedRequests() const;
+
+    /**
+     * @param priority
+     * @return The time the requests of the priority waited in the queue, before being executed. Requests executed
+     *        right away, without the I/O thread, are not counted.
+     */
+    QueueWait getQueueWait(Priority priority) const;
+
+    /**
+     * @return The number of requests executed at the same time, one on each I/O thread.
+     */
+    std::size_t getLaneCount() const;
+
+    /**
+     * @brief Starts the I/O threads.
+     */
+    void start();
+
+    /**
+     * @brief Stops the I/O threads, failing the requests that are still queued. Requests submitted after this are
+     *        executed on the thread submitting them.
+     */
+    void stop();
+
+    bool isRunning() const;
+
+private:
+    struct Job
+    {
+        int16_t slaveAddress;
+        Request request;
+        Callback callback;
+        std::chrono::steady_clock::time_point queuedAt;
+    };
+
+    struct SlaveQueue
+    {
+        std::deque<Job> jobs;
+        std::uint32_t weight = 1;
+        // The number of requests executed in the current turn of the slave.
+        std::uint32_t served = 0;
+        // Whether a request of the slave is executing on one of the lanes.
+        bool executing = false;
+    };
+
+    void run();
+
+    // Takes the next job whose slave isn't executing a request, and marks the slave as executing. Returns false if
+    // there is no such job.
+    bool takeJob(Job& job, Priority& priority);
+
+    // Whether the calling thread is one of the I/O threads.
+    bool isLaneThread() const;
+
+    // Executes the request on the client, reporting exceptions as a failed request.
+    bool execute(const Request& request);
+
+    ModbusClient& m_modbusClient;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_condition;
+    std::map<int16_t, SlaveQueue> m_queues;
+    // The slaves with queued requests, in the order they get their turns. The first one is executing its turn.
+    std::deque<int16_t> m_turns;
+    // High priority requests of all the slaves, in the order they were submitted.
+    std::deque<Job> m_priorityJobs;
+    std::size_t m_queuedRequests;
+    QueueWait m_queueWaits[2];
+
+    std::size_t m_laneCount;
+    std::atomic_bool m_running;
+    std::vector<std::thread> m_threads;
+    std::vector<std::thread::id> m_threadIds;
+};
+}    // namespace wolkabout::more_modbus
+
+#endif    // MOREMODBUS_MODBUSBUSSCHEDULER_H
@@ -19,6 +19,8 @@
 #include "more_modbus/modbus/ModbusClient.h"
 
 #include "core/utilities/Logger.h"
+#include "more_modbus/modbus/ModbusTcpCodec.h"
+#include "more_modbus/modbus/RoundTripEstimator.h"
 
 #include <modbus/modbus.h>
 
@@ -33,6 +35,85 @@ ModbusClient::ModbusClient(std::chrono::milliseconds responseTimeout)
 {
 }
 
+ModbusClient::~ModbusClient() = default;
+
+template <typename Request> bool ModbusClient::execute(int slaveAddress, std::uint8_t functionCode, Request request)
+{
+    std::lock_guard<decltype(m_modbusMutex)> l{m_modbusMutex};
+    if (!changeSlaveAddress(slaveAddress))
+    {
+        return false;
+    }
+
+    waitBeforeRequest();
+    if (m_roundTripEstimator == nullptr)
+    {
+        return request();
+    }
+
+    const auto responseTimeout = m_roundTripEstimator->getResponseTimeout(slaveAddress, functionCode);
+    applyTimeouts(responseTimeout, m_roundTripEstimator->getByteTimeout(slaveAddress, functionCode));
+    const auto start = std::chrono::steady_clock::now();
+    const auto success = request();
+    const auto roundTripTime =
+      std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+    recordRoundTrip(slaveAddress, functionCode, success, roundTripTime, responseTimeout);
+    return success;
+}
+
+void ModbusClient::recordRoundTrip(int slaveAddress, std::uint8_t functionCode, bool success,
+                                   std::chrono::microseconds roundTripTime, std::chrono::microseconds responseTimeout)
+{
+    std::lock_guard<decltype(m_modbusMutex)> l{m_modbusMutex};
+    if (m_roundTripEstimator == nullptr)
+    {
+        return;
+    }
+
+    if (success)
+        m_roundTripEstimator->addSample(slaveAddress, functionCode, roundTripTime);
+    else if (roundTripTime >= responseTimeout)
+        m_roundTripEstimator->addTimeout(slaveAddress, functionCode);
+}
+
+void ModbusClient::enableAdaptiveTimeouts(std::chrono::milliseconds floor, std::chrono::milliseconds ceiling)
+{
+    std::lock_guard<decltype(m_modbusMutex)> l{m_modbusMutex};
+    m_roundTripEstimator.reset(new RoundTripEstimator(floor, ceiling));
+}
+
+void ModbusClient::disableAdaptiveTimeouts()
+{
+    std::lock_guard<decltype(m_modbusMutex)> l{m_modbusMutex};
+    if (m_roundTripEstimator == nullptr)
+    {
+        return;
+    }
+
+    m_roundTripEstimator.reset();
+    if (m_connected)
+    {
+        applyTimeouts(m_responseTimeout, DEFAULT_BYTE_TIMEOUT);
+    }
+}
+
+bool ModbusClient::hasAdaptiveTimeouts()
+{
+    std::lock_guard<decltype(m_modbusMutex)> l{m_modbusMutex};
+    return m_roundTripEstimator != nullptr;
+}
+
+std::chrono::microseconds ModbusClient::getResponseTimeout(int slaveAddress, std::uint8_t functionCode)
+{
+    std::lock_guard<decltype(m_modbusMutex)> l{m_modbusMutex};
+    if (m_roundTripEstimator == nullptr)
+    {
+        return m_responseTimeout;
+    }
+
+    return m_roundTripEstimator->getResponseTimeout(slaveAddress, functionCode);
+}
+
 bool ModbusClient::connect()
 {
     if (m_connected)
@@ -91,103 +172,145 @@ bool ModbusClient::isConnected()
     return m_connected;
 }
 
-bool ModbusClient::writeHoldingRegister(int slaveAddress, int address, uint16_t value)
+std::size_t ModbusClient::getConnectionCount() const
 {
-    std::lock_guard<decltype(m_modbusMutex)> l{m_modbusMutex};
-    if (!changeSlaveAddress(slaveAddress))
-    {
-        return false;
-    }
+    return 1;
+}
+
+bool ModbusClient::pipelinesRequests() const
+{
+    return false;
+}
 
-    return writeHoldingRegister(address, value);
+bool ModbusClient::writeHoldingRegister(int slaveAddress, int address, uint16_t value)
+{
+    return execute(slaveAddress, ModbusTcpCodec::WRITE_SINGLE_REGISTER,
+                   [&] { return writeHoldingRegister(address, value); });
 }
 
 bool ModbusClient::writeHoldingRegisters(int slaveAddress, int address, std::vector<uint16_t>& values)
 {
-    std::lock_guard<decltype(m_modbusMutex)> l{m_modbusMutex};
-    if (!changeSlaveAddress(slaveAddress))
-    {
-        return false;
-    }
+    return execute(slaveAddress, ModbusTcpCodec::WRITE_MULTIPLE_REGISTERS,
+                   [&] { return writeHoldingRegisters(address, values); });
+}
 
-    return writeHoldingRegisters(address, values);
+bool ModbusClient::maskWriteHoldingRegister(int slaveAddress, int address, uint16_t andMask, uint16_t orMask)
+{
+    return execute(slaveAddress, ModbusTcpCodec::MASK_WRITE_REGISTER,
+                   [&] { return maskWriteHoldingRegister(address, andMask, orMask); });
 }
 
 bool ModbusClient::writeCoil(int slaveAddress, int address, bool value)
 {
-    std::lock_guard<decltype(m_modbusMutex)> l{m_modbusMutex};
-    if (!changeSlaveAddress(slaveAddress))
-    {
-        return false;
-    }
+    return execute(slaveAddress, ModbusTcpCodec::WRITE_SINGLE_COIL, [&] { return writeCoil(address, value); });
+}
 
-    return writeCoil(address, value);
+bool ModbusClient::writeCoils(int slaveAddress, int address, std::vector<bool>& values)
+{
+    return execute(slaveAddress, ModbusTcpCodec::WRITE_MULTIPLE_COILS, [&] { return writeCoils(address, values); });
 }
 
 bool ModbusClient::readInputRegisters(int slaveAddress, int address, int number, std::vector<uint16_t>& values)
 {
-    std::lock_guard<decltype(m_modbusMutex)> l{m_modbusMutex};
-    if (!changeSlaveAddress(slaveAddress))
-    {
-        return false;
-    }
+    return execute(slaveAddress, static_cast<std::uint8_t>(ModbusReadFunction::READ_INPUT_REGISTERS),
+                   [&] { return readInputRegisters(address, number, values); });
+}
 
-    return readInputRegisters(address, number, values);
+bool ModbusClient::readInputRegisters(int slaveAddress, int address, int number, uint16_t* values)
+{
+    return execute(slaveAddress, static_cast<std::uint8_t>(ModbusReadFunction::READ_INPUT_REGISTERS),
+                   [&] { return readInputRegisters(address, number, values); });
 }
 
 bool ModbusClient::readInputContacts(int slaveAddress, int address, int number, std::vector<bool>& values)
 {
-    std::lock_guard<decltype(m_modbusMutex)> l{m_modbusMutex};
-    if (!changeSlaveAddress(slaveAddress))
-    {
-        return false;
-    }
+    return execute(slaveAddress, static_cast<std::uint8_t>(ModbusReadFunction::READ_DISCRETE_INPUTS),
+                   [&] { return readInputContacts(address, number, values); });
+}
 
-    return readInputContacts(address, number, values);
+bool ModbusClient::readInputContacts(int slaveAddress, int address, int number, uint8_t* values)
+{
+    return execute(slaveAddress, static_cast<std::uint8_t>(ModbusReadFunction::READ_DISCRETE_INPUTS),
+                   [&] { return readInputContacts(address, number, values); });
 }
 
 bool ModbusClient::readHoldingRegister(int slaveAddress, int address, uint16_t& value)
 {
-    std::lock_guard<decltype(m_modbusMutex)> l{m_modbusMutex};
-    if (!changeSlaveAddress(slaveAddress))
-    {
-        return false;
-    }
-
-    return readHoldingRegister(address, value);
+    return execute(slaveAddress, static_cast<std::uint8_t>(ModbusReadFunction::READ_HOLDING_REGISTERS),
+                   [&] { return readHoldingRegister(address, value); });
 }
 
 bool ModbusClient::readHoldingRegisters(int slaveAddress, int address, int number, std::vector<uint16_t>& values)
 {
-    std::lock_guard<decltype(m_modbusMutex)> l{m_modbusMutex};
-    if (!changeSlaveAddress(slaveAddress))
-    {
-        return false;
-    }
+    return execute(slaveAddress, static_cast<std::uint8_t>(ModbusReadFunction::READ_HOLDING_REGISTERS),
+                   [&] { return readHoldingRegisters(address, number, values); });
+}
 
-    return readHoldingRegisters(address, number, values);
+bool ModbusClient::readHoldingRegisters(int slaveAddress, int address, int number, uint16_t* values)
+{
+    return execute(slaveAddress, static_cast<std::uint8_t>(ModbusReadFunction::READ_HOLDING_REGISTERS),
+                   [&] { return readHoldingRegisters(address, number, values); });
 }
 
 bool ModbusClient::readCoil(int slaveAddress, int address, bool& value)
 {
-    std::lock_guard<decltype(m_modbusMutex)> l{m_modbusMutex};
-    if (!changeSlaveAddress(slaveAddress))
-    {
-        return false;
-    }
-    bool read = readCoil(address, value);
-    return read;
+    return execute(slaveAddress, static_cast<std::uint8_t>(ModbusReadFunction::READ_COILS),
+                   [&] { return readCoil(address, value); });
 }
 
 bool ModbusClient::readCoils(int slaveAddress, int address, int number, std::vector<bool>& values)
 {
-    std::lock_guard<decltype(m_modbusMutex)> l{m_modbusMutex};
-    if (!changeSlaveAddress(slaveAddress))
+    return execute(slaveAddress, static_cast<std::uint8_t>(ModbusReadFunction::READ_COILS),
+                   [&] { return readCoils(address, number, values); });
+}
+
+bool ModbusClient::readCoils(int slaveAddress, int address, int number, uint8_t* values)
+{
+    return execute(slaveAddress, static_cast<std::uint8_t>(ModbusReadFunction::READ_COILS),
+                   [&] { return readCoils(address, number, values); });
+}
+
+bool ModbusClient::read(ModbusReadRequest& request)
+{
+    request.registers.clear();
+    request.bits.clear();
+    switch (request.function)
     {
-        return false;
+    case ModbusReadFunction::READ_COILS:
+        request.success = request.bitBuffer != nullptr ?
+                            readCoils(request.slaveAddress, request.address, request.number, request.bitBuffer) :
+                            readCoils(request.slaveAddress, request.address, request.number, request.bits);
+        break;
+    case ModbusReadFunction::READ_DISCRETE_INPUTS:
+        request.success =
+          request.bitBuffer != nullptr ?
+            readInputContacts(request.slaveAddress, request.address, request.number, request.bitBuffer) :
+            readInputContacts(request.slaveAddress, request.address, request.number, request.bits);
+        break;
+    case ModbusReadFunction::READ_HOLDING_REGISTERS:
+        request.success =
+          request.registerBuffer != nullptr ?
+            readHoldingRegisters(request.slaveAddress, request.address, request.number, request.registerBuffer) :
+            readHoldingRegisters(request.slaveAddress, request.address, request.number, request.registers);
+        break;
+    case ModbusReadFunction::READ_INPUT_REGISTERS:
+        request.success =
+          request.registerBuffer != nullptr ?
+            readInputRegisters(request.slaveAddress, request.address, request.number, request.registerBuffer) :
+            readInputRegisters(request.slaveAddress, request.address, request.number, request.registers);
+        break;
+    default:
+        request.success = false;
     }
+    return request.success;
+}
 
-    return readCoils(address, number, values);
+bool ModbusClient::readBatch(std::vector<ModbusReadRequest>& requests)
+{
+    auto success = true;
+    for (auto& request : requests)
+        success = read(request) && success;
+    return success;
 }
 
 //
@@ -214,6 +337,17 @@ bool ModbusClient::writeHoldingRegisters(int address, std::vector<uint16_t>& val
     return true;
 }
 
+bool ModbusClient::maskWriteHoldingRegister(int address, uint16_t andMask, uint16_t orMask)
+{
+    if (modbus_mask_write_register(m_modbus, address, andMask, orMask) == -1)
+    {
+        LOG(DEBUG) << "LibModbusClient: Unable to mask write holding register - " << modbus_strerror(errno);
+        return false;
+    }
+
+    return true;
+}
+
 bool ModbusClient::writeCoil(int address, bool value)
 {
     if (modbus_write_bit(m_modbus, address, value ? TRUE : FALSE) == -1)
@@ -225,19 +359,37 @@ bool ModbusClient::writeCoil(int address, bool value)
     return true;
 }
 
-bool ModbusClient::readInputRegisters(int address, int number, std::vector<uint16_t>& values)
+bool ModbusClient::writeCoils(int address, std::vector<bool>& values)
 {
-    std::vector<uint16_t> tmpValues(static_cast<uint32_t>(number));
+    auto bits = std::vector<uint8_t>(values.cbegin(), values.cend());
+    if (modbus_write_bits(m_modbus, address, static_cast<int>(bits.size()), bits.data()) == -1)
+    {
+        LOG(DEBUG) << "LibModbusClient: Unable to write coils - " << modbus_strerror(errno);
+        return false;
+    }
 
-    if (modbus_read_input_registers(m_modbus, address, number, &tmpValues[0]) == -1)
+    return true;
+}
+
+bool ModbusClient::readInputRegisters(int address, int number, std::vector<uint16_t>& values)
+{
+    const auto size = values.size();
+    values.resize(size + static_cast<std::size_t>(number));
+    if (!readInputRegisters(address, number, values.data() + size))
     {
-        LOG(DEBUG) << "LibModbusClient: Unable to read input registers - " << modbus_strerror(errno);
+        values.resize(size);
         return false;
     }
 
-    for (const uint16_t& tmpValue : tmpValues)
+    return true;
+}
+
+bool ModbusClient::readInputRegisters(int address, int number, uint16_t* values)
+{
+    if (modbus_read_input_registers(m_modbus, address, number, values) == -1)
     {
-        values.push_back(tmpValue);
+        LOG(DEBUG) << "LibModbusClient: Unable to read input registers - " << modbus_strerror(errno);
+        return false;
     }
 
     return true;
@@ -245,20 +397,28 @@ bool ModbusClient::readInputRegisters(int address, int number, std::vector<uint1
 
 bool ModbusClient::readInputContacts(int address, int number, std::vector<bool>& values)
 {
-    int size = (number / 8 + (number % 8 != 0));
-    std::vector<std::uint8_t> tmpValues(static_cast<uint32_t>(size));
-
-    int bits_read = modbus_read_input_bits(m_modbus, address, number, &tmpValues[0]);
-    if (bits_read == -1)
+    // libmodbus places every bit into its own byte.
+    std::vector<std::uint8_t> tmpValues(static_cast<std::vector<std::uint8_t>::size_type>(number));
+    if (!readInputContacts(address, number, tmpValues.data()))
     {
-        LOG(DEBUG) << "LibModbusClient: Unable to read input contacts - " << modbus_strerror(errno);
         return false;
     }
 
-    for (uint32_t i = 0; i < static_cast<uint32_t>(bits_read); i++)
+    for (const auto& tmpValue : tmpValues)
+    {
+        values.push_back(tmpValue != 0);
+    }
+    return true;
+}
+
+bool ModbusClient::readInputContacts(int address, int number, uint8_t* values)
+{
+    if (modbus_read_input_bits(m_modbus, address, number, values) == -1)
     {
-        values.push_back(static_cast<bool>(tmpValues[i]));
+        LOG(DEBUG) << "LibModbusClient: Unable to read input contacts - " << modbus_strerror(errno);
+        return false;
     }
+
     return true;
 }
 
@@ -275,17 +435,23 @@ bool ModbusClient::readHoldingRegister(int address, uint16_t& value)
 
 bool ModbusClient::readHoldingRegisters(int address, int number, std::vector<uint16_t>& values)
 {
-    std::vector<uint16_t> tmpValues(static_cast<uint32_t>(number));
-
-    if (modbus_read_registers(m_modbus, address, number, &tmpValues[0]) == -1)
+    const auto size = values.size();
+    values.resize(size + static_cast<std::size_t>(number));
+    if (!readHoldingRegisters(address, number, values.data() + size))
     {
-        LOG(DEBUG) << "LibModbusClient: Unable to read holding registers - " << modbus_strerror(errno);
+        values.resize(size);
         return false;
     }
 
-    for (const uint16_t& tmpValue : tmpValues)
+    return true;
+}
+
+bool ModbusClient::readHoldingRegisters(int address, int number, uint16_t* values)
+{
+    if (modbus_read_registers(m_modbus, address, number, values) == -1)
     {
-        values.push_back(tmpValue);
+        LOG(DEBUG) << "LibModbusClient: Unable to read holding registers - " << modbus_strerror(errno);
+        return false;
     }
 
     return true;
@@ -308,21 +474,44 @@ bool ModbusClient::readCoil(int address, bool& value)
 bool ModbusClient::readCoils(int address, int number, std::vector<bool>& values)
 {
     std::vector<std::uint8_t> tmpValues(static_cast<std::vector<std::uint8_t>::size_type>(number));
-    int bits_read = 0;
-    bits_read = modbus_read_bits(m_modbus, address, number, &tmpValues[0]);
-    if (bits_read == -1)
+    if (!readCoils(address, number, tmpValues.data()))
     {
-        LOG(DEBUG) << "LibModbusClient: Unable to read coils - " << modbus_strerror(errno);
         return false;
     }
 
-    for (uint32_t i = 0; i < static_cast<uint32_t>(bits_read); i++)
+    for (const auto& tmpValue : tmpValues)
+    {
+        values.push_back(tmpValue != 0);
+    }
+    return true;
+}
+
+bool ModbusClient::readCoils(int address, int number, uint8_t* values)
+{
+    if (modbus_read_bits(m_modbus, address, number, values) == -1)
     {
-        values.push_back(static_cast<bool>(tmpValues[i]));
+        LOG(DEBUG) << "LibModbusClient: Unable to read coils - " << modbus_strerror(errno);
+        return false;
     }
+
     return true;
 }
 
+void ModbusClient::applyTimeouts(std::chrono::microseconds responseTimeout, std::chrono::microseconds byteTimeout)
+{
+    const auto second = std::chrono::microseconds{std::chrono::seconds{1}}.count();
+    if (modbus_set_response_timeout(m_modbus, static_cast<uint32_t>(responseTimeout.count() / second),
+                                    static_cast<uint32_t>(responseTimeout.count() % second)) == -1)
+    {
+        LOG(DEBUG) << "LibModbusClient: Unable to set response timeout - " << modbus_strerror(errno);
+    }
+    if (modbus_set_byte_timeout(m_modbus, static_cast<uint32_t>(byteTimeout.count() / second),
+                                static_cast<uint32_t>(byteTimeout.count() % second)) == -1)
+    {
+        LOG(DEBUG) << "LibModbusClient: Unable to set byte timeout - " << modbus_strerror(errno);
+    }
+}
+
 bool ModbusClient::changeSlaveAddress(int address)
 {
     if (modbus_set_slave(m_modbus, address) == -1)
@@ -333,5 +522,7 @@ bool ModbusClient::changeSlaveAddress(int address)
 
     return true;
 }
+
+void ModbusClient::waitBeforeRequest() {}
 }    // namespace more_modbus
 }    // namespace wolkabout
@@ -20,6 +20,8 @@
 #define MODBUSCLIENT_H
 
 #include <chrono>
+#include <cstdint>
+#include <memory>
 #include <mutex>
 #include <string>
 #include <vector>
@@ -31,16 +33,80 @@ namespace wolkabout
 {
 namespace more_modbus
 {
+class RoundTripEstimator;
+
+/**
+ * @brief Modbus function codes of the reads that can be submitted to a client as a batch.
+ */
+enum class ModbusReadFunction : std::uint8_t
+{
+    READ_COILS = 0x01,
+    READ_DISCRETE_INPUTS = 0x02,
+    READ_HOLDING_REGISTERS = 0x03,
+    READ_INPUT_REGISTERS = 0x04
+};
+
+/**
+ * @brief Describes a single read that is a part of a batch. The client fills in the values and the success flag.
+ */
+struct ModbusReadRequest
+{
+    int slaveAddress;
+    ModbusReadFunction function;
+    int address;
+    int number;
+
+    std::vector<uint16_t> registers;
+    std::vector<bool> bits;
+    bool success;
+
+    // When set, the values are written into these caller-owned buffers (of at least `number` elements) instead of
+    // `registers`/`bits`. Bits take one byte each, and are 0 or 1.
+    uint16_t* registerBuffer = nullptr;
+    uint8_t* bitBuffer = nullptr;
+};
+
 /**
  * @brief Main interface class for Clients to inherit.
  * @details Describes all methods necessary for the ModbusGroupReader to use while reading
- *         a group. Uses a mutex so calls don't overlap.
+ *         a group. Uses a mutex so calls don't overlap. The public methods are virtual, so clients
+ *         like the ModbusClientPool can dispatch them onto other connections. The multiple value reads
+ *         have overloads taking a caller-owned buffer, which libmodbus writes into directly.
  */
 class ModbusClient
 {
 public:
+    // Most values a single function 16/15 request can write.
+    static constexpr int MAX_WRITE_REGISTERS = 123;
+    static constexpr int MAX_WRITE_COILS = 1968;
+
     explicit ModbusClient(std::chrono::milliseconds responseTimeout);
-    virtual ~ModbusClient() = default;
+    virtual ~ModbusClient();
+
+    /**
+     * @brief Makes the response timeouts adapt to each slave and function code, from the measured round trip times.
+     * @details The response timeout for a request is the smoothed round trip time plus four times its variance,
+     *         kept between the floor and the ceiling. Slaves that haven't responded yet get the ceiling, and every
+     *         timeout doubles the timeout of the slave, up to the ceiling. So the slaves that drop off fail fast,
+     *         while the slow slaves stay reachable. The byte timeout is derived in the same way.
+     * @param floor the shortest timeout a request can get
+     * @param ceiling the longest timeout a request can get
+     */
+    virtual void enableAdaptiveTimeouts(std::chrono::milliseconds floor, std::chrono::milliseconds ceiling);
+
+    /**
+     * @brief Returns to the response timeout passed to the constructor, for all the slaves.
+     */
+    virtual void disableAdaptiveTimeouts();
+
+    virtual bool hasAdaptiveTimeouts();
+
+    /**
+     * @param slaveAddress
+     * @param functionCode
+     * @return The response timeout the next request with the function code, to the slave, will get.
+     */
+    virtual std::chrono::microseconds getResponseTimeout(int slaveAddress, std::uint8_t functionCode);
 
     /**
      * @return Returns whether or not the client successfully established a modbus connection
@@ -58,6 +124,16 @@ public:
      */
     virtual bool isConnected();
 
+    /**
+     * @return The number of requests the client can execute at the same time, each on its own connection.
+     */
+    virtual std::size_t getConnectionCount() const;
+
+    /**
+     * @return Whether the client keeps the requests of a readBatch() in flight at the same time.
+     */
+    virtual bool pipelinesRequests() const;
+
     /**
      * @brief Writes a single uint16_t value into a HOLDING REGISTER, targeting the address.
      * @details Modbus code function 6 is being used in this call.
@@ -66,7 +142,7 @@ public:
      * @param value
      * @return Returns whether or not the operation was successful.
      */
-    bool writeHoldingRegister(int slaveAddress, int address, uint16_t value);
+    virtual bool writeHoldingRegister(int slaveAddress, int address, uint16_t value);
 
     /**
      * @brief Writes multiple uint16_t values into HOLDING REGISTERS, targeting the address, and however many registers
@@ -77,7 +153,19 @@ public:
      * @param values
      * @return Returns whether or not the operation was successful.
      */
-    bool writeHoldingRegisters(int slaveAddress, int address, std::vector<uint16_t>& values);
+    virtual bool writeHoldingRegisters(int slaveAddress, int address, std::vector<uint16_t>& values);
+
+    /**
+     * @brief Modifies the bits of a HOLDING REGISTER in a single request, without reading it first.
+     *       The register will hold `(current AND andMask) OR (orMask AND NOT andMask)`.
+     * @details Modbus code function 22 is being used in this call, not every device supports it.
+     * @param slaveAddress
+     * @param address
+     * @param andMask the bits that keep their current value
+     * @param orMask the new values of the bits not in the andMask
+     * @return Returns whether or not the operation was successful.
+     */
+    virtual bool maskWriteHoldingRegister(int slaveAddress, int address, uint16_t andMask, uint16_t orMask);
 
     /**
      * @brief Writes a single bool value to a COIL, targeting the address.
@@ -87,7 +175,18 @@ public:
      * @param value
      * @return Returns whether or not the operation was successful.
      */
-    bool writeCoil(int slaveAddress, int address, bool value);
+    virtual bool writeCoil(int slaveAddress, int address, bool value);
+
+    /**
+     * @brief Writes multiple bool values to COILS, targeting the address, and however many coils after, dictated by
+     *       the length of vector passed as value.
+     * @details Modbus code function 15 is being used in this call.
+     * @param slaveAddress
+     * @param address
+     * @param values
+     * @return Returns whether or not the operation was successful.
+     */
+    virtual bool writeCoils(int slaveAddress, int address, std::vector<bool>& values);
 
     /**
      * @brief Reads from multiple INPUT_CONTACTS, starting from address,
@@ -99,7 +198,18 @@ public:
      * @param values
      * @return Returns whether or not the operation was successful.
      */
-    bool readInputContacts(int slaveAddress, int address, int number, std::vector<bool>& values);
+    virtual bool readInputContacts(int slaveAddress, int address, int number, std::vector<bool>& values);
+
+    /**
+     * @brief Reads from multiple INPUT_CONTACTS into a caller-owned buffer, without any allocation.
+     * @details Modbus code function 2 is being used in this call.
+     * @param slaveAddress
+     * @param address
+     * @param number
+     * @param values buffer of at least `number` bytes, every bit is placed in its own byte as 0 or 1
+     * @return Returns whether or not the operation was successful.
+     */
+    virtual bool readInputContacts(int slaveAddress, int address, int number, uint8_t* values);
 
     /**
      * @brief Reads from a single HOLDING_REGISTER, targeting the address.
@@ -109,7 +219,7 @@ public:
      * @param value
      * @return Returns whether or not the operation was successful.
      */
-    bool readHoldingRegister(int slaveAddress, int address, uint16_t& value);
+    virtual bool readHoldingRegister(int slaveAddress, int address, uint16_t& value);
 
     /**
      * @brief Reads from multiple HOLDING_REGISTERS, targeting the address,
@@ -121,7 +231,18 @@ public:
      * @param values
      * @return Returns whether or not the operation was successful.
      */
-    bool readHoldingRegisters(int slaveAddress, int address, int number, std::vector<uint16_t>& values);
+    virtual bool readHoldingRegisters(int slaveAddress, int address, int number, std::vector<uint16_t>& values);
+
+    /**
+     * @brief Reads from multiple HOLDING_REGISTERS into a caller-owned buffer, without any allocation.
+     * @details Modbus code function 3 is being used in this call.
+     * @param slaveAddress
+     * @param address
+     * @param number
+     * @param values buffer of at least `number` elements
+     * @return Returns whether or not the operation was successful.
+     */
+    virtual bool readHoldingRegisters(int slaveAddress, int address, int number, uint16_t* values);
 
     /**
      * @brief Reads from multiple INPUT_REGISTERS, targeting the address,
@@ -133,7 +254,18 @@ public:
      * @param values
      * @return Returns whether or not the operation was successful.
      */
-    bool readInputRegisters(int slaveAddress, int address, int number, std::vector<uint16_t>& values);
+    virtual bool readInputRegisters(int slaveAddress, int address, int number, std::vector<uint16_t>& values);
+
+    /**
+     * @brief Reads from multiple INPUT_REGISTERS into a caller-owned buffer, without any allocation.
+     * @details Modbus code function 4 is being used in this call.
+     * @param slaveAddress
+     * @param address
+     * @param number
+     * @param values buffer of at least `number` elements
+     * @return Returns whether or not the operation was successful.
+     */
+    virtual bool readInputRegisters(int slaveAddress, int address, int number, uint16_t* values);
 
     /**
      * @brief Reads from a single COIL, targeting the address.
@@ -143,7 +275,7 @@ public:
      * @param value
      * @return Returns whether or not the operation was successful.
      */
-    bool readCoil(int slaveAddress, int address, bool& value);
+    virtual bool readCoil(int slaveAddress, int address, bool& value);
 
     /**
      * @brief Reads from multiple COILS, targeting the address,
@@ -155,7 +287,36 @@ public:
      * @param values
      * @return Returns whether or not the operation was successful.
      */
-    bool readCoils(int slaveAddress, int address, int number, std::vector<bool>& values);
+    virtual bool readCoils(int slaveAddress, int address, int number, std::vector<bool>& values);
+
+    /**
+     * @brief Reads from multiple COILS into a caller-owned buffer, without any allocation.
+     * @details Modbus code function 1 is being used in this call.
+     * @param slaveAddress
+     * @param address
+     * @param number
+     * @param values buffer of at least `number` bytes, every bit is placed in its own byte as 0 or 1
+     * @return Returns whether or not the operation was successful.
+     */
+    virtual bool readCoils(int slaveAddress, int address, int number, uint8_t* values);
+
+    /**
+     * @brief Executes the passed read. Registers are placed in `registers`, and coils/contacts in `bits`, unless the
+     *       request points to its own buffers.
+     * @param request
+     * @return Returns whether the read was successful.
+     */
+    bool read(ModbusReadRequest& request);
+
+    /**
+     * @brief Executes all the passed reads. Registers are placed in `registers`, and coils/contacts in `bits`, unless
+     *       the request points to its own buffers.
+     * @details The default implementation executes the reads one after another. Clients that can have multiple
+     *         requests in flight override this to submit the whole batch at once.
+     * @param requests
+     * @return Returns whether all of the reads were successful.
+     */
+    virtual bool readBatch(std::vector<ModbusReadRequest>& requests);
 
 protected:
     virtual bool createContext() = 0;
@@ -163,26 +324,53 @@ protected:
 
     virtual bool writeHoldingRegister(int address, uint16_t value);
     virtual bool writeHoldingRegisters(int address, std::vector<uint16_t>& values);
+    virtual bool maskWriteHoldingRegister(int address, uint16_t andMask, uint16_t orMask);
 
     virtual bool writeCoil(int address, bool value);
+    virtual bool writeCoils(int address, std::vector<bool>& values);
 
     virtual bool readHoldingRegister(int address, uint16_t& value);
     virtual bool readHoldingRegisters(int address, int number, std::vector<uint16_t>& values);
+    virtual bool readHoldingRegisters(int address, int number, uint16_t* values);
 
     virtual bool readInputRegisters(int address, int number, std::vector<uint16_t>& values);
+    virtual bool readInputRegisters(int address, int number, uint16_t* values);
 
     virtual bool readCoil(int address, bool& value);
     virtual bool readCoils(int address, int number, std::vector<bool>& values);
+    virtual bool readCoils(int address, int number, uint8_t* values);
 
     virtual bool readInputContacts(int address, int number, std::vector<bool>& values);
+    virtual bool readInputContacts(int address, int number, uint8_t* values);
 
     virtual bool changeSlaveAddress(int address);
+
+    // Waits for whatever the client needs before a request is sent, before its round trip time starts counting.
+    virtual void waitBeforeRequest();
+
+    // Feeds the outcome of a request to the adaptive timeouts, if enabled. Failures that took the whole response
+    // timeout are timeouts, the quicker ones (exceptions, a closed connection) tell nothing about the round trip.
+    void recordRoundTrip(int slaveAddress, std::uint8_t functionCode, bool success,
+                         std::chrono::microseconds roundTripTime, std::chrono::microseconds responseTimeout);
+
+    // Sets the timeouts of the libmodbus context. Clients that don't use libmodbus apply the timeouts themselves.
+    virtual void applyTimeouts(std::chrono::microseconds responseTimeout, std::chrono::microseconds byteTimeout);
+
     std::chrono::milliseconds m_responseTimeout;
 
+    // The byte timeout libmodbus uses by default.
+    static constexpr std::chrono::milliseconds DEFAULT_BYTE_TIMEOUT{500};
+
     bool m_connected;
     bool m_contextCreated;
     std::recursive_mutex m_modbusMutex;
     modbus_t* m_modbus;
+
+private:
+    // Locks the client, changes the slave address, and executes the request, with the adaptive timeouts if enabled.
+    template <typename Request> bool execute(int slaveAddress, std::uint8_t functionCode, Request request);
+
+    std::unique_ptr<RoundTripEstimator> m_roundTripEstimator;
 };
 }    // namespace more_modbus
 }    // namespace wolkabout
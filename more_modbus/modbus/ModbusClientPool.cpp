@@ -0,0 +1,384 @@
+/**
+ * Copyright 2023 Wolkabout Technology s.r.o.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "more_modbus/modbus/ModbusClientPool.h"
+
+#include "core/utilities/Logger.h"
+
+#include <stdexcept>
+
+using namespace wolkabout::legacy;
+
+namespace wolkabout::more_modbus
+{
+ModbusClientPool::ModbusClientPool(std::vector<std::unique_ptr<ModbusClient>> clients)
+: ModbusClient(std::chrono::milliseconds{0}), m_clients(std::move(clients))
+{
+    if (m_clients.empty())
+        throw std::logic_error("ModbusClientPool: The pool requires at least one client.");
+    for (const auto& client : m_clients)
+    {
+        if (client == nullptr)
+            throw std::logic_error("ModbusClientPool: The pool can not hold a null client.");
+    }
+    m_leased.resize(m_clients.size(), false);
+    m_broken.resize(m_clients.size(), false);
+}
+
+ModbusClientPool::~ModbusClientPool()
+{
+    disconnect();
+}
+
+bool ModbusClientPool::connect()
+{
+    auto connected = std::size_t{0};
+    for (auto i = std::size_t{0}; i < m_clients.size(); ++i)
+    {
+        if (!m_clients[i]->connect())
+            continue;
+        ++connected;
+
+        std::lock_guard<std::mutex> lock{m_poolMutex};
+        m_broken[i] = false;
+    }
+    LOG(DEBUG) << "ModbusClientPool: Connected " << connected << "/" << m_clients.size() << " connections.";
+
+    // Wake anyone waiting for a connection, there might be new ones available.
+    notifyWaiting();
+    return connected > 0;
+}
+
+bool ModbusClientPool::disconnect()
+{
+    auto success = true;
+    for (const auto& client : m_clients)
+        success = client->disconnect() && success;
+
+    // The clients are disconnected on purpose, so they are no longer reconnected when they're leased.
+    {
+        std::lock_guard<std::mutex> lock{m_poolMutex};
+        m_broken.assign(m_clients.size(), false);
+    }
+
+    // The waiting operations should now notice that there are no connected clients.
+    notifyWaiting();
+    return success;
+}
+
+bool ModbusClientPool::isConnected()
+{
+    for (const auto& client : m_clients)
+    {
+        if (client->isConnected())
+            return true;
+    }
+    return false;
+}
+
+std::size_t ModbusClientPool::getConnectionCount() const
+{
+    return m_clients.size();
+}
+
+bool ModbusClientPool::pipelinesRequests() const
+{
+    for (const auto& client : m_clients)
+    {
+        if (!client->pipelinesRequests())
+            return false;
+    }
+    return true;
+}
+
+void ModbusClientPool::enableAdaptiveTimeouts(std::chrono::milliseconds floor, std::chrono::milliseconds ceiling)
+{
+    for (const auto& client : m_clients)
+        client->enableAdaptiveTimeouts(floor, ceiling);
+}
+
+void ModbusClientPool::disableAdaptiveTimeouts()
+{
+    for (const auto& client : m_clients)
+        client->disableAdaptiveTimeouts();
+}
+
+bool ModbusClientPool::hasAdaptiveTimeouts()
+{
+    for (const auto& client : m_clients)
+    {
+        if (!client->hasAdaptiveTimeouts())
+            return false;
+    }
+    return true;
+}
+
+std::chrono::microseconds ModbusClientPool::getResponseTimeout(int slaveAddress, std::uint8_t functionCode)
+{
+    auto index = std::size_t{0};
+    {
+        std::lock_guard<std::mutex> lock{m_poolMutex};
+        const auto it = m_lastConnection.find(slaveAddress);
+        if (it != m_lastConnection.cend())
+            index = it->second;
+    }
+    return m_clients[index]->getResponseTimeout(slaveAddress, functionCode);
+}
+
+bool ModbusClientPool::writeHoldingRegister(int slaveAddress, int address, uint16_t value)
+{
+    return execute(slaveAddress, [&](ModbusClient& client) {
+        return client.writeHoldingRegister(slaveAddress, address, value);
+    });
+}
+
+bool ModbusClientPool::writeHoldingRegisters(int slaveAddress, int address, std::vector<uint16_t>& values)
+{
+    return execute(slaveAddress, [&](ModbusClient& client) {
+        return client.writeHoldingRegisters(slaveAddress, address, values);
+    });
+}
+
+bool ModbusClientPool::maskWriteHoldingRegister(int slaveAddress, int address, uint16_t andMask, uint16_t orMask)
+{
+    return execute(slaveAddress, [&](ModbusClient& client) {
+        return client.maskWriteHoldingRegister(slaveAddress, address, andMask, orMask);
+    });
+}
+
+bool ModbusClientPool::writeCoil(int slaveAddress, int address, bool value)
+{
+    return execute(slaveAddress,
+                   [&](ModbusClient& client) { return client.writeCoil(slaveAddress, address, value); });
+}
+
+bool ModbusClientPool::writeCoils(int slaveAddress, int address, std::vector<bool>& values)
+{
+    return execute(slaveAddress,
+                   [&](ModbusClient& client) { return client.writeCoils(slaveAddress, address, values); });
+}
+
+bool ModbusClientPool::readInputContacts(int slaveAddress, int address, int number, std::vector<bool>& values)
+{
+    return execute(slaveAddress, [&](ModbusClient& client) {
+        return client.readInputContacts(slaveAddress, address, number, values);
+    });
+}
+
+bool ModbusClientPool::readInputContacts(int slaveAddress, int address, int number, uint8_t* values)
+{
+    return execute(slaveAddress, [&](ModbusClient& client) {
+        return client.readInputContacts(slaveAddress, address, number, values);
+    });
+}
+
+bool ModbusClientPool::readHoldingRegister(int slaveAddress, int address, uint16_t& value)
+{
+    return execute(slaveAddress, [&](ModbusClient& client) {
+        return client.readHoldingRegister(slaveAddress, address, value);
+    });
+}
+
+bool ModbusClientPool::readHoldingRegisters(int slaveAddress, int address, int number, std::vector<uint16_t>& values)
+{
+    return execute(slaveAddress, [&](ModbusClient& client) {
+        return client.readHoldingRegisters(slaveAddress, address, number, values);
+    });
+}
+
+bool ModbusClientPool::readHoldingRegisters(int slaveAddress, int address, int number, uint16_t* values)
+{
+    return execute(slaveAddress, [&](ModbusClient& client) {
+        return client.readHoldingRegisters(slaveAddress, address, number, values);
+    });
+}
+
+bool ModbusClientPool::readInputRegisters(int slaveAddress, int address, int number, std::vector<uint16_t>& values)
+{
+    return execute(slaveAddress, [&](ModbusClient& client) {
+        return client.readInputRegisters(slaveAddress, address, number, values);
+    });
+}
+
+bool ModbusClientPool::readInputRegisters(int slaveAddress, int address, int number, uint16_t* values)
+{
+    return execute(slaveAddress, [&](ModbusClient& client) {
+        return client.readInputRegisters(slaveAddress, address, number, values);
+    });
+}
+
+bool ModbusClientPool::readCoil(int slaveAddress, int address, bool& value)
+{
+    return execute(slaveAddress,
+                   [&](ModbusClient& client) { return client.readCoil(slaveAddress, address, value); });
+}
+
+bool ModbusClientPool::readCoils(int slaveAddress, int address, int number, std::vector<bool>& values)
+{
+    return execute(slaveAddress, [&](ModbusClient& client) {
+        return client.readCoils(slaveAddress, address, number, values);
+    });
+}
+
+bool ModbusClientPool::readCoils(int slaveAddress, int address, int number, uint8_t* values)
+{
+    return execute(slaveAddress, [&](ModbusClient& client) {
+        return client.readCoils(slaveAddress, address, number, values);
+    });
+}
+
+bool ModbusClientPool::readBatch(std::vector<ModbusReadRequest>& requests)
+{
+    if (requests.empty())
+        return true;
+
+    // If no connection can be leased, the requests must not be left looking successful.
+    for (auto& request : requests)
+        request.success = false;
+    return execute(requests.front().slaveAddress, [&](ModbusClient& client) { return client.readBatch(requests); });
+}
+
+bool ModbusClientPool::createContext()
+{
+    // The pool itself holds no context, every client manages its own.
+    return true;
+}
+
+bool ModbusClientPool::destroyContext()
+{
+    return true;
+}
+
+template <typename Operation> bool ModbusClientPool::execute(int slaveAddress, Operation operation)
+{
+    auto index = std::size_t{0};
+    auto broken = false;
+    if (!acquire(slaveAddress, index, broken))
+    {
+        LOG(ERROR) << "ModbusClientPool: None of the connections are connected.";
+        return false;
+    }
+
+    if (broken && !reconnect(index))
+    {
+        release(index);
+        return false;
+    }
+
+    // The clients stay connected after their connection broke, so the connection is made anew after a failure.
+    const auto result = operation(*m_clients[index]);
+    if (!result)
+        reconnect(index);
+    release(index);
+    return result;
+}
+
+bool ModbusClientPool::acquire(int slaveAddress, std::size_t& index, bool& broken)
+{
+    std::unique_lock<std::mutex> lock{m_poolMutex};
+    while (true)
+    {
+        auto anyConnected = false;
+        auto found = false;
+
+        // Prefer the connection the slave has been using last, if it is available.
+        const auto lastIt = m_lastConnection.find(slaveAddress);
+        if (lastIt != m_lastConnection.cend() && !m_leased[lastIt->second] && !m_broken[lastIt->second] &&
+            m_clients[lastIt->second]->isConnected())
+        {
+            index = lastIt->second;
+            found = true;
+        }
+
+        for (auto i = std::size_t{0}; i < m_clients.size() && !found; ++i)
+        {
+            if (m_broken[i] || !m_clients[i]->isConnected())
+                continue;
+            anyConnected = true;
+            if (!m_leased[i])
+            {
+                index = i;
+                found = true;
+            }
+        }
+
+        // The connections that failed to reconnect are tried again once none of the others are free.
+        for (auto i = std::size_t{0}; i < m_clients.size() && !found; ++i)
+        {
+            if (!m_broken[i])
+                continue;
+            anyConnected = true;
+            if (!m_leased[i])
+            {
+                index = i;
+                found = true;
+            }
+        }
+
+        if (found)
+        {
+            m_leased[index] = true;
+            broken = m_broken[index];
+            m_lastConnection[slaveAddress] = index;
+            return true;
+        }
+        if (!anyConnected)
+            return false;
+        m_poolCondition.wait(lock);
+    }
+}
+
+bool ModbusClientPool::reconnect(std::size_t index)
+{
+    auto& client = *m_clients[index];
+    client.disconnect();
+    const auto connected = client.connect();
+    if (!connected)
+        LOG(WARN) << "ModbusClientPool: Connection " << index << " failed to reconnect.";
+
+    // The slaves pinned to the connection are free to move to the other ones.
+    std::lock_guard<std::mutex> lock{m_poolMutex};
+    m_broken[index] = !connected;
+    for (auto it = m_lastConnection.begin(); it != m_lastConnection.end();)
+    {
+        if (it->second == index)
+            it = m_lastConnection.erase(it);
+        else
+            ++it;
+    }
+    return connected;
+}
+
+void ModbusClientPool::notifyWaiting()
+{
+    // Taking the lock makes sure no waiter is between checking the clients and starting to wait.
+    {
+        std::lock_guard<std::mutex> lock{m_poolMutex};
+    }
+    m_poolCondition.notify_all();
+}
+
+void ModbusClientPool::release(std::size_t index)
+{
+    {
+        std::lock_guard<std::mutex> lock{m_poolMutex};
+        m_leased[index] = false;
+    }
+    m_poolCondition.notify_one();
+}
+}    // namespace wolkabout::more_modbus
@@ -0,0 +1,164 @@
+/**
+ * Copyright 2023 Wolkabout Technology s.r.o.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef MOREMODBUS_MODBUSCLIENTPOOL_H
+#define MOREMODBUS_MODBUSCLIENTPOOL_H
+
+#include "more_modbus/modbus/ModbusClient.h"
+
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace wolkabout::more_modbus
+{
+/**
+ * @brief ModbusClient implementation that spreads requests over multiple connections.
+ * @details The pool owns N clients (for example N LibModbusTcpIpClient instances towards the same gateway), and
+ *         for every request leases one of the connected clients that is not currently in use. This way the
+ *         per-device threads of the ModbusReader don't serialize on a single connection. A slave is preferably
+ *         handed the same connection it used the last time, so devices tend to stay pinned to a connection.
+ *         A client whose operation failed is disconnected and connected again, and the slaves pinned to it are
+ *         unpinned, as a broken connection can still report being connected.
+ */
+class ModbusClientPool : public ModbusClient
+{
+public:
+    /**
+     * @brief Constructor for the pool.
+     * @param clients the clients the pool will own and hand out. Must contain at least one client.
+     */
+    explicit ModbusClientPool(std::vector<std::unique_ptr<ModbusClient>> clients);
+
+    ~ModbusClientPool() override;
+
+    /**
+     * @return Returns true if at least one of the clients in the pool is connected after the call.
+     */
+    bool connect() override;
+
+    /**
+     * @return Returns true if all of the clients in the pool have been disconnected.
+     */
+    bool disconnect() override;
+
+    /**
+     * @return Returns whether at least one of the clients in the pool is connected.
+     */
+    bool isConnected() override;
+
+    /**
+     * @return The number of clients (connections) owned by the pool.
+     */
+    std::size_t getConnectionCount() const override;
+
+    /**
+     * @return Whether all the clients in the pool pipeline their requests.
+     */
+    bool pipelinesRequests() const override;
+
+    /**
+     * @brief Makes the response timeouts of all the clients in the pool adapt, each to its own connection.
+     * @param floor the shortest timeout a request can get
+     * @param ceiling the longest timeout a request can get
+     */
+    void enableAdaptiveTimeouts(std::chrono::milliseconds floor, std::chrono::milliseconds ceiling) override;
+
+    void disableAdaptiveTimeouts() override;
+
+    /**
+     * @return Whether all the clients in the pool have adaptive timeouts.
+     */
+    bool hasAdaptiveTimeouts() override;
+
+    /**
+     * @param slaveAddress
+     * @param functionCode
+     * @return The response timeout of the client the slave was last handed, or of the first client.
+     */
+    std::chrono::microseconds getResponseTimeout(int slaveAddress, std::uint8_t functionCode) override;
+
+    bool writeHoldingRegister(int slaveAddress, int address, uint16_t value) override;
+
+    bool writeHoldingRegisters(int slaveAddress, int address, std::vector<uint16_t>& values) override;
+
+    bool maskWriteHoldingRegister(int slaveAddress, int address, uint16_t andMask, uint16_t orMask) override;
+
+    bool writeCoil(int slaveAddress, int address, bool value) override;
+
+    bool writeCoils(int slaveAddress, int address, std::vector<bool>& values) override;
+
+    bool readInputContacts(int slaveAddress, int address, int number, std::vector<bool>& values) override;
+
+    bool readInputContacts(int slaveAddress, int address, int number, uint8_t* values) override;
+
+    bool readHoldingRegister(int slaveAddress, int address, uint16_t& value) override;
+
+    bool readHoldingRegisters(int slaveAddress, int address, int number, std::vector<uint16_t>& values) override;
+
+    bool readHoldingRegisters(int slaveAddress, int address, int number, uint16_t* values) override;
+
+    bool readInputRegisters(int slaveAddress, int address, int number, std::vector<uint16_t>& values) override;
+
+    bool readInputRegisters(int slaveAddress, int address, int number, uint16_t* values) override;
+
+    bool readCoil(int slaveAddress, int address, bool& value) override;
+
+    bool readCoils(int slaveAddress, int address, int number, std::vector<bool>& values) override;
+
+    bool readCoils(int slaveAddress, int address, int number, uint8_t* values) override;
+
+    /**
+     * @brief Executes the whole batch on a single leased connection.
+     * @param requests
+     * @return Returns whether all of the reads were successful.
+     */
+    bool readBatch(std::vector<ModbusReadRequest>& requests) override;
+
+private:
+    bool createContext() override;
+    bool destroyContext() override;
+
+    // Executes the operation on a leased client, and returns the client to the pool afterwards.
+    template <typename Operation> bool execute(int slaveAddress, Operation operation);
+
+    // Blocks until a connected client is free. Returns false if none of the clients are connected. `broken` tells
+    // whether the client has to be reconnected first.
+    bool acquire(int slaveAddress, std::size_t& index, bool& broken);
+
+    // Connects the client anew, and unpins the slaves from it. Returns whether the client connected.
+    bool reconnect(std::size_t index);
+
+    void release(std::size_t index);
+
+    void notifyWaiting();
+
+    std::vector<std::unique_ptr<ModbusClient>> m_clients;
+
+    std::mutex m_poolMutex;
+    std::condition_variable m_poolCondition;
+    std::vector<bool> m_leased;
+    std::vector<bool> m_broken;
+    std::map<int, std::size_t> m_lastConnection;
+};
+}    // namespace wolkabout::more_modbus
+
+#endif    // MOREMODBUS_MODBUSCLIENTPOOL_H
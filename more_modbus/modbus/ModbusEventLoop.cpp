@@ -0,0 +1,666 @@
+/**
+ * Copyright 2023 Wolkabout Technology s.r.o.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "more_modbus/modbus/ModbusEventLoop.h"
+
+#include "core/utilities/Logger.h"
+#include "more_modbus/modbus/ModbusGroupReader.h"
+#include "more_modbus/modbus/ModbusTcpCodec.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdexcept>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace wolkabout::legacy;
+
+namespace wolkabout::more_modbus
+{
+namespace
+{
+// The same timeout the libmodbus based clients use while establishing the connection.
+const auto CONNECT_TIMEOUT = std::chrono::milliseconds{2000};
+const auto MIN_RECONNECT_DELAY = std::chrono::seconds{1};
+const auto MAX_RECONNECT_DELAY = std::chrono::seconds{60};
+const auto MAX_EVENTS = 64;
+
+// The epoll data of the wake up event, gateway ids start from 1.
+const auto WAKE_UP_ID = std::uint32_t{0};
+}    // namespace
+
+ModbusEventLoop::ModbusEventLoop()
+: m_epoll(epoll_create1(EPOLL_CLOEXEC))
+, m_wakeUp(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC))
+, m_running(false)
+, m_nextGatewayId(WAKE_UP_ID + 1)
+{
+    if (m_epoll == -1 || m_wakeUp == -1)
+        throw std::runtime_error("ModbusEventLoop: Failed to create the epoll instance.");
+
+    auto event = epoll_event{};
+    event.events = EPOLLIN;
+    event.data.u32 = WAKE_UP_ID;
+    epoll_ctl(m_epoll, EPOLL_CTL_ADD, m_wakeUp, &event);
+}
+
+ModbusEventLoop::~ModbusEventLoop()
+{
+    stop();
+    close(m_wakeUp);
+    close(m_epoll);
+}
+
+ModbusEventLoop::GatewayId ModbusEventLoop::addGateway(const std::string& ipAddress, int port,
+                                                       std::chrono::milliseconds responseTimeout,
+                                                       std::uint16_t windowSize)
+{
+    auto id = GatewayId{};
+    {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        id = m_nextGatewayId++;
+        auto& gateway = m_gateways[id];
+        gateway.ipAddress = ipAddress;
+        gateway.port = port;
+        gateway.responseTimeout = responseTimeout;
+        gateway.windowSize = windowSize > 0 ? windowSize : std::uint16_t{1};
+        gateway.socket = -1;
+        gateway.state = ConnectionState::DISCONNECTED;
+        gateway.reconnectTime = Clock::now();
+        gateway.reconnectDelay = MIN_RECONNECT_DELAY;
+        gateway.nextTransactionId = 0;
+    }
+    wakeUp();
+    return id;
+}
+
+bool ModbusEventLoop::addDevice(GatewayId gateway, const std::shared_ptr<ModbusDevice>& device,
+                                std::chrono::milliseconds readPeriod)
+{
+    if (device == nullptr)
+        return false;
+
+    {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        if (m_gateways.find(gateway) == m_gateways.cend())
+        {
+            LOG(ERROR) << "ModbusEventLoop: Unable to add device '" << device->getName() << "' - Unknown gateway.";
+            return false;
+        }
+        m_devices.emplace_back(PolledDevice{gateway, device, readPeriod, Clock::now(), 0, 0, 0, false, false});
+    }
+    wakeUp();
+    return true;
+}
+
+bool ModbusEventLoop::submitRead(GatewayId gateway, ModbusReadRequest request, ReadCallback callback)
+{
+    auto pdu = ModbusTcpCodec::readPdu(request.function, request.address, request.number);
+    const auto unitId = static_cast<std::uint8_t>(request.slaveAddress);
+    return queueRequest(gateway, Request{unitId, std::move(pdu), std::move(request), std::move(callback), nullptr});
+}
+
+bool ModbusEventLoop::submitWrite(GatewayId gateway, int slaveAddress, int address,
+                                  const std::vector<uint16_t>& values, WriteCallback callback)
+{
+    if (values.empty())
+        return false;
+
+    auto pdu = values.size() == 1 ? ModbusTcpCodec::writeRegisterPdu(address, values.front()) :
+                                    ModbusTcpCodec::writeRegistersPdu(address, values);
+    return queueRequest(gateway, Request{static_cast<std::uint8_t>(slaveAddress), std::move(pdu), {}, nullptr,
+                                         std::move(callback)});
+}
+
+bool ModbusEventLoop::submitWrite(GatewayId gateway, int slaveAddress, int address, bool value,
+                                  WriteCallback callback)
+{
+    return queueRequest(gateway, Request{static_cast<std::uint8_t>(slaveAddress),
+                                         ModbusTcpCodec::writeCoilPdu(address, value), {}, nullptr,
+                                         std::move(callback)});
+}
+
+bool ModbusEventLoop::isConnected(GatewayId gateway)
+{
+    std::lock_guard<std::mutex> lock{m_mutex};
+    const auto it = m_gateways.find(gateway);
+    return it != m_gateways.cend() && it->second.state == ConnectionState::CONNECTED;
+}
+
+bool ModbusEventLoop::start()
+{
+    if (m_running)
+        return true;
+
+    LOG(DEBUG) << "ModbusEventLoop: Starting the event loop.";
+    m_running = true;
+    m_thread = std::unique_ptr<std::thread>(new std::thread(&ModbusEventLoop::run, this));
+    return true;
+}
+
+void ModbusEventLoop::stop()
+{
+    if (!m_running)
+        return;
+
+    LOG(DEBUG) << "ModbusEventLoop: Stopping the event loop.";
+    m_running = false;
+    wakeUp();
+    if (m_thread != nullptr && m_thread->joinable())
+        m_thread->join();
+    m_thread.reset();
+
+    // Everything that was still waiting gets failed.
+    auto completions = std::vector<std::function<void()>>{};
+    {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        for (auto& gateway : m_gateways)
+        {
+            closeGateway(gateway.first, gateway.second);
+            gateway.second.reconnectTime = Clock::now();
+        }
+        completions.swap(m_completions);
+    }
+    for (const auto& completion : completions)
+        completion();
+}
+
+bool ModbusEventLoop::isRunning() const
+{
+    return m_running;
+}
+
+void ModbusEventLoop::run()
+{
+    epoll_event events[MAX_EVENTS];
+    while (m_running)
+    {
+        // Even with nothing scheduled, the loop wakes up every once in a while.
+        auto timeout = std::chrono::milliseconds{1000};
+        {
+            std::lock_guard<std::mutex> lock{m_mutex};
+            const auto wakeUpTime = nextWakeUp();
+            const auto now = Clock::now();
+            if (wakeUpTime <= now)
+                timeout = std::chrono::milliseconds{0};
+            else if (wakeUpTime - now < timeout)
+                timeout = std::chrono::ceil<std::chrono::milliseconds>(wakeUpTime - now);
+        }
+
+        const auto count = epoll_wait(m_epoll, events, MAX_EVENTS, static_cast<int>(timeout.count()));
+        if (count == -1 && errno != EINTR)
+        {
+            LOG(ERROR) << "ModbusEventLoop: Failed to wait for events - " << std::strerror(errno);
+            break;
+        }
+
+        auto completions = std::vector<std::function<void()>>{};
+        {
+            std::lock_guard<std::mutex> lock{m_mutex};
+            for (auto i = 0; i < count; ++i)
+            {
+                const auto id = events[i].data.u32;
+                if (id == WAKE_UP_ID)
+                {
+                    auto value = std::uint64_t{};
+                    while (read(m_wakeUp, &value, sizeof(value)) > 0)
+                        ;
+                    continue;
+                }
+
+                const auto it = m_gateways.find(id);
+                if (it == m_gateways.end())
+                    continue;
+                auto& gateway = it->second;
+                if (gateway.state == ConnectionState::CONNECTING)
+                {
+                    finishConnecting(id, gateway);
+                    continue;
+                }
+                if (gateway.state != ConnectionState::CONNECTED)
+                    continue;
+                if ((events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP)) != 0)
+                    receive(id, gateway);
+                if (gateway.state == ConnectionState::CONNECTED && (events[i].events & EPOLLOUT) != 0)
+                    flushSendBuffer(id, gateway);
+            }
+
+            auto now = Clock::now();
+            for (auto& entry : m_gateways)
+            {
+                auto& gateway = entry.second;
+                if (gateway.state == ConnectionState::DISCONNECTED && gateway.reconnectTime <= now)
+                    startConnecting(entry.first, gateway);
+                else if (gateway.state == ConnectionState::CONNECTING && gateway.connectDeadline <= now)
+                {
+                    LOG(WARN) << "ModbusEventLoop: Timed out connecting to " << gateway.ipAddress << ":"
+                              << gateway.port;
+                    closeGateway(entry.first, gateway);
+                }
+                else if (gateway.state == ConnectionState::CONNECTED)
+                    expireRequests(gateway, now);
+            }
+
+            pollDevices(now);
+
+            for (auto& entry : m_gateways)
+            {
+                if (entry.second.state == ConnectionState::CONNECTED)
+                    fillWindow(entry.first, entry.second, now);
+            }
+            completions.swap(m_completions);
+        }
+
+        // The callbacks are free to submit new requests, so they are called without the lock.
+        for (const auto& completion : completions)
+            completion();
+    }
+}
+
+void ModbusEventLoop::startConnecting(GatewayId id, Gateway& gateway)
+{
+    LOG(INFO) << "ModbusEventLoop: Connecting to " << gateway.ipAddress << ":" << gateway.port;
+    auto hints = addrinfo{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_NUMERICSERV;
+    addrinfo* addresses = nullptr;
+    const auto resolved =
+      getaddrinfo(gateway.ipAddress.c_str(), std::to_string(gateway.port).c_str(), &hints, &addresses);
+    if (resolved != 0 || addresses == nullptr)
+    {
+        LOG(ERROR) << "ModbusEventLoop: Unable to resolve address - " << gai_strerror(resolved);
+        closeGateway(id, gateway);
+        return;
+    }
+
+    gateway.socket =
+      socket(addresses->ai_family, addresses->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC, addresses->ai_protocol);
+    auto connected = -1;
+    if (gateway.socket != -1)
+        connected = connect(gateway.socket, addresses->ai_addr, addresses->ai_addrlen);
+    const auto error = errno;
+    freeaddrinfo(addresses);
+    if (gateway.socket == -1 || (connected != 0 && error != EINPROGRESS))
+    {
+        LOG(ERROR) << "ModbusEventLoop: Unable to connect - " << std::strerror(error);
+        closeGateway(id, gateway);
+        return;
+    }
+
+    auto event = epoll_event{};
+    event.events = EPOLLIN | EPOLLOUT;
+    event.data.u32 = id;
+    epoll_ctl(m_epoll, EPOLL_CTL_ADD, gateway.socket, &event);
+    gateway.state = ConnectionState::CONNECTING;
+    gateway.connectDeadline = Clock::now() + CONNECT_TIMEOUT;
+    if (connected == 0)
+        finishConnecting(id, gateway);
+}
+
+void ModbusEventLoop::finishConnecting(GatewayId id, Gateway& gateway)
+{
+    auto error = 0;
+    auto length = static_cast<socklen_t>(sizeof(error));
+    if (getsockopt(gateway.socket, SOL_SOCKET, SO_ERROR, &error, &length) == -1 || error != 0)
+    {
+        LOG(ERROR) << "ModbusEventLoop: Unable to connect - " << std::strerror(error);
+        closeGateway(id, gateway);
+        return;
+    }
+
+    // Requests are small, and they should leave as soon as they are queued.
+    auto noDelay = 1;
+    setsockopt(gateway.socket, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+
+    LOG(INFO) << "ModbusEventLoop: Connected to " << gateway.ipAddress << ":" << gateway.port;
+    gateway.state = ConnectionState::CONNECTED;
+    gateway.reconnectDelay = MIN_RECONNECT_DELAY;
+    updateEvents(id, gateway);
+}
+
+void ModbusEventLoop::closeGateway(GatewayId id, Gateway& gateway)
+{
+    if (gateway.socket != -1)
+    {
+        LOG(INFO) << "ModbusEventLoop: Disconnecting from " << gateway.ipAddress << ":" << gateway.port;
+        epoll_ctl(m_epoll, EPOLL_CTL_DEL, gateway.socket, nullptr);
+        close(gateway.socket);
+        gateway.socket = -1;
+    }
+
+    // None of the requests can be answered anymore.
+    for (auto& inFlight : gateway.inFlight)
+        failRequest(inFlight.second.request);
+    gateway.inFlight.clear();
+    for (auto& request : gateway.queue)
+        failRequest(request);
+    gateway.queue.clear();
+    gateway.sendBuffer.clear();
+    gateway.receiveBuffer.clear();
+
+    gateway.state = ConnectionState::DISCONNECTED;
+    gateway.reconnectTime = Clock::now() + gateway.reconnectDelay;
+    gateway.reconnectDelay = std::min(gateway.reconnectDelay * 2, MAX_RECONNECT_DELAY);
+    LOG(DEBUG) << "ModbusEventLoop: Gateway " << id << " will reconnect in "
+               << std::chrono::duration_cast<std::chrono::milliseconds>(gateway.reconnectTime - Clock::now()).count()
+               << "ms.";
+}
+
+void ModbusEventLoop::fillWindow(GatewayId id, Gateway& gateway, Clock::time_point now)
+{
+    while (gateway.inFlight.size() < gateway.windowSize && !gateway.queue.empty())
+    {
+        auto transactionId = gateway.nextTransactionId++;
+        while (gateway.inFlight.find(transactionId) != gateway.inFlight.cend())
+            transactionId = gateway.nextTransactionId++;
+
+        auto& request = gateway.queue.front();
+        const auto frame = ModbusTcpCodec::encodeFrame(transactionId, request.unitId, request.pdu);
+        gateway.sendBuffer.insert(gateway.sendBuffer.end(), frame.cbegin(), frame.cend());
+        gateway.inFlight.emplace(transactionId, InFlight{std::move(request), now + gateway.responseTimeout});
+        gateway.queue.pop_front();
+    }
+
+    if (!gateway.sendBuffer.empty())
+        flushSendBuffer(id, gateway);
+}
+
+void ModbusEventLoop::flushSendBuffer(GatewayId id, Gateway& gateway)
+{
+    auto sent = std::size_t{0};
+    while (sent < gateway.sendBuffer.size())
+    {
+        const auto result =
+          send(gateway.socket, gateway.sendBuffer.data() + sent, gateway.sendBuffer.size() - sent, MSG_NOSIGNAL);
+        if (result > 0)
+        {
+            sent += static_cast<std::size_t>(result);
+            continue;
+        }
+        if (result == -1 && errno == EINTR)
+            continue;
+        if (result == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            break;
+
+        LOG(ERROR) << "ModbusEventLoop: Unable to send requests - " << std::strerror(errno);
+        closeGateway(id, gateway);
+        return;
+    }
+
+    gateway.sendBuffer.erase(gateway.sendBuffer.begin(),
+                             gateway.sendBuffer.begin() + static_cast<std::ptrdiff_t>(sent));
+    updateEvents(id, gateway);
+}
+
+void ModbusEventLoop::receive(GatewayId id, Gateway& gateway)
+{
+    std::uint8_t buffer[1024];
+    auto alive = true;
+    while (true)
+    {
+        const auto result = recv(gateway.socket, buffer, sizeof(buffer), 0);
+        if (result > 0)
+        {
+            gateway.receiveBuffer.insert(gateway.receiveBuffer.end(), buffer, buffer + result);
+            continue;
+        }
+        if (result == -1 && errno == EINTR)
+            continue;
+        // Zero means that the other side closed the connection.
+        alive = result == -1 && (errno == EAGAIN || errno == EWOULDBLOCK);
+        break;
+    }
+
+    // Match every complete frame with the request it answers, even if the connection broke after it.
+    auto offset = std::size_t{0};
+    auto& data = gateway.receiveBuffer;
+    while (data.size() - offset >= ModbusTcpCodec::HEADER_SIZE)
+    {
+        auto header = ModbusTcpCodec::Header{};
+        if (!ModbusTcpCodec::decodeHeader(&data[offset], data.size() - offset, header))
+        {
+            LOG(ERROR) << "ModbusEventLoop: Received an invalid frame header from " << gateway.ipAddress << ".";
+            closeGateway(id, gateway);
+            return;
+        }
+
+        const auto frameSize = ModbusTcpCodec::HEADER_SIZE - 1 + header.length;
+        if (data.size() - offset < frameSize)
+            break;
+
+        const auto it = gateway.inFlight.find(header.transactionId);
+        if (it != gateway.inFlight.end() && it->second.request.unitId == header.unitId)
+        {
+            const auto pduStart = data.cbegin() + static_cast<std::ptrdiff_t>(offset + ModbusTcpCodec::HEADER_SIZE);
+            const auto response =
+              std::vector<std::uint8_t>(pduStart, pduStart + static_cast<std::ptrdiff_t>(header.length - 1));
+            completeRequest(it->second.request, response);
+            gateway.inFlight.erase(it);
+        }
+        else
+        {
+            LOG(DEBUG) << "ModbusEventLoop: Discarding response for unknown transaction " << header.transactionId
+                       << ".";
+        }
+        offset += frameSize;
+    }
+    data.erase(data.begin(), data.begin() + static_cast<std::ptrdiff_t>(offset));
+
+    if (!alive)
+    {
+        LOG(WARN) << "ModbusEventLoop: Connection to " << gateway.ipAddress << ":" << gateway.port << " lost.";
+        closeGateway(id, gateway);
+    }
+}
+
+void ModbusEventLoop::expireRequests(Gateway& gateway, Clock::time_point now)
+{
+    for (auto it = gateway.inFlight.begin(); it != gateway.inFlight.end();)
+    {
+        if (it->second.deadline > now)
+        {
+            ++it;
+            continue;
+        }
+
+        // A late response will not match anything and get discarded.
+        LOG(DEBUG) << "ModbusEventLoop: Transaction " << it->first << " on " << gateway.ipAddress << " timed out.";
+        failRequest(it->second.request);
+        it = gateway.inFlight.erase(it);
+    }
+}
+
+void ModbusEventLoop::failRequest(Request& request)
+{
+    if (request.onRead)
+    {
+        request.read.success = false;
+        m_completions.emplace_back([callback = std::move(request.onRead), read = std::move(request.read)] {
+            callback(read);
+        });
+    }
+    else if (request.onWrite)
+    {
+        m_completions.emplace_back([callback = std::move(request.onWrite)] { callback(false); });
+    }
+}
+
+void ModbusEventLoop::completeRequest(Request& request, const std::vector<std::uint8_t>& response)
+{
+    if (request.onRead)
+    {
+        auto& result = request.read;
+        result.registers.clear();
+        result.bits.clear();
+        if (result.function == ModbusReadFunction::READ_COILS ||
+            result.function == ModbusReadFunction::READ_DISCRETE_INPUTS)
+            result.success = ModbusTcpCodec::decodeBits(result.function, result.number, response, result.bits);
+        else
+            result.success =
+              ModbusTcpCodec::decodeRegisters(result.function, result.number, response, result.registers);
+
+        m_completions.emplace_back([callback = std::move(request.onRead), read = std::move(request.read)] {
+            callback(read);
+        });
+    }
+    else if (request.onWrite)
+    {
+        const auto success = ModbusTcpCodec::checkWriteResponse(request.pdu, response);
+        m_completions.emplace_back([callback = std::move(request.onWrite), success] { callback(success); });
+    }
+}
+
+void ModbusEventLoop::pollDevices(Clock::time_point now)
+{
+    for (auto index = std::size_t{0}; index < m_devices.size(); ++index)
+    {
+        auto& polled = m_devices[index];
+        if (polled.pendingGroups > 0 || polled.nextRead > now)
+            continue;
+
+        // Keep the reads on the period grid, unless the device fell behind by more than a period.
+        polled.nextRead += polled.readPeriod;
+        if (polled.nextRead <= now)
+            polled.nextRead = now + polled.readPeriod;
+
+        auto& gateway = m_gateways[polled.gateway];
+        if (gateway.state != ConnectionState::CONNECTED)
+        {
+            if (polled.status || !polled.statusReported)
+            {
+                polled.status = false;
+                polled.statusReported = true;
+                m_completions.emplace_back([device = polled.device] { device->triggerOnStatusChange(false); });
+            }
+            continue;
+        }
+
+        polled.submittedGroups = 0;
+        polled.failedGroups = 0;
+        for (const auto& group : polled.device->getGroups())
+        {
+            auto read = ModbusReadRequest{};
+            if (group->isReadRestricted() || !ModbusGroupReader::createReadRequest(*group, read))
+                continue;
+
+            auto pdu = ModbusTcpCodec::readPdu(read.function, read.address, read.number);
+            auto callback = [this, index, group](const ModbusReadRequest& result) {
+                onGroupRead(index, *group, result);
+            };
+            gateway.queue.emplace_back(Request{static_cast<std::uint8_t>(read.slaveAddress), std::move(pdu),
+                                               std::move(read), std::move(callback), nullptr});
+            ++polled.submittedGroups;
+        }
+        polled.pendingGroups = polled.submittedGroups;
+    }
+}
+
+void ModbusEventLoop::onGroupRead(std::size_t deviceIndex, RegisterGroup& group, const ModbusReadRequest& request)
+{
+    // Passing the values triggers the device callbacks, so it happens outside of the lock.
+    const auto success = ModbusGroupReader::processReadRequest(group, request);
+
+    auto device = std::shared_ptr<ModbusDevice>{};
+    auto status = false;
+    {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        auto& polled = m_devices[deviceIndex];
+        if (!success)
+            ++polled.failedGroups;
+        if (polled.pendingGroups == 0 || --polled.pendingGroups > 0)
+            return;
+
+        // If all the groups had error while reading, report the device as having errors.
+        status = polled.failedGroups != polled.submittedGroups;
+        if (polled.status == status && polled.statusReported)
+            return;
+        polled.status = status;
+        polled.statusReported = true;
+        device = polled.device;
+    }
+
+    LOG(INFO) << "DeviceStatus: '" << device->getName() << "': " << status;
+    device->triggerOnStatusChange(status);
+}
+
+void ModbusEventLoop::updateEvents(GatewayId id, Gateway& gateway)
+{
+    auto event = epoll_event{};
+    event.events = EPOLLIN;
+    if (gateway.state == ConnectionState::CONNECTING || !gateway.sendBuffer.empty())
+        event.events |= EPOLLOUT;
+    event.data.u32 = id;
+    epoll_ctl(m_epoll, EPOLL_CTL_MOD, gateway.socket, &event);
+}
+
+ModbusEventLoop::Clock::time_point ModbusEventLoop::nextWakeUp() const
+{
+    auto wakeUp = Clock::time_point::max();
+    for (const auto& entry : m_gateways)
+    {
+        const auto& gateway = entry.second;
+        switch (gateway.state)
+        {
+        case ConnectionState::DISCONNECTED:
+            wakeUp = std::min(wakeUp, gateway.reconnectTime);
+            break;
+        case ConnectionState::CONNECTING:
+            wakeUp = std::min(wakeUp, gateway.connectDeadline);
+            break;
+        case ConnectionState::CONNECTED:
+            for (const auto& inFlight : gateway.inFlight)
+                wakeUp = std::min(wakeUp, inFlight.second.deadline);
+            break;
+        }
+    }
+
+    for (const auto& polled : m_devices)
+    {
+        if (polled.pendingGroups == 0)
+            wakeUp = std::min(wakeUp, polled.nextRead);
+    }
+    return wakeUp;
+}
+
+bool ModbusEventLoop::queueRequest(GatewayId gateway, Request request)
+{
+    {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        const auto it = m_gateways.find(gateway);
+        if (!m_running || it == m_gateways.end() || it->second.state == ConnectionState::DISCONNECTED)
+            return false;
+        it->second.queue.emplace_back(std::move(request));
+    }
+    wakeUp();
+    return true;
+}
+
+void ModbusEventLoop::wakeUp()
+{
+    const auto value = std::uint64_t{1};
+    if (write(m_wakeUp, &value, sizeof(value)) == -1)
+        LOG(TRACE) << "ModbusEventLoop: Unable to wake up the loop - " << std::strerror(errno);
+}
+}    // namespace wolkabout::more_modbus
@@ -0,0 +1,227 @@
+/**
+ * Copyright 2023 Wolkabout Technology s.r.o.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef MOREMODBUS_MODBUSEVENTLOOP_H
+#define MOREMODBUS_MODBUSEVENTLOOP_H
+
+#include "more_modbus/ModbusDevice.h"
+#include "more_modbus/modbus/ModbusClient.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace wolkabout::more_modbus
+{
+/**
+ * @brief Polls devices behind many Modbus/TCP gateways using a single thread.
+ * @details Every gateway is a non-blocking socket registered with one epoll instance. Connecting, sending requests,
+ *         receiving responses, response timeouts and reconnecting are all driven by the loop thread, so the number
+ *         of threads doesn't grow with the number of gateways or devices. Each gateway can have up to `windowSize`
+ *         requests in flight, matched by the transaction id. Devices added to the loop are read every read period,
+ *         and their values are passed to the groups the same way the ModbusReader does it. The device callbacks are
+ *         executed on the loop thread, so they should not block.
+ */
+class ModbusEventLoop
+{
+public:
+    using GatewayId = std::uint32_t;
+    using ReadCallback = std::function<void(const ModbusReadRequest&)>;
+    using WriteCallback = std::function<void(bool)>;
+
+    ModbusEventLoop();
+
+    virtual ~ModbusEventLoop();
+
+    /**
+     * @brief Adds a gateway the loop will connect to once started.
+     * @param ipAddress of the modbus server
+     * @param port of the modbus server
+     * @param responseTimeout the time each request has to receive its response
+     * @param windowSize the maximum number of requests in flight at the same time
+     * @return The id used to refer to the gateway.
+     */
+    GatewayId addGateway(const std::string& ipAddress, int port, std::chrono::milliseconds responseTimeout,
+                         std::uint16_t windowSize = 8);
+
+    /**
+     * @brief Adds a device the loop will read through the gateway.
+     * @param gateway the id returned by addGateway()
+     * @param device
+     * @param readPeriod the period between two reads of the device
+     * @return Whether the gateway exists.
+     */
+    bool addDevice(GatewayId gateway, const std::shared_ptr<ModbusDevice>& device,
+                   std::chrono::milliseconds readPeriod);
+
+    /**
+     * @brief Queues a read on the gateway. The callback is called from the loop thread once the read completes.
+     * @details Requests are accepted only while the loop is running, and the gateway is connected or connecting.
+     * @param gateway
+     * @param request
+     * @param callback
+     * @return Whether the request has been queued.
+     */
+    bool submitRead(GatewayId gateway, ModbusReadRequest request, ReadCallback callback);
+
+    /**
+     * @brief Queues a write of HOLDING REGISTERS on the gateway. A single value is written using function 6,
+     *       multiple values using function 16.
+     * @param gateway
+     * @param slaveAddress
+     * @param address
+     * @param values
+     * @param callback called from the loop thread with the result of the write
+     * @return Whether the request has been queued.
+     */
+    bool submitWrite(GatewayId gateway, int slaveAddress, int address, const std::vector<uint16_t>& values,
+                     WriteCallback callback);
+
+    /**
+     * @brief Queues a write of a COIL on the gateway, using function 5.
+     * @param gateway
+     * @param slaveAddress
+     * @param address
+     * @param value
+     * @param callback called from the loop thread with the result of the write
+     * @return Whether the request has been queued.
+     */
+    bool submitWrite(GatewayId gateway, int slaveAddress, int address, bool value, WriteCallback callback);
+
+    /**
+     * @param gateway
+     * @return Whether the gateway is connected.
+     */
+    bool isConnected(GatewayId gateway);
+
+    /**
+     * @brief Starts the loop thread.
+     * @return Whether the loop is running.
+     */
+    bool start();
+
+    void stop();
+
+    bool isRunning() const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    enum class ConnectionState
+    {
+        DISCONNECTED,
+        CONNECTING,
+        CONNECTED
+    };
+
+    struct Request
+    {
+        std::uint8_t unitId;
+        std::vector<std::uint8_t> pdu;
+        // Exactly one of the callbacks is set, depending on the type of the request.
+        ModbusReadRequest read;
+        ReadCallback onRead;
+        WriteCallback onWrite;
+    };
+
+    struct InFlight
+    {
+        Request request;
+        Clock::time_point deadline;
+    };
+
+    struct Gateway
+    {
+        std::string ipAddress;
+        int port;
+        std::chrono::milliseconds responseTimeout;
+        std::uint16_t windowSize;
+
+        int socket;
+        ConnectionState state;
+        Clock::time_point connectDeadline;
+        Clock::time_point reconnectTime;
+        std::chrono::seconds reconnectDelay;
+
+        std::uint16_t nextTransactionId;
+        std::deque<Request> queue;
+        std::map<std::uint16_t, InFlight> inFlight;
+        std::vector<std::uint8_t> sendBuffer;
+        std::vector<std::uint8_t> receiveBuffer;
+    };
+
+    struct PolledDevice
+    {
+        GatewayId gateway;
+        std::shared_ptr<ModbusDevice> device;
+        std::chrono::milliseconds readPeriod;
+        Clock::time_point nextRead;
+
+        std::size_t submittedGroups;
+        std::size_t pendingGroups;
+        std::size_t failedGroups;
+        bool status;
+        bool statusReported;
+    };
+
+    void run();
+
+    // All of the following are called from the loop thread, with m_mutex locked.
+    void startConnecting(GatewayId id, Gateway& gateway);
+    void finishConnecting(GatewayId id, Gateway& gateway);
+    void closeGateway(GatewayId id, Gateway& gateway);
+    void fillWindow(GatewayId id, Gateway& gateway, Clock::time_point now);
+    void flushSendBuffer(GatewayId id, Gateway& gateway);
+    void receive(GatewayId id, Gateway& gateway);
+    void expireRequests(Gateway& gateway, Clock::time_point now);
+    void failRequest(Request& request);
+    void completeRequest(Request& request, const std::vector<std::uint8_t>& response);
+    void pollDevices(Clock::time_point now);
+    void updateEvents(GatewayId id, Gateway& gateway);
+    Clock::time_point nextWakeUp() const;
+
+    // Called from the completions, without the lock.
+    void onGroupRead(std::size_t deviceIndex, RegisterGroup& group, const ModbusReadRequest& request);
+
+    bool queueRequest(GatewayId gateway, Request request);
+    void wakeUp();
+
+    int m_epoll;
+    int m_wakeUp;
+    std::atomic_bool m_running;
+    std::unique_ptr<std::thread> m_thread;
+
+    mutable std::mutex m_mutex;
+    GatewayId m_nextGatewayId;
+    std::map<GatewayId, Gateway> m_gateways;
+    std::vector<PolledDevice> m_devices;
+
+    // Callbacks are collected while m_mutex is locked, and executed after it is released.
+    std::vector<std::function<void()>> m_completions;
+};
+}    // namespace wolkabout::more_modbus
+
+#endif    // MOREMODBUS_MODBUSEVENTLOOP_H
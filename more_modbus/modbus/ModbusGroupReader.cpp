@@ -20,7 +20,13 @@
 
 #include "core/utilities/Logger.h"
 #include "more_modbus/ModbusReader.h"
-#include "more_modbus/utilities/DataParsers.h"
+#include "more_modbus/mappings/FloatMapping.h"
+#include "more_modbus/mappings/Int32Mapping.h"
+#include "more_modbus/mappings/UInt32Mapping.h"
+#include "more_modbus/utilities/WordDiff.h"
+
+#include <stdexcept>
+#include <type_traits>
 
 using namespace wolkabout::legacy;
 
@@ -46,11 +52,115 @@ bool ModbusGroupReader::readGroup(ModbusClient& modbusClient, RegisterGroup& gro
     }
 }
 
+std::size_t ModbusGroupReader::readGroups(ModbusClient& modbusClient,
+                                          const std::vector<std::shared_ptr<RegisterGroup>>& groups)
+{
+    return readGroups([&](std::vector<ModbusReadRequest>& requests) { modbusClient.readBatch(requests); }, groups);
+}
+
+std::size_t ModbusGroupReader::readGroups(const std::function<void(std::vector<ModbusReadRequest>&)>& readBatch,
+                                          const std::vector<std::shared_ptr<RegisterGroup>>& groups)
+{
+    // Reused by every call made from the same thread, so reading doesn't allocate once they have grown.
+    thread_local auto requests = std::vector<ModbusReadRequest>{};
+    thread_local auto requestGroups = std::vector<RegisterGroup*>{};
+    requests.clear();
+    requestGroups.clear();
+
+    auto unreadGroups = std::size_t{0};
+    for (const auto& group : groups)
+    {
+        if (group->isReadRestricted())
+            continue;
+
+        requests.emplace_back();
+        if (!createReadRequest(*group, requests.back()))
+        {
+            requests.pop_back();
+            ++unreadGroups;
+            continue;
+        }
+        requests.back().registerBuffer = group->getRegisterBuffer();
+        requests.back().bitBuffer = group->getBitBuffer();
+        requestGroups.emplace_back(group.get());
+    }
+    if (requests.empty())
+        return unreadGroups;
+
+    readBatch(requests);
+    for (auto i = std::size_t{0}; i < requests.size(); ++i)
+    {
+        if (!processReadRequest(*requestGroups[i], requests[i]))
+            ++unreadGroups;
+    }
+    return unreadGroups;
+}
+
+bool ModbusGroupReader::createReadRequest(const RegisterGroup& group, ModbusReadRequest& request)
+{
+    switch (group.getRegisterType())
+    {
+    case RegisterType::COIL:
+        request.function = ModbusReadFunction::READ_COILS;
+        break;
+    case RegisterType::INPUT_CONTACT:
+        request.function = ModbusReadFunction::READ_DISCRETE_INPUTS;
+        break;
+    case RegisterType::INPUT_REGISTER:
+        request.function = ModbusReadFunction::READ_INPUT_REGISTERS;
+        break;
+    case RegisterType::HOLDING_REGISTER:
+        request.function = ModbusReadFunction::READ_HOLDING_REGISTERS;
+        break;
+    default:
+        return false;
+    }
+
+    request.slaveAddress = group.getSlaveAddress();
+    request.address = group.getStartingAddress();
+    request.number = group.getAddressCount();
+    request.registers.clear();
+    request.bits.clear();
+    request.success = false;
+    request.registerBuffer = nullptr;
+    request.bitBuffer = nullptr;
+    return true;
+}
+
+bool ModbusGroupReader::processReadRequest(RegisterGroup& group, const ModbusReadRequest& request)
+{
+    if (!request.success)
+    {
+        LOG(WARN) << "ModbusGroupReader: Unable to read group on device " << group.getSlaveAddress() << ", starting on "
+                  << group.getStartingAddress() << " counting " << group.getAddressCount() << " addresses.";
+        return false;
+    }
+
+    if (request.function == ModbusReadFunction::READ_COILS ||
+        request.function == ModbusReadFunction::READ_DISCRETE_INPUTS)
+    {
+        if (request.bitBuffer != nullptr)
+        {
+            passValuesToGroup(group, request.bitBuffer);
+            return true;
+        }
+
+        const auto bits = group.getBitBuffer();
+        for (auto i = std::size_t{0}; i < request.bits.size() && i < group.getAddressCount(); ++i)
+            bits[i] = request.bits[i] ? 1 : 0;
+        passValuesToGroup(group, bits);
+    }
+    else
+    {
+        passValuesToGroup(group, request.registerBuffer != nullptr ? request.registerBuffer : request.registers.data());
+    }
+    return true;
+}
+
 bool ModbusGroupReader::readCoilGroup(ModbusClient& modbusClient, RegisterGroup& group)
 {
-    std::vector<bool> boolValues;
     if (!modbusClient.readCoils(group.getSlaveAddress(), group.getStartingAddress(), group.getAddressCount(),
-                                boolValues))
+                                group.getBitBuffer()))
     {
         LOG(WARN) << "ModbusGroupReader: Unable to read coil group on device " << group.getSlaveAddress()
                   << ", starting on " << group.getStartingAddress() << " counting " << group.getAddressCount()
@@ -58,15 +168,14 @@ bool ModbusGroupReader::readCoilGroup(ModbusClient& modbusClient, RegisterGroup&
         return false;
     }
 
-    passValuesToGroup(group, boolValues);
+    passValuesToGroup(group, group.getBitBuffer());
     return true;
 }
 
 bool ModbusGroupReader::readDiscreteInputGroup(ModbusClient& modbusClient, RegisterGroup& group)
 {
-    std::vector<bool> boolValues;
     if (!modbusClient.readInputContacts(group.getSlaveAddress(), group.getStartingAddress(), group.getAddressCount(),
-                                        boolValues))
+                                        group.getBitBuffer()))
     {
         LOG(WARN) << "ModbusGroupReader: Unable to read discrete input group on device " << group.getSlaveAddress()
                   << ", starting on " << group.getStartingAddress() << " counting " << group.getAddressCount()
@@ -74,15 +183,14 @@ bool ModbusGroupReader::readDiscreteInputGroup(ModbusClient& modbusClient, Regis
         return false;
     }
 
-    passValuesToGroup(group, boolValues);
+    passValuesToGroup(group, group.getBitBuffer());
     return true;
 }
 
 bool ModbusGroupReader::readHoldingRegisterGroup(ModbusClient& modbusClient, RegisterGroup& group)
 {
-    std::vector<uint16_t> registerValues;
     if (!modbusClient.readHoldingRegisters(group.getSlaveAddress(), group.getStartingAddress(), group.getAddressCount(),
-                                           registerValues))
+                                           group.getRegisterBuffer()))
     {
         LOG(WARN) << "ModbusGroupReader: Unable to read holding register group on device " << group.getSlaveAddress()
                   << ", starting on " << group.getStartingAddress() << " counting " << group.getAddressCount()
@@ -90,15 +198,14 @@ bool ModbusGroupReader::readHoldingRegisterGroup(ModbusClient& modbusClient, Reg
         return false;
     }
 
-    passValuesToGroup(group, registerValues);
+    passValuesToGroup(group, group.getRegisterBuffer());
     return true;
 }
 
 bool ModbusGroupReader::readInputRegisterGroup(ModbusClient& modbusClient, RegisterGroup& group)
 {
-    std::vector<uint16_t> registerValues;
     if (!modbusClient.readInputRegisters(group.getSlaveAddress(), group.getStartingAddress(), group.getAddressCount(),
-                                         registerValues))
+                                         group.getRegisterBuffer()))
     {
         LOG(WARN) << "ModbusGroupReader: Unable to read input register group on device " << group.getSlaveAddress()
                   << ", starting on " << group.getStartingAddress() << " counting " << group.getAddressCount()
@@ -106,98 +213,205 @@ bool ModbusGroupReader::readInputRegisterGroup(ModbusClient& modbusClient, Regis
         return false;
     }
 
-    passValuesToGroup(group, registerValues);
+    passValuesToGroup(group, group.getRegisterBuffer());
     return true;
 }
 
-void ModbusGroupReader::passValuesToGroup(RegisterGroup& group, const std::vector<bool>& values)
+void ModbusGroupReader::passValuesToGroup(RegisterGroup& group, const uint8_t* values)
 {
-    uint32_t i = 0;
-    const auto mappingMap = group.getMappingsMap();
-    for (const auto& mapping : mappingMap)
+    // Taken before the values are passed, so a mapping written in the meantime makes the next read pass them again.
+    const auto generation = group.beginPassingValues();
+
+    // Nothing changed since the last read, only the mappings with a frequency filter might have a held back change.
+    if (group.isSameAsLastRead(values))
     {
-        bool newValue = values[i++];
-        if (mapping.second->doesUpdate(newValue))
-        {
-            mapping.second->update(newValue);
-            if (auto device = group.getDevice().lock())
-                device->triggerOnMappingValueChange(mapping.second, newValue);
-            LOG(INFO) << "ModbusGroupReader: Mapping value changed - Reference: '" << mapping.second->getReference()
-                      << "' Value: '" << mapping.second->getBoolValue() << "'";
-        }
+        group.countRead(passValuesToSteps(group, group.getFilteredDecodePlan(), values));
+        group.rememberRead(generation);
+        return;
     }
+
+    if (auto device = group.getDevice().lock())
+        device->storeRead(group, values);
+    group.countRead(passValuesToSteps(group, group.getDecodePlan(), values));
+    group.rememberRead(generation);
 }
 
-void ModbusGroupReader::passValuesToGroup(RegisterGroup& group, const std::vector<uint16_t>& values)
+void ModbusGroupReader::passValuesToGroup(RegisterGroup& group, const uint16_t* values)
 {
-    const auto claims = group.getMappingsClaims();
-    const auto& mappingsSet = group.getMappings();
-    const auto& mappings =
-      std::vector<std::pair<std::string, std::shared_ptr<RegisterMapping>>>(mappingsSet.begin(), mappingsSet.end());
+    const auto generation = group.beginPassingValues();
+    // The values are stored in the image of the device after they are passed, as the mappings without a filter keep
+    // their value in the image, and compare the values with it.
+    if (!group.hasLastRead())
+    {
+        group.countRead(passValuesToSteps(group, group.getDecodePlan(), values));
+        if (auto device = group.getDevice().lock())
+            device->storeRead(group, values);
+        group.rememberRead(generation);
+        return;
+    }
 
-    uint32_t skipMappings = 0, valueCounter = 0, mappingCounter = 0;
-    for (const auto& mapping : mappings)
+    // Only the mappings of the registers that changed since the last read are looked at, along with the mappings with
+    // a frequency filter, that might have a held back change.
+    thread_local auto changedRegisters = std::vector<std::uint64_t>{};
+    changedRegisters.assign((group.getAddressCount() + std::size_t{63}) / 64, 0);
+    auto changed = passValuesToSteps(group, group.getFilteredDecodePlan(), values);
+    if (group.findChangedRegisters(values, changedRegisters.data()) > 0)
     {
-        if (skipMappings > 0)
-        {
-            ++mappingCounter;
-            --skipMappings;
-            continue;
-        }
+        changed |= passChangedValues(group, changedRegisters, values);
+        if (auto device = group.getDevice().lock())
+            device->storeRead(group, values);
+    }
+    group.countRead(changed);
+    group.rememberRead(generation);
+}
 
-        const auto address = GroupUtility::getAddressFromString(mapping.first);
-        if (mapping.first.find(GroupUtility::SEPARATOR) != std::string::npos)
-        {
-            const auto& bits = DataParsers::separateBits(values[valueCounter++]);
-            uint32_t shift = 0;
-            while (mappingCounter + shift <= group.getMappings().size() - 1 &&
-                   address == GroupUtility::getAddressFromString(claims[mappingCounter + shift]))
-            {
-                if (shift > 0)
-                    skipMappings++;
-
-                const auto bitIndex = GroupUtility::getBitFromString(claims[mappingCounter + shift]);
-                const auto bitValue = bits[static_cast<uint16_t>(bitIndex)];
-
-                const auto& bitMapping = mappings.at(mappingCounter + shift);
-
-                if (bitMapping.second->doesUpdate(bitValue))
-                {
-                    bitMapping.second->update(bitValue);
-                    if (auto device = group.getDevice().lock())
-                        device->triggerOnMappingValueChange(bitMapping.second, bitValue);
-                    LOG(INFO) << "ModbusGroupReader: Mapping value changed - Reference: '"
-                              << bitMapping.second->getReference() << "' Value: '" << bitValue << "'";
-                }
-                ++shift;
-            }
-        }
+bool ModbusGroupReader::passValuesToSteps(RegisterGroup& group, const std::vector<DecodeStep>& steps,
+                                          const uint8_t* values)
+{
+    auto changed = false;
+    for (const auto& step : steps)
+        changed |= passValueToMapping(group, step.mapping, values[step.offset] != 0);
+    return changed;
+}
+
+bool ModbusGroupReader::passValuesToSteps(RegisterGroup& group, const std::vector<DecodeStep>& steps,
+                                          const uint16_t* values)
+{
+    auto changed = false;
+    for (auto index = std::size_t{0}; index < steps.size();)
+    {
+        const auto& step = steps[index];
+        if (step.runLength > 1)
+            changed |= passValuesToRun(group, &step, step.runLength, values);
         else
+            changed |= passValuesToStep(group, step, values);
+        index += step.runLength;
+    }
+    return changed;
+}
+
+bool ModbusGroupReader::passChangedValues(RegisterGroup& group, const std::vector<std::uint64_t>& changedRegisters,
+                                          const uint16_t* values)
+{
+    const auto& steps = group.getDecodePlan();
+    auto changed = false;
+    // The steps are visited in ascending order, so a step of many registers is visited only for the first of them.
+    auto nextStep = std::size_t{0};
+    for (auto word = std::size_t{0}; word < changedRegisters.size(); ++word)
+    {
+        for (auto bits = changedRegisters[word]; bits != 0; bits &= bits - 1)
         {
-            // If the mapping has multiple values, they will get added now, and their loop iterations
-            // will be skipped.
-            std::vector<uint16_t> data;
-            std::string loggingString;
-            for (int i = 0; i < mapping.second->getRegisterCount(); i++)
+            const auto offset = word * 64 + WordDiff::lowestBit(bits);
+            for (const auto index : group.getStepsOfRegister(offset))
             {
-                if (i > 0)
-                    skipMappings++;
+                if (index < nextStep)
+                    continue;
+                nextStep = index + std::size_t{1};
 
-                loggingString.append(std::to_string(values[valueCounter]) + " ");
-                data.emplace_back(values[valueCounter++]);
-            }
-
-            if (mapping.second->doesUpdate(data))
-            {
-                mapping.second->update(data);
-                if (auto device = group.getDevice().lock())
-                    device->triggerOnMappingValueChange(mapping.second, data);
-                LOG(INFO) << "ModbusGroupReader: Mapping value changed - Reference: '" << mapping.second->getReference()
-                          << "' Values: " << loggingString;
+                // The steps with a frequency filter have already been visited.
+                const auto& step = steps[index];
+                if (!step.filtered)
+                    changed |= passValuesToStep(group, step, values);
             }
         }
+    }
+    return changed;
+}
+
+bool ModbusGroupReader::passValuesToStep(RegisterGroup& group, const DecodeStep& step, const uint16_t* values)
+{
+    const auto value = values + step.offset;
+    if (step.decoder == DecodeStep::Decoder::REGISTER_BIT)
+        return passValueToMapping(group, step.mapping, ((*value >> step.bitIndex) & 1) != 0);
+    if (step.decoder != DecodeStep::Decoder::REGISTERS)
+        return passValuesToRun(group, &step, 1, values);
+
+    auto& data = group.getMappingValues();
+    data.assign(value, value + step.wordCount);
+    return passValuesToMapping(group, step.mapping, data);
+}
 
-        ++mappingCounter;
+bool ModbusGroupReader::passValuesToRun(RegisterGroup& group, const DecodeStep* steps, std::size_t count,
+                                        const uint16_t* values)
+{
+    switch (steps->decoder)
+    {
+    case DecodeStep::Decoder::FLOAT:
+        return passDecodedValues<FloatMapping, float>(group, steps, count, values);
+    case DecodeStep::Decoder::INT32:
+        return passDecodedValues<Int32Mapping, int32_t>(group, steps, count, values);
+    case DecodeStep::Decoder::UINT32:
+        return passDecodedValues<UInt32Mapping, uint32_t>(group, steps, count, values);
+    default:
+        throw std::logic_error("ModbusGroupReader: Only the pairs of registers of a run can be parsed at once.");
+    }
+}
+
+template <typename MappingType, typename ValueType>
+bool ModbusGroupReader::passDecodedValues(RegisterGroup& group, const DecodeStep* steps, std::size_t count,
+                                          const uint16_t* values)
+{
+    thread_local auto decoded = std::vector<ValueType>{};
+    decoded.resize(count);
+    const auto registers = values + steps->offset;
+    if constexpr (std::is_same<ValueType, float>::value)
+        DataParsers::registersToFloat(registers, count, steps->wordOrder, decoded.data());
+    else if constexpr (std::is_same<ValueType, int32_t>::value)
+        DataParsers::registersToInt32(registers, count, steps->wordOrder, decoded.data());
+    else
+        DataParsers::registersToUint32(registers, count, steps->wordOrder, decoded.data());
+
+    auto& data = group.getMappingValues();
+    auto changed = false;
+    for (auto index = std::size_t{0}; index < count; ++index)
+    {
+        const auto& step = steps[index];
+        data.assign(values + step.offset, values + step.offset + step.wordCount);
+        if (!step.mapping->doesUpdate(data))
+            continue;
+
+        static_cast<MappingType&>(*step.mapping).updateDecoded(data, decoded[index]);
+        notifyMappingChange(group, step.mapping, data);
+        changed = true;
     }
+    return changed;
+}
+
+bool ModbusGroupReader::passValueToMapping(RegisterGroup& group, const std::shared_ptr<RegisterMapping>& mapping,
+                                           bool value)
+{
+    if (!mapping->doesUpdate(value))
+        return false;
+
+    mapping->update(value);
+    if (auto device = group.getDevice().lock())
+        device->triggerOnMappingValueChange(mapping, value);
+    LOG(INFO) << "ModbusGroupReader: Mapping value changed - Reference: '" << mapping->getReference() << "' Value: '"
+              << mapping->getBoolValue() << "'";
+    return true;
+}
+
+bool ModbusGroupReader::passValuesToMapping(RegisterGroup& group, const std::shared_ptr<RegisterMapping>& mapping,
+                                            const std::vector<uint16_t>& values)
+{
+    if (!mapping->doesUpdate(values))
+        return false;
+
+    mapping->update(values);
+    notifyMappingChange(group, mapping, values);
+    return true;
+}
+
+void ModbusGroupReader::notifyMappingChange(RegisterGroup& group, const std::shared_ptr<RegisterMapping>& mapping,
+                                            const std::vector<uint16_t>& values)
+{
+    if (auto device = group.getDevice().lock())
+        device->triggerOnMappingValueChange(mapping, values);
+
+    std::string loggingString;
+    for (const auto& value : values)
+        loggingString.append(std::to_string(value) + " ");
+    LOG(INFO) << "ModbusGroupReader: Mapping value changed - Reference: '" << mapping->getReference()
+              << "' Values: " << loggingString;
 }
 }    // namespace wolkabout::more_modbus
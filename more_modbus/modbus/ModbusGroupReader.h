@@ -22,10 +22,13 @@
 #include "more_modbus/RegisterGroup.h"
 #include "more_modbus/modbus/ModbusClient.h"
 
+#include <functional>
+
 namespace wolkabout::more_modbus
 {
 /**
  * @brief Collection of utility methods used by ModbusReader to read a group.
+ * @details Groups are read into the buffers they own, so reading them repeatedly doesn't allocate.
  */
 class ModbusGroupReader
 {
@@ -38,6 +41,43 @@ public:
      */
     static bool readGroup(ModbusClient& modbusClient, RegisterGroup& group);
 
+    /**
+     * @brief Reads all the passed groups as a single batch, so clients that support it can have all the requests
+     *        in flight at once. The values are passed to the groups the same way readGroup() does it.
+     * @param modbusClient
+     * @param groups
+     * @return The number of groups that have not been read successfully.
+     */
+    static std::size_t readGroups(ModbusClient& modbusClient,
+                                  const std::vector<std::shared_ptr<RegisterGroup>>& groups);
+
+    /**
+     * @brief Reads all the passed groups as a single batch, executed by the passed function, so the batch can be
+     *        executed on another thread while the values are still passed to the groups on this one.
+     * @param readBatch executes the requests, and returns once they are completed
+     * @param groups
+     * @return The number of groups that have not been read successfully.
+     */
+    static std::size_t readGroups(const std::function<void(std::vector<ModbusReadRequest>&)>& readBatch,
+                                  const std::vector<std::shared_ptr<RegisterGroup>>& groups);
+
+    /**
+     * @brief Creates the request that reads the whole group.
+     * @param group
+     * @param request the request to be filled in
+     * @return Whether the group can be read at all.
+     */
+    static bool createReadRequest(const RegisterGroup& group, ModbusReadRequest& request);
+
+    /**
+     * @brief Passes the values of a completed read request to the group. Used for reads executed asynchronously,
+     *       outside of readGroup()/readGroups().
+     * @param group
+     * @param request
+     * @return Whether the request has been successful.
+     */
+    static bool processReadRequest(RegisterGroup& group, const ModbusReadRequest& request);
+
 private:
     /**
      * @brief Read a group of COIL mappings, and aggregate read values to each mapping, using passValuesToGroup().
@@ -75,18 +115,57 @@ private:
     static bool readInputRegisterGroup(ModbusClient& modbusClient, RegisterGroup& group);
 
     /**
-     * @brief Helping method that aggregates read bool values to each mapping inside a group.
+     * @brief Helping method that aggregates read bit values to each mapping inside a group.
+     * @details When the values are the same as in the last read of the group, only the mappings with a frequency
+     *         filter are looked at.
      * @param group
-     * @param values
+     * @param values one byte per address of the group
      */
-    static void passValuesToGroup(RegisterGroup& group, const std::vector<bool>& values);
+    static void passValuesToGroup(RegisterGroup& group, const uint8_t* values);
 
     /**
      * @brief Helping method that aggregates read uint16_t values to each mapping inside a group.
+     * @details Once the group has been read, only the mappings of the registers that changed since the last read, and
+     *         the mappings with a frequency filter, are looked at.
      * @param group
-     * @param values
+     * @param values one register per address of the group
      */
-    static void passValuesToGroup(RegisterGroup& group, const std::vector<uint16_t>& values);
+    static void passValuesToGroup(RegisterGroup& group, const uint16_t* values);
+
+    // Passes the values of the bit buffer to the mappings of the steps. Returns whether any of them was updated.
+    static bool passValuesToSteps(RegisterGroup& group, const std::vector<DecodeStep>& steps, const uint8_t* values);
+
+    // Passes the values of the register buffer to the mappings of the steps. Returns whether any of them was updated.
+    static bool passValuesToSteps(RegisterGroup& group, const std::vector<DecodeStep>& steps, const uint16_t* values);
+
+    // Passes the values to the mappings of the steps of the changed registers, marked in the mask. Returns whether any
+    // of them was updated.
+    static bool passChangedValues(RegisterGroup& group, const std::vector<std::uint64_t>& changedRegisters,
+                                  const uint16_t* values);
+
+    // Passes the values of the register buffer to the mapping of the step. Returns whether it was updated.
+    static bool passValuesToStep(RegisterGroup& group, const DecodeStep& step, const uint16_t* values);
+
+    // Parses the pairs of registers of the run of steps starting with the step at once, and passes them to their
+    // mappings. Returns whether any of them was updated.
+    static bool passValuesToRun(RegisterGroup& group, const DecodeStep* steps, std::size_t count,
+                                const uint16_t* values);
+
+    // Parses the pairs of registers of the steps, whose mappings are of the type, and passes them to the mappings.
+    template <typename MappingType, typename ValueType>
+    static bool passDecodedValues(RegisterGroup& group, const DecodeStep* steps, std::size_t count,
+                                  const uint16_t* values);
+
+    // Updates the mapping with the value, if it changes it, and notifies the device. Returns whether it was updated.
+    static bool passValueToMapping(RegisterGroup& group, const std::shared_ptr<RegisterMapping>& mapping, bool value);
+
+    // Updates the mapping with the values, if they change it, and notifies the device. Returns whether it was updated.
+    static bool passValuesToMapping(RegisterGroup& group, const std::shared_ptr<RegisterMapping>& mapping,
+                                    const std::vector<uint16_t>& values);
+
+    // Notifies the device and logs the values of the mapping that was updated.
+    static void notifyMappingChange(RegisterGroup& group, const std::shared_ptr<RegisterMapping>& mapping,
+                                    const std::vector<uint16_t>& values);
 };
 }    // namespace wolkabout::more_modbus
 
@@ -0,0 +1,190 @@
+/**
+ * Copyright 2023 Wolkabout Technology s.r.o.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "more_modbus/modbus/ModbusTcpCodec.h"
+
+#include <algorithm>
+
+namespace wolkabout::more_modbus
+{
+namespace
+{
+void appendUint16(std::vector<std::uint8_t>& data, std::uint16_t value)
+{
+    data.emplace_back(static_cast<std::uint8_t>(value >> 8));
+    data.emplace_back(static_cast<std::uint8_t>(value & 0xFF));
+}
+
+std::uint16_t readUint16(const std::uint8_t* data)
+{
+    return static_cast<std::uint16_t>((data[0] << 8) | data[1]);
+}
+}    // namespace
+
+std::vector<std::uint8_t> ModbusTcpCodec::encodeFrame(std::uint16_t transactionId, std::uint8_t unitId,
+                                                      const std::vector<std::uint8_t>& pdu)
+{
+    auto frame = std::vector<std::uint8_t>{};
+    frame.reserve(HEADER_SIZE + pdu.size());
+    appendUint16(frame, transactionId);
+    appendUint16(frame, 0);
+    // The length counts the unit id and the PDU.
+    appendUint16(frame, static_cast<std::uint16_t>(pdu.size() + 1));
+    frame.emplace_back(unitId);
+    frame.insert(frame.end(), pdu.cbegin(), pdu.cend());
+    return frame;
+}
+
+bool ModbusTcpCodec::decodeHeader(const std::uint8_t* data, std::size_t size, Header& header)
+{
+    if (size < HEADER_SIZE)
+        return false;
+
+    header.transactionId = readUint16(data);
+    header.protocolId = readUint16(data + 2);
+    header.length = readUint16(data + 4);
+    header.unitId = data[6];
+    return header.protocolId == 0 && header.length >= 2 && header.length <= MAX_PDU_SIZE + 1;
+}
+
+std::vector<std::uint8_t> ModbusTcpCodec::readPdu(ModbusReadFunction function, int address, int number)
+{
+    auto pdu = std::vector<std::uint8_t>{static_cast<std::uint8_t>(function)};
+    appendUint16(pdu, static_cast<std::uint16_t>(address));
+    appendUint16(pdu, static_cast<std::uint16_t>(number));
+    return pdu;
+}
+
+std::vector<std::uint8_t> ModbusTcpCodec::writeCoilPdu(int address, bool value)
+{
+    auto pdu = std::vector<std::uint8_t>{WRITE_SINGLE_COIL};
+    appendUint16(pdu, static_cast<std::uint16_t>(address));
+    appendUint16(pdu, value ? 0xFF00 : 0x0000);
+    return pdu;
+}
+
+std::vector<std::uint8_t> ModbusTcpCodec::writeCoilsPdu(int address, const std::vector<bool>& values)
+{
+    auto pdu = std::vector<std::uint8_t>{WRITE_MULTIPLE_COILS};
+    appendUint16(pdu, static_cast<std::uint16_t>(address));
+    appendUint16(pdu, static_cast<std::uint16_t>(values.size()));
+    const auto bytes = (values.size() + 7) / 8;
+    pdu.emplace_back(static_cast<std::uint8_t>(bytes));
+    pdu.resize(pdu.size() + bytes, 0);
+    for (auto i = std::size_t{0}; i < values.size(); ++i)
+    {
+        if (values[i])
+            pdu[6 + i / 8] = static_cast<std::uint8_t>(pdu[6 + i / 8] | (1 << (i % 8)));
+    }
+    return pdu;
+}
+
+std::vector<std::uint8_t> ModbusTcpCodec::writeRegisterPdu(int address, std::uint16_t value)
+{
+    auto pdu = std::vector<std::uint8_t>{WRITE_SINGLE_REGISTER};
+    appendUint16(pdu, static_cast<std::uint16_t>(address));
+    appendUint16(pdu, value);
+    return pdu;
+}
+
+std::vector<std::uint8_t> ModbusTcpCodec::writeRegistersPdu(int address, const std::vector<std::uint16_t>& values)
+{
+    auto pdu = std::vector<std::uint8_t>{WRITE_MULTIPLE_REGISTERS};
+    appendUint16(pdu, static_cast<std::uint16_t>(address));
+    appendUint16(pdu, static_cast<std::uint16_t>(values.size()));
+    pdu.emplace_back(static_cast<std::uint8_t>(values.size() * 2));
+    for (const auto& value : values)
+        appendUint16(pdu, value);
+    return pdu;
+}
+
+std::vector<std::uint8_t> ModbusTcpCodec::maskWriteRegisterPdu(int address, std::uint16_t andMask,
+                                                               std::uint16_t orMask)
+{
+    auto pdu = std::vector<std::uint8_t>{MASK_WRITE_REGISTER};
+    appendUint16(pdu, static_cast<std::uint16_t>(address));
+    appendUint16(pdu, andMask);
+    appendUint16(pdu, orMask);
+    return pdu;
+}
+
+bool ModbusTcpCodec::decodeRegisters(ModbusReadFunction function, int number, const std::vector<std::uint8_t>& pdu,
+                                     std::vector<std::uint16_t>& values)
+{
+    const auto size = values.size();
+    values.resize(size + static_cast<std::size_t>(number));
+    if (!decodeRegisters(function, number, pdu, values.data() + size))
+    {
+        values.resize(size);
+        return false;
+    }
+    return true;
+}
+
+bool ModbusTcpCodec::decodeRegisters(ModbusReadFunction function, int number, const std::vector<std::uint8_t>& pdu,
+                                     std::uint16_t* values)
+{
+    const auto byteCount = static_cast<std::size_t>(number) * 2;
+    if (pdu.size() != byteCount + 2 || pdu[0] != static_cast<std::uint8_t>(function) || pdu[1] != byteCount)
+        return false;
+
+    for (auto i = std::size_t{0}; i < byteCount; i += 2)
+        *values++ = readUint16(&pdu[2 + i]);
+    return true;
+}
+
+bool ModbusTcpCodec::decodeBits(ModbusReadFunction function, int number, const std::vector<std::uint8_t>& pdu,
+                                std::vector<bool>& values)
+{
+    const auto byteCount = static_cast<std::size_t>(number / 8 + (number % 8 != 0));
+    if (pdu.size() != byteCount + 2 || pdu[0] != static_cast<std::uint8_t>(function) || pdu[1] != byteCount)
+        return false;
+
+    // The bits are packed starting with the least significant bit of the first byte.
+    values.reserve(values.size() + static_cast<std::size_t>(number));
+    for (auto i = 0; i < number; ++i)
+        values.emplace_back(((pdu[2 + static_cast<std::size_t>(i / 8)] >> (i % 8)) & 0x01) != 0);
+    return true;
+}
+
+bool ModbusTcpCodec::decodeBits(ModbusReadFunction function, int number, const std::vector<std::uint8_t>& pdu,
+                                std::uint8_t* values)
+{
+    const auto byteCount = static_cast<std::size_t>(number / 8 + (number % 8 != 0));
+    if (pdu.size() != byteCount + 2 || pdu[0] != static_cast<std::uint8_t>(function) || pdu[1] != byteCount)
+        return false;
+
+    for (auto i = 0; i < number; ++i)
+        values[i] = static_cast<std::uint8_t>((pdu[2 + static_cast<std::size_t>(i / 8)] >> (i % 8)) & 0x01);
+    return true;
+}
+
+bool ModbusTcpCodec::checkWriteResponse(const std::vector<std::uint8_t>& request,
+                                        const std::vector<std::uint8_t>& response)
+{
+    // Responses to writes echo the function code, the address and the value/quantity, or both masks.
+    const auto echoSize = !request.empty() && request[0] == MASK_WRITE_REGISTER ? std::size_t{7} : std::size_t{5};
+    return request.size() >= echoSize && response.size() == echoSize &&
+           std::equal(response.cbegin(), response.cend(), request.cbegin());
+}
+
+bool ModbusTcpCodec::isException(const std::vector<std::uint8_t>& pdu)
+{
+    return !pdu.empty() && (pdu[0] & EXCEPTION_FLAG) != 0;
+}
+}    // namespace wolkabout::more_modbus
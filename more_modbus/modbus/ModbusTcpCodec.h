@@ -0,0 +1,188 @@
+/**
+ * Copyright 2023 Wolkabout Technology s.r.o.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef MOREMODBUS_MODBUSTCPCODEC_H
+#define MOREMODBUS_MODBUSTCPCODEC_H
+
+#include "more_modbus/modbus/ModbusClient.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace wolkabout::more_modbus
+{
+/**
+ * @brief Collection of utility methods used to encode Modbus/TCP requests and decode their responses,
+ *        without going through libmodbus.
+ * @details A frame consists of the 7 byte MBAP header (transaction id, protocol id, length, unit id)
+ *          followed by the PDU (function code and data). All the fields are big endian.
+ */
+class ModbusTcpCodec
+{
+public:
+    static constexpr std::size_t HEADER_SIZE = 7;
+    static constexpr std::size_t MAX_PDU_SIZE = 253;
+
+    static constexpr std::uint8_t WRITE_SINGLE_COIL = 0x05;
+    static constexpr std::uint8_t WRITE_SINGLE_REGISTER = 0x06;
+    static constexpr std::uint8_t WRITE_MULTIPLE_COILS = 0x0F;
+    static constexpr std::uint8_t WRITE_MULTIPLE_REGISTERS = 0x10;
+    static constexpr std::uint8_t MASK_WRITE_REGISTER = 0x16;
+    static constexpr std::uint8_t EXCEPTION_FLAG = 0x80;
+
+    /**
+     * @brief The decoded MBAP header of a frame.
+     */
+    struct Header
+    {
+        std::uint16_t transactionId;
+        std::uint16_t protocolId;
+        std::uint16_t length;
+        std::uint8_t unitId;
+    };
+
+    /**
+     * @brief Wraps the PDU into a Modbus/TCP frame.
+     * @param transactionId the id the response will be matched by
+     * @param unitId the slave address
+     * @param pdu
+     * @return The encoded frame.
+     */
+    static std::vector<std::uint8_t> encodeFrame(std::uint16_t transactionId, std::uint8_t unitId,
+                                                 const std::vector<std::uint8_t>& pdu);
+
+    /**
+     * @brief Decodes the MBAP header at the start of the data.
+     * @param data
+     * @param size the number of available bytes, must be at least HEADER_SIZE
+     * @param header the decoded header
+     * @return Whether the header is valid. The frame is HEADER_SIZE - 1 + header.length bytes long.
+     */
+    static bool decodeHeader(const std::uint8_t* data, std::size_t size, Header& header);
+
+    /**
+     * @brief Creates the PDU for one of the read functions (1-4).
+     * @param function
+     * @param address
+     * @param number
+     * @return The encoded PDU.
+     */
+    static std::vector<std::uint8_t> readPdu(ModbusReadFunction function, int address, int number);
+
+    /**
+     * @brief Creates the PDU for writing a single coil (function 5).
+     * @param address
+     * @param value
+     * @return The encoded PDU.
+     */
+    static std::vector<std::uint8_t> writeCoilPdu(int address, bool value);
+
+    /**
+     * @brief Creates the PDU for writing multiple coils (function 15).
+     * @param address
+     * @param values
+     * @return The encoded PDU.
+     */
+    static std::vector<std::uint8_t> writeCoilsPdu(int address, const std::vector<bool>& values);
+
+    /**
+     * @brief Creates the PDU for writing a single holding register (function 6).
+     * @param address
+     * @param value
+     * @return The encoded PDU.
+     */
+    static std::vector<std::uint8_t> writeRegisterPdu(int address, std::uint16_t value);
+
+    /**
+     * @brief Creates the PDU for writing multiple holding registers (function 16).
+     * @param address
+     * @param values
+     * @return The encoded PDU.
+     */
+    static std::vector<std::uint8_t> writeRegistersPdu(int address, const std::vector<std::uint16_t>& values);
+
+    /**
+     * @brief Creates the PDU for modifying the bits of a single holding register (function 22).
+     * @param address
+     * @param andMask
+     * @param orMask
+     * @return The encoded PDU.
+     */
+    static std::vector<std::uint8_t> maskWriteRegisterPdu(int address, std::uint16_t andMask, std::uint16_t orMask);
+
+    /**
+     * @brief Decodes the register values out of the response PDU of a function 3 or 4 request.
+     * @param function the function of the request
+     * @param number the number of registers requested
+     * @param pdu the response PDU
+     * @param values the decoded values are appended here
+     * @return Whether the response is valid for the request.
+     */
+    static bool decodeRegisters(ModbusReadFunction function, int number, const std::vector<std::uint8_t>& pdu,
+                                std::vector<std::uint16_t>& values);
+
+    /**
+     * @brief Decodes the register values out of the response PDU of a function 3 or 4 request into a buffer.
+     * @param function the function of the request
+     * @param number the number of registers requested
+     * @param pdu the response PDU
+     * @param values buffer of at least `number` elements
+     * @return Whether the response is valid for the request.
+     */
+    static bool decodeRegisters(ModbusReadFunction function, int number, const std::vector<std::uint8_t>& pdu,
+                                std::uint16_t* values);
+
+    /**
+     * @brief Decodes the bit values out of the response PDU of a function 1 or 2 request.
+     * @param function the function of the request
+     * @param number the number of bits requested
+     * @param pdu the response PDU
+     * @param values the decoded values are appended here
+     * @return Whether the response is valid for the request.
+     */
+    static bool decodeBits(ModbusReadFunction function, int number, const std::vector<std::uint8_t>& pdu,
+                           std::vector<bool>& values);
+
+    /**
+     * @brief Decodes the bit values out of the response PDU of a function 1 or 2 request into a buffer.
+     * @param function the function of the request
+     * @param number the number of bits requested
+     * @param pdu the response PDU
+     * @param values buffer of at least `number` bytes, every bit is placed in its own byte as 0 or 1
+     * @return Whether the response is valid for the request.
+     */
+    static bool decodeBits(ModbusReadFunction function, int number, const std::vector<std::uint8_t>& pdu,
+                           std::uint8_t* values);
+
+    /**
+     * @brief Checks that the response PDU of a write request (functions 5, 6, 15, 16 and 22) echoes the request.
+     * @param request the request PDU
+     * @param response the response PDU
+     * @return Whether the write has been acknowledged.
+     */
+    static bool checkWriteResponse(const std::vector<std::uint8_t>& request, const std::vector<std::uint8_t>& response);
+
+    /**
+     * @param pdu the response PDU
+     * @return Whether the response is a Modbus exception.
+     */
+    static bool isException(const std::vector<std::uint8_t>& pdu);
+};
+}    // namespace wolkabout::more_modbus
+
+#endif    // MOREMODBUS_MODBUSTCPCODEC_H
@@ -0,0 +1,558 @@
+/**
+ * Copyright 2023 Wolkabout Technology s.r.o.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "more_modbus/modbus/PipelinedTcpIpClient.h"
+
+#include "core/utilities/Logger.h"
+#include "more_modbus/modbus/ModbusTcpCodec.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <map>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <utility>
+
+using namespace wolkabout::legacy;
+
+namespace wolkabout::more_modbus
+{
+namespace
+{
+// The same timeout the libmodbus based clients use while establishing the connection.
+const auto CONNECT_TIMEOUT = std::chrono::milliseconds{2000};
+
+int waitForSocket(int socket, short events, std::chrono::milliseconds timeout)
+{
+    auto descriptor = pollfd{socket, events, 0};
+    auto result = 0;
+    do
+    {
+        result = poll(&descriptor, 1, static_cast<int>(timeout.count()));
+    } while (result == -1 && errno == EINTR);
+    return result;
+}
+}    // namespace
+
+PipelinedTcpIpClient::PipelinedTcpIpClient(std::string ipAddress, int port, std::chrono::milliseconds responseTimeout,
+                                           std::uint16_t windowSize)
+: ModbusClient(responseTimeout)
+, m_ipAddress(std::move(ipAddress))
+, m_port(port)
+, m_windowSize(windowSize > 0 ? windowSize : std::uint16_t{1})
+, m_socket(-1)
+, m_nextTransactionId(0)
+{
+}
+
+PipelinedTcpIpClient::~PipelinedTcpIpClient()
+{
+    destroyContext();
+}
+
+bool PipelinedTcpIpClient::connect()
+{
+    std::lock_guard<decltype(m_modbusMutex)> l{m_modbusMutex};
+    if (m_connected)
+        return true;
+
+    LOG(INFO) << "PipelinedTcpIpClient: Connecting to " << m_ipAddress << ":" << m_port;
+    auto hints = addrinfo{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* addresses = nullptr;
+    const auto resolved = getaddrinfo(m_ipAddress.c_str(), std::to_string(m_port).c_str(), &hints, &addresses);
+    if (resolved != 0)
+    {
+        LOG(ERROR) << "PipelinedTcpIpClient: Unable to resolve address - " << gai_strerror(resolved);
+        return false;
+    }
+
+    // The error of the last address that was tried, errno is overwritten by the cleanup after the loop.
+    auto lastError = 0;
+    for (auto address = addresses; address != nullptr && m_socket == -1; address = address->ai_next)
+    {
+        const auto socket = ::socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+        if (socket == -1)
+        {
+            lastError = errno;
+            continue;
+        }
+
+        // The socket stays non-blocking, all the waiting is done with poll.
+        fcntl(socket, F_SETFL, fcntl(socket, F_GETFL, 0) | O_NONBLOCK);
+        auto connected = ::connect(socket, address->ai_addr, address->ai_addrlen) == 0;
+        lastError = connected ? 0 : errno;
+        if (!connected && lastError == EINPROGRESS)
+        {
+            const auto ready = waitForSocket(socket, POLLOUT, CONNECT_TIMEOUT);
+            if (ready == 1)
+            {
+                auto error = 0;
+                auto length = static_cast<socklen_t>(sizeof(error));
+                lastError = getsockopt(socket, SOL_SOCKET, SO_ERROR, &error, &length) == 0 ? error : errno;
+                connected = lastError == 0;
+            }
+            else
+            {
+                lastError = ready == 0 ? ETIMEDOUT : errno;
+            }
+        }
+
+        if (connected)
+            m_socket = socket;
+        else
+            close(socket);
+    }
+    freeaddrinfo(addresses);
+
+    if (m_socket == -1)
+    {
+        LOG(ERROR) << "PipelinedTcpIpClient: Unable to connect - " << std::strerror(lastError);
+        return false;
+    }
+
+    // Requests are small, and they should leave as soon as they are queued.
+    auto noDelay = 1;
+    setsockopt(m_socket, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+
+    LOG(INFO) << "PipelinedTcpIpClient: Connected successfully.";
+    m_receiveBuffer.clear();
+    m_contextCreated = true;
+    m_connected = true;
+    return true;
+}
+
+bool PipelinedTcpIpClient::disconnect()
+{
+    std::lock_guard<decltype(m_modbusMutex)> l{m_modbusMutex};
+    closeSocket();
+    return true;
+}
+
+bool PipelinedTcpIpClient::isConnected()
+{
+    std::lock_guard<decltype(m_modbusMutex)> l{m_modbusMutex};
+    return m_connected;
+}
+
+bool PipelinedTcpIpClient::pipelinesRequests() const
+{
+    return true;
+}
+
+bool PipelinedTcpIpClient::writeHoldingRegister(int slaveAddress, int address, uint16_t value)
+{
+    return executeWrite(slaveAddress, ModbusTcpCodec::writeRegisterPdu(address, value));
+}
+
+bool PipelinedTcpIpClient::writeHoldingRegisters(int slaveAddress, int address, std::vector<uint16_t>& values)
+{
+    return executeWrite(slaveAddress, ModbusTcpCodec::writeRegistersPdu(address, values));
+}
+
+bool PipelinedTcpIpClient::maskWriteHoldingRegister(int slaveAddress, int address, uint16_t andMask, uint16_t orMask)
+{
+    return executeWrite(slaveAddress, ModbusTcpCodec::maskWriteRegisterPdu(address, andMask, orMask));
+}
+
+bool PipelinedTcpIpClient::writeCoil(int slaveAddress, int address, bool value)
+{
+    return executeWrite(slaveAddress, ModbusTcpCodec::writeCoilPdu(address, value));
+}
+
+bool PipelinedTcpIpClient::writeCoils(int slaveAddress, int address, std::vector<bool>& values)
+{
+    return executeWrite(slaveAddress, ModbusTcpCodec::writeCoilsPdu(address, values));
+}
+
+bool PipelinedTcpIpClient::readInputContacts(int slaveAddress, int address, int number, std::vector<bool>& values)
+{
+    auto requests = std::vector<ModbusReadRequest>{
+      {slaveAddress, ModbusReadFunction::READ_DISCRETE_INPUTS, address, number, {}, {}, false}};
+    if (!readBatch(requests))
+        return false;
+
+    values.insert(values.end(), requests.front().bits.cbegin(), requests.front().bits.cend());
+    return true;
+}
+
+bool PipelinedTcpIpClient::readInputContacts(int slaveAddress, int address, int number, uint8_t* values)
+{
+    auto requests = std::vector<ModbusReadRequest>{
+      {slaveAddress, ModbusReadFunction::READ_DISCRETE_INPUTS, address, number, {}, {}, false}};
+    requests.front().bitBuffer = values;
+    return readBatch(requests);
+}
+
+bool PipelinedTcpIpClient::readHoldingRegister(int slaveAddress, int address, uint16_t& value)
+{
+    auto values = std::vector<uint16_t>{};
+    if (!readHoldingRegisters(slaveAddress, address, 1, values))
+        return false;
+
+    value = values.front();
+    return true;
+}
+
+bool PipelinedTcpIpClient::readHoldingRegisters(int slaveAddress, int address, int number,
+                                                std::vector<uint16_t>& values)
+{
+    auto requests = std::vector<ModbusReadRequest>{
+      {slaveAddress, ModbusReadFunction::READ_HOLDING_REGISTERS, address, number, {}, {}, false}};
+    if (!readBatch(requests))
+        return false;
+
+    values.insert(values.end(), requests.front().registers.cbegin(), requests.front().registers.cend());
+    return true;
+}
+
+bool PipelinedTcpIpClient::readHoldingRegisters(int slaveAddress, int address, int number, uint16_t* values)
+{
+    auto requests = std::vector<ModbusReadRequest>{
+      {slaveAddress, ModbusReadFunction::READ_HOLDING_REGISTERS, address, number, {}, {}, false}};
+    requests.front().registerBuffer = values;
+    return readBatch(requests);
+}
+
+bool PipelinedTcpIpClient::readInputRegisters(int slaveAddress, int address, int number, std::vector<uint16_t>& values)
+{
+    auto requests = std::vector<ModbusReadRequest>{
+      {slaveAddress, ModbusReadFunction::READ_INPUT_REGISTERS, address, number, {}, {}, false}};
+    if (!readBatch(requests))
+        return false;
+
+    values.insert(values.end(), requests.front().registers.cbegin(), requests.front().registers.cend());
+    return true;
+}
+
+bool PipelinedTcpIpClient::readInputRegisters(int slaveAddress, int address, int number, uint16_t* values)
+{
+    auto requests = std::vector<ModbusReadRequest>{
+      {slaveAddress, ModbusReadFunction::READ_INPUT_REGISTERS, address, number, {}, {}, false}};
+    requests.front().registerBuffer = values;
+    return readBatch(requests);
+}
+
+bool PipelinedTcpIpClient::readCoil(int slaveAddress, int address, bool& value)
+{
+    auto values = std::vector<bool>{};
+    if (!readCoils(slaveAddress, address, 1, values))
+        return false;
+
+    value = values.front();
+    return true;
+}
+
+bool PipelinedTcpIpClient::readCoils(int slaveAddress, int address, int number, std::vector<bool>& values)
+{
+    auto requests =
+      std::vector<ModbusReadRequest>{{slaveAddress, ModbusReadFunction::READ_COILS, address, number, {}, {}, false}};
+    if (!readBatch(requests))
+        return false;
+
+    values.insert(values.end(), requests.front().bits.cbegin(), requests.front().bits.cend());
+    return true;
+}
+
+bool PipelinedTcpIpClient::readCoils(int slaveAddress, int address, int number, uint8_t* values)
+{
+    auto requests = std::vector<ModbusReadRequest>{
+      {slaveAddress, ModbusReadFunction::READ_COILS, address, number, {}, {}, false}};
+    requests.front().bitBuffer = values;
+    return readBatch(requests);
+}
+
+bool PipelinedTcpIpClient::readBatch(std::vector<ModbusReadRequest>& requests)
+{
+    std::lock_guard<decltype(m_modbusMutex)> l{m_modbusMutex};
+
+    auto transactions = std::vector<Transaction>{};
+    transactions.reserve(requests.size());
+    for (auto& request : requests)
+    {
+        request.registers.clear();
+        request.bits.clear();
+        request.success = false;
+        const auto unitId = static_cast<std::uint8_t>(request.slaveAddress);
+        auto pdu = ModbusTcpCodec::readPdu(request.function, request.address, request.number);
+        transactions.emplace_back(Transaction{unitId, std::move(pdu), {}, false});
+    }
+    execute(transactions);
+
+    auto success = true;
+    for (auto i = std::size_t{0}; i < requests.size(); ++i)
+    {
+        auto& request = requests[i];
+        const auto& transaction = transactions[i];
+        if (!transaction.completed)
+        {
+            success = false;
+            continue;
+        }
+
+        switch (request.function)
+        {
+        case ModbusReadFunction::READ_COILS:
+        case ModbusReadFunction::READ_DISCRETE_INPUTS:
+            request.success =
+              request.bitBuffer != nullptr ?
+                ModbusTcpCodec::decodeBits(request.function, request.number, transaction.response, request.bitBuffer) :
+                ModbusTcpCodec::decodeBits(request.function, request.number, transaction.response, request.bits);
+            break;
+        case ModbusReadFunction::READ_HOLDING_REGISTERS:
+        case ModbusReadFunction::READ_INPUT_REGISTERS:
+            request.success = request.registerBuffer != nullptr ?
+                                ModbusTcpCodec::decodeRegisters(request.function, request.number,
+                                                                transaction.response, request.registerBuffer) :
+                                ModbusTcpCodec::decodeRegisters(request.function, request.number,
+                                                                transaction.response, request.registers);
+            break;
+        default:
+            break;
+        }
+
+        if (!request.success)
+        {
+            if (ModbusTcpCodec::isException(transaction.response) && transaction.response.size() > 1)
+                LOG(DEBUG) << "PipelinedTcpIpClient: Slave " << request.slaveAddress << " responded with exception "
+                           << static_cast<int>(transaction.response[1]) << ".";
+            else
+                LOG(DEBUG) << "PipelinedTcpIpClient: Invalid response from slave " << request.slaveAddress << ".";
+        }
+        success = request.success && success;
+    }
+    return success;
+}
+
+bool PipelinedTcpIpClient::createContext()
+{
+    // The socket is created when connecting.
+    return true;
+}
+
+bool PipelinedTcpIpClient::destroyContext()
+{
+    std::lock_guard<decltype(m_modbusMutex)> l{m_modbusMutex};
+    closeSocket();
+    m_contextCreated = false;
+    return true;
+}
+
+void PipelinedTcpIpClient::applyTimeouts(std::chrono::microseconds, std::chrono::microseconds) {}
+
+bool PipelinedTcpIpClient::execute(std::vector<Transaction>& transactions)
+{
+    if (!m_connected)
+    {
+        LOG(DEBUG) << "PipelinedTcpIpClient: Unable to execute requests - Not connected.";
+        return false;
+    }
+
+    struct InFlight
+    {
+        std::size_t index;
+        std::chrono::steady_clock::time_point sent;
+        std::chrono::microseconds timeout;
+        std::chrono::steady_clock::time_point deadline;
+    };
+    // Feeds the round trip of a transaction to the adaptive timeouts, its function code is the first byte of the PDU.
+    const auto recordTransaction = [&](const InFlight& transaction, bool success,
+                                       std::chrono::steady_clock::time_point end) {
+        const auto& request = transactions[transaction.index];
+        recordRoundTrip(request.unitId, request.request.front(), success,
+                        std::chrono::duration_cast<std::chrono::microseconds>(end - transaction.sent),
+                        transaction.timeout);
+    };
+    auto inFlight = std::map<std::uint16_t, InFlight>{};
+    auto next = std::size_t{0};
+    auto completed = std::size_t{0};
+
+    while (next < transactions.size() || !inFlight.empty())
+    {
+        // Fill up the window.
+        while (next < transactions.size() && inFlight.size() < m_windowSize)
+        {
+            auto& transaction = transactions[next];
+            transaction.completed = false;
+            transaction.response.clear();
+
+            const auto transactionId = m_nextTransactionId++;
+            if (!sendFrame(ModbusTcpCodec::encodeFrame(transactionId, transaction.unitId, transaction.request)))
+            {
+                LOG(ERROR) << "PipelinedTcpIpClient: Unable to send request - " << std::strerror(errno);
+                closeSocket();
+                return false;
+            }
+            // Each transaction gets the timeout of its slave and function code, when adaptive timeouts are enabled.
+            const auto timeout = getResponseTimeout(transaction.unitId, transaction.request.front());
+            const auto sent = std::chrono::steady_clock::now();
+            inFlight[transactionId] = InFlight{next++, sent, timeout, sent + timeout};
+        }
+
+        // Expire the requests that ran out of time. A late response will not match anything and get discarded.
+        auto now = std::chrono::steady_clock::now();
+        auto earliest = std::chrono::steady_clock::time_point::max();
+        for (auto it = inFlight.begin(); it != inFlight.end();)
+        {
+            if (it->second.deadline <= now)
+            {
+                LOG(DEBUG) << "PipelinedTcpIpClient: Transaction " << it->first << " timed out.";
+                recordTransaction(it->second, false, now);
+                it = inFlight.erase(it);
+                continue;
+            }
+            earliest = std::min(earliest, it->second.deadline);
+            ++it;
+        }
+        if (inFlight.empty())
+            continue;
+
+        // Even if the connection broke, the responses that have arrived before that are still matched.
+        const auto timeout = std::chrono::duration_cast<std::chrono::milliseconds>(earliest - now);
+        const auto alive = receive(timeout + std::chrono::milliseconds{1});
+
+        // Match every complete frame in the buffer with the request it answers.
+        auto offset = std::size_t{0};
+        while (m_receiveBuffer.size() - offset >= ModbusTcpCodec::HEADER_SIZE)
+        {
+            auto header = ModbusTcpCodec::Header{};
+            if (!ModbusTcpCodec::decodeHeader(&m_receiveBuffer[offset], m_receiveBuffer.size() - offset, header))
+            {
+                LOG(ERROR) << "PipelinedTcpIpClient: Received an invalid frame header.";
+                closeSocket();
+                return false;
+            }
+
+            const auto frameSize = ModbusTcpCodec::HEADER_SIZE - 1 + header.length;
+            if (m_receiveBuffer.size() - offset < frameSize)
+                break;
+
+            const auto it = inFlight.find(header.transactionId);
+            if (it != inFlight.end() && transactions[it->second.index].unitId == header.unitId)
+            {
+                auto& transaction = transactions[it->second.index];
+                const auto pduStart = m_receiveBuffer.cbegin() + static_cast<std::ptrdiff_t>(offset) +
+                                      static_cast<std::ptrdiff_t>(ModbusTcpCodec::HEADER_SIZE);
+                transaction.response.assign(pduStart, pduStart + static_cast<std::ptrdiff_t>(header.length - 1));
+                transaction.completed = true;
+                ++completed;
+                recordTransaction(it->second, true, std::chrono::steady_clock::now());
+                inFlight.erase(it);
+            }
+            else
+            {
+                LOG(DEBUG) << "PipelinedTcpIpClient: Discarding response for unknown transaction "
+                           << header.transactionId << ".";
+            }
+            offset += frameSize;
+        }
+        m_receiveBuffer.erase(m_receiveBuffer.begin(), m_receiveBuffer.begin() + static_cast<std::ptrdiff_t>(offset));
+
+        if (!alive)
+        {
+            LOG(ERROR) << "PipelinedTcpIpClient: Connection lost while waiting for responses.";
+            closeSocket();
+            return completed == transactions.size();
+        }
+    }
+
+    return completed == transactions.size();
+}
+
+bool PipelinedTcpIpClient::executeWrite(int slaveAddress, std::vector<std::uint8_t> pdu)
+{
+    std::lock_guard<decltype(m_modbusMutex)> l{m_modbusMutex};
+
+    auto transactions =
+      std::vector<Transaction>{Transaction{static_cast<std::uint8_t>(slaveAddress), std::move(pdu), {}, false}};
+    if (!execute(transactions))
+        return false;
+
+    const auto& transaction = transactions.front();
+    if (!ModbusTcpCodec::checkWriteResponse(transaction.request, transaction.response))
+    {
+        LOG(DEBUG) << "PipelinedTcpIpClient: Write was not acknowledged by slave " << slaveAddress << ".";
+        return false;
+    }
+    return true;
+}
+
+bool PipelinedTcpIpClient::sendFrame(const std::vector<std::uint8_t>& frame)
+{
+    auto sent = std::size_t{0};
+    while (sent < frame.size())
+    {
+        const auto result = send(m_socket, frame.data() + sent, frame.size() - sent, MSG_NOSIGNAL);
+        if (result > 0)
+        {
+            sent += static_cast<std::size_t>(result);
+            continue;
+        }
+        if (result == -1 && errno == EINTR)
+            continue;
+        if (result == -1 && (errno == EAGAIN || errno == EWOULDBLOCK) &&
+            waitForSocket(m_socket, POLLOUT, m_responseTimeout) == 1)
+            continue;
+        return false;
+    }
+    return true;
+}
+
+bool PipelinedTcpIpClient::receive(std::chrono::milliseconds timeout)
+{
+    const auto ready = waitForSocket(m_socket, POLLIN, timeout);
+    if (ready == 0)
+        return true;
+    if (ready == -1)
+        return false;
+
+    std::uint8_t buffer[1024];
+    while (true)
+    {
+        const auto result = recv(m_socket, buffer, sizeof(buffer), 0);
+        if (result > 0)
+        {
+            m_receiveBuffer.insert(m_receiveBuffer.end(), buffer, buffer + result);
+            continue;
+        }
+        if (result == -1 && errno == EINTR)
+            continue;
+        // Zero means that the other side closed the connection.
+        return result == -1 && (errno == EAGAIN || errno == EWOULDBLOCK);
+    }
+}
+
+void PipelinedTcpIpClient::closeSocket()
+{
+    if (m_socket != -1)
+    {
+        LOG(INFO) << "PipelinedTcpIpClient: Disconnecting from " << m_ipAddress << ":" << m_port;
+        close(m_socket);
+        m_socket = -1;
+    }
+    m_receiveBuffer.clear();
+    m_connected = false;
+}
+}    // namespace wolkabout::more_modbus
@@ -0,0 +1,142 @@
+/**
+ * Copyright 2023 Wolkabout Technology s.r.o.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef MOREMODBUS_PIPELINEDTCPIPCLIENT_H
+#define MOREMODBUS_PIPELINEDTCPIPCLIENT_H
+
+#include "more_modbus/modbus/ModbusClient.h"
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace wolkabout::more_modbus
+{
+/**
+ * @brief ModbusClient implementation for Modbus TCP/IP connections that can have multiple requests in flight.
+ * @details Encodes the frames itself instead of going through libmodbus, and matches the responses to the requests
+ *         by the transaction id of the MBAP header. Single calls still wait for their response, but a batch submitted
+ *         through readBatch() keeps up to `windowSize` requests outstanding, so on high latency links the batch
+ *         costs roughly a single round trip per window instead of a round trip per request.
+ *         The server (or gateway) needs to accept multiple outstanding requests, most Modbus/TCP gateways do.
+ */
+class PipelinedTcpIpClient : public ModbusClient
+{
+public:
+    /**
+     * @brief Constructor for the client
+     * @param ipAddress of the modbus server
+     * @param port of the modbus server
+     * @param responseTimeout the time each request has to receive its response, unless adaptive timeouts are enabled
+     * @param windowSize the maximum number of requests in flight at the same time
+     */
+    PipelinedTcpIpClient(std::string ipAddress, int port, std::chrono::milliseconds responseTimeout,
+                         std::uint16_t windowSize = 8);
+
+    ~PipelinedTcpIpClient() override;
+
+    bool connect() override;
+
+    bool disconnect() override;
+
+    bool isConnected() override;
+
+    /**
+     * @return Returns true, the requests of a batch are in flight at the same time.
+     */
+    bool pipelinesRequests() const override;
+
+    bool writeHoldingRegister(int slaveAddress, int address, uint16_t value) override;
+
+    bool writeHoldingRegisters(int slaveAddress, int address, std::vector<uint16_t>& values) override;
+
+    bool maskWriteHoldingRegister(int slaveAddress, int address, uint16_t andMask, uint16_t orMask) override;
+
+    bool writeCoil(int slaveAddress, int address, bool value) override;
+
+    bool writeCoils(int slaveAddress, int address, std::vector<bool>& values) override;
+
+    bool readInputContacts(int slaveAddress, int address, int number, std::vector<bool>& values) override;
+
+    bool readInputContacts(int slaveAddress, int address, int number, uint8_t* values) override;
+
+    bool readHoldingRegister(int slaveAddress, int address, uint16_t& value) override;
+
+    bool readHoldingRegisters(int slaveAddress, int address, int number, std::vector<uint16_t>& values) override;
+
+    bool readHoldingRegisters(int slaveAddress, int address, int number, uint16_t* values) override;
+
+    bool readInputRegisters(int slaveAddress, int address, int number, std::vector<uint16_t>& values) override;
+
+    bool readInputRegisters(int slaveAddress, int address, int number, uint16_t* values) override;
+
+    bool readCoil(int slaveAddress, int address, bool& value) override;
+
+    bool readCoils(int slaveAddress, int address, int number, std::vector<bool>& values) override;
+
+    bool readCoils(int slaveAddress, int address, int number, uint8_t* values) override;
+
+    /**
+     * @brief Submits all the reads at once, keeping up to the window size of them in flight.
+     * @param requests
+     * @return Returns whether all of the reads were successful.
+     */
+    bool readBatch(std::vector<ModbusReadRequest>& requests) override;
+
+private:
+    /**
+     * @brief A single request/response exchange.
+     */
+    struct Transaction
+    {
+        std::uint8_t unitId;
+        std::vector<std::uint8_t> request;
+        std::vector<std::uint8_t> response;
+        bool completed;
+    };
+
+    bool createContext() override;
+    bool destroyContext() override;
+
+    // Each transaction takes its response timeout from the client, so there is no context to apply it to.
+    void applyTimeouts(std::chrono::microseconds responseTimeout, std::chrono::microseconds byteTimeout) override;
+
+    // Sends all the transactions, keeping at most m_windowSize in flight. Returns whether all got a response.
+    bool execute(std::vector<Transaction>& transactions);
+
+    bool executeWrite(int slaveAddress, std::vector<std::uint8_t> pdu);
+
+    bool sendFrame(const std::vector<std::uint8_t>& frame);
+
+    // Receives everything available on the socket within the timeout. Returns false if the connection broke.
+    bool receive(std::chrono::milliseconds timeout);
+
+    void closeSocket();
+
+    std::string m_ipAddress;
+    int m_port;
+    std::uint16_t m_windowSize;
+
+    int m_socket;
+    std::uint16_t m_nextTransactionId;
+    std::vector<std::uint8_t> m_receiveBuffer;
+};
+}    // namespace wolkabout::more_modbus
+
+#endif    // MOREMODBUS_PIPELINEDTCPIPCLIENT_H
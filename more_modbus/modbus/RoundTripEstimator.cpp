@@ -0,0 +1,93 @@
+/**
+ * Copyright 2023 Wolkabout Technology s.r.o.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "more_modbus/modbus/RoundTripEstimator.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace wolkabout::more_modbus
+{
+RoundTripEstimator::RoundTripEstimator(std::chrono::microseconds floor, std::chrono::microseconds ceiling)
+: m_floor(floor), m_ceiling(ceiling)
+{
+    if (m_floor.count() <= 0 || m_ceiling < m_floor)
+        throw std::logic_error("RoundTripEstimator: The floor has to be positive, and not above the ceiling.");
+}
+
+std::chrono::microseconds RoundTripEstimator::getResponseTimeout(int slaveAddress, std::uint8_t functionCode) const
+{
+    const auto it = m_statistics.find({slaveAddress, functionCode});
+    return it != m_statistics.cend() ? it->second.responseTimeout : m_ceiling;
+}
+
+std::chrono::microseconds RoundTripEstimator::getByteTimeout(int slaveAddress, std::uint8_t functionCode) const
+{
+    const auto it = m_statistics.find({slaveAddress, functionCode});
+    if (it == m_statistics.cend())
+        return m_ceiling;
+    return std::min(std::max(it->second.roundTripTimeVariance, m_floor), it->second.responseTimeout);
+}
+
+void RoundTripEstimator::addSample(int slaveAddress, std::uint8_t functionCode,
+                                   std::chrono::microseconds roundTripTime)
+{
+    const auto key = std::make_pair(slaveAddress, functionCode);
+    auto it = m_statistics.find(key);
+    if (it == m_statistics.end())
+    {
+        // The first measurement, SRTT = R, RTTVAR = R / 2.
+        it = m_statistics.emplace(key, Statistics{roundTripTime, roundTripTime / 2, {}}).first;
+    }
+    else
+    {
+        // RTTVAR = 3/4 RTTVAR + 1/4 |SRTT - R|, SRTT = 7/8 SRTT + 1/8 R.
+        auto& statistics = it->second;
+        const auto difference = statistics.smoothedRoundTripTime - roundTripTime;
+        statistics.roundTripTimeVariance =
+          (3 * statistics.roundTripTimeVariance + (difference.count() < 0 ? -difference : difference)) / 4;
+        statistics.smoothedRoundTripTime = (7 * statistics.smoothedRoundTripTime + roundTripTime) / 8;
+    }
+
+    auto& statistics = it->second;
+    statistics.responseTimeout = clamp(statistics.smoothedRoundTripTime + 4 * statistics.roundTripTimeVariance);
+}
+
+void RoundTripEstimator::addTimeout(int slaveAddress, std::uint8_t functionCode)
+{
+    // A slave that never responded is already at the ceiling.
+    const auto it = m_statistics.find({slaveAddress, functionCode});
+    if (it != m_statistics.end())
+        it->second.responseTimeout = clamp(2 * it->second.responseTimeout);
+}
+
+const std::chrono::microseconds& RoundTripEstimator::getFloor() const
+{
+    return m_floor;
+}
+
+const std::chrono::microseconds& RoundTripEstimator::getCeiling() const
+{
+    return m_ceiling;
+}
+
+std::chrono::microseconds RoundTripEstimator::clamp(std::chrono::microseconds timeout) const
+{
+    return std::min(std::max(timeout, m_floor), m_ceiling);
+}
+}    // namespace wolkabout::more_modbus
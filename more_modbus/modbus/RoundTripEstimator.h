@@ -0,0 +1,97 @@
+/**
+ * Copyright 2023 Wolkabout Technology s.r.o.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef MOREMODBUS_ROUNDTRIPESTIMATOR_H
+#define MOREMODBUS_ROUNDTRIPESTIMATOR_H
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <utility>
+
+namespace wolkabout::more_modbus
+{
+/**
+ * @brief Estimates the response timeout for each slave and function code from the measured round trip times.
+ * @details Uses the TCP retransmission timeout estimation (RFC 6298). The smoothed round trip time and its variance
+ *         are kept for each slave and function code, and the timeout is the smoothed time plus four variances, kept
+ *         between the floor and the ceiling. Slaves without any measurements get the ceiling, and every timeout
+ *         doubles the timeout of the slave, so the slaves that stopped responding fail fast, but slow slaves are
+ *         given more time until they respond again. Not thread safe, the client uses it under its own lock.
+ */
+class RoundTripEstimator
+{
+public:
+    /**
+     * @brief Default constructor.
+     * @param floor the shortest timeout that will be estimated
+     * @param ceiling the longest timeout that will be estimated
+     */
+    RoundTripEstimator(std::chrono::microseconds floor, std::chrono::microseconds ceiling);
+
+    /**
+     * @param slaveAddress
+     * @param functionCode
+     * @return The time to wait for the response of the request.
+     */
+    std::chrono::microseconds getResponseTimeout(int slaveAddress, std::uint8_t functionCode) const;
+
+    /**
+     * @param slaveAddress
+     * @param functionCode
+     * @return The time to wait between two bytes of the response, as long as the variance of the round trip time, but
+     *         at least the floor, and at most the response timeout.
+     */
+    std::chrono::microseconds getByteTimeout(int slaveAddress, std::uint8_t functionCode) const;
+
+    /**
+     * @brief Adds a measured round trip time, of a request the slave has responded to.
+     * @param slaveAddress
+     * @param functionCode
+     * @param roundTripTime
+     */
+    void addSample(int slaveAddress, std::uint8_t functionCode, std::chrono::microseconds roundTripTime);
+
+    /**
+     * @brief Reports a request the slave didn't respond to in time, doubling its timeout.
+     * @param slaveAddress
+     * @param functionCode
+     */
+    void addTimeout(int slaveAddress, std::uint8_t functionCode);
+
+    const std::chrono::microseconds& getFloor() const;
+
+    const std::chrono::microseconds& getCeiling() const;
+
+private:
+    struct Statistics
+    {
+        std::chrono::microseconds smoothedRoundTripTime;
+        std::chrono::microseconds roundTripTimeVariance;
+        std::chrono::microseconds responseTimeout;
+    };
+
+    std::chrono::microseconds clamp(std::chrono::microseconds timeout) const;
+
+    std::chrono::microseconds m_floor;
+    std::chrono::microseconds m_ceiling;
+    std::map<std::pair<int, std::uint8_t>, Statistics> m_statistics;
+};
+}    // namespace wolkabout::more_modbus
+
+#endif    // MOREMODBUS_ROUNDTRIPESTIMATOR_H
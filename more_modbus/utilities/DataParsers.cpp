@@ -19,14 +19,101 @@
 #include "more_modbus/utilities/DataParsers.h"
 
 #include <bitset>
+#include <cstring>
 #include <sstream>
 #include <stdexcept>
 #include <string>
 
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && !defined(__ARM_BIG_ENDIAN)
+#include <arm_neon.h>
+#endif
+
 namespace wolkabout
 {
 namespace more_modbus
 {
+namespace
+{
+inline bool swapsWords(DataParsers::WordOrder order)
+{
+    return order == DataParsers::WordOrder::ABCD || order == DataParsers::WordOrder::BADC;
+}
+
+inline bool swapsBytes(DataParsers::WordOrder order)
+{
+    return order == DataParsers::WordOrder::BADC || order == DataParsers::WordOrder::DCBA;
+}
+
+inline uint16_t swapBytes(uint16_t value)
+{
+    return static_cast<uint16_t>((value << 8) | (value >> 8));
+}
+
+inline uint32_t mergeRegisterPair(const uint16_t* pair, DataParsers::WordOrder order)
+{
+    auto first = pair[0], second = pair[1];
+    if (swapsBytes(order))
+    {
+        first = swapBytes(first);
+        second = swapBytes(second);
+    }
+    if (swapsWords(order))
+        return (static_cast<uint32_t>(first) << 16) | second;
+    return (static_cast<uint32_t>(second) << 16) | first;
+}
+
+// Merges the pairs of registers into the 32-bit values, written to the bytes. On a little endian machine, which all
+// of the vectorized ones are, a pair of registers in the low register first order already is the value in memory,
+// so the other orders just swap the registers of each pair, the bytes of each register, or both.
+void mergeRegisters(const uint16_t* registers, std::size_t count, DataParsers::WordOrder order, unsigned char* values)
+{
+    auto index = std::size_t{0};
+#if defined(__AVX2__)
+    // The bytes of each value in memory picked from the bytes of its pair, 8 values at a time.
+    static const int PATTERNS[] = {0x01000302, 0x03020100, 0x00010203, 0x02030001};
+    const auto shuffle =
+      _mm256_add_epi8(_mm256_set1_epi32(PATTERNS[static_cast<int>(order)]),
+                      _mm256_setr_epi8(0, 0, 0, 0, 4, 4, 4, 4, 8, 8, 8, 8, 12, 12, 12, 12, 0, 0, 0, 0, 4, 4, 4, 4, 8,
+                                       8, 8, 8, 12, 12, 12, 12));
+    for (; index + 8 <= count; index += 8)
+    {
+        const auto pairs = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(registers + index * 2));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(values + index * 4), _mm256_shuffle_epi8(pairs, shuffle));
+    }
+#endif
+#if defined(__SSE2__)
+    for (; index + 4 <= count; index += 4)
+    {
+        auto pairs = _mm_loadu_si128(reinterpret_cast<const __m128i*>(registers + index * 2));
+        if (swapsWords(order))
+            pairs = _mm_shufflehi_epi16(_mm_shufflelo_epi16(pairs, 0xB1), 0xB1);
+        if (swapsBytes(order))
+            pairs = _mm_or_si128(_mm_slli_epi16(pairs, 8), _mm_srli_epi16(pairs, 8));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(values + index * 4), pairs);
+    }
+#elif defined(__ARM_NEON) && !defined(__ARM_BIG_ENDIAN)
+    for (; index + 4 <= count; index += 4)
+    {
+        auto pairs = vld1q_u16(registers + index * 2);
+        if (swapsWords(order))
+            pairs = vrev32q_u16(pairs);
+        if (swapsBytes(order))
+            pairs = vreinterpretq_u16_u8(vrev16q_u8(vreinterpretq_u8_u16(pairs)));
+        vst1q_u8(values + index * 4, vreinterpretq_u8_u16(pairs));
+    }
+#endif
+    for (; index < count; ++index)
+    {
+        const auto value = mergeRegisterPair(registers + index * 2, order);
+        std::memcpy(values + index * 4, &value, sizeof(value));
+    }
+}
+}    // namespace
+
 uint8_t DataParsers::MAX_UINT8 = 255;
 uint8_t DataParsers::SHIFT_UINT8 = 8;
 uint16_t DataParsers::MAX_UINT16 = 65535;
@@ -141,8 +228,9 @@ uint32_t DataParsers::registersToUint32(const std::vector<uint16_t>& value, Data
     if (value.size() != 2)
         throw std::logic_error("DataParsers: You must pass exactly 2 values to parse into an UInt32.");
 
-    uint8_t bigValue = (endian == DataParsers::Endian::BIG), smallValue = !bigValue;
-    return static_cast<uint32_t>((value[bigValue] << SHIFT_UINT16) + value[smallValue]);
+    auto parsed = uint32_t{0};
+    registersToUint32(value.data(), 1, endian == Endian::BIG ? WordOrder::CDAB : WordOrder::ABCD, &parsed);
+    return parsed;
 }
 
 float DataParsers::registersToFloat(const std::vector<uint16_t>& value, DataParsers::Endian endian)
@@ -150,22 +238,25 @@ float DataParsers::registersToFloat(const std::vector<uint16_t>& value, DataPars
     if (value.size() != 2)
         throw std::logic_error("DataParsers: You must pass exactly 2 values to parse into an Float.");
 
-    std::bitset<32> newBits(0);
-    if (endian == Endian::BIG)
-    {
-        newBits = newBits | std::bitset<32>(value[0]);
-        newBits <<= 16;
-        newBits = newBits | std::bitset<32>(value[1]);
-    }
-    else
-    {
-        newBits = newBits | std::bitset<32>(value[1]);
-        newBits <<= 16;
-        newBits = newBits | std::bitset<32>(value[0]);
-    }
+    auto parsed = 0.0f;
+    registersToFloat(value.data(), 1, endian == Endian::BIG ? WordOrder::ABCD : WordOrder::CDAB, &parsed);
+    return parsed;
+}
+
+void DataParsers::registersToUint32(const uint16_t* registers, std::size_t count, WordOrder order, uint32_t* values)
+{
+    mergeRegisters(registers, count, order, reinterpret_cast<unsigned char*>(values));
+}
 
-    auto newValue = newBits.to_ullong();
-    return *reinterpret_cast<float*>(&newValue);
+void DataParsers::registersToInt32(const uint16_t* registers, std::size_t count, WordOrder order, int32_t* values)
+{
+    mergeRegisters(registers, count, order, reinterpret_cast<unsigned char*>(values));
+}
+
+void DataParsers::registersToFloat(const uint16_t* registers, std::size_t count, WordOrder order, float* values)
+{
+    static_assert(sizeof(float) == sizeof(uint32_t), "The floats have to be 32 bits wide.");
+    mergeRegisters(registers, count, order, reinterpret_cast<unsigned char*>(values));
 }
 
 int16_t DataParsers::uint16ToInt16(uint16_t value)
@@ -20,6 +20,7 @@
 #define WOLKABOUT_MODBUS_DATAPARSERS_H
 
 #include <bitset>
+#include <cstddef>
 #include <cstdint>
 #include <string>
 #include <vector>
@@ -44,6 +45,22 @@ public:
         LITTLE
     };
 
+    /**
+     * @brief The order of the bytes of a 32-bit value spread over two registers, where A is its highest byte, and the
+     *         first register holds the first two bytes, the first of them as its upper 8 bits.
+     */
+    enum class WordOrder
+    {
+        // The high register first, big endian.
+        ABCD = 0,
+        // The low register first, the word swapped variant.
+        CDAB,
+        // The high register first, with the bytes of each register swapped.
+        BADC,
+        // The low register first, with the bytes of each register swapped, little endian.
+        DCBA
+    };
+
     /**
      * @brief Convert passed string value, where each character can be interpreted as an ASCII character
      *         into an uint16_t vector, where one uint16_t holds two characters, one as first 8 bits,
@@ -132,6 +149,36 @@ public:
      */
     static float registersToFloat(const std::vector<uint16_t>& value, DataParsers::Endian endian);
 
+    /**
+     * @brief Parse pairs of uint16_t values, one after another, to 32 bit Unsigned Integers.
+     * @details The pairs are parsed a block at a time with AVX2, SSE2 or NEON, whichever the library is compiled for.
+     * @param registers count * 2 uint16_t values, most often acquired by reading with modbus client.
+     * @param count the number of values to parse.
+     * @param order the order of the bytes of each value.
+     * @param values count values the parsed values are written to.
+     */
+    static void registersToUint32(const uint16_t* registers, std::size_t count, WordOrder order, uint32_t* values);
+
+    /**
+     * @brief Parse pairs of uint16_t values, one after another, to 32 bit Integers.
+     * @details The pairs are parsed a block at a time with AVX2, SSE2 or NEON, whichever the library is compiled for.
+     * @param registers count * 2 uint16_t values, most often acquired by reading with modbus client.
+     * @param count the number of values to parse.
+     * @param order the order of the bytes of each value.
+     * @param values count values the parsed values are written to.
+     */
+    static void registersToInt32(const uint16_t* registers, std::size_t count, WordOrder order, int32_t* values);
+
+    /**
+     * @brief Parse pairs of uint16_t values, one after another, to 32 bit Floats.
+     * @details The pairs are parsed a block at a time with AVX2, SSE2 or NEON, whichever the library is compiled for.
+     * @param registers count * 2 uint16_t values, most often acquired by reading with modbus client.
+     * @param count the number of values to parse.
+     * @param order the order of the bytes of each value.
+     * @param values count values the parsed values are written to.
+     */
+    static void registersToFloat(const uint16_t* registers, std::size_t count, WordOrder order, float* values);
+
     /**
      * @brief Static cast of uint16_t value to int16_t.
      * @param value uint16_t value (0 <=> (2^16 - 1))
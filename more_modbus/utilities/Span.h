@@ -0,0 +1,114 @@
+/**
+ * Copyright 2023 Wolkabout Technology s.r.o.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef MOREMODBUS_SPAN_H
+#define MOREMODBUS_SPAN_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace wolkabout::more_modbus
+{
+/**
+ * @brief Non-owning view of a contiguous block of values.
+ * @details The view is only valid as long as the storage it points to isn't resized or destroyed.
+ */
+template <typename T> class Span
+{
+public:
+    Span() = default;
+
+    Span(T* data, std::size_t size) : m_data(data), m_size(size) {}
+
+    T* data() const { return m_data; }
+
+    std::size_t size() const { return m_size; }
+
+    bool empty() const { return m_size == 0; }
+
+    T& operator[](std::size_t index) const { return m_data[index]; }
+
+    T* begin() const { return m_data; }
+
+    T* end() const { return m_data + m_size; }
+
+    /**
+     * @param offset
+     * @param count
+     * @return The view of the count values starting at the offset, cut to the end of this view.
+     */
+    Span subspan(std::size_t offset, std::size_t count) const
+    {
+        if (offset >= m_size)
+            return {};
+        return {m_data + offset, count < m_size - offset ? count : m_size - offset};
+    }
+
+private:
+    T* m_data = nullptr;
+    std::size_t m_size = 0;
+};
+
+/**
+ * @brief Non-owning view of a block of bits, packed into 64-bit words, starting at any bit of the first word.
+ * @details The view is only valid as long as the storage it points to isn't resized or destroyed.
+ */
+class BitSpan
+{
+public:
+    BitSpan() = default;
+
+    BitSpan(const std::uint64_t* words, std::size_t offset, std::size_t size)
+    : m_words(words), m_offset(offset), m_size(size)
+    {
+    }
+
+    const std::uint64_t* words() const { return m_words; }
+
+    std::size_t offset() const { return m_offset; }
+
+    std::size_t size() const { return m_size; }
+
+    bool empty() const { return m_size == 0; }
+
+    bool operator[](std::size_t index) const
+    {
+        const auto bit = m_offset + index;
+        return ((m_words[bit / 64] >> (bit % 64)) & 1) != 0;
+    }
+
+    /**
+     * @param offset
+     * @param count
+     * @return The view of the count bits starting at the offset, cut to the end of this view.
+     */
+    BitSpan subspan(std::size_t offset, std::size_t count) const
+    {
+        if (offset >= m_size)
+            return {};
+        return {m_words, m_offset + offset, count < m_size - offset ? count : m_size - offset};
+    }
+
+private:
+    const std::uint64_t* m_words = nullptr;
+    std::size_t m_offset = 0;
+    std::size_t m_size = 0;
+};
+}    // namespace wolkabout::more_modbus
+
+#endif    // MOREMODBUS_SPAN_H
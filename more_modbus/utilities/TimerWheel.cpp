@@ -0,0 +1,209 @@
+/**
+ * Copyright 2023 Wolkabout Technology s.r.o.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "more_modbus/utilities/TimerWheel.h"
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+namespace wolkabout::more_modbus
+{
+TimerWheel::TimerWheel(std::chrono::milliseconds resolution, std::size_t slotsPerLevel, std::size_t levels)
+: m_origin(Clock::now())
+, m_resolution(resolution)
+, m_slotsPerLevel(slotsPerLevel)
+, m_currentTick(0)
+, m_levels(levels, std::vector<std::vector<Entry>>(slotsPerLevel))
+, m_levelSizes(levels, 0)
+, m_nextGeneration(0)
+{
+    if (resolution.count() <= 0 || slotsPerLevel < 2 || levels == 0)
+        throw std::logic_error("TimerWheel: The resolution, slots and levels have to be positive.");
+}
+
+void TimerWheel::schedule(TimerId id, Clock::time_point deadline)
+{
+    // The entry of the previous deadline is left behind, and skipped once the wheel reaches it.
+    const auto entry = Entry{id, std::max(toTick(deadline), m_currentTick + 1), m_nextGeneration++};
+    m_timers[id] = entry;
+    insert(entry);
+}
+
+bool TimerWheel::cancel(TimerId id)
+{
+    return m_timers.erase(id) > 0;
+}
+
+bool TimerWheel::isScheduled(TimerId id) const
+{
+    return m_timers.find(id) != m_timers.cend();
+}
+
+std::vector<TimerWheel::TimerId> TimerWheel::advance(Clock::time_point now)
+{
+    auto expired = std::vector<TimerId>{};
+    if (now < m_origin)
+        return expired;
+
+    const auto nowTick = static_cast<std::uint64_t>((now - m_origin) / m_resolution);
+    while (m_currentTick < nowTick)
+    {
+        if (m_timers.empty())
+        {
+            // Only the left behind entries remain, so there is nothing to move through.
+            for (auto level = std::size_t{0}; level < m_levels.size(); ++level)
+            {
+                for (auto& slot : m_levels[level])
+                    slot.clear();
+                m_levelSizes[level] = 0;
+            }
+            m_currentTick = nowTick;
+            break;
+        }
+
+        // Skip the ticks where nothing expires, up to the next time the second level has to be moved down.
+        if (m_levelSizes[0] == 0)
+        {
+            const auto nextCascade = (m_currentTick / m_slotsPerLevel + 1) * m_slotsPerLevel;
+            m_currentTick = std::min(nowTick, nextCascade - 1);
+            if (m_currentTick == nowTick)
+                break;
+        }
+
+        ++m_currentTick;
+        auto width = std::uint64_t{1};
+        for (auto level = std::size_t{1}; level < m_levels.size(); ++level)
+        {
+            width *= m_slotsPerLevel;
+            if (m_currentTick % width != 0)
+                break;
+            cascade(level);
+        }
+
+        auto& slot = m_levels[0][m_currentTick % m_slotsPerLevel];
+        for (const auto& entry : slot)
+        {
+            if (isCurrent(entry))
+            {
+                expired.emplace_back(entry.id);
+                m_timers.erase(entry.id);
+            }
+        }
+        m_levelSizes[0] -= slot.size();
+        slot.clear();
+    }
+    return expired;
+}
+
+TimerWheel::Clock::time_point TimerWheel::nextWakeUp() const
+{
+    if (m_timers.empty())
+        return Clock::time_point::max();
+
+    auto wakeUp = Clock::time_point::max();
+    if (m_levelSizes[0] > 0)
+    {
+        for (auto tick = m_currentTick + 1; tick < m_currentTick + m_slotsPerLevel; ++tick)
+        {
+            if (!m_levels[0][tick % m_slotsPerLevel].empty())
+            {
+                wakeUp = toTime(tick);
+                break;
+            }
+        }
+    }
+
+    for (auto level = std::size_t{1}; level < m_levels.size(); ++level)
+    {
+        if (m_levelSizes[level] > 0)
+        {
+            const auto nextCascade = (m_currentTick / m_slotsPerLevel + 1) * m_slotsPerLevel;
+            return std::min(wakeUp, toTime(nextCascade));
+        }
+    }
+    return wakeUp;
+}
+
+std::size_t TimerWheel::size() const
+{
+    return m_timers.size();
+}
+
+bool TimerWheel::empty() const
+{
+    return m_timers.empty();
+}
+
+void TimerWheel::insert(const Entry& entry)
+{
+    const auto delta = entry.tick - m_currentTick;
+    auto level = std::size_t{0};
+    auto width = std::uint64_t{1};
+    while (level + 1 < m_levels.size() && delta >= width * m_slotsPerLevel)
+    {
+        width *= m_slotsPerLevel;
+        ++level;
+    }
+
+    // Deadlines past the last level wait in its furthest slot.
+    const auto tick = std::min(entry.tick, m_currentTick + width * m_slotsPerLevel - 1);
+    m_levels[level][(tick / width) % m_slotsPerLevel].emplace_back(entry);
+    ++m_levelSizes[level];
+}
+
+void TimerWheel::cascade(std::size_t level)
+{
+    auto width = std::uint64_t{1};
+    for (auto i = std::size_t{0}; i < level; ++i)
+        width *= m_slotsPerLevel;
+
+    auto entries = std::vector<Entry>{};
+    entries.swap(m_levels[level][(m_currentTick / width) % m_slotsPerLevel]);
+    m_levelSizes[level] -= entries.size();
+    for (const auto& entry : entries)
+    {
+        if (isCurrent(entry))
+            insert(entry);
+    }
+}
+
+bool TimerWheel::isCurrent(const Entry& entry) const
+{
+    const auto it = m_timers.find(entry.id);
+    return it != m_timers.cend() && it->second.generation == entry.generation;
+}
+
+std::uint64_t TimerWheel::toTick(Clock::time_point time) const
+{
+    if (time <= m_origin)
+        return 0;
+    if (time >= Clock::time_point::max() - m_resolution)
+        return std::numeric_limits<std::uint64_t>::max() / 2;
+
+    // Rounded up, so the timers never expire before their deadline.
+    const auto elapsed = time - m_origin;
+    const auto ticks = static_cast<std::uint64_t>(elapsed / m_resolution);
+    return elapsed % m_resolution == Clock::duration::zero() ? ticks : ticks + 1;
+}
+
+TimerWheel::Clock::time_point TimerWheel::toTime(std::uint64_t tick) const
+{
+    return m_origin + m_resolution * static_cast<Clock::rep>(tick);
+}
+}    // namespace wolkabout::more_modbus
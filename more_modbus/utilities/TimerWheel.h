@@ -0,0 +1,126 @@
+/**
+ * Copyright 2023 Wolkabout Technology s.r.o.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef MOREMODBUS_TIMERWHEEL_H
+#define MOREMODBUS_TIMERWHEEL_H
+
+#include <chrono>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace wolkabout::more_modbus
+{
+/**
+ * @brief Hierarchical timer wheel, holding the deadlines of many timers identified by a number.
+ * @details Time is divided into ticks of the resolution. The first level has a slot for each of the next
+ *         `slotsPerLevel` ticks, and each next level has slots that are `slotsPerLevel` times longer. Timers are put
+ *         into the slot of the level that covers their deadline, and are moved down a level when the wheel reaches
+ *         their slot, so scheduling and expiring a timer takes constant time, no matter how many there are. Deadlines
+ *         past the last level are kept in its furthest slot until they come close enough. Timers never expire before
+ *         their deadline, but can expire up to a tick after it. Not thread safe.
+ */
+class TimerWheel
+{
+public:
+    using Clock = std::chrono::steady_clock;
+    using TimerId = std::uint64_t;
+
+    /**
+     * @brief Default constructor.
+     * @param resolution the length of a single tick
+     * @param slotsPerLevel the number of slots in every level
+     * @param levels the number of levels
+     */
+    explicit TimerWheel(std::chrono::milliseconds resolution = std::chrono::milliseconds(1),
+                        std::size_t slotsPerLevel = 256, std::size_t levels = 4);
+
+    /**
+     * @brief Schedules the timer, replacing its previous deadline if it is already scheduled.
+     * @param id
+     * @param deadline deadlines in the past expire on the next tick
+     */
+    void schedule(TimerId id, Clock::time_point deadline);
+
+    /**
+     * @param id
+     * @return Whether the timer was scheduled.
+     */
+    bool cancel(TimerId id);
+
+    /**
+     * @param id
+     * @return Whether the timer is scheduled.
+     */
+    bool isScheduled(TimerId id) const;
+
+    /**
+     * @brief Moves the wheel up to the time, and removes the timers that expired.
+     * @param now
+     * @return The timers that expired, in the order of their deadlines, to a tick.
+     */
+    std::vector<TimerId> advance(Clock::time_point now);
+
+    /**
+     * @brief The time the wheel should be advanced at next. It is the deadline of the next timer if it is in the first
+     *       level, otherwise the time the timers of a higher level have to be moved down.
+     * @return The time, or Clock::time_point::max() if there are no timers.
+     */
+    Clock::time_point nextWakeUp() const;
+
+    std::size_t size() const;
+
+    bool empty() const;
+
+private:
+    struct Entry
+    {
+        TimerId id;
+        std::uint64_t tick;
+        // Tells the entries of a rescheduled timer apart, even if they have the same tick.
+        std::uint64_t generation;
+    };
+
+    // Puts the entry into the slot covering its tick, relative to the current tick.
+    void insert(const Entry& entry);
+
+    // Moves the entries of the current slot of the level down to the lower levels.
+    void cascade(std::size_t level);
+
+    // Whether the entry still holds the deadline of its timer, entries of the rescheduled timers are left behind.
+    bool isCurrent(const Entry& entry) const;
+
+    std::uint64_t toTick(Clock::time_point time) const;
+
+    Clock::time_point toTime(std::uint64_t tick) const;
+
+    Clock::time_point m_origin;
+    std::chrono::milliseconds m_resolution;
+    std::size_t m_slotsPerLevel;
+    std::uint64_t m_currentTick;
+
+    // Slots of every level, and the number of entries in each level.
+    std::vector<std::vector<std::vector<Entry>>> m_levels;
+    std::vector<std::size_t> m_levelSizes;
+    // The current entry of each scheduled timer.
+    std::unordered_map<TimerId, Entry> m_timers;
+    std::uint64_t m_nextGeneration;
+};
+}    // namespace wolkabout::more_modbus
+
+#endif    // MOREMODBUS_TIMERWHEEL_H
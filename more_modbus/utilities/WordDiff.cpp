@@ -0,0 +1,139 @@
+/**
+ * Copyright 2023 Wolkabout Technology s.r.o.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "more_modbus/utilities/WordDiff.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace wolkabout::more_modbus
+{
+namespace
+{
+// Marks the registers of a block starting at the index, that is a multiple of the block size, so the block never
+// crosses a word of the mask.
+inline void markBlock(std::uint64_t* mask, std::size_t index, std::uint64_t bits)
+{
+    mask[index / 64] |= bits << (index % 64);
+}
+
+// Marks the registers from the index to the count that differ, one at a time.
+inline void markRemaining(const std::uint16_t* left, const std::uint16_t* right, std::size_t index, std::size_t count,
+                          std::uint64_t* mask)
+{
+    for (; index < count; ++index)
+    {
+        if (left[index] != right[index])
+            mask[index / 64] |= std::uint64_t{1} << (index % 64);
+    }
+}
+
+std::size_t countMask(const std::uint64_t* mask, std::size_t count)
+{
+    auto changed = std::size_t{0};
+    for (auto word = std::size_t{0}; word < (count + 63) / 64; ++word)
+        changed += WordDiff::countBits(mask[word]);
+    return changed;
+}
+}    // namespace
+
+std::size_t WordDiff::compare(const std::uint16_t* left, const std::uint16_t* right, std::size_t count,
+                              std::uint64_t* mask)
+{
+    auto index = std::size_t{0};
+#if defined(__AVX2__)
+    for (; index + 16 <= count; index += 16)
+    {
+        const auto equal =
+          _mm256_cmpeq_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(left + index)),
+                             _mm256_loadu_si256(reinterpret_cast<const __m256i*>(right + index)));
+        // Narrowing the halves to bytes leaves a byte per register, in their order.
+        const auto bytes = _mm_packs_epi16(_mm256_castsi256_si128(equal), _mm256_extracti128_si256(equal, 1));
+        const auto equalBits = static_cast<std::uint32_t>(_mm_movemask_epi8(bytes));
+        markBlock(mask, index, ~equalBits & 0xFFFFu);
+    }
+#endif
+#if defined(__SSE2__)
+    for (; index + 8 <= count; index += 8)
+    {
+        const auto equal = _mm_cmpeq_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(left + index)),
+                                           _mm_loadu_si128(reinterpret_cast<const __m128i*>(right + index)));
+        const auto equalBits = static_cast<std::uint32_t>(_mm_movemask_epi8(_mm_packs_epi16(equal, equal)));
+        markBlock(mask, index, ~equalBits & 0xFFu);
+    }
+#elif defined(__ARM_NEON)
+    static const std::uint16_t weights[8] = {1, 2, 4, 8, 16, 32, 64, 128};
+    const auto weightVector = vld1q_u16(weights);
+    for (; index + 8 <= count; index += 8)
+    {
+        const auto different = vmvnq_u16(vceqq_u16(vld1q_u16(left + index), vld1q_u16(right + index)));
+        const auto weighted = vandq_u16(different, weightVector);
+#if defined(__aarch64__)
+        const auto bits = vaddvq_u16(weighted);
+#else
+        auto sum = vadd_u16(vget_low_u16(weighted), vget_high_u16(weighted));
+        sum = vpadd_u16(sum, sum);
+        sum = vpadd_u16(sum, sum);
+        const auto bits = vget_lane_u16(sum, 0);
+#endif
+        markBlock(mask, index, bits);
+    }
+#endif
+    markRemaining(left, right, index, count, mask);
+    return countMask(mask, count);
+}
+
+std::size_t WordDiff::compareScalar(const std::uint16_t* left, const std::uint16_t* right, std::size_t count,
+                                    std::uint64_t* mask)
+{
+    markRemaining(left, right, 0, count, mask);
+    return countMask(mask, count);
+}
+
+std::size_t WordDiff::lowestBit(std::uint64_t word)
+{
+#if defined(__GNUC__)
+    return static_cast<std::size_t>(__builtin_ctzll(word));
+#else
+    auto index = std::size_t{0};
+    while ((word & 1) == 0)
+    {
+        word >>= 1;
+        ++index;
+    }
+    return index;
+#endif
+}
+
+std::size_t WordDiff::countBits(std::uint64_t word)
+{
+#if defined(__GNUC__)
+    return static_cast<std::size_t>(__builtin_popcountll(word));
+#else
+    auto count = std::size_t{0};
+    for (; word != 0; word &= word - 1)
+        ++count;
+    return count;
+#endif
+}
+}    // namespace wolkabout::more_modbus
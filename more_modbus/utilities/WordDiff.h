@@ -0,0 +1,67 @@
+/**
+ * Copyright 2023 Wolkabout Technology s.r.o.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef MOREMODBUS_WORDDIFF_H
+#define MOREMODBUS_WORDDIFF_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace wolkabout::more_modbus
+{
+/**
+ * @brief Finds the registers that differ between two buffers.
+ * @details The buffers are compared 16 registers at a time with AVX2, or 8 at a time with SSE2 or NEON, whichever the
+ *         library is compiled for, and the registers left over one by one.
+ */
+class WordDiff
+{
+public:
+    /**
+     * @brief Compares the buffers, marking the registers that differ in the mask.
+     * @param left
+     * @param right
+     * @param count the number of registers in each of the buffers
+     * @param mask (count + 63) / 64 words, cleared by the caller. The bit of each register that differs is set, the
+     *             register at index i being the bit i % 64 of the word i / 64.
+     * @return The number of registers that differ.
+     */
+    static std::size_t compare(const std::uint16_t* left, const std::uint16_t* right, std::size_t count,
+                               std::uint64_t* mask);
+
+    /**
+     * @brief Compares the buffers one register at a time, the same way as compare() does.
+     */
+    static std::size_t compareScalar(const std::uint16_t* left, const std::uint16_t* right, std::size_t count,
+                                     std::uint64_t* mask);
+
+    /**
+     * @param word
+     * @return The index of the lowest set bit of the word, which can't be zero.
+     */
+    static std::size_t lowestBit(std::uint64_t word);
+
+    /**
+     * @param word
+     * @return The number of set bits in the word.
+     */
+    static std::size_t countBits(std::uint64_t word);
+};
+}    // namespace wolkabout::more_modbus
+
+#endif    // MOREMODBUS_WORDDIFF_H
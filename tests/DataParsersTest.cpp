@@ -539,4 +539,56 @@ TEST_F(DataParsersTest, Int16ToUInt16Test)
         EXPECT_EQ(kvp.first, value);
     }
 }
+
+TEST_F(DataParsersTest, RegisterPairsAreParsedInEveryWordOrder)
+{
+    using namespace wolkabout::more_modbus;
+    // A pair of registers per value, the first one holding the index, so the values tell where they came from.
+    for (const auto count : {0, 1, 3, 4, 5, 8, 9, 15, 16, 17, 60})
+    {
+        auto registers = std::vector<uint16_t>{};
+        for (auto index = 0; index < count; ++index)
+        {
+            registers.emplace_back(static_cast<uint16_t>(0x1200 + index));
+            registers.emplace_back(0x3456);
+        }
+
+        const auto size = static_cast<std::size_t>(count);
+        auto values = std::vector<uint32_t>(size);
+        // The index lands in a different byte of the value in each of the orders.
+        const auto expect = [&](DataParsers::WordOrder order, uint32_t first, uint32_t shift)
+        {
+            DataParsers::registersToUint32(registers.data(), size, order, values.data());
+            for (auto index = 0u; index < size; ++index)
+                EXPECT_EQ(values[index], first + (index << shift)) << "count " << count << " index " << index;
+        };
+        expect(DataParsers::WordOrder::ABCD, 0x12003456, 16);
+        expect(DataParsers::WordOrder::CDAB, 0x34561200, 0);
+        expect(DataParsers::WordOrder::BADC, 0x00125634, 24);
+        expect(DataParsers::WordOrder::DCBA, 0x56340012, 8);
+    }
+}
+
+TEST_F(DataParsersTest, RegisterPairsAreParsedLikeSingleValues)
+{
+    using namespace wolkabout::more_modbus;
+    const auto registers =
+      std::vector<uint16_t>{0x4049, 0x0FDB, 0xC2F6, 0xE979, 0x8000, 0x0001, 0xBFFF, 0xFFFE, 0x1, 0x2};
+    const auto count = registers.size() / 2;
+
+    auto floats = std::vector<float>(count);
+    auto int32s = std::vector<int32_t>(count);
+    auto uint32s = std::vector<uint32_t>(count);
+    DataParsers::registersToFloat(registers.data(), count, DataParsers::WordOrder::ABCD, floats.data());
+    DataParsers::registersToInt32(registers.data(), count, DataParsers::WordOrder::ABCD, int32s.data());
+    DataParsers::registersToUint32(registers.data(), count, DataParsers::WordOrder::CDAB, uint32s.data());
+    for (auto index = std::size_t{0}; index < count; ++index)
+    {
+        const auto pair = std::vector<uint16_t>{registers[index * 2], registers[index * 2 + 1]};
+        EXPECT_EQ(floats[index], DataParsers::registersToFloat(pair, DataParsers::Endian::BIG));
+        EXPECT_EQ(int32s[index], DataParsers::registersToInt32(pair, DataParsers::Endian::LITTLE));
+        EXPECT_EQ(uint32s[index], DataParsers::registersToUint32(pair, DataParsers::Endian::BIG));
+    }
+    EXPECT_FLOAT_EQ(floats[0], 3.1415927f);
+}
 }    // namespace
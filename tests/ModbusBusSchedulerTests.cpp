@@ -0,0 +1,181 @@
+/**
+ * Copyright 2023 Wolkabout Technology s.r.o.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "more_modbus/modbus/ModbusBusScheduler.h"
+#include "mocks/ModbusClientMocking.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <stdexcept>
+
+using namespace wolkabout::more_modbus;
+using namespace ::testing;
+
+class ModbusBusSchedulerTests : public ::testing::Test
+{
+public:
+    void SetUp() override { scheduler.start(); }
+
+    // Occupies the I/O thread until the returned promise is set, so the following requests stay queued.
+    std::shared_ptr<std::promise<void>> blockBus()
+    {
+        auto started = std::promise<void>{};
+        auto release = std::make_shared<std::promise<void>>();
+        auto released = release->get_future().share();
+        scheduler.submit(0, [&started, released](ModbusClient&) {
+            started.set_value();
+            released.wait();
+            return true;
+        });
+        started.get_future().wait();
+        return release;
+    }
+
+    // Queues a request of the slave that records its turn.
+    std::future<bool> record(int16_t slaveAddress,
+                             ModbusBusScheduler::Priority priority = ModbusBusScheduler::Priority::NORMAL)
+    {
+        return scheduler.submit(
+          slaveAddress,
+          [this, slaveAddress](ModbusClient&) {
+              order.emplace_back(slaveAddress);
+              return true;
+          },
+          priority);
+    }
+
+    ModbusClientMock client;
+    ModbusBusScheduler scheduler{client};
+    std::vector<int16_t> order;
+};
+
+TEST_F(ModbusBusSchedulerTests, SlavesTakeTurns)
+{
+    auto release = blockBus();
+    auto results = std::vector<std::future<bool>>{};
+    for (const auto slaveAddress : {1, 1, 1, 2, 2, 3})
+        results.emplace_back(record(static_cast<int16_t>(slaveAddress)));
+    EXPECT_EQ(scheduler.getQueuedRequests(), 6);
+
+    release->set_value();
+    for (auto& result : results)
+        EXPECT_TRUE(result.get());
+    EXPECT_EQ(order, (std::vector<int16_t>{1, 2, 3, 1, 2, 1}));
+    EXPECT_EQ(scheduler.getQueuedRequests(), 0);
+}
+
+TEST_F(ModbusBusSchedulerTests, WeightedSlavesExecuteMoreRequestsInARow)
+{
+    EXPECT_THROW(scheduler.setWeight(1, 0), std::logic_error);
+    scheduler.setWeight(1, 2);
+    EXPECT_EQ(scheduler.getWeight(1), 2);
+    EXPECT_EQ(scheduler.getWeight(2), 1);
+
+    auto release = blockBus();
+    auto results = std::vector<std::future<bool>>{};
+    for (const auto slaveAddress : {1, 1, 1, 2, 2, 3})
+        results.emplace_back(record(static_cast<int16_t>(slaveAddress)));
+
+    release->set_value();
+    for (auto& result : results)
+        result.wait();
+    EXPECT_EQ(order, (std::vector<int16_t>{1, 1, 2, 3, 1, 2}));
+}
+
+TEST_F(ModbusBusSchedulerTests, HighPriorityRequestsSkipTheTurns)
+{
+    auto release = blockBus();
+    auto results = std::vector<std::future<bool>>{};
+    for (const auto slaveAddress : {1, 1, 2})
+        results.emplace_back(record(static_cast<int16_t>(slaveAddress)));
+    results.emplace_back(record(3, ModbusBusScheduler::Priority::HIGH));
+    results.emplace_back(record(1, ModbusBusScheduler::Priority::HIGH));
+    std::this_thread::sleep_for(std::chrono::milliseconds{10});
+
+    release->set_value();
+    for (auto& result : results)
+        result.wait();
+    EXPECT_EQ(order, (std::vector<int16_t>{3, 1, 1, 2, 1}));
+
+    // Both of the high priority requests waited for the request that was on the bus.
+    const auto highWait = scheduler.getQueueWait(ModbusBusScheduler::Priority::HIGH);
+    EXPECT_EQ(highWait.requests, 2);
+    EXPECT_GE(highWait.maximum, std::chrono::milliseconds{10});
+    EXPECT_LE(highWait.maximum, highWait.total);
+    EXPECT_EQ(scheduler.getQueueWait(ModbusBusScheduler::Priority::NORMAL).requests, 4);
+}
+
+TEST_F(ModbusBusSchedulerTests, LanesExecuteTheSlavesAtOnce)
+{
+    EXPECT_EQ(scheduler.getLaneCount(), 1);
+    auto lanes = ModbusBusScheduler{client, 2};
+    EXPECT_EQ(lanes.getLaneCount(), 2);
+    lanes.start();
+
+    // The requests of the first slave only succeed if the second slave is executed next to them, and they aren't
+    // executed next to each other.
+    auto overlapping = std::promise<void>{};
+    const auto overlapped = overlapping.get_future().share();
+    auto executing = std::atomic_int{0};
+    const auto request = [&, overlapped](ModbusClient&) {
+        const auto alone = ++executing == 1;
+        const auto overlaps = overlapped.wait_for(std::chrono::seconds{1}) == std::future_status::ready;
+        --executing;
+        return alone && overlaps;
+    };
+    auto first = lanes.submit(1, request);
+    auto second = lanes.submit(1, request);
+    auto third = lanes.submit(2, [&](ModbusClient&) {
+        overlapping.set_value();
+        return true;
+    });
+    EXPECT_TRUE(first.get());
+    EXPECT_TRUE(second.get());
+    EXPECT_TRUE(third.get());
+    lanes.stop();
+}
+
+TEST_F(ModbusBusSchedulerTests, CallbacksAndFailures)
+{
+    // Exceptions are reported as failed requests.
+    auto callbackResult = std::promise<bool>{};
+    scheduler.submit(
+      1, [](ModbusClient&) -> bool { throw std::runtime_error("Failure"); },
+      [&](bool result) { callbackResult.set_value(result); });
+    EXPECT_FALSE(callbackResult.get_future().get());
+
+    // Requests are executed on the client the scheduler was given.
+    EXPECT_CALL(client, writeCoil(1, 5, true)).WillOnce(Return(true));
+    EXPECT_TRUE(scheduler.submit(1, [](ModbusClient& bus) { return bus.writeCoil(1, 5, true); }).get());
+
+    // Stopping fails the requests that are still queued.
+    auto release = blockBus();
+    auto queued = record(2);
+    auto stopper = std::thread{[&] { scheduler.stop(); }};
+    while (scheduler.isRunning())
+        std::this_thread::yield();
+    release->set_value();
+    stopper.join();
+    EXPECT_FALSE(queued.get());
+    EXPECT_TRUE(order.empty());
+
+    // Without the I/O thread, the requests are executed right away.
+    EXPECT_TRUE(record(3).get());
+    EXPECT_EQ(order, (std::vector<int16_t>{3}));
+}
@@ -0,0 +1,229 @@
+/**
+ * Copyright 2023 Wolkabout Technology s.r.o.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#define private public
+#define protected public
+#include "more_modbus/modbus/ModbusClientPool.h"
+#undef private
+#undef protected
+
+#include "mocks/ModbusClientMocking.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+
+using namespace ::testing;
+using namespace wolkabout::more_modbus;
+
+class ModbusClientPoolTests : public ::testing::Test
+{
+public:
+    void SetUp() override
+    {
+        auto clients = std::vector<std::unique_ptr<ModbusClient>>{};
+        for (auto i = 0; i < 2; ++i)
+        {
+            auto mock = std::unique_ptr<NiceMock<ModbusClientMock>>(new NiceMock<ModbusClientMock>);
+            mocks.emplace_back(mock.get());
+            clients.emplace_back(std::move(mock));
+        }
+        pool.reset(new ModbusClientPool(std::move(clients)));
+    }
+
+    void TearDown() override
+    {
+        pool.reset();
+        mocks.clear();
+    }
+
+    std::vector<NiceMock<ModbusClientMock>*> mocks;
+    std::unique_ptr<ModbusClientPool> pool;
+};
+
+TEST_F(ModbusClientPoolTests, EmptyPool)
+{
+    EXPECT_THROW(ModbusClientPool(std::vector<std::unique_ptr<ModbusClient>>{}), std::logic_error);
+}
+
+TEST_F(ModbusClientPoolTests, ConnectIfAnyConnects)
+{
+    EXPECT_CALL(*mocks[0], connect).WillOnce(Return(false));
+    EXPECT_CALL(*mocks[1], connect).WillOnce(Return(true));
+    EXPECT_TRUE(pool->connect());
+
+    EXPECT_CALL(*mocks[0], connect).WillOnce(Return(false));
+    EXPECT_CALL(*mocks[1], connect).WillOnce(Return(false));
+    EXPECT_FALSE(pool->connect());
+}
+
+TEST_F(ModbusClientPoolTests, NoConnectedClients)
+{
+    EXPECT_CALL(*mocks[0], isConnected).WillRepeatedly(Return(false));
+    EXPECT_CALL(*mocks[1], isConnected).WillRepeatedly(Return(false));
+    EXPECT_CALL(*mocks[0], readHoldingRegister).Times(0);
+    EXPECT_CALL(*mocks[1], readHoldingRegister).Times(0);
+
+    auto value = uint16_t{};
+    EXPECT_FALSE(pool->isConnected());
+    EXPECT_FALSE(pool->readHoldingRegister(1, 0, value));
+}
+
+TEST_F(ModbusClientPoolTests, SkipsDisconnectedClient)
+{
+    EXPECT_CALL(*mocks[0], isConnected).WillRepeatedly(Return(false));
+    EXPECT_CALL(*mocks[1], isConnected).WillRepeatedly(Return(true));
+    EXPECT_CALL(*mocks[0], writeCoil).Times(0);
+    EXPECT_CALL(*mocks[1], writeCoil(1, 5, true)).WillOnce(Return(true));
+
+    EXPECT_TRUE(pool->writeCoil(1, 5, true));
+}
+
+TEST_F(ModbusClientPoolTests, SlaveKeepsItsConnection)
+{
+    EXPECT_CALL(*mocks[0], isConnected).WillRepeatedly(Return(true));
+    EXPECT_CALL(*mocks[1], isConnected).WillRepeatedly(Return(true));
+
+    // The slave has been using the second connection, so it should stay on it while it's free.
+    pool->m_lastConnection[2] = 1;
+    EXPECT_CALL(*mocks[0], readCoils).Times(0);
+    EXPECT_CALL(*mocks[1], readCoils).Times(3).WillRepeatedly(Return(true));
+
+    auto values = std::vector<bool>{};
+    for (auto i = 0; i < 3; ++i)
+        EXPECT_TRUE(pool->readCoils(2, 0, 4, values));
+}
+
+TEST_F(ModbusClientPoolTests, FailedConnectionIsReconnected)
+{
+    EXPECT_CALL(*mocks[0], isConnected).WillRepeatedly(Return(true));
+    EXPECT_CALL(*mocks[1], isConnected).WillRepeatedly(Return(true));
+    auto values = std::vector<bool>{};
+
+    // The connection of the slave broke, so it is connected anew, and the slave is no longer pinned to it.
+    pool->m_lastConnection[1] = 0;
+    EXPECT_CALL(*mocks[0], readCoils(1, 0, 4, _)).WillOnce(Return(false)).WillOnce(Return(true));
+    EXPECT_CALL(*mocks[0], disconnect).WillOnce(Return(true));
+    EXPECT_CALL(*mocks[0], connect).WillOnce(Return(true));
+    EXPECT_FALSE(pool->readCoils(1, 0, 4, values));
+    EXPECT_EQ(pool->m_lastConnection.count(1), 0);
+    EXPECT_TRUE(pool->readCoils(1, 0, 4, values));
+
+    // A connection that failed to reconnect is left out while the other one is free, and tried again once it's not.
+    EXPECT_CALL(*mocks[0], readCoils(2, 0, 4, _)).WillOnce(Return(false)).WillOnce(Return(true));
+    EXPECT_CALL(*mocks[0], disconnect).WillRepeatedly(Return(true));
+    EXPECT_CALL(*mocks[0], connect).WillOnce(Return(false)).WillOnce(Return(true));
+    EXPECT_CALL(*mocks[1], readCoils(2, 0, 4, _)).WillOnce(Return(true));
+    EXPECT_FALSE(pool->readCoils(2, 0, 4, values));
+    EXPECT_TRUE(pool->m_broken[0]);
+    EXPECT_TRUE(pool->readCoils(2, 0, 4, values));
+
+    pool->m_leased[1] = true;
+    EXPECT_TRUE(pool->readCoils(2, 0, 4, values));
+    pool->m_leased[1] = false;
+    EXPECT_FALSE(pool->m_broken[0]);
+}
+
+TEST_F(ModbusClientPoolTests, AdaptiveTimeoutsAreForwardedToTheClients)
+{
+    pool->enableAdaptiveTimeouts(std::chrono::milliseconds(10), std::chrono::milliseconds(1000));
+    EXPECT_TRUE(pool->hasAdaptiveTimeouts());
+    EXPECT_TRUE(mocks[0]->hasAdaptiveTimeouts());
+    EXPECT_TRUE(mocks[1]->hasAdaptiveTimeouts());
+
+    // The slave has been using the second connection, which has measured it, so its timeout is the one reported.
+    pool->m_lastConnection[2] = 1;
+    mocks[1]->recordRoundTrip(2, 3, true, std::chrono::milliseconds(1), std::chrono::milliseconds(1000));
+    EXPECT_EQ(pool->getResponseTimeout(2, 3), mocks[1]->getResponseTimeout(2, 3));
+    EXPECT_LT(pool->getResponseTimeout(2, 3), mocks[0]->getResponseTimeout(2, 3));
+
+    pool->disableAdaptiveTimeouts();
+    EXPECT_FALSE(pool->hasAdaptiveTimeouts());
+    EXPECT_EQ(pool->getResponseTimeout(2, 3), std::chrono::milliseconds(500));
+}
+
+TEST_F(ModbusClientPoolTests, RequestsRunInParallel)
+{
+    const auto delay = std::chrono::milliseconds{200};
+    auto concurrent = std::atomic_int{0};
+    auto maxConcurrent = std::atomic_int{0};
+    const auto slowRead = [&](int, int, int, std::vector<uint16_t>&) {
+        const auto current = ++concurrent;
+        if (current > maxConcurrent)
+            maxConcurrent = current;
+        std::this_thread::sleep_for(delay);
+        --concurrent;
+        return true;
+    };
+
+    for (const auto& mock : mocks)
+    {
+        EXPECT_CALL(*mock, isConnected).WillRepeatedly(Return(true));
+        EXPECT_CALL(*mock, readHoldingRegisters).WillOnce(Invoke(slowRead));
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    auto first = std::thread([&] {
+        auto values = std::vector<uint16_t>{};
+        EXPECT_TRUE(pool->readHoldingRegisters(1, 0, 10, values));
+    });
+    auto second = std::thread([&] {
+        auto values = std::vector<uint16_t>{};
+        EXPECT_TRUE(pool->readHoldingRegisters(2, 0, 10, values));
+    });
+    first.join();
+    second.join();
+
+    EXPECT_EQ(maxConcurrent, 2);
+    EXPECT_LT(std::chrono::steady_clock::now() - start, delay * 2);
+}
+
+TEST_F(ModbusClientPoolTests, WaitsForFreeConnection)
+{
+    EXPECT_CALL(*mocks[0], isConnected).WillRepeatedly(Return(true));
+    EXPECT_CALL(*mocks[1], isConnected).WillRepeatedly(Return(false));
+
+    auto concurrent = std::atomic_int{0};
+    auto maxConcurrent = std::atomic_int{0};
+    const auto slowRead = [&](int, int, int, std::vector<uint16_t>&) {
+        const auto current = ++concurrent;
+        if (current > maxConcurrent)
+            maxConcurrent = current;
+        std::this_thread::sleep_for(std::chrono::milliseconds{50});
+        --concurrent;
+        return true;
+    };
+    EXPECT_CALL(*mocks[0], readInputRegisters).Times(2).WillRepeatedly(Invoke(slowRead));
+
+    auto first = std::thread([&] {
+        auto values = std::vector<uint16_t>{};
+        EXPECT_TRUE(pool->readInputRegisters(1, 0, 2, values));
+    });
+    auto second = std::thread([&] {
+        auto values = std::vector<uint16_t>{};
+        EXPECT_TRUE(pool->readInputRegisters(2, 0, 2, values));
+    });
+    first.join();
+    second.join();
+
+    EXPECT_EQ(maxConcurrent, 1);
+}
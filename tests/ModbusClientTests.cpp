@@ -30,6 +30,7 @@
 
 #include <iostream>
 #include <memory>
+#include <thread>
 
 std::unique_ptr<LibModbusMock> libModbusMock;
 
@@ -57,6 +58,11 @@ int modbus_set_response_timeout(modbus_t* ctx, uint32_t to_sec, uint32_t to_usec
     return libModbusMock->modbus_set_response_timeout(ctx, to_sec, to_usec);
 }
 
+int modbus_set_byte_timeout(modbus_t* ctx, uint32_t to_sec, uint32_t to_usec)
+{
+    return libModbusMock->modbus_set_byte_timeout(ctx, to_sec, to_usec);
+}
+
 int modbus_connect(modbus_t* ctx)
 {
     return libModbusMock->modbus_connect(ctx);
@@ -120,6 +126,11 @@ int modbus_write_registers(modbus_t* ctx, int addr, int nb, const uint16_t* data
     return libModbusMock->modbus_write_registers(ctx, addr, nb, data);
 }
 
+int modbus_mask_write_register(modbus_t* ctx, int addr, uint16_t and_mask, uint16_t or_mask)
+{
+    return libModbusMock->modbus_mask_write_register(ctx, addr, and_mask, or_mask);
+}
+
 /*
  * All client specific functions
  */
@@ -221,6 +232,36 @@ TEST_F(ModbusTCPClientTest, HappyFlow)
     ASSERT_TRUE(modbusClient->isConnected());
 }
 
+TEST_F(ModbusTCPClientTest, AdaptiveTimeouts)
+{
+    const auto& modbusClient = std::unique_ptr<wolkabout::more_modbus::LibModbusTcpIpClient>(
+      new wolkabout::more_modbus::LibModbusTcpIpClient("TEST IP ADDRESS", 551, std::chrono::milliseconds(500)));
+    modbusClient->enableAdaptiveTimeouts(std::chrono::milliseconds(10), std::chrono::milliseconds(1000));
+    EXPECT_CALL(*libModbusMock, modbus_set_slave).WillRepeatedly(Return(1));
+    EXPECT_CALL(*libModbusMock, modbus_set_byte_timeout).WillRepeatedly(Return(1));
+
+    // The slave hasn't responded yet, so it gets the ceiling, and quick responses bring it down to the floor.
+    EXPECT_CALL(*libModbusMock, modbus_set_response_timeout(_, 1, 0)).WillOnce(Return(1));
+    EXPECT_CALL(*libModbusMock, modbus_set_response_timeout(_, 0, 10000)).WillOnce(Return(1));
+    EXPECT_CALL(*libModbusMock, modbus_read_registers)
+      .WillOnce(Return(1))
+      .WillOnce(DoAll(InvokeWithoutArgs([] { std::this_thread::sleep_for(std::chrono::milliseconds(15)); }),
+                      Return(-1)));
+    auto value = uint16_t{0};
+    EXPECT_TRUE(modbusClient->readHoldingRegister(1, 0, value));
+    EXPECT_EQ(modbusClient->getResponseTimeout(1, 0x03), std::chrono::milliseconds(10));
+
+    // The timeout doubles the timeout, other slaves and function codes are not affected.
+    EXPECT_FALSE(modbusClient->readHoldingRegister(1, 0, value));
+    EXPECT_EQ(modbusClient->getResponseTimeout(1, 0x03), std::chrono::milliseconds(20));
+    EXPECT_EQ(modbusClient->getResponseTimeout(1, 0x04), std::chrono::milliseconds(1000));
+    EXPECT_EQ(modbusClient->getResponseTimeout(2, 0x03), std::chrono::milliseconds(1000));
+
+    modbusClient->disableAdaptiveTimeouts();
+    EXPECT_FALSE(modbusClient->hasAdaptiveTimeouts());
+    EXPECT_EQ(modbusClient->getResponseTimeout(1, 0x03), std::chrono::milliseconds(500));
+}
+
 TEST_F(ModbusTCPClientTest, SetSlaveBad)
 {
     const auto& modbusClient = std::unique_ptr<wolkabout::more_modbus::LibModbusTcpIpClient>(
@@ -266,6 +307,22 @@ TEST_F(ModbusTCPClientTest, WriteHoldingRegisters)
     }
 }
 
+TEST_F(ModbusTCPClientTest, MaskWriteHoldingRegister)
+{
+    const auto& modbusClient = std::unique_ptr<wolkabout::more_modbus::LibModbusTcpIpClient>(
+      new wolkabout::more_modbus::LibModbusTcpIpClient("TEST IP ADDRESS", 551, std::chrono::milliseconds(500)));
+    EXPECT_CALL(*libModbusMock, modbus_set_slave).WillOnce(Return(-1)).WillRepeatedly(Return(1));
+    EXPECT_CALL(*libModbusMock, modbus_mask_write_register(_, 1, 0xFFFB, 0x0004))
+      .WillOnce(Return(-1))
+      .WillOnce(Return(1));
+    const auto booleans = std::vector<bool>{false, false, true};
+
+    for (uint32_t i = 0; i < 3; i++)
+    {
+        EXPECT_EQ(booleans[i], modbusClient->maskWriteHoldingRegister(i + 1, 1, 0xFFFB, 0x0004));
+    }
+}
+
 TEST_F(ModbusTCPClientTest, WriteCoil)
 {
     const auto& modbusClient = std::unique_ptr<wolkabout::more_modbus::LibModbusTcpIpClient>(
@@ -371,6 +428,40 @@ TEST_F(ModbusTCPClientTest, ReadHoldingRegisters)
     }
 }
 
+TEST_F(ModbusTCPClientTest, ReadHoldingRegistersIntoBuffer)
+{
+    const auto& modbusClient = std::unique_ptr<wolkabout::more_modbus::LibModbusTcpIpClient>(
+      new wolkabout::more_modbus::LibModbusTcpIpClient("TEST IP ADDRESS", 551, std::chrono::milliseconds(500)));
+    const uint16_t data[] = {7, 8, 9};
+    EXPECT_CALL(*libModbusMock, modbus_set_slave).WillRepeatedly(Return(1));
+    EXPECT_CALL(*libModbusMock, modbus_read_registers(_, 4, 3, _))
+      .WillOnce(DoAll(SetArrayArgument<3>(data, data + 3), Return(3)));
+
+    uint16_t values[4] = {0, 0, 0, 0};
+    ASSERT_TRUE(modbusClient->readHoldingRegisters(1, 4, 3, values));
+    EXPECT_EQ(values[0], 7);
+    EXPECT_EQ(values[1], 8);
+    EXPECT_EQ(values[2], 9);
+    EXPECT_EQ(values[3], 0);
+}
+
+TEST_F(ModbusTCPClientTest, ReadInputContactsReturnsEveryBit)
+{
+    const auto& modbusClient = std::unique_ptr<wolkabout::more_modbus::LibModbusTcpIpClient>(
+      new wolkabout::more_modbus::LibModbusTcpIpClient("TEST IP ADDRESS", 551, std::chrono::milliseconds(500)));
+    // libmodbus writes one byte for every bit read.
+    const auto data = std::vector<uint8_t>{1, 0, 1, 1, 0, 0, 0, 0, 1, 0, 1};
+    EXPECT_CALL(*libModbusMock, modbus_set_slave).WillRepeatedly(Return(1));
+    EXPECT_CALL(*libModbusMock, modbus_read_input_bits(_, 0, 11, _))
+      .WillOnce(DoAll(SetArrayArgument<3>(data.cbegin(), data.cend()), Return(11)));
+
+    std::vector<bool> values;
+    ASSERT_TRUE(modbusClient->readInputContacts(1, 0, 11, values));
+    ASSERT_EQ(values.size(), data.size());
+    for (auto i = std::size_t{0}; i < data.size(); ++i)
+        EXPECT_EQ(values[i], data[i] != 0);
+}
+
 TEST_F(ModbusSerialRTUClientTest, NewRTUReturnsNull)
 {
     const auto& modbusClient = std::unique_ptr<wolkabout::more_modbus::LibModbusSerialRtuClient>(
@@ -681,3 +772,91 @@ TEST_F(ModbusSerialRTUClientTest, ReadHoldingRegisters)
         EXPECT_EQ(booleans[i], modbusClient->readHoldingRegisters(i + 1, 0, 3, values));
     }
 }
+
+TEST_F(ModbusSerialRTUClientTest, SilentIntervalFromSerialSettings)
+{
+    using Client = wolkabout::more_modbus::LibModbusSerialRtuClient;
+    EXPECT_EQ(Client::calculateSilentInterval(9600, 8, 1, Client::BitParity::NONE).count(), 3646);
+    EXPECT_EQ(Client::calculateSilentInterval(19200, 8, 1, Client::BitParity::EVEN).count(), 2006);
+    EXPECT_EQ(Client::calculateSilentInterval(115200, 8, 1, Client::BitParity::ODD).count(), 335);
+    EXPECT_EQ(Client::calculateSilentInterval(115200, 8, 2, Client::BitParity::NONE).count(), 335);
+}
+
+TEST_F(ModbusSerialRTUClientTest, TurnaroundDelayIsKeptPerSlave)
+{
+    const auto& modbusClient = std::unique_ptr<wolkabout::more_modbus::LibModbusSerialRtuClient>(
+      new wolkabout::more_modbus::LibModbusSerialRtuClient(
+        "/dev/testSerial", 115200, 8, 1, wolkabout::more_modbus::LibModbusSerialRtuClient::BitParity::NONE,
+        std::chrono::milliseconds(500)));
+    EXPECT_CALL(*libModbusMock, modbus_set_slave).WillRepeatedly(Return(1));
+    EXPECT_CALL(*libModbusMock, modbus_read_registers).WillRepeatedly(Return(1));
+
+    modbusClient->setTurnaroundDelay(1, std::chrono::milliseconds(30));
+    EXPECT_EQ(modbusClient->getTurnaroundDelay(1), std::chrono::milliseconds(30));
+    EXPECT_EQ(modbusClient->getTurnaroundDelay(2), modbusClient->getSilentInterval());
+
+    auto& client = static_cast<wolkabout::more_modbus::ModbusClient&>(*modbusClient);
+    auto value = uint16_t{0};
+    const auto start = std::chrono::steady_clock::now();
+    ASSERT_TRUE(client.readHoldingRegister(1, 0, value));
+    ASSERT_TRUE(client.readHoldingRegister(2, 0, value));
+    EXPECT_GE(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(30));
+
+    modbusClient->clearTurnaroundDelay(1);
+    EXPECT_EQ(modbusClient->getTurnaroundDelay(1), modbusClient->getSilentInterval());
+}
+
+TEST_F(ModbusSerialRTUClientTest, TurnaroundDelayIsNotPartOfTheRoundTrip)
+{
+    const auto& modbusClient = std::unique_ptr<wolkabout::more_modbus::LibModbusSerialRtuClient>(
+      new wolkabout::more_modbus::LibModbusSerialRtuClient(
+        "/dev/testSerial", 115200, 8, 1, wolkabout::more_modbus::LibModbusSerialRtuClient::BitParity::NONE,
+        std::chrono::milliseconds(500)));
+    EXPECT_CALL(*libModbusMock, modbus_set_slave).WillRepeatedly(Return(1));
+    EXPECT_CALL(*libModbusMock, modbus_read_registers).WillRepeatedly(Return(1));
+    EXPECT_CALL(*libModbusMock, modbus_set_response_timeout).WillRepeatedly(Return(0));
+    EXPECT_CALL(*libModbusMock, modbus_set_byte_timeout).WillRepeatedly(Return(0));
+
+    // The reads answer at once, only the second one waits for the turnaround delay of the first.
+    modbusClient->setTurnaroundDelay(1, std::chrono::milliseconds(30));
+    modbusClient->enableAdaptiveTimeouts(std::chrono::milliseconds(10), std::chrono::milliseconds(1000));
+    auto& client = static_cast<wolkabout::more_modbus::ModbusClient&>(*modbusClient);
+    auto value = uint16_t{0};
+    for (auto i = 0; i < 3; ++i)
+        ASSERT_TRUE(client.readHoldingRegister(1, 0, value));
+    EXPECT_LT(client.getResponseTimeout(1, 3), std::chrono::milliseconds(30));
+}
+
+TEST_F(ModbusSerialRTUClientTest, CalibrateTurnaroundDelay)
+{
+    const auto& modbusClient = std::unique_ptr<wolkabout::more_modbus::LibModbusSerialRtuClient>(
+      new wolkabout::more_modbus::LibModbusSerialRtuClient(
+        "/dev/testSerial", 115200, 8, 1, wolkabout::more_modbus::LibModbusSerialRtuClient::BitParity::NONE,
+        std::chrono::milliseconds(500)));
+    EXPECT_CALL(*libModbusMock, modbus_set_slave).WillRepeatedly(Return(1));
+
+    // The slave doesn't respond to requests that the client sends less than 3 ms after the previous one. It looks at
+    // the delay the client is tried with rather than at the clock, as sleeping can overshoot on a loaded machine.
+    const auto needed = std::chrono::microseconds(3000);
+    EXPECT_CALL(*libModbusMock, modbus_read_registers).WillRepeatedly(Invoke([&](modbus_t*, int, int, uint16_t*) {
+        return modbusClient->m_turnaroundDelays.at(1) >= needed ? 1 : -1;
+    }));
+
+    ASSERT_TRUE(modbusClient->calibrateTurnaroundDelay(1, 0));
+    const auto delay = modbusClient->getTurnaroundDelay(1);
+    EXPECT_GE(delay, needed);
+    EXPECT_LE(delay, needed + wolkabout::more_modbus::LibModbusSerialRtuClient::CALIBRATION_RESOLUTION);
+}
+
+TEST_F(ModbusSerialRTUClientTest, CalibrateUnreadableSlave)
+{
+    const auto& modbusClient = std::unique_ptr<wolkabout::more_modbus::LibModbusSerialRtuClient>(
+      new wolkabout::more_modbus::LibModbusSerialRtuClient(
+        "/dev/testSerial", 115200, 8, 1, wolkabout::more_modbus::LibModbusSerialRtuClient::BitParity::NONE,
+        std::chrono::milliseconds(500)));
+    EXPECT_CALL(*libModbusMock, modbus_set_slave).WillRepeatedly(Return(1));
+    EXPECT_CALL(*libModbusMock, modbus_read_registers).WillRepeatedly(Return(-1));
+
+    EXPECT_FALSE(modbusClient->calibrateTurnaroundDelay(1, 0));
+    EXPECT_EQ(modbusClient->getTurnaroundDelay(1), modbusClient->getSilentInterval());
+}
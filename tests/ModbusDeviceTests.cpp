@@ -124,3 +124,69 @@ TEST_F(ModbusDeviceTests, InitialExampleTest)
     EXPECT_TRUE(valueChangeSuccess);
     EXPECT_TRUE(statusChangeSuccess);
 }
+
+TEST_F(ModbusDeviceTests, GroupsAreSplitByReadPeriod)
+{
+    using namespace wolkabout::more_modbus;
+    auto rateMappings = std::vector<std::shared_ptr<RegisterMapping>>{};
+    for (auto address = 0; address < 4; ++address)
+    {
+        rateMappings.emplace_back(std::make_shared<RegisterMappingMock>("HR" + std::to_string(address),
+                                                                        RegisterType::HOLDING_REGISTER, address));
+        // The even registers are needed often, the odd ones in the read period of the reader.
+        if (address % 2 == 0)
+            rateMappings.back()->setReadPeriod(std::chrono::milliseconds(100));
+    }
+
+    const auto device = std::make_shared<ModbusDevice>("TEST", 1);
+    ASSERT_NO_THROW(device->createGroups(rateMappings));
+    ASSERT_EQ(device->getGroups().size(), 4);
+    for (const auto& group : device->getGroups())
+    {
+        EXPECT_EQ(group->getAddressCount(), 1);
+        EXPECT_EQ(group->getReadPeriod(),
+                  group->getStartingAddress() % 2 == 0 ? std::chrono::milliseconds(100) : std::chrono::milliseconds(0));
+    }
+
+    // Adjacent mappings of the same read period still share a group.
+    rateMappings[1]->setReadPeriod(std::chrono::milliseconds(100));
+    const auto merged = std::make_shared<ModbusDevice>("TEST", 1);
+    ASSERT_NO_THROW(merged->createGroups(rateMappings));
+    ASSERT_EQ(merged->getGroups().size(), 2);
+    EXPECT_EQ(merged->getGroups().front()->getAddressCount(), 3);
+    EXPECT_EQ(merged->getGroups().front()->getReadPeriod(), std::chrono::milliseconds(100));
+    EXPECT_EQ(ModbusDevice(*merged).getGroups().front()->getReadPeriod(), std::chrono::milliseconds(100));
+}
+
+TEST_F(ModbusDeviceTests, RewriteDeadlinesAreSpreadOverThePeriod)
+{
+    using namespace wolkabout::more_modbus;
+    auto rewritable = std::vector<std::shared_ptr<RegisterMapping>>{};
+    for (auto address = 0; address < 4; ++address)
+    {
+        rewritable.emplace_back(std::make_shared<RegisterMappingMock>("HR" + std::to_string(address),
+                                                                      RegisterType::HOLDING_REGISTER, address));
+        rewritable.back()->setRepeatedWrite(std::chrono::milliseconds(1000));
+    }
+    const auto start = std::chrono::steady_clock::now();
+    const auto device = std::make_shared<ModbusDevice>("TEST", 1);
+    ASSERT_NO_THROW(device->createGroups(rewritable));
+
+    // Only the first mapping is due right away, the rest are spread over the period instead of all being overdue.
+    EXPECT_LT(device->getNextRewrite(), start + std::chrono::milliseconds(100));
+    const auto first = device->takeDueRewritable(start + std::chrono::milliseconds(100));
+    ASSERT_EQ(first.size(), 1);
+    EXPECT_GT(device->getNextRewrite(), start + std::chrono::milliseconds(100));
+    const auto rest = device->takeDueRewritable(start + std::chrono::milliseconds(1100));
+    EXPECT_EQ(rest.size(), 3);
+    EXPECT_EQ(device->getNextRewrite(), std::chrono::steady_clock::time_point::max());
+
+    // Taken mappings are due again once they are scheduled, unless they were removed in the meantime.
+    device->scheduleRewrite(first.front(), start + std::chrono::milliseconds(2000));
+    device->scheduleRewrite(rest.front(), start + std::chrono::milliseconds(1500));
+    device->scheduleRewrite(rest.front(), start + std::chrono::milliseconds(1200));
+    EXPECT_EQ(device->getNextRewrite(), start + std::chrono::milliseconds(1500));
+    device->removeRewritable(rest.front());
+    EXPECT_EQ(device->getRewritable().size(), 3);
+    EXPECT_EQ(device->takeDueRewritable(start + std::chrono::milliseconds(2000)), first);
+}
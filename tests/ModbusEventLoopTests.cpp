@@ -0,0 +1,148 @@
+/**
+ * Copyright 2023 Wolkabout Technology s.r.o.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#define private public
+#define protected public
+#include "more_modbus/modbus/ModbusEventLoop.h"
+#undef private
+#undef protected
+
+#include "mocks/ModbusTcpServerMocking.h"
+#include "more_modbus/mappings/BoolMapping.h"
+#include "more_modbus/mappings/UInt16Mapping.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <thread>
+
+using namespace wolkabout::more_modbus;
+
+class ModbusEventLoopTests : public ::testing::Test
+{
+public:
+    static bool waitFor(const std::function<bool()>& condition,
+                        std::chrono::milliseconds timeout = std::chrono::milliseconds{3000})
+    {
+        const auto deadline = std::chrono::steady_clock::now() + timeout;
+        while (!condition())
+        {
+            if (std::chrono::steady_clock::now() > deadline)
+                return false;
+            std::this_thread::sleep_for(std::chrono::milliseconds{5});
+        }
+        return true;
+    }
+
+    ModbusEventLoop loop;
+};
+
+TEST_F(ModbusEventLoopTests, SubmitReadAndWrite)
+{
+    ModbusTcpServerMock server;
+    const auto gateway = loop.addGateway("127.0.0.1", server.port, std::chrono::milliseconds{500});
+    ASSERT_TRUE(loop.start());
+    ASSERT_TRUE(waitFor([&] { return loop.isConnected(gateway); }));
+
+    auto read = std::atomic_bool{false};
+    auto values = std::vector<std::uint16_t>{};
+    const auto request = ModbusReadRequest{1, ModbusReadFunction::READ_INPUT_REGISTERS, 20, 3, {}, {}, false};
+    ASSERT_TRUE(loop.submitRead(gateway, request, [&](const ModbusReadRequest& result) {
+        EXPECT_TRUE(result.success);
+        values = result.registers;
+        read = true;
+    }));
+    auto written = std::atomic_bool{false};
+    ASSERT_TRUE(loop.submitWrite(gateway, 1, 5, std::vector<std::uint16_t>{1, 2}, [&](bool success) {
+        EXPECT_TRUE(success);
+        written = true;
+    }));
+
+    ASSERT_TRUE(waitFor([&] { return read && written; }));
+    EXPECT_EQ(values, (std::vector<std::uint16_t>{20, 21, 22}));
+    loop.stop();
+}
+
+TEST_F(ModbusEventLoopTests, RequestTimesOut)
+{
+    ModbusTcpServerMock server;
+    server.respond = false;
+    const auto gateway = loop.addGateway("127.0.0.1", server.port, std::chrono::milliseconds{100});
+    ASSERT_TRUE(loop.start());
+    ASSERT_TRUE(waitFor([&] { return loop.isConnected(gateway); }));
+
+    auto result = std::atomic_int{-1};
+    ASSERT_TRUE(loop.submitWrite(gateway, 1, 0, true, [&](bool success) { result = success ? 1 : 0; }));
+    ASSERT_TRUE(waitFor([&] { return result != -1; }));
+    EXPECT_EQ(result, 0);
+    EXPECT_TRUE(loop.isConnected(gateway));
+    loop.stop();
+}
+
+TEST_F(ModbusEventLoopTests, PollsDevicesOnMultipleGateways)
+{
+    const auto gatewayCount = 3;
+    auto servers = std::vector<std::unique_ptr<ModbusTcpServerMock>>{};
+    auto devices = std::vector<std::shared_ptr<ModbusDevice>>{};
+    auto statuses = std::vector<std::unique_ptr<std::atomic_bool>>{};
+    auto registerValues = std::vector<std::unique_ptr<std::atomic_int>>{};
+    for (auto i = 0; i < gatewayCount; ++i)
+    {
+        servers.emplace_back(new ModbusTcpServerMock);
+        servers.back()->offset = static_cast<std::uint16_t>(100 * (i + 1));
+        statuses.emplace_back(new std::atomic_bool{false});
+        registerValues.emplace_back(new std::atomic_int{-1});
+
+        auto device = std::make_shared<ModbusDevice>("Device" + std::to_string(i), 1);
+        device->createGroups({std::make_shared<UInt16Mapping>("HR", RegisterType::HOLDING_REGISTER, 5),
+                              std::make_shared<BoolMapping>("C", RegisterType::COIL, 0)});
+        auto& status = *statuses.back();
+        auto& value = *registerValues.back();
+        device->setOnStatusChange([&status](bool newStatus) { status = newStatus; });
+        device->setOnMappingValueChange(
+          [&value](const std::shared_ptr<RegisterMapping>&, const std::vector<std::uint16_t>& data) {
+              value = data.front();
+          });
+        devices.emplace_back(device);
+
+        const auto gateway = loop.addGateway("127.0.0.1", servers.back()->port, std::chrono::milliseconds{500});
+        ASSERT_TRUE(loop.addDevice(gateway, device, std::chrono::milliseconds{50}));
+    }
+    ASSERT_TRUE(loop.start());
+
+    for (auto i = 0; i < gatewayCount; ++i)
+    {
+        ASSERT_TRUE(waitFor([&] { return *statuses[i] && *registerValues[i] != -1; }));
+        EXPECT_EQ(*registerValues[i], 100 * (i + 1) + 5);
+    }
+
+    // The devices keep getting read every read period.
+    const auto requests = servers.front()->requests.load();
+    EXPECT_TRUE(waitFor([&] { return servers.front()->requests >= requests + 4; }));
+
+    // Losing the gateway reports the device as offline, while the others stay online.
+    servers.front().reset();
+    EXPECT_TRUE(waitFor([&] { return !*statuses.front(); }));
+    EXPECT_TRUE(*statuses.back());
+
+    // The callbacks capture the locals, so the loop has to stop before they go away.
+    loop.stop();
+}
@@ -0,0 +1,148 @@
+/**
+ * Copyright 2023 Wolkabout Technology s.r.o.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#define private public
+#define protected public
+#include "more_modbus/ModbusFleet.h"
+#undef private
+#undef protected
+
+#include "mocks/ModbusClientMocking.h"
+#include "more_modbus/mappings/UInt16Mapping.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <thread>
+
+using namespace wolkabout::more_modbus;
+using namespace ::testing;
+
+class ModbusFleetTests : public ::testing::Test
+{
+public:
+    static bool waitFor(const std::function<bool()>& condition,
+                        std::chrono::milliseconds timeout = std::chrono::milliseconds{3000})
+    {
+        const auto deadline = std::chrono::steady_clock::now() + timeout;
+        while (!condition())
+        {
+            if (std::chrono::steady_clock::now() > deadline)
+                return false;
+            std::this_thread::sleep_for(std::chrono::milliseconds{5});
+        }
+        return true;
+    }
+
+    static std::shared_ptr<NiceMock<ModbusClientMock>> createClient(bool connects = true)
+    {
+        auto client = std::make_shared<NiceMock<ModbusClientMock>>();
+        ON_CALL(*client, connect).WillByDefault(Return(connects));
+        ON_CALL(*client, isConnected).WillByDefault(Return(connects));
+        ON_CALL(*client, readHoldingRegisters(_, _, _, An<std::vector<uint16_t>&>()))
+          .WillByDefault(DoAll(SetArgReferee<3>(std::vector<uint16_t>{1}), Return(true)));
+        return client;
+    }
+
+    static std::shared_ptr<ModbusDevice> createDevice(const std::string& name, std::int16_t slaveAddress)
+    {
+        auto device = std::make_shared<ModbusDevice>(name, slaveAddress);
+        device->createGroups({std::make_shared<UInt16Mapping>("HR", RegisterType::HOLDING_REGISTER, 0)});
+        return device;
+    }
+};
+
+TEST_F(ModbusFleetTests, AddBusesAndDevices)
+{
+    auto fleet = ModbusFleet{2};
+    const auto client = createClient();
+    EXPECT_TRUE(fleet.addBus("RTU1", client, std::chrono::milliseconds{100}));
+    EXPECT_FALSE(fleet.addBus("RTU1", client, std::chrono::milliseconds{100}));
+    EXPECT_FALSE(fleet.addBus("RTU2", nullptr, std::chrono::milliseconds{100}));
+
+    EXPECT_TRUE(fleet.addDevice("RTU1", createDevice("Device1", 1)));
+    EXPECT_FALSE(fleet.addDevice("RTU2", createDevice("Device2", 2)));
+    EXPECT_FALSE(fleet.addDevice("RTU1", createDevice("Device1", 2)));
+    EXPECT_FALSE(fleet.addDevice("RTU1", createDevice("Device3", 1)));
+
+    EXPECT_EQ(fleet.getDevices().size(), 1);
+    ASSERT_NE(fleet.getDevice("Device1"), nullptr);
+    EXPECT_EQ(fleet.getDevice("Device1")->getSlaveAddress(), 1);
+    EXPECT_EQ(fleet.getDevice("Device2"), nullptr);
+    EXPECT_EQ(fleet.getBusOfDevice("Device1"), "RTU1");
+    EXPECT_NE(fleet.getReader("RTU1"), nullptr);
+    EXPECT_FALSE(fleet.submit("RTU1", [](ModbusClient&) {}));
+
+    EXPECT_THROW(ModbusFleet{0}, std::logic_error);
+}
+
+TEST_F(ModbusFleetTests, PollsAllBusesWithFewerWorkers)
+{
+    const auto busCount = 4;
+    auto fleet = ModbusFleet{1};
+    auto clients = std::vector<std::shared_ptr<NiceMock<ModbusClientMock>>>{};
+    for (auto i = 0; i < busCount; ++i)
+    {
+        clients.emplace_back(createClient(i != busCount - 1));
+        const auto bus = "Bus" + std::to_string(i);
+        ASSERT_TRUE(fleet.addBus(bus, clients.back(), std::chrono::milliseconds{20}));
+        ASSERT_TRUE(fleet.addDevice(bus, createDevice("Device" + std::to_string(i), 1)));
+    }
+    ASSERT_TRUE(fleet.start());
+
+    EXPECT_TRUE(waitFor([&] {
+        const auto statuses = fleet.getDeviceStatuses();
+        return statuses.at("Device0") && statuses.at("Device1") && statuses.at("Device2");
+    }));
+    EXPECT_FALSE(fleet.getDeviceStatuses().at("Device3"));
+    fleet.stop();
+    EXPECT_FALSE(fleet.isRunning());
+}
+
+TEST_F(ModbusFleetTests, TasksOfABusNeverOverlap)
+{
+    auto fleet = ModbusFleet{4};
+    const auto client = createClient();
+    ASSERT_TRUE(fleet.addBus("TCP", client, std::chrono::milliseconds{1}));
+    ASSERT_TRUE(fleet.addDevice("TCP", createDevice("Device", 1)));
+
+    auto executing = std::atomic_int{0};
+    auto overlapped = std::atomic_bool{false};
+    auto completed = std::atomic_int{0};
+    const auto task = [&](ModbusClient&) {
+        if (++executing > 1)
+            overlapped = true;
+        std::this_thread::sleep_for(std::chrono::milliseconds{1});
+        --executing;
+        ++completed;
+    };
+    ON_CALL(*client, readHoldingRegisters(_, _, _, An<std::vector<uint16_t>&>()))
+      .WillByDefault(DoAll(Invoke([&](int, int, int, std::vector<uint16_t>&) { task(*client); }),
+                           SetArgReferee<3>(std::vector<uint16_t>{1}), Return(true)));
+
+    ASSERT_TRUE(fleet.start());
+    for (auto i = 0; i < 20; ++i)
+        ASSERT_TRUE(fleet.submit("TCP", task));
+    EXPECT_TRUE(waitFor([&] { return completed >= 40; }));
+    fleet.stop();
+    EXPECT_FALSE(overlapped);
+}
@@ -24,10 +24,14 @@
 
 #include "mocks/ModbusClientMocking.h"
 #include "mocks/ModbusDeviceMocking.h"
+#include "more_modbus/mappings/BoolMapping.h"
+#include "more_modbus/mappings/UInt16Mapping.h"
+#include "more_modbus/modbus/ModbusClientPool.h"
 
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 
+#include <atomic>
 #include <iostream>
 #include <memory>
 
@@ -75,3 +79,468 @@ TEST_F(ModbusReaderTests, ExampleTest)
     std::this_thread::sleep_for(std::chrono::milliseconds(500));
     EXPECT_NO_THROW(reader->stop());
 }
+
+TEST_F(ModbusReaderTests, WriteBitMappingProbesMaskWrite)
+{
+    using namespace wolkabout::more_modbus;
+    const auto reader = std::make_shared<ModbusReader>(*modbusClientMock, std::chrono::milliseconds(500));
+    const auto mapping =
+      std::make_shared<BoolMapping>("B", RegisterType::HOLDING_REGISTER, 4, OperationType::TAKE_BIT, 2);
+    const auto device = std::make_shared<ModbusDevice>("Device", 1);
+    device->createGroups({mapping});
+    reader->addDevice(device);
+
+    // The device takes the mask write, so the register is never read.
+    EXPECT_CALL(*modbusClientMock, maskWriteHoldingRegister(1, 4, 0xFFFB, 0x0004)).WillOnce(Return(true));
+    EXPECT_CALL(*modbusClientMock, readHoldingRegister).Times(0);
+    EXPECT_TRUE(reader->writeBitMapping(*mapping, true));
+    EXPECT_EQ(device->getMaskWriteSupport(), MaskWriteSupport::SUPPORTED);
+
+    // Once it is known to be supported, a failed mask write is a failed write.
+    EXPECT_CALL(*modbusClientMock, maskWriteHoldingRegister(1, 4, 0xFFFB, 0x0000)).WillOnce(Return(false));
+    EXPECT_FALSE(reader->writeBitMapping(*mapping, false));
+    EXPECT_EQ(device->getMaskWriteSupport(), MaskWriteSupport::SUPPORTED);
+}
+
+TEST_F(ModbusReaderTests, WriteBitMappingFallsBackToReadAndWrite)
+{
+    using namespace wolkabout::more_modbus;
+    const auto reader = std::make_shared<ModbusReader>(*modbusClientMock, std::chrono::milliseconds(500));
+    const auto mapping =
+      std::make_shared<BoolMapping>("B", RegisterType::HOLDING_REGISTER, 4, OperationType::TAKE_BIT, 2);
+    const auto device = std::make_shared<ModbusDevice>("Device", 1);
+    device->createGroups({mapping});
+    reader->addDevice(device);
+
+    EXPECT_CALL(*modbusClientMock, maskWriteHoldingRegister).WillOnce(Return(false));
+    EXPECT_CALL(*modbusClientMock, readHoldingRegister(1, 4, _))
+      .WillRepeatedly(DoAll(SetArgReferee<2>(uint16_t{0x0011}), Return(true)));
+    EXPECT_CALL(*modbusClientMock, writeHoldingRegister(1, 4, 0x0015)).Times(2).WillRepeatedly(Return(true));
+    EXPECT_TRUE(reader->writeBitMapping(*mapping, true));
+    EXPECT_EQ(device->getMaskWriteSupport(), MaskWriteSupport::UNSUPPORTED);
+
+    // The device is not probed again.
+    EXPECT_TRUE(reader->writeBitMapping(*mapping, true));
+}
+
+TEST_F(ModbusReaderTests, WriteMappingsBatchesAdjacentMappings)
+{
+    using namespace wolkabout::more_modbus;
+    const auto reader = std::make_shared<ModbusReader>(*modbusClientMock, std::chrono::milliseconds(500));
+    auto mappings = std::vector<std::shared_ptr<RegisterMapping>>{};
+    for (const auto address : {2, 0, 1, 5})
+        mappings.emplace_back(
+          std::make_shared<BoolMapping>("C" + std::to_string(address), RegisterType::COIL, address));
+    for (const auto address : {10, 11})
+        mappings.emplace_back(
+          std::make_shared<UInt16Mapping>("HR" + std::to_string(address), RegisterType::HOLDING_REGISTER, address));
+    const auto first = std::make_shared<ModbusDevice>("First", 1);
+    first->createGroups(mappings);
+    reader->addDevice(first);
+    const auto otherMapping = std::make_shared<UInt16Mapping>("HR", RegisterType::HOLDING_REGISTER, 12);
+    const auto second = std::make_shared<ModbusDevice>("Second", 2);
+    second->createGroups({otherMapping});
+    reader->addDevice(second);
+
+    EXPECT_CALL(*modbusClientMock, writeCoils(1, 0, ElementsAre(false, true, true))).WillOnce(Return(true));
+    EXPECT_CALL(*modbusClientMock, writeCoil(1, 5, true)).WillOnce(Return(false));
+    EXPECT_CALL(*modbusClientMock, writeHoldingRegisters(1, 10, ElementsAre(7, 8))).WillOnce(Return(true));
+    EXPECT_CALL(*modbusClientMock, writeHoldingRegister(2, 12, 9)).WillOnce(Return(true));
+
+    const auto results = reader->writeMappings({{mappings[0], {}, true},
+                                                {mappings[1], {}, false},
+                                                {otherMapping, {9}, false},
+                                                {mappings[2], {}, true},
+                                                {mappings[3], {}, true},
+                                                {mappings[5], {8}, false},
+                                                {mappings[4], {7}, false}});
+    EXPECT_EQ(results, (std::vector<bool>{true, true, true, true, false, true, true}));
+    EXPECT_FALSE(mappings[3]->isValid());
+
+    EXPECT_THROW(reader->writeMappings({{mappings[4], {1, 2}, false}}), std::logic_error);
+}
+
+TEST_F(ModbusReaderTests, PlanWritesRespectsTheFrameLimit)
+{
+    using namespace wolkabout::more_modbus;
+    auto writes = std::vector<MappingWrite>{};
+    for (auto address = 0; address < 2000; ++address)
+    {
+        auto mapping = std::make_shared<BoolMapping>("C", RegisterType::COIL, static_cast<int16_t>(address));
+        mapping->setSlaveAddress(1);
+        writes.emplace_back(MappingWrite{mapping, {}, address % 2 == 0});
+    }
+
+    const auto frames = ModbusReader::planWrites(writes);
+    ASSERT_EQ(frames.size(), 2);
+    EXPECT_EQ(frames[0].count, ModbusClient::MAX_WRITE_COILS);
+    EXPECT_EQ(frames[1].address, ModbusClient::MAX_WRITE_COILS);
+    EXPECT_EQ(frames[1].coils.size(), 2000 - ModbusClient::MAX_WRITE_COILS);
+}
+
+TEST_F(ModbusReaderTests, CircuitBreakerProbesOfflineDevice)
+{
+    using namespace wolkabout::more_modbus;
+    const auto reader = std::make_shared<ModbusReader>(*modbusClientMock, std::chrono::milliseconds(500));
+    reader->setCircuitBreaker(2, std::chrono::milliseconds(50), std::chrono::milliseconds(200));
+    const auto device = std::make_shared<ModbusDevice>("Device", 1);
+    device->createGroups({std::make_shared<UInt16Mapping>("HR", RegisterType::HOLDING_REGISTER, 5),
+                          std::make_shared<BoolMapping>("C", RegisterType::COIL, 0)});
+    device->setLivenessRegister(RegisterType::HOLDING_REGISTER, 100);
+    auto statuses = std::vector<bool>{};
+    device->setOnStatusChange([&](bool status) { statuses.emplace_back(status); });
+    reader->addDevice(device);
+
+    // Two failed reads open the circuit, and the groups are not read anymore.
+    EXPECT_CALL(*modbusClientMock, readHoldingRegisters(1, 5, 1, An<std::vector<uint16_t>&>()))
+      .Times(2)
+      .WillRepeatedly(Return(false));
+    EXPECT_CALL(*modbusClientMock, readCoils(1, 0, 1, An<std::vector<bool>&>())).Times(2).WillRepeatedly(Return(false));
+    EXPECT_FALSE(reader->readDeviceGroups(device));
+    EXPECT_FALSE(reader->isCircuitOpen(1));
+    EXPECT_FALSE(reader->readDeviceGroups(device));
+    EXPECT_TRUE(reader->isCircuitOpen(1));
+    EXPECT_FALSE(reader->readDeviceGroups(device));
+    Mock::VerifyAndClearExpectations(modbusClientMock.get());
+
+    // Once the backoff expires, the liveness register is probed, and a failed probe keeps the circuit open.
+    EXPECT_CALL(*modbusClientMock, readHoldingRegister(1, 100, _)).WillOnce(Return(false)).WillOnce(Return(true));
+    std::this_thread::sleep_for(std::chrono::milliseconds(55));
+    EXPECT_FALSE(reader->readDeviceGroups(device));
+    EXPECT_TRUE(reader->isCircuitOpen(1));
+
+    // The backoff has doubled, and the successful probe resumes the full reads.
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    EXPECT_FALSE(reader->readDeviceGroups(device));
+    std::this_thread::sleep_for(std::chrono::milliseconds(60));
+    EXPECT_CALL(*modbusClientMock, readHoldingRegisters(1, 5, 1, An<std::vector<uint16_t>&>()))
+      .WillOnce(DoAll(SetArgReferee<3>(std::vector<uint16_t>{1}), Return(true)));
+    EXPECT_CALL(*modbusClientMock, readCoils(1, 0, 1, An<std::vector<bool>&>()))
+      .WillOnce(DoAll(SetArgReferee<3>(std::vector<bool>{true}), Return(true)));
+    EXPECT_TRUE(reader->readDeviceGroups(device));
+    EXPECT_FALSE(reader->isCircuitOpen(1));
+    EXPECT_EQ(statuses, (std::vector<bool>{false, true}));
+}
+
+TEST_F(ModbusReaderTests, ReconnectDelaysBackOffWithJitter)
+{
+    using namespace wolkabout::more_modbus;
+    const auto reader = std::make_shared<ModbusReader>(*modbusClientMock, std::chrono::milliseconds(500));
+    reader->setReconnectDelays(std::chrono::seconds(1), std::chrono::seconds(8));
+    EXPECT_THROW(reader->setReconnectDelays(std::chrono::seconds(2), std::chrono::seconds(1)), std::logic_error);
+
+    for (const auto expected : {1, 2, 4, 8, 8})
+    {
+        const auto before = std::chrono::steady_clock::now();
+        reader->scheduleReconnect();
+        const auto delay = reader->m_connectionState.nextAttempt - before;
+        EXPECT_GE(delay, std::chrono::milliseconds(expected * 500));
+        EXPECT_LE(delay, std::chrono::milliseconds(expected * 1000 + 100));
+    }
+    EXPECT_EQ(reader->m_connectionState.failedAttempts, 5);
+}
+
+TEST_F(ModbusReaderTests, StopInterruptsTheReconnect)
+{
+    using namespace wolkabout::more_modbus;
+    const auto reader = std::make_shared<ModbusReader>(*modbusClientMock, std::chrono::milliseconds(50));
+    reader->setReconnectDelays(std::chrono::minutes(10), std::chrono::hours(1));
+
+    // The first connection succeeds, and is lost right after.
+    EXPECT_CALL(*modbusClientMock, isConnected).WillRepeatedly(Return(false));
+    EXPECT_CALL(*modbusClientMock, connect).WillOnce(Return(true)).WillRepeatedly(Return(false));
+    ASSERT_TRUE(reader->start());
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    EXPECT_GE(reader->m_connectionState.failedAttempts, 1);
+
+    const auto start = std::chrono::steady_clock::now();
+    reader->stop();
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(1));
+}
+
+TEST_F(ModbusReaderTests, GroupsAreReadAtTheirOwnPeriods)
+{
+    using namespace wolkabout::more_modbus;
+    const auto reader = std::make_shared<ModbusReader>(*modbusClientMock, std::chrono::milliseconds(1000));
+    const auto fast = std::make_shared<UInt16Mapping>("Alarm", RegisterType::HOLDING_REGISTER, 10);
+    fast->setReadPeriod(std::chrono::milliseconds(50));
+    const auto device = std::make_shared<ModbusDevice>("Device", 1);
+    device->createGroups({std::make_shared<UInt16Mapping>("Nameplate", RegisterType::HOLDING_REGISTER, 0), fast});
+    reader->addDevice(device);
+    ASSERT_EQ(device->getGroups().size(), 2);
+    const auto& slow = device->getGroups()[0];
+    const auto& alarm = device->getGroups()[1];
+    EXPECT_EQ(reader->getPollPeriod(), std::chrono::milliseconds(50));
+
+    // Every group is due at first, after that only the fast one until the read period of the reader passes.
+    const auto start = std::chrono::steady_clock::now();
+    EXPECT_EQ(reader->takeDueGroups(*device, start), (std::vector<std::shared_ptr<RegisterGroup>>{slow, alarm}));
+    EXPECT_EQ(reader->nextGroupRead(*device), start + std::chrono::milliseconds(50));
+    EXPECT_TRUE(reader->takeDueGroups(*device, start + std::chrono::milliseconds(20)).empty());
+    for (const auto offset : {60, 110, 160})
+    {
+        EXPECT_EQ(reader->takeDueGroups(*device, start + std::chrono::milliseconds(offset)),
+                  (std::vector<std::shared_ptr<RegisterGroup>>{alarm}));
+    }
+
+    // The group whose deadline passed first is read first.
+    EXPECT_EQ(reader->takeDueGroups(*device, start + std::chrono::milliseconds(1001)),
+              (std::vector<std::shared_ptr<RegisterGroup>>{alarm, slow}));
+
+    // Polling only reads the groups that are due.
+    EXPECT_CALL(*modbusClientMock, isConnected).WillRepeatedly(Return(true));
+    EXPECT_CALL(*modbusClientMock, readHoldingRegisters(1, 10, 1, An<std::vector<uint16_t>&>()))
+      .WillOnce(DoAll(SetArgReferee<3>(std::vector<uint16_t>{1}), Return(true)));
+    EXPECT_CALL(*modbusClientMock, readHoldingRegisters(1, 0, 1, An<std::vector<uint16_t>&>())).Times(0);
+    reader->m_groupDeadlines[1] = {std::chrono::steady_clock::time_point::max(), std::chrono::steady_clock::now()};
+    EXPECT_TRUE(reader->poll());
+    EXPECT_TRUE(reader->poll());
+}
+
+TEST_F(ModbusReaderTests, ReadsManyDevicesOnFixedWorkers)
+{
+    using namespace wolkabout::more_modbus;
+    const auto reader = std::make_shared<ModbusReader>(*modbusClientMock, std::chrono::milliseconds(50), 2);
+    const auto deviceCount = 20;
+    auto reads = std::vector<std::atomic_int>(deviceCount + 1);
+    for (auto i = 1; i <= deviceCount; ++i)
+    {
+        const auto device = std::make_shared<ModbusDevice>("Device" + std::to_string(i), i);
+        device->createGroups({std::make_shared<UInt16Mapping>("HR", RegisterType::HOLDING_REGISTER, 0)});
+        reader->addDevice(device);
+    }
+
+    EXPECT_CALL(*modbusClientMock, isConnected).WillRepeatedly(Return(true));
+    EXPECT_CALL(*modbusClientMock, readHoldingRegisters(_, 0, 1, An<std::vector<uint16_t>&>()))
+      .WillRepeatedly(DoAll(Invoke([&](int slaveAddress, int, int, std::vector<uint16_t>&) { ++reads[slaveAddress]; }),
+                            SetArgReferee<3>(std::vector<uint16_t>{1}), Return(true)));
+    ASSERT_TRUE(reader->start());
+
+    // Every device is read in its period, while the number of threads doesn't depend on the number of devices.
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(3);
+    auto allRead = false;
+    while (!allRead && std::chrono::steady_clock::now() < deadline)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        allRead = std::all_of(reads.begin() + 1, reads.end(), [](const std::atomic_int& count) { return count >= 3; });
+    }
+    EXPECT_TRUE(allRead);
+    EXPECT_EQ(reader->m_workers.size(), 2);
+    reader->stop();
+    EXPECT_TRUE(reader->m_workers.empty());
+}
+
+TEST_F(ModbusReaderTests, PooledConnectionsAreReadAtOnce)
+{
+    using namespace wolkabout::more_modbus;
+    auto executing = std::atomic_int{0};
+    auto overlapped = std::atomic_bool{false};
+    auto clients = std::vector<std::unique_ptr<ModbusClient>>{};
+    for (auto i = 0; i < 2; ++i)
+    {
+        auto mock = std::unique_ptr<NiceMock<ModbusClientMock>>(new NiceMock<ModbusClientMock>);
+        EXPECT_CALL(*mock, connect).WillRepeatedly(Return(true));
+        EXPECT_CALL(*mock, isConnected).WillRepeatedly(Return(true));
+        EXPECT_CALL(*mock, readHoldingRegisters(_, 0, 1, An<std::vector<uint16_t>&>()))
+          .WillRepeatedly(DoAll(Invoke([&](int, int, int, std::vector<uint16_t>&) {
+                                    if (++executing > 1)
+                                        overlapped = true;
+                                    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+                                    --executing;
+                                }),
+                                SetArgReferee<3>(std::vector<uint16_t>{1}), Return(true)));
+        clients.emplace_back(std::move(mock));
+    }
+    auto pool = ModbusClientPool{std::move(clients)};
+
+    // The bus scheduler has a lane for each connection, so the requests of two slaves are on the wire together.
+    const auto reader = std::make_shared<ModbusReader>(pool, std::chrono::milliseconds(50), 2);
+    EXPECT_EQ(reader->getBusScheduler().getLaneCount(), 2);
+    for (auto i = 1; i <= 2; ++i)
+    {
+        const auto device = std::make_shared<ModbusDevice>("Device" + std::to_string(i), i);
+        device->createGroups({std::make_shared<UInt16Mapping>("HR", RegisterType::HOLDING_REGISTER, 0)});
+        reader->addDevice(device);
+    }
+    ASSERT_TRUE(reader->start());
+
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(3);
+    while (!overlapped && std::chrono::steady_clock::now() < deadline)
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    EXPECT_TRUE(overlapped);
+    reader->stop();
+}
+
+TEST_F(ModbusReaderTests, AddingRewritableWakesTheReader)
+{
+    using namespace wolkabout::more_modbus;
+    const auto reader = std::make_shared<ModbusReader>(*modbusClientMock, std::chrono::seconds(10));
+    const auto restricted = std::make_shared<UInt16Mapping>("Setpoint", RegisterType::HOLDING_REGISTER, 5, true);
+    const auto device = std::make_shared<ModbusDevice>("Device", 1);
+    device->createGroups({std::make_shared<UInt16Mapping>("HR", RegisterType::HOLDING_REGISTER, 0), restricted});
+    reader->addDevice(device);
+
+    EXPECT_CALL(*modbusClientMock, isConnected).WillRepeatedly(Return(true));
+    EXPECT_CALL(*modbusClientMock, readHoldingRegisters(1, 0, 1, An<std::vector<uint16_t>&>()))
+      .WillRepeatedly(DoAll(SetArgReferee<3>(std::vector<uint16_t>{1}), Return(true)));
+    auto written = std::atomic_bool{false};
+    EXPECT_CALL(*modbusClientMock, writeHoldingRegister(1, 5, _)).WillOnce(DoAll(Assign(&written, true), Return(true)));
+    ASSERT_TRUE(reader->start());
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+    // The reader sleeps for the read period, but the new rewritable mapping is written right away.
+    restricted->setRepeatedWrite(std::chrono::minutes(1));
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+    while (!written && std::chrono::steady_clock::now() < deadline)
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    EXPECT_TRUE(written);
+    reader->stop();
+}
+
+TEST_F(ModbusReaderTests, AsyncWritesCompleteWithoutBlocking)
+{
+    using namespace wolkabout::more_modbus;
+    const auto reader = std::make_shared<ModbusReader>(*modbusClientMock, std::chrono::seconds(10));
+    const auto coil = std::make_shared<BoolMapping>("C", RegisterType::COIL, 3);
+    const auto setpoint = std::make_shared<UInt16Mapping>("Setpoint", RegisterType::HOLDING_REGISTER, 5, true);
+    const auto device = std::make_shared<ModbusDevice>("Device", 1);
+    device->createGroups({coil, setpoint});
+    reader->addDevice(device);
+
+    EXPECT_CALL(*modbusClientMock, isConnected).WillRepeatedly(Return(true));
+    EXPECT_CALL(*modbusClientMock, readCoils(1, 3, 1, _))
+      .WillRepeatedly(DoAll(SetArgReferee<3>(std::vector<bool>{false}), Return(true)));
+    EXPECT_CALL(*modbusClientMock, writeCoil(1, 3, true)).WillOnce(Return(true));
+    EXPECT_CALL(*modbusClientMock, writeHoldingRegisters(1, 5, An<std::vector<uint16_t>&>())).WillOnce(Return(false));
+    ASSERT_TRUE(reader->start());
+
+    // Both of the writes are queued before either of them completes.
+    auto coilWrite = coil->writeValueAsync(true);
+    auto setpointWritten = std::promise<bool>{};
+    setpoint->writeValueAsync(std::vector<uint16_t>{7}, [&](bool written) { setpointWritten.set_value(written); });
+    EXPECT_TRUE(coilWrite.get());
+    EXPECT_FALSE(setpointWritten.get_future().get());
+    EXPECT_FALSE(setpoint->isValid());
+    reader->stop();
+
+    // The mapping is checked before the write is queued, and without the scheduler the write completes right away.
+    EXPECT_THROW(reader->writeMappingAsync(*coil, std::vector<uint16_t>{1}), std::logic_error);
+    EXPECT_CALL(*modbusClientMock, writeCoil(1, 3, false)).WillOnce(Return(true));
+    auto called = false;
+    reader->writeMappingAsync(*coil, false, [&](bool written) { called = written; });
+    EXPECT_TRUE(called);
+}
+
+TEST_F(ModbusReaderTests, WritesWaitForOneGroupRead)
+{
+    using namespace wolkabout::more_modbus;
+    using namespace std::chrono;
+    const auto reader = std::make_shared<ModbusReader>(*modbusClientMock, seconds(10));
+    const auto setpoint = std::make_shared<UInt16Mapping>("Setpoint", RegisterType::HOLDING_REGISTER, 100, true);
+    auto mappings = std::vector<std::shared_ptr<RegisterMapping>>{setpoint};
+    for (auto address = 0; address < 40; address += 10)
+        mappings.emplace_back(std::make_shared<UInt16Mapping>("HR" + std::to_string(address),
+                                                              RegisterType::HOLDING_REGISTER, address));
+    const auto device = std::make_shared<ModbusDevice>("Device", 1);
+    device->createGroups(mappings);
+    ASSERT_EQ(device->getGroups().size(), 5);
+    reader->addDevice(device);
+
+    auto reading = std::atomic_bool{false};
+    EXPECT_CALL(*modbusClientMock, isConnected).WillRepeatedly(Return(true));
+    EXPECT_CALL(*modbusClientMock, readHoldingRegisters(1, _, 1, An<std::vector<uint16_t>&>()))
+      .WillRepeatedly(DoAll(Invoke([&](int, int, int, std::vector<uint16_t>&) {
+                                reading = true;
+                                std::this_thread::sleep_for(milliseconds(100));
+                            }),
+                            SetArgReferee<3>(std::vector<uint16_t>{1}), Return(true)));
+    EXPECT_CALL(*modbusClientMock, writeHoldingRegisters(1, 100, An<std::vector<uint16_t>&>()))
+      .WillOnce(Return(true));
+    ASSERT_TRUE(reader->start());
+
+    // The write is submitted while the first of the four group reads is on the bus, and goes right after it.
+    const auto deadline = steady_clock::now() + seconds(1);
+    while (!reading && steady_clock::now() < deadline)
+        std::this_thread::sleep_for(milliseconds(1));
+    ASSERT_TRUE(reading);
+    EXPECT_TRUE(setpoint->writeValueAsync(std::vector<uint16_t>{7}).get());
+    reader->stop();
+
+    const auto wait = reader->getBusScheduler().getQueueWait(ModbusBusScheduler::Priority::HIGH);
+    EXPECT_EQ(wait.requests, 1);
+    EXPECT_LT(wait.maximum, milliseconds(200));
+}
+
+TEST_F(ModbusReaderTests, DeadlinesStayOnThePeriodGrid)
+{
+    using namespace wolkabout::more_modbus;
+    using namespace std::chrono;
+    const auto reader = std::make_shared<ModbusReader>(*modbusClientMock, milliseconds(100));
+    const auto device = std::make_shared<ModbusDevice>("Device", 1);
+    device->createGroups({std::make_shared<UInt16Mapping>("HR", RegisterType::HOLDING_REGISTER, 0)});
+    EXPECT_THROW(device->setPhaseOffset(milliseconds(-1)), std::logic_error);
+    device->setPhaseOffset(milliseconds(50));
+    reader->addDevice(device);
+
+    // The first read is due at the phase offset.
+    const auto start = steady_clock::now();
+    EXPECT_TRUE(reader->takeDueGroups(*device, start).empty());
+    EXPECT_EQ(reader->nextGroupRead(*device), start + milliseconds(50));
+
+    // A late read doesn't move the next deadline.
+    EXPECT_EQ(reader->takeDueGroups(*device, start + milliseconds(53)).size(), 1);
+    EXPECT_EQ(reader->nextGroupRead(*device), start + milliseconds(150));
+
+    // The reads missed while the device was busy are skipped, and the deadlines stay on the grid.
+    EXPECT_EQ(reader->takeDueGroups(*device, start + milliseconds(390)).size(), 1);
+    EXPECT_EQ(reader->nextGroupRead(*device), start + milliseconds(450));
+
+    const auto timing = reader->getPollTiming(1);
+    EXPECT_EQ(timing.reads, 2);
+    EXPECT_EQ(timing.overruns, 2);
+    EXPECT_EQ(timing.lastJitter, milliseconds(240));
+    EXPECT_EQ(timing.maxJitter, milliseconds(240));
+    EXPECT_EQ(timing.totalJitter, milliseconds(243));
+    EXPECT_EQ(reader->getPollTiming(2).reads, 0);
+}
+
+TEST_F(ModbusReaderTests, QuietGroupsAreReadLessOften)
+{
+    using namespace wolkabout::more_modbus;
+    using namespace std::chrono;
+    const auto reader = std::make_shared<ModbusReader>(*modbusClientMock, milliseconds(100));
+    EXPECT_THROW(reader->setAdaptivePolling(milliseconds(400), 1.0), std::logic_error);
+    reader->setAdaptivePolling(milliseconds(400));
+    const auto device = std::make_shared<ModbusDevice>("Device", 1);
+    device->createGroups({std::make_shared<UInt16Mapping>("HR", RegisterType::HOLDING_REGISTER, 0)});
+    reader->addDevice(device);
+    const auto& group = device->getGroups()[0];
+
+    // Reads that don't change anything double the period, up to the maximum.
+    auto now = steady_clock::now();
+    for (const auto period : {200, 400, 400})
+    {
+        const auto due = reader->takeDueGroups(*device, now);
+        ASSERT_EQ(due.size(), 1);
+        group->countRead(false);
+        reader->adaptReadPeriods(*device, due);
+        EXPECT_EQ(reader->getCurrentReadPeriod(1, 0), milliseconds(period));
+        now = reader->nextGroupRead(*device);
+    }
+
+    // A failed read keeps the period.
+    auto due = reader->takeDueGroups(*device, now);
+    reader->adaptReadPeriods(*device, due);
+    EXPECT_EQ(reader->getCurrentReadPeriod(1, 0), milliseconds(400));
+    now = reader->nextGroupRead(*device);
+
+    // The first change brings the group back to its own period.
+    due = reader->takeDueGroups(*device, now);
+    group->countRead(true);
+    reader->adaptReadPeriods(*device, due);
+    EXPECT_EQ(reader->getCurrentReadPeriod(1, 0), milliseconds(100));
+    EXPECT_EQ(reader->nextGroupRead(*device), now + milliseconds(100));
+    EXPECT_EQ(group->getReadCount(), 4);
+    EXPECT_EQ(group->getChangeCount(), 1);
+    EXPECT_EQ(reader->getCurrentReadPeriod(2, 0), milliseconds(0));
+}
@@ -0,0 +1,257 @@
+/**
+ * Copyright 2023 Wolkabout Technology s.r.o.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#define private public
+#define protected public
+#include "more_modbus/modbus/PipelinedTcpIpClient.h"
+#undef private
+#undef protected
+
+#include "more_modbus/modbus/ModbusTcpCodec.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+
+using namespace wolkabout::more_modbus;
+
+class PipelinedTcpIpClientTests : public ::testing::Test
+{
+public:
+    void SetUp() override
+    {
+        listener = socket(AF_INET, SOCK_STREAM, 0);
+        ASSERT_NE(listener, -1);
+        auto address = sockaddr_in{};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        address.sin_port = 0;
+        ASSERT_EQ(bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)), 0);
+        ASSERT_EQ(listen(listener, 1), 0);
+        auto length = static_cast<socklen_t>(sizeof(address));
+        getsockname(listener, reinterpret_cast<sockaddr*>(&address), &length);
+        port = ntohs(address.sin_port);
+    }
+
+    void TearDown() override
+    {
+        if (server.joinable())
+            server.join();
+        close(listener);
+    }
+
+    // Reads a single request frame from the connection.
+    static bool readFrame(int connection, std::vector<std::uint8_t>& frame)
+    {
+        frame.resize(ModbusTcpCodec::HEADER_SIZE);
+        if (recv(connection, frame.data(), frame.size(), MSG_WAITALL) != static_cast<ssize_t>(frame.size()))
+            return false;
+        const auto length = static_cast<std::size_t>((frame[4] << 8) | frame[5]);
+        frame.resize(ModbusTcpCodec::HEADER_SIZE - 1 + length);
+        const auto rest = frame.size() - ModbusTcpCodec::HEADER_SIZE;
+        return recv(connection, frame.data() + ModbusTcpCodec::HEADER_SIZE, rest, MSG_WAITALL) ==
+               static_cast<ssize_t>(rest);
+    }
+
+    // Responds to a read holding registers request with registers holding their own addresses.
+    static void respond(int connection, const std::vector<std::uint8_t>& request)
+    {
+        const auto transactionId = static_cast<std::uint16_t>((request[0] << 8) | request[1]);
+        const auto address = (request[8] << 8) | request[9];
+        const auto number = (request[10] << 8) | request[11];
+        auto pdu = std::vector<std::uint8_t>{request[7], static_cast<std::uint8_t>(number * 2)};
+        for (auto i = 0; i < number; ++i)
+        {
+            pdu.emplace_back(static_cast<std::uint8_t>((address + i) >> 8));
+            pdu.emplace_back(static_cast<std::uint8_t>((address + i) & 0xFF));
+        }
+        const auto frame = ModbusTcpCodec::encodeFrame(transactionId, request[6], pdu);
+        send(connection, frame.data(), frame.size(), MSG_NOSIGNAL);
+    }
+
+    int listener = -1;
+    std::uint16_t port = 0;
+    std::thread server;
+};
+
+TEST_F(PipelinedTcpIpClientTests, EncodeFrame)
+{
+    const auto frame =
+      ModbusTcpCodec::encodeFrame(0x0102, 7, ModbusTcpCodec::readPdu(ModbusReadFunction::READ_INPUT_REGISTERS, 10, 3));
+    EXPECT_EQ(frame, (std::vector<std::uint8_t>{0x01, 0x02, 0x00, 0x00, 0x00, 0x06, 0x07, 0x04, 0x00, 0x0A, 0x00,
+                                                0x03}));
+
+    auto header = ModbusTcpCodec::Header{};
+    ASSERT_TRUE(ModbusTcpCodec::decodeHeader(frame.data(), frame.size(), header));
+    EXPECT_EQ(header.transactionId, 0x0102);
+    EXPECT_EQ(header.length, 6);
+    EXPECT_EQ(header.unitId, 7);
+}
+
+TEST_F(PipelinedTcpIpClientTests, DecodeResponses)
+{
+    auto bits = std::vector<bool>{};
+    EXPECT_TRUE(ModbusTcpCodec::decodeBits(ModbusReadFunction::READ_COILS, 10, {0x01, 0x02, 0x05, 0x02}, bits));
+    EXPECT_EQ(bits, (std::vector<bool>{true, false, true, false, false, false, false, false, false, true}));
+
+    auto registers = std::vector<std::uint16_t>{};
+    EXPECT_FALSE(
+      ModbusTcpCodec::decodeRegisters(ModbusReadFunction::READ_HOLDING_REGISTERS, 1, {0x83, 0x02}, registers));
+    EXPECT_TRUE(ModbusTcpCodec::isException({0x83, 0x02}));
+    EXPECT_TRUE(ModbusTcpCodec::decodeRegisters(ModbusReadFunction::READ_HOLDING_REGISTERS, 1, {0x03, 0x02, 0x12, 0x34},
+                                                registers));
+    EXPECT_EQ(registers, std::vector<std::uint16_t>{0x1234});
+
+    const auto request = ModbusTcpCodec::writeRegisterPdu(5, 0xABCD);
+    EXPECT_TRUE(ModbusTcpCodec::checkWriteResponse(request, request));
+    EXPECT_FALSE(ModbusTcpCodec::checkWriteResponse(request, {0x86, 0x01}));
+
+    const auto coils =
+      ModbusTcpCodec::writeCoilsPdu(19, {true, false, true, true, false, false, true, true, true, false});
+    EXPECT_EQ(coils, (std::vector<std::uint8_t>{0x0F, 0x00, 0x13, 0x00, 0x0A, 0x02, 0xCD, 0x01}));
+    EXPECT_TRUE(ModbusTcpCodec::checkWriteResponse(coils, {0x0F, 0x00, 0x13, 0x00, 0x0A}));
+}
+
+TEST_F(PipelinedTcpIpClientTests, BatchIsPipelined)
+{
+    const auto requestCount = 4;
+    server = std::thread([&] {
+        const auto connection = accept(listener, nullptr, nullptr);
+        // All the requests have to arrive before any of them is answered, and the answers go out in reverse order.
+        auto frames = std::vector<std::vector<std::uint8_t>>(requestCount);
+        for (auto& frame : frames)
+            ASSERT_TRUE(readFrame(connection, frame));
+        for (auto it = frames.rbegin(); it != frames.rend(); ++it)
+            respond(connection, *it);
+        close(connection);
+    });
+
+    auto client = PipelinedTcpIpClient{"127.0.0.1", port, std::chrono::milliseconds{2000}, 4};
+    ASSERT_TRUE(client.connect());
+
+    auto requests = std::vector<ModbusReadRequest>{};
+    for (auto i = 0; i < requestCount; ++i)
+        requests.emplace_back(
+          ModbusReadRequest{i + 1, ModbusReadFunction::READ_HOLDING_REGISTERS, i * 10, 2, {}, {}, false});
+    EXPECT_TRUE(client.readBatch(requests));
+
+    for (auto i = 0; i < requestCount; ++i)
+    {
+        EXPECT_TRUE(requests[i].success);
+        const auto address = static_cast<std::uint16_t>(i * 10);
+        const auto expected = std::vector<std::uint16_t>{address, static_cast<std::uint16_t>(address + 1)};
+        EXPECT_EQ(requests[i].registers, expected);
+    }
+}
+
+TEST_F(PipelinedTcpIpClientTests, WindowLimitsRequestsInFlight)
+{
+    const auto requestCount = 6;
+    auto maxOutstanding = 0;
+    server = std::thread([&] {
+        const auto connection = accept(listener, nullptr, nullptr);
+        auto handled = 0;
+        while (handled < requestCount)
+        {
+            // Collect everything the client sends before it starts waiting for responses.
+            auto frames = std::vector<std::vector<std::uint8_t>>{};
+            auto descriptor = pollfd{connection, POLLIN, 0};
+            while (poll(&descriptor, 1, 100) == 1)
+            {
+                frames.emplace_back();
+                ASSERT_TRUE(readFrame(connection, frames.back()));
+            }
+            maxOutstanding = std::max(maxOutstanding, static_cast<int>(frames.size()));
+            for (const auto& frame : frames)
+                respond(connection, frame);
+            handled += static_cast<int>(frames.size());
+        }
+        close(connection);
+    });
+
+    auto client = PipelinedTcpIpClient{"127.0.0.1", port, std::chrono::milliseconds{2000}, 2};
+    ASSERT_TRUE(client.connect());
+
+    auto requests = std::vector<ModbusReadRequest>{};
+    for (auto i = 0; i < requestCount; ++i)
+        requests.emplace_back(ModbusReadRequest{1, ModbusReadFunction::READ_INPUT_REGISTERS, i, 1, {}, {}, false});
+    EXPECT_TRUE(client.readBatch(requests));
+    server.join();
+    EXPECT_EQ(maxOutstanding, 2);
+}
+
+TEST_F(PipelinedTcpIpClientTests, TimeoutAndDisconnect)
+{
+    server = std::thread([&] {
+        const auto connection = accept(listener, nullptr, nullptr);
+        auto frame = std::vector<std::uint8_t>{};
+        readFrame(connection, frame);
+        // Never respond, and close the connection after the request has timed out.
+        std::this_thread::sleep_for(std::chrono::milliseconds{200});
+        close(connection);
+    });
+
+    auto client = PipelinedTcpIpClient{"127.0.0.1", port, std::chrono::milliseconds{100}, 2};
+    ASSERT_TRUE(client.connect());
+
+    auto value = std::uint16_t{};
+    EXPECT_FALSE(client.readHoldingRegister(1, 0, value));
+    EXPECT_TRUE(client.isConnected());
+
+    // The next read finds out that the other side has closed the connection.
+    server.join();
+    EXPECT_FALSE(client.readHoldingRegister(1, 0, value));
+    EXPECT_FALSE(client.isConnected());
+}
+
+TEST_F(PipelinedTcpIpClientTests, AdaptiveTimeouts)
+{
+    auto responded = std::atomic_bool{false};
+    server = std::thread([&] {
+        const auto connection = accept(listener, nullptr, nullptr);
+        auto frame = std::vector<std::uint8_t>{};
+        if (readFrame(connection, frame))
+            respond(connection, frame);
+        responded = true;
+        // Never respond to the second request.
+        readFrame(connection, frame);
+        std::this_thread::sleep_for(std::chrono::milliseconds{300});
+        close(connection);
+    });
+
+    auto client = PipelinedTcpIpClient{"127.0.0.1", port, std::chrono::milliseconds{5000}, 2};
+    client.enableAdaptiveTimeouts(std::chrono::milliseconds{20}, std::chrono::milliseconds{1000});
+    ASSERT_TRUE(client.connect());
+
+    // The measured round trip brings the timeout down to the floor, so the second request doesn't wait 5 seconds.
+    auto value = std::uint16_t{};
+    EXPECT_TRUE(client.readHoldingRegister(1, 0, value));
+    EXPECT_TRUE(responded);
+    EXPECT_EQ(client.getResponseTimeout(1, 3), std::chrono::milliseconds{20});
+
+    const auto start = std::chrono::steady_clock::now();
+    EXPECT_FALSE(client.readHoldingRegister(1, 0, value));
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::milliseconds{1000});
+    EXPECT_GT(client.getResponseTimeout(1, 3), std::chrono::milliseconds{20});
+}
@@ -39,12 +39,15 @@
 #include "more_modbus/mappings/StringMapping.h"
 #include "more_modbus/mappings/UInt16Mapping.h"
 #include "more_modbus/mappings/UInt32Mapping.h"
+#include "more_modbus/modbus/ModbusGroupReader.h"
+#include "more_modbus/utilities/DataParsers.h"
 
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 
 #include <iostream>
 #include <memory>
+#include <thread>
 
 class ProperReadingTest : public ::testing::Test
 {
@@ -161,3 +164,226 @@ TEST_F(ProperReadingTest, InitializeReader)
     EXPECT_NO_THROW(reader->stop());
     std::this_thread::sleep_for(std::chrono::milliseconds(2000));
 }
+
+TEST_F(ProperReadingTest, GroupValuesArePassedToMappings)
+{
+    const auto boolData = std::vector<bool>{true};
+    const auto holdingData = std::vector<uint16_t>{1, 2, 3, 4, 0x15, 0x4865, 0x7921, 0, 0, 0};
+    const auto inputData = std::vector<uint16_t>(6, 0);
+
+    EXPECT_CALL(*modbusClientMock, readCoils).WillRepeatedly(DoAll(SetArgReferee<3>(boolData), Return(true)));
+    EXPECT_CALL(*modbusClientMock, readInputContacts).WillRepeatedly(DoAll(SetArgReferee<3>(boolData), Return(true)));
+    EXPECT_CALL(*modbusClientMock, readHoldingRegisters)
+      .WillRepeatedly(DoAll(SetArgReferee<3>(holdingData), Return(true)));
+    EXPECT_CALL(*modbusClientMock, readInputRegisters).WillRepeatedly(DoAll(SetArgReferee<3>(inputData), Return(true)));
+
+    // The groups are read into their own buffers, and reading them again doesn't change anything.
+    for (auto i = 0; i < 2; ++i)
+    {
+        EXPECT_EQ(wolkabout::more_modbus::ModbusGroupReader::readGroups(*modbusClientMock, device->getGroups()), 0);
+
+        EXPECT_EQ(uint16Mapping->getValue(), 1);
+        EXPECT_TRUE(bitMapping->getBoolValue());
+        EXPECT_EQ(stringMapping->getValue(), "Hey!");
+        EXPECT_TRUE(coilMapping->getBoolValue());
+    }
+
+    auto bits = std::vector<bool>{};
+    for (const auto& mapping : mappings)
+    {
+        if (mapping->getReference().find("HRB") == 0)
+            bits.emplace_back(mapping->getBoolValue());
+    }
+    EXPECT_EQ(bits, (std::vector<bool>{true, true, true, false}));
+}
+
+TEST_F(ProperReadingTest, UnchangedReadsSkipTheMappings)
+{
+    const auto holdingData = std::vector<uint16_t>{1, 2, 3, 4, 0x15, 0x4865, 0x7921, 0, 0, 0};
+    EXPECT_CALL(*modbusClientMock, readHoldingRegisters)
+      .WillRepeatedly(DoAll(SetArgReferee<3>(holdingData), Return(true)));
+    auto changes = 0;
+    device->setOnMappingValueChange([&](const std::shared_ptr<wolkabout::more_modbus::RegisterMapping>&,
+                                        const std::vector<uint16_t>&) { ++changes; });
+
+    const auto& group = uint16Mapping->getGroup().lock();
+    ASSERT_NE(group, nullptr);
+    EXPECT_TRUE(wolkabout::more_modbus::ModbusGroupReader::readGroup(*modbusClientMock, *group));
+    EXPECT_EQ(changes, 5);
+    EXPECT_TRUE(group->hasLastRead());
+
+    // The last read is the one stored in the image of the device.
+    const auto image = device->getRegisterImage(wolkabout::more_modbus::RegisterType::HOLDING_REGISTER)
+                         .subspan(group->getImageOffset(), group->getAddressCount());
+    EXPECT_EQ(std::vector<uint16_t>(image.begin(), image.end()), holdingData);
+
+    // The same values are not passed to the mappings again.
+    EXPECT_TRUE(wolkabout::more_modbus::ModbusGroupReader::readGroup(*modbusClientMock, *group));
+    EXPECT_EQ(changes, 5);
+    EXPECT_EQ(group->getReadCount(), 2);
+    EXPECT_EQ(group->getChangeCount(), 1);
+
+    // Until a mapping changes outside of the read.
+    uint16Mapping->setValid(false);
+    EXPECT_FALSE(group->hasLastRead());
+    EXPECT_TRUE(wolkabout::more_modbus::ModbusGroupReader::readGroup(*modbusClientMock, *group));
+    EXPECT_EQ(uint16Mapping->getBytesValues(), std::vector<uint16_t>{1});
+    EXPECT_EQ(changes, 6);
+}
+
+TEST_F(ProperReadingTest, ForgettingDuringAReadIsNotLost)
+{
+    const auto holdingData = std::vector<uint16_t>{1, 2, 3, 4, 0x15, 0x4865, 0x7921, 0, 0, 0};
+    EXPECT_CALL(*modbusClientMock, readHoldingRegisters)
+      .WillRepeatedly(DoAll(SetArgReferee<3>(holdingData), Return(true)));
+    const auto& group = uint16Mapping->getGroup().lock();
+    ASSERT_NE(group, nullptr);
+
+    // A mapping written from another thread while the values of a read are passed makes the group forget the read
+    // being passed, so the values of the next read are passed again.
+    auto forgotten = false;
+    device->setOnMappingValueChange([&](const std::shared_ptr<wolkabout::more_modbus::RegisterMapping>&,
+                                        const std::vector<uint16_t>&) {
+        if (!forgotten)
+        {
+            forgotten = true;
+            std::thread([&] { uint16Mapping->setValid(false); }).join();
+        }
+    });
+    EXPECT_TRUE(wolkabout::more_modbus::ModbusGroupReader::readGroup(*modbusClientMock, *group));
+    EXPECT_FALSE(uint16Mapping->isValid());
+    EXPECT_FALSE(group->hasLastRead());
+
+    EXPECT_TRUE(wolkabout::more_modbus::ModbusGroupReader::readGroup(*modbusClientMock, *group));
+    EXPECT_TRUE(uint16Mapping->isValid());
+    EXPECT_TRUE(group->hasLastRead());
+}
+
+TEST_F(ProperReadingTest, ReadsAreStoredInTheDeviceImages)
+{
+    using namespace wolkabout::more_modbus;
+    const auto holdingData = std::vector<uint16_t>{1, 2, 3, 4, 0x15, 0x4865, 0x7921, 0, 0, 0};
+    EXPECT_CALL(*modbusClientMock, readCoils)
+      .WillRepeatedly(DoAll(SetArgReferee<3>(std::vector<bool>{true}), Return(true)));
+    EXPECT_CALL(*modbusClientMock, readInputContacts)
+      .WillRepeatedly(DoAll(SetArgReferee<3>(std::vector<bool>{false}), Return(true)));
+    EXPECT_CALL(*modbusClientMock, readHoldingRegisters)
+      .WillRepeatedly(DoAll(SetArgReferee<3>(holdingData), Return(true)));
+    EXPECT_CALL(*modbusClientMock, readInputRegisters)
+      .WillRepeatedly(DoAll(SetArgReferee<3>(std::vector<uint16_t>(6, 9)), Return(true)));
+    // The images are created with the groups, before anything is read.
+    ASSERT_EQ(uint16Mapping->getRegisterView().size(), 1);
+    EXPECT_EQ(uint16Mapping->getRegisterView()[0], 0);
+    EXPECT_EQ(ModbusGroupReader::readGroups(*modbusClientMock, device->getGroups()), 0);
+
+    const auto holdingImage = device->getRegisterImage(RegisterType::HOLDING_REGISTER);
+    EXPECT_EQ(std::vector<uint16_t>(holdingImage.begin(), holdingImage.end()), holdingData);
+    EXPECT_EQ(device->getRegisterImage(RegisterType::INPUT_REGISTER).size(), 6);
+    EXPECT_TRUE(device->getRegisterImage(RegisterType::COIL).empty());
+
+    // The mappings are views into the images.
+    EXPECT_EQ(uint16Mapping->getRegisterView()[0], 1);
+    const auto string = stringMapping->getRegisterView();
+    EXPECT_EQ(std::vector<uint16_t>(string.begin(), string.end()),
+              (std::vector<uint16_t>{0x4865, 0x7921, 0, 0, 0}));
+    EXPECT_EQ(bitMapping->getRegisterView()[0], 0x15);
+    EXPECT_EQ(nonWriteableFloatMapping->getRegisterView()[1], 9);
+    ASSERT_EQ(coilMapping->getBitView().size(), 1);
+    EXPECT_TRUE(coilMapping->getBitView()[0]);
+    EXPECT_FALSE(device->getBitImage(RegisterType::INPUT_CONTACT)[0]);
+    EXPECT_TRUE(coilMapping->getRegisterView().empty());
+}
+
+TEST_F(ProperReadingTest, UnfilteredMappingsKeepTheirValuesInTheImages)
+{
+    using namespace wolkabout::more_modbus;
+    const auto filtered =
+      std::make_shared<UInt16Mapping>("Filtered", RegisterType::HOLDING_REGISTER, 0, false, -1, 5.0);
+    const auto plain = std::make_shared<UInt16Mapping>("Plain", RegisterType::HOLDING_REGISTER, 1);
+    auto filterDevice = std::make_shared<ModbusDevice>("FILTER DEVICE", 1);
+    filterDevice->createGroups({filtered, plain});
+    EXPECT_TRUE(plain->m_byteValues.empty());
+    EXPECT_EQ(plain->m_imageRegisters.data(), plain->getRegisterView().data());
+    EXPECT_EQ(filtered->m_byteValues.size(), 1);
+    EXPECT_TRUE(filtered->m_imageRegisters.empty());
+
+    auto holdingData = std::vector<uint16_t>{10, 20};
+    EXPECT_CALL(*modbusClientMock, readHoldingRegisters)
+      .WillRepeatedly(DoAll(Invoke([&](int, int, int, std::vector<uint16_t>& values) { values = holdingData; }),
+                            Return(true)));
+    const auto& group = plain->getGroup().lock();
+    ASSERT_NE(group, nullptr);
+    EXPECT_TRUE(ModbusGroupReader::readGroup(*modbusClientMock, *group));
+    EXPECT_EQ(filtered->getBytesValues(), std::vector<uint16_t>{10});
+    EXPECT_EQ(plain->getBytesValues(), std::vector<uint16_t>{20});
+
+    // The deadband holds back the change of the filtered mapping, but not of the image.
+    holdingData = {12, 21};
+    EXPECT_TRUE(ModbusGroupReader::readGroup(*modbusClientMock, *group));
+    EXPECT_EQ(filtered->getBytesValues(), std::vector<uint16_t>{10});
+    EXPECT_EQ(filtered->getRegisterView()[0], 12);
+    EXPECT_EQ(plain->getBytesValues(), std::vector<uint16_t>{21});
+    EXPECT_EQ(plain->getValue(), 21);
+
+    // The mappings keep their values once the device is gone.
+    filterDevice.reset();
+    EXPECT_TRUE(plain->m_imageRegisters.empty());
+    EXPECT_EQ(plain->getBytesValues(), std::vector<uint16_t>{21});
+}
+
+TEST_F(ProperReadingTest, OnlyTheMappingsOfChangedRegistersAreDecoded)
+{
+    auto holdingData = std::vector<uint16_t>{1, 2, 3, 4, 0x15, 0x4865, 0x7921, 0, 0, 0};
+    EXPECT_CALL(*modbusClientMock, readHoldingRegisters)
+      .WillRepeatedly(DoAll(Invoke([&](int, int, int, std::vector<uint16_t>& values) { values = holdingData; }),
+                            Return(true)));
+    const auto& group = uint16Mapping->getGroup().lock();
+    ASSERT_NE(group, nullptr);
+    EXPECT_TRUE(wolkabout::more_modbus::ModbusGroupReader::readGroup(*modbusClientMock, *group));
+
+    // The registers of the string and of the bits change, the first register doesn't, so its mapping isn't decoded.
+    auto decoded = std::vector<std::string>{};
+    device->setOnMappingValueChange([&](const std::shared_ptr<wolkabout::more_modbus::RegisterMapping>& mapping,
+                                        const std::vector<uint16_t>&) {
+        decoded.emplace_back(mapping->getReference());
+    });
+    holdingData[4] = 0x14;
+    holdingData[9] = 0x2100;
+    EXPECT_TRUE(wolkabout::more_modbus::ModbusGroupReader::readGroup(*modbusClientMock, *group));
+    EXPECT_EQ(decoded, std::vector<std::string>{"HRSTR"});
+    EXPECT_FALSE(bitMapping->getBoolValue());
+    EXPECT_EQ(stringMapping->getBytesValues(), (std::vector<uint16_t>{0x4865, 0x7921, 0, 0, 0x2100}));
+    EXPECT_EQ(group->getChangeCount(), 2);
+}
+
+TEST_F(ProperReadingTest, RunsOfFloatsAreParsedAtOnce)
+{
+    using namespace wolkabout::more_modbus;
+    auto floats = std::vector<std::shared_ptr<FloatMapping>>{};
+    auto floatMappings = std::vector<std::shared_ptr<RegisterMapping>>{};
+    for (auto index = 0; index < 5; ++index)
+    {
+        floats.emplace_back(std::make_shared<FloatMapping>("F" + std::to_string(index), _registerType::INPUT_REGISTER,
+                                                           std::vector<std::int32_t>{index * 2, index * 2 + 1}));
+        floatMappings.emplace_back(floats.back());
+    }
+    const auto floatDevice = std::make_shared<ModbusDevice>("FLOAT DEVICE", 1);
+    floatDevice->createGroups(floatMappings);
+    const auto& group = floats.front()->getGroup().lock();
+    ASSERT_NE(group, nullptr);
+    EXPECT_EQ(group->getDecodePlan().front().decoder, DecodeStep::Decoder::FLOAT);
+    EXPECT_EQ(group->getDecodePlan().front().runLength, 5);
+
+    auto inputData = std::vector<uint16_t>{};
+    for (auto index = 0; index < 5; ++index)
+    {
+        const auto value = 1.5f * static_cast<float>(index);
+        const auto registers = DataParsers::floatToRegisters(value, DataParsers::Endian::BIG);
+        inputData.insert(inputData.end(), registers.cbegin(), registers.cend());
+    }
+    EXPECT_CALL(*modbusClientMock, readInputRegisters)
+      .WillRepeatedly(DoAll(SetArgReferee<3>(inputData), Return(true)));
+    EXPECT_TRUE(ModbusGroupReader::readGroup(*modbusClientMock, *group));
+    for (auto index = 0; index < 5; ++index)
+        EXPECT_FLOAT_EQ(floats[static_cast<std::size_t>(index)]->getValue(), 1.5f * static_cast<float>(index));
+}
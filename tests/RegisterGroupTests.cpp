@@ -112,3 +112,58 @@ TEST_F(RegisterGroupTests, InitialExampleTest)
 
     EXPECT_NO_THROW(readOnlyGroup->setDevice(std::make_shared<ModbusDeviceMock>()));
 }
+
+TEST_F(RegisterGroupTests, ClaimsAreKeptSorted)
+{
+    using namespace wolkabout::more_modbus;
+    const auto claim = GroupUtility::makeClaim(40012, 3);
+    EXPECT_EQ(GroupUtility::getAddress(claim), 40012);
+    EXPECT_EQ(GroupUtility::getBit(claim), 3);
+    EXPECT_EQ(GroupUtility::getBit(GroupUtility::makeClaim(40012)), -1);
+    EXPECT_EQ(GroupUtility::toString(claim), "40012.3");
+    EXPECT_LT(GroupUtility::makeClaim(40012), claim);
+    EXPECT_LT(claim, GroupUtility::makeClaim(40013));
+
+    // The mappings are added out of order, the claims and extents of the group stay sorted.
+    auto group = std::make_shared<RegisterGroup>(mappings[5], nullptr);
+    EXPECT_TRUE(group->addMapping(mappings[3]));
+    EXPECT_TRUE(group->addMapping(mappings[4]));
+    EXPECT_TRUE(group->addMapping(mappings[2]));
+    EXPECT_EQ(group->getStartingAddress(), 0);
+    EXPECT_EQ(group->getAddressCount(), 5);
+    EXPECT_EQ(group->getMappingsClaims(), (std::vector<std::string>{"0", "1", "2", "3", "4.0", "4.1"}));
+    EXPECT_EQ(group->getMappings().front().second, mappings[2]);
+    EXPECT_EQ(group->getMappings().back().second, mappings[5]);
+
+    // A multi-register mapping is copied once.
+    const auto copy = RegisterGroup(*group);
+    EXPECT_EQ(copy.getAddressCount(), 5);
+    EXPECT_EQ(copy.getMappings()[0].second, copy.getMappings()[2].second);
+    EXPECT_NE(copy.getMappings()[0].second, mappings[2]);
+}
+
+TEST_F(RegisterGroupTests, DecodePlanHasAStepForEachMapping)
+{
+    using namespace wolkabout::more_modbus;
+    auto group = std::make_shared<RegisterGroup>(mappings[2], nullptr);
+    EXPECT_TRUE(group->addMapping(mappings[3]));
+    EXPECT_TRUE(group->addMapping(mappings[4]));
+    group->compileDecodePlan();
+    ASSERT_EQ(group->getDecodePlan().size(), 3);
+    EXPECT_TRUE(group->getFilteredDecodePlan().empty());
+
+    const auto& string = group->getDecodePlan()[0];
+    EXPECT_EQ(string.offset, 0);
+    EXPECT_EQ(string.wordCount, 3);
+    EXPECT_EQ(string.decoder, DecodeStep::Decoder::REGISTERS);
+    EXPECT_EQ(string.mapping, mappings[2]);
+    EXPECT_EQ(group->getDecodePlan()[1].offset, 3);
+
+    // Adding a mapping compiles the plan again.
+    EXPECT_TRUE(group->addMapping(mappings[5]));
+    ASSERT_EQ(group->getDecodePlan().size(), 4);
+    const auto& bit = group->getDecodePlan()[3];
+    EXPECT_EQ(bit.offset, 4);
+    EXPECT_EQ(bit.bitIndex, 1);
+    EXPECT_EQ(bit.decoder, DecodeStep::Decoder::REGISTER_BIT);
+}
@@ -0,0 +1,80 @@
+/**
+ * Copyright 2023 Wolkabout Technology s.r.o.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "more_modbus/modbus/RoundTripEstimator.h"
+
+#include <gtest/gtest.h>
+
+#include <stdexcept>
+
+using namespace wolkabout::more_modbus;
+using namespace std::chrono;
+
+class RoundTripEstimatorTests : public ::testing::Test
+{
+public:
+    RoundTripEstimator estimator{milliseconds{10}, milliseconds{1000}};
+};
+
+TEST_F(RoundTripEstimatorTests, UnknownSlavesGetTheCeiling)
+{
+    EXPECT_EQ(estimator.getResponseTimeout(1, 0x03), milliseconds{1000});
+    EXPECT_EQ(estimator.getByteTimeout(1, 0x03), milliseconds{1000});
+
+    // There is nothing to back off from.
+    estimator.addTimeout(1, 0x03);
+    EXPECT_EQ(estimator.getResponseTimeout(1, 0x03), milliseconds{1000});
+
+    EXPECT_THROW(RoundTripEstimator(milliseconds{0}, milliseconds{10}), std::logic_error);
+    EXPECT_THROW(RoundTripEstimator(milliseconds{20}, milliseconds{10}), std::logic_error);
+}
+
+TEST_F(RoundTripEstimatorTests, FollowsTheRoundTripTime)
+{
+    // SRTT = 100, RTTVAR = 50, RTO = 100 + 4 * 50.
+    estimator.addSample(1, 0x03, milliseconds{100});
+    EXPECT_EQ(estimator.getResponseTimeout(1, 0x03), milliseconds{300});
+    EXPECT_EQ(estimator.getByteTimeout(1, 0x03), milliseconds{50});
+
+    // RTTVAR = (3 * 50 + 100) / 4 = 62.5, SRTT = (7 * 100 + 200) / 8 = 112.5, RTO = 112.5 + 250.
+    estimator.addSample(1, 0x03, milliseconds{200});
+    EXPECT_EQ(estimator.getResponseTimeout(1, 0x03), microseconds{362500});
+
+    // A steady round trip time lowers the variance, down to the floor.
+    for (auto i = 0; i < 100; ++i)
+        estimator.addSample(1, 0x03, milliseconds{1});
+    EXPECT_EQ(estimator.getResponseTimeout(1, 0x03), milliseconds{10});
+    EXPECT_EQ(estimator.getByteTimeout(1, 0x03), milliseconds{10});
+
+    // Other function codes and slaves are kept separately.
+    EXPECT_EQ(estimator.getResponseTimeout(1, 0x04), milliseconds{1000});
+    EXPECT_EQ(estimator.getResponseTimeout(2, 0x03), milliseconds{1000});
+}
+
+TEST_F(RoundTripEstimatorTests, TimeoutsBackOffUpToTheCeiling)
+{
+    estimator.addSample(1, 0x03, milliseconds{100});
+    estimator.addTimeout(1, 0x03);
+    EXPECT_EQ(estimator.getResponseTimeout(1, 0x03), milliseconds{600});
+    estimator.addTimeout(1, 0x03);
+    EXPECT_EQ(estimator.getResponseTimeout(1, 0x03), milliseconds{1000});
+
+    // The next response brings the timeout back to the estimate.
+    estimator.addSample(1, 0x03, milliseconds{100});
+    EXPECT_EQ(estimator.getResponseTimeout(1, 0x03), milliseconds{250});
+}
@@ -0,0 +1,95 @@
+/**
+ * Copyright 2023 Wolkabout Technology s.r.o.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#define private public
+#include "more_modbus/utilities/TimerWheel.h"
+#undef private
+
+#include <gtest/gtest.h>
+
+#include <stdexcept>
+
+using namespace wolkabout::more_modbus;
+using namespace std::chrono;
+
+class TimerWheelTests : public ::testing::Test
+{
+public:
+    TimerWheel wheel;
+    TimerWheel::Clock::time_point origin = wheel.m_origin;
+};
+
+TEST_F(TimerWheelTests, ExpiresTimersOfEveryLevel)
+{
+    wheel.schedule(1, origin + milliseconds{5});
+    wheel.schedule(2, origin + milliseconds{3});
+    wheel.schedule(3, origin + milliseconds{300});
+    wheel.schedule(4, origin + seconds{100});
+    EXPECT_EQ(wheel.size(), 4);
+
+    EXPECT_TRUE(wheel.advance(origin + milliseconds{2}).empty());
+    EXPECT_EQ(wheel.nextWakeUp(), origin + milliseconds{3});
+    EXPECT_EQ(wheel.advance(origin + milliseconds{5}), (std::vector<TimerWheel::TimerId>{2, 1}));
+
+    // The timers of the higher levels are moved down when the wheel reaches their slot.
+    EXPECT_EQ(wheel.nextWakeUp(), origin + milliseconds{256});
+    EXPECT_TRUE(wheel.advance(origin + milliseconds{299}).empty());
+    EXPECT_EQ(wheel.advance(origin + milliseconds{300}), (std::vector<TimerWheel::TimerId>{3}));
+    EXPECT_TRUE(wheel.advance(origin + milliseconds{99999}).empty());
+    EXPECT_EQ(wheel.advance(origin + seconds{100}), (std::vector<TimerWheel::TimerId>{4}));
+
+    EXPECT_TRUE(wheel.empty());
+    EXPECT_EQ(wheel.nextWakeUp(), TimerWheel::Clock::time_point::max());
+}
+
+TEST_F(TimerWheelTests, RescheduleAndCancel)
+{
+    wheel.schedule(1, origin + milliseconds{10});
+    wheel.schedule(1, origin + milliseconds{20});
+    EXPECT_EQ(wheel.size(), 1);
+    EXPECT_TRUE(wheel.advance(origin + milliseconds{15}).empty());
+    EXPECT_EQ(wheel.advance(origin + milliseconds{20}), (std::vector<TimerWheel::TimerId>{1}));
+    EXPECT_FALSE(wheel.isScheduled(1));
+
+    // A cancelled timer scheduled again at the same deadline expires only once.
+    wheel.schedule(2, origin + milliseconds{30});
+    EXPECT_TRUE(wheel.cancel(2));
+    EXPECT_FALSE(wheel.cancel(2));
+    wheel.schedule(2, origin + milliseconds{30});
+    EXPECT_EQ(wheel.advance(origin + milliseconds{40}), (std::vector<TimerWheel::TimerId>{2}));
+
+    // Deadlines in the past expire on the next tick.
+    wheel.schedule(3, origin);
+    EXPECT_TRUE(wheel.advance(origin + milliseconds{40}).empty());
+    EXPECT_EQ(wheel.advance(origin + milliseconds{41}), (std::vector<TimerWheel::TimerId>{3}));
+}
+
+TEST_F(TimerWheelTests, DeadlinesPastTheLastLevel)
+{
+    EXPECT_THROW(TimerWheel(milliseconds{0}), std::logic_error);
+
+    // Four slots in two levels cover 16 ticks.
+    auto small = TimerWheel{milliseconds{1}, 4, 2};
+    const auto start = small.m_origin;
+    small.schedule(1, start + milliseconds{100});
+    small.schedule(2, start + milliseconds{17});
+    EXPECT_TRUE(small.advance(start + milliseconds{16}).empty());
+    EXPECT_EQ(small.advance(start + milliseconds{17}), (std::vector<TimerWheel::TimerId>{2}));
+    EXPECT_TRUE(small.advance(start + milliseconds{99}).empty());
+    EXPECT_EQ(small.advance(start + milliseconds{100}), (std::vector<TimerWheel::TimerId>{1}));
+}
@@ -0,0 +1,68 @@
+/**
+ * Copyright 2023 Wolkabout Technology s.r.o.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "more_modbus/utilities/WordDiff.h"
+
+#include <gtest/gtest.h>
+
+#include <random>
+#include <vector>
+
+using namespace wolkabout::more_modbus;
+
+TEST(WordDiffTests, MarksTheRegistersThatDiffer)
+{
+    auto left = std::vector<std::uint16_t>(130, 0x1234);
+    auto right = left;
+    for (const auto index : {0, 7, 8, 63, 64, 100, 129})
+        right[static_cast<std::size_t>(index)] ^= 0x8000;
+
+    auto mask = std::vector<std::uint64_t>(3, 0);
+    EXPECT_EQ(WordDiff::compare(left.data(), right.data(), left.size(), mask.data()), 7u);
+    EXPECT_EQ(mask[0], (std::uint64_t{1} << 0) | (std::uint64_t{1} << 7) | (std::uint64_t{1} << 8) |
+                         (std::uint64_t{1} << 63));
+    EXPECT_EQ(mask[1], (std::uint64_t{1} << 0) | (std::uint64_t{1} << 36));
+    EXPECT_EQ(mask[2], std::uint64_t{1} << 1);
+
+    EXPECT_EQ(WordDiff::lowestBit(mask[1]), 0u);
+    EXPECT_EQ(WordDiff::lowestBit(mask[2]), 1u);
+    EXPECT_EQ(WordDiff::countBits(mask[0]), 4u);
+}
+
+TEST(WordDiffTests, MatchesTheScalarComparison)
+{
+    auto random = std::mt19937{42};
+    for (const auto count : {0, 1, 7, 8, 15, 16, 17, 31, 64, 65, 127, 200})
+    {
+        auto left = std::vector<std::uint16_t>(static_cast<std::size_t>(count));
+        for (auto& value : left)
+            value = static_cast<std::uint16_t>(random());
+        auto right = left;
+        for (auto& value : right)
+        {
+            if (random() % 5 == 0)
+                value = static_cast<std::uint16_t>(value + 1);
+        }
+
+        auto mask = std::vector<std::uint64_t>((left.size() + 63) / 64 + 1, 0);
+        auto expected = mask;
+        EXPECT_EQ(WordDiff::compare(left.data(), right.data(), left.size(), mask.data()),
+                  WordDiff::compareScalar(left.data(), right.data(), left.size(), expected.data()));
+        EXPECT_EQ(mask, expected) << "count " << count;
+    }
+}
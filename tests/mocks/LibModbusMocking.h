@@ -37,6 +37,7 @@ public:
      * General necessary modbus functions
      */
     MOCK_METHOD3(modbus_set_response_timeout, int(modbus_t*, uint32_t, uint32_t));
+    MOCK_METHOD3(modbus_set_byte_timeout, int(modbus_t*, uint32_t, uint32_t));
     MOCK_METHOD1(modbus_connect, int(modbus_t*));
     MOCK_METHOD1(modbus_flush, int(modbus_t*));
     MOCK_METHOD1(modbus_close, void(modbus_t*));
@@ -53,6 +54,7 @@ public:
     MOCK_METHOD3(modbus_write_register, int(modbus_t*, int, const uint16_t));
     MOCK_METHOD4(modbus_write_bits, int(modbus_t*, int, int, const uint8_t*));
     MOCK_METHOD4(modbus_write_registers, int(modbus_t*, int, int, const uint16_t*));
+    MOCK_METHOD4(modbus_mask_write_register, int(modbus_t*, int, uint16_t, uint16_t));
 
     /*
      * Ones necessary for specific ModbusClient implementations
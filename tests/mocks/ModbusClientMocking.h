@@ -28,6 +28,7 @@
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 
+#include <algorithm>
 #include <iostream>
 #include <memory>
 
@@ -45,8 +46,10 @@ public:
     MOCK_METHOD0(disconnect, bool());
     MOCK_METHOD0(isConnected, bool());
     MOCK_METHOD3(writeHoldingRegister, bool(int, int, uint16_t));
-    MOCK_METHOD3(writeHoldingRegisters, bool(int, int, std::vector<uint16_t>));
+    MOCK_METHOD3(writeHoldingRegisters, bool(int, int, std::vector<uint16_t>&));
+    MOCK_METHOD4(maskWriteHoldingRegister, bool(int, int, uint16_t, uint16_t));
     MOCK_METHOD3(writeCoil, bool(int, int, bool));
+    MOCK_METHOD3(writeCoils, bool(int, int, std::vector<bool>&));
     MOCK_METHOD4(readInputContacts, bool(int, int, int, std::vector<bool>&));
     MOCK_METHOD4(readInputRegisters, bool(int, int, int, std::vector<uint16_t>&));
     MOCK_METHOD3(readHoldingRegister, bool(int, int, uint16_t&));
@@ -54,6 +57,44 @@ public:
     MOCK_METHOD3(readCoil, bool(int, int, bool&));
     MOCK_METHOD4(readCoils, bool(int, int, int, std::vector<bool>&));
     MOCK_METHOD1(changeSlaveAddress, bool(int));
+
+    // The buffer reads are forwarded to the mocked vector reads, so expectations cover both. At most `number`
+    // values are copied, as the expectations may return more.
+    bool readInputContacts(int slaveAddress, int address, int number, uint8_t* values) override
+    {
+        auto bits = std::vector<bool>{};
+        if (!readInputContacts(slaveAddress, address, number, bits))
+            return false;
+        std::copy_n(bits.cbegin(), std::min(bits.size(), static_cast<std::size_t>(number)), values);
+        return true;
+    }
+
+    bool readInputRegisters(int slaveAddress, int address, int number, uint16_t* values) override
+    {
+        auto registers = std::vector<uint16_t>{};
+        if (!readInputRegisters(slaveAddress, address, number, registers))
+            return false;
+        std::copy_n(registers.cbegin(), std::min(registers.size(), static_cast<std::size_t>(number)), values);
+        return true;
+    }
+
+    bool readHoldingRegisters(int slaveAddress, int address, int number, uint16_t* values) override
+    {
+        auto registers = std::vector<uint16_t>{};
+        if (!readHoldingRegisters(slaveAddress, address, number, registers))
+            return false;
+        std::copy_n(registers.cbegin(), std::min(registers.size(), static_cast<std::size_t>(number)), values);
+        return true;
+    }
+
+    bool readCoils(int slaveAddress, int address, int number, uint8_t* values) override
+    {
+        auto bits = std::vector<bool>{};
+        if (!readCoils(slaveAddress, address, number, bits))
+            return false;
+        std::copy_n(bits.cbegin(), std::min(bits.size(), static_cast<std::size_t>(number)), values);
+        return true;
+    }
 };
 
 #endif    // MOREMODBUS_MODBUSCLIENTMOCKING_H
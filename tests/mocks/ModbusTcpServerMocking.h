@@ -0,0 +1,175 @@
+/**
+ * Copyright 2023 Wolkabout Technology s.r.o.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef MOREMODBUS_MODBUSTCPSERVERMOCKING_H
+#define MOREMODBUS_MODBUSTCPSERVERMOCKING_H
+
+#include "more_modbus/modbus/ModbusTcpCodec.h"
+
+#include <arpa/inet.h>
+#include <atomic>
+#include <cstdint>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+/**
+ * Minimal Modbus/TCP server on the loopback interface. Every register holds its own address plus the offset, every
+ * coil/contact is on, and writes are acknowledged. Serves any number of connections from a single thread.
+ */
+class ModbusTcpServerMock
+{
+public:
+    ModbusTcpServerMock()
+    {
+        m_listener = socket(AF_INET, SOCK_STREAM, 0);
+        auto address = sockaddr_in{};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        address.sin_port = 0;
+        bind(m_listener, reinterpret_cast<sockaddr*>(&address), sizeof(address));
+        listen(m_listener, 16);
+        auto length = static_cast<socklen_t>(sizeof(address));
+        getsockname(m_listener, reinterpret_cast<sockaddr*>(&address), &length);
+        port = ntohs(address.sin_port);
+
+        m_running = true;
+        m_thread = std::thread(&ModbusTcpServerMock::run, this);
+    }
+
+    ~ModbusTcpServerMock()
+    {
+        m_running = false;
+        m_thread.join();
+        for (const auto& connection : m_connections)
+        {
+            if (connection.socket != -1)
+                close(connection.socket);
+        }
+        close(m_listener);
+    }
+
+    std::uint16_t port = 0;
+    std::atomic_bool respond{true};
+    std::atomic<std::uint16_t> offset{0};
+    std::atomic_int requests{0};
+
+private:
+    struct Connection
+    {
+        int socket;
+        std::vector<std::uint8_t> buffer;
+    };
+
+    void run()
+    {
+        while (m_running)
+        {
+            auto descriptors = std::vector<pollfd>{{m_listener, POLLIN, 0}};
+            for (const auto& connection : m_connections)
+                descriptors.push_back({connection.socket, POLLIN, 0});
+            if (poll(descriptors.data(), descriptors.size(), 20) <= 0)
+                continue;
+
+            if ((descriptors[0].revents & POLLIN) != 0)
+                m_connections.push_back({accept(m_listener, nullptr, nullptr), {}});
+            for (auto i = std::size_t{1}; i < descriptors.size(); ++i)
+            {
+                if ((descriptors[i].revents & (POLLIN | POLLHUP)) != 0)
+                    serve(m_connections[i - 1]);
+            }
+        }
+    }
+
+    void serve(Connection& connection)
+    {
+        std::uint8_t data[1024];
+        const auto received = recv(connection.socket, data, sizeof(data), MSG_DONTWAIT);
+        if (received <= 0)
+        {
+            // Negative descriptors are ignored by poll.
+            close(connection.socket);
+            connection.socket = -1;
+            return;
+        }
+        connection.buffer.insert(connection.buffer.end(), data, data + received);
+
+        while (connection.buffer.size() >= wolkabout::more_modbus::ModbusTcpCodec::HEADER_SIZE)
+        {
+            const auto length = static_cast<std::size_t>((connection.buffer[4] << 8) | connection.buffer[5]);
+            const auto frameSize = wolkabout::more_modbus::ModbusTcpCodec::HEADER_SIZE - 1 + length;
+            if (connection.buffer.size() < frameSize)
+                break;
+
+            const auto frameEnd = connection.buffer.begin() + static_cast<std::ptrdiff_t>(frameSize);
+            const auto frame = std::vector<std::uint8_t>(connection.buffer.begin(), frameEnd);
+            connection.buffer.erase(connection.buffer.begin(), frameEnd);
+            ++requests;
+            if (respond)
+                answer(connection.socket, frame);
+        }
+    }
+
+    void answer(int socket, const std::vector<std::uint8_t>& request)
+    {
+        const auto transactionId = static_cast<std::uint16_t>((request[0] << 8) | request[1]);
+        const auto function = request[7];
+        const auto address = (request[8] << 8) | request[9];
+        const auto number = (request[10] << 8) | request[11];
+
+        auto pdu = std::vector<std::uint8_t>{function};
+        if (function == 0x01 || function == 0x02)
+        {
+            const auto bytes = number / 8 + (number % 8 != 0);
+            pdu.push_back(static_cast<std::uint8_t>(bytes));
+            for (auto i = 0; i < bytes; ++i)
+                pdu.push_back(0xFF);
+            // The bits after the last requested one have to be zero.
+            if (number % 8 != 0)
+                pdu.back() = static_cast<std::uint8_t>((1 << (number % 8)) - 1);
+        }
+        else if (function == 0x03 || function == 0x04)
+        {
+            pdu.push_back(static_cast<std::uint8_t>(number * 2));
+            for (auto i = 0; i < number; ++i)
+            {
+                const auto value = static_cast<std::uint16_t>(address + i + offset);
+                pdu.push_back(static_cast<std::uint8_t>(value >> 8));
+                pdu.push_back(static_cast<std::uint8_t>(value & 0xFF));
+            }
+        }
+        else
+        {
+            // Mask writes echo both masks, the other writes the address and the value/quantity.
+            pdu.assign(request.begin() + 7, function == 0x16 ? request.end() : request.begin() + 12);
+        }
+
+        const auto frame = wolkabout::more_modbus::ModbusTcpCodec::encodeFrame(transactionId, request[6], pdu);
+        send(socket, frame.data(), frame.size(), MSG_NOSIGNAL);
+    }
+
+    int m_listener = -1;
+    std::atomic_bool m_running{false};
+    std::thread m_thread;
+    std::vector<Connection> m_connections;
+};
+
+#endif    // MOREMODBUS_MODBUSTCPSERVERMOCKING_H
@@ -29,9 +29,7 @@
 
 using namespace ::testing;
 
-typedef std::set<std::pair<std::string, std::shared_ptr<wolkabout::more_modbus::RegisterMapping>>,
-                 wolkabout::more_modbus::GroupUtility>
-  MappingsMap;
+typedef wolkabout::more_modbus::MappingsMap MappingsMap;
 
 class RegisterGroupMock : public wolkabout::more_modbus::RegisterGroup
 {
@@ -84,7 +84,7 @@ public:
     MOCK_METHOD1(update, bool(const std::vector<uint16_t>&));
     MOCK_METHOD1(doesUpdate, bool(const std::vector<uint16_t>&));
     MOCK_METHOD1(update, bool(bool));
-    MOCK_METHOD0(getBytesValues, std::vector<uint16_t>&());
+    MOCK_METHOD0(getBytesValues, std::vector<uint16_t>());
     MOCK_METHOD0(getBoolValue, bool());
     MOCK_METHOD0(isInitialized, bool());
     MOCK_METHOD0(isValid, bool());